@@ -0,0 +1,171 @@
+import argparse, os, struct, time
+import numpy as np
+import pandas as pd
+from scipy.linalg import pinv
+from sklearn.preprocessing import MinMaxScaler, OneHotEncoder
+
+# Quantization constants shared with firmware/main/dsp/elm.h
+INPUT_MAX_MAGNITUDE = 127
+HIDDEN_MAX = 32767
+INPUT_VECTOR_LANES = 16
+HIDDEN_VECTOR_LANES = 8
+SIMD_ACCUMULATOR_MAX = (1 << 39) - 1
+WEIGHT_SCALE = np.sqrt(3.0) / INPUT_MAX_MAGNITUDE  # Gives the uniform int8 projection the unit variance of the original Gaussian one
+BATCH_SIZE = 2048
+
+def stride(size, lanes):
+  return ((size + lanes - 1) // lanes) * lanes
+
+def generate_projection(seed, input_size, hidden_size):
+  # Reproduce the xorshift32 stream used by elm_init(): input weights row by row for each hidden neuron, then the biases
+  state = seed if seed else 1
+  values = np.empty(hidden_size * input_size + hidden_size, dtype=np.int8)
+  for n in range(values.size):
+    state ^= (state << 13) & 0xFFFFFFFF
+    state ^= state >> 17
+    state ^= (state << 5) & 0xFFFFFFFF
+    value = (state >> 24) - 256 if (state >> 24) >= 128 else (state >> 24)
+    values[n] = -INPUT_MAX_MAGNITUDE if value == -128 else value
+  return values[:hidden_size * input_size].reshape(hidden_size, input_size), values[hidden_size * input_size:]
+
+def quantize_input(x_normalized, input_scale):
+  # Matches elm_quantize_input(): single-precision scaling, round-half-even, and symmetric saturation
+  scaled = x_normalized.astype(np.float32) * (np.float32(1.0) / np.float32(input_scale))
+  return np.clip(np.rint(scaled), -INPUT_MAX_MAGNITUDE, INPUT_MAX_MAGNITUDE).astype(np.int64)
+
+def hidden_accumulators(x_quantized, projection, bias_accumulators):
+  return (x_quantized @ projection.T.astype(np.int64)) + bias_accumulators
+
+def requantize_hidden(accumulators, hidden_shift):
+  rounding = (1 << (hidden_shift - 1)) if hidden_shift else 0
+  return np.minimum((np.maximum(accumulators, 0) + rounding) >> hidden_shift, HIDDEN_MAX) * (accumulators > 0)
+
+def quantized_predict(x_normalized, model):
+  # Integer pipeline identical to elm_infer(), evaluated in batches to bound memory use
+  predictions = np.empty(x_normalized.shape[0], dtype=np.int64)
+  for start in range(0, x_normalized.shape[0], BATCH_SIZE):
+    x_quantized = quantize_input(x_normalized[start:start + BATCH_SIZE], model['input_scale'])
+    hidden = requantize_hidden(hidden_accumulators(x_quantized, model['projection'], model['bias_accumulators']), model['hidden_shift'])
+    predictions[start:start + BATCH_SIZE] = np.argmax(hidden @ model['output_weights'].T.astype(np.int64), axis=1)
+  return predictions
+
+def export_model(x_train, y_train, hidden_size, seed):
+  # Train the float ELM exactly as main.py does, but on the projection that the node can regenerate from the seed
+  input_size = x_train.shape[1]
+  projection, bias_weights = generate_projection(seed, input_size, hidden_size)
+  input_weights = projection.T.astype(np.float64) * WEIGHT_SCALE
+  biases = bias_weights.astype(np.float64) * WEIGHT_SCALE
+  def hidden_nodes(x):
+    return np.maximum(0, np.dot(x, input_weights) + biases)
+  output_weights = np.dot(pinv(hidden_nodes(x_train)), y_train)
+
+  # Choose the input scale from the training range and the hidden shift so that no training activation saturates
+  input_scale = np.float32(max(np.abs(x_train).max(), 1.0e-6) / INPUT_MAX_MAGNITUDE)
+  bias_accumulators = np.rint(bias_weights.astype(np.float32) / input_scale).astype(np.int64)
+  max_accumulator = 0
+  for start in range(0, x_train.shape[0], BATCH_SIZE):
+    x_quantized = quantize_input(x_train[start:start + BATCH_SIZE], input_scale)
+    max_accumulator = max(max_accumulator, int(hidden_accumulators(x_quantized, projection, bias_accumulators).max()))
+  hidden_shift = 0
+  while ((max_accumulator + ((1 << (hidden_shift - 1)) if hidden_shift else 0)) >> hidden_shift) > HIDDEN_MAX:
+    hidden_shift += 1
+
+  # Fold the hidden scale into the readout and quantize it so that no dot product can overflow the 40-bit SIMD accumulator
+  hidden_scale = float(input_scale) * WEIGHT_SCALE * (1 << hidden_shift)
+  readout = output_weights.T * hidden_scale
+  max_weight = min(HIDDEN_MAX, SIMD_ACCUMULATOR_MAX // (hidden_size * HIDDEN_MAX))
+  output_scale = max(np.abs(readout).max(), 1.0e-12) / max_weight
+  quantized_readout = np.clip(np.rint(readout / output_scale), -max_weight, max_weight).astype(np.int16)
+  return {
+    'input_size': input_size, 'hidden_size': hidden_size, 'output_size': y_train.shape[1], 'seed': seed,
+    'projection': projection, 'bias_accumulators': bias_accumulators, 'input_scale': input_scale, 'hidden_shift': hidden_shift,
+    'output_weights': quantized_readout, 'output_scale': np.float32(output_scale),
+    'float_predict': lambda x: np.argmax(np.dot(hidden_nodes(x), output_weights), axis=1)
+  }
+
+def padded_output_weights(model):
+  padded = np.zeros((model['output_size'], stride(model['hidden_size'], HIDDEN_VECTOR_LANES)), dtype=np.int16)
+  padded[:, :model['hidden_size']] = model['output_weights']
+  return padded
+
+def write_binary_model(path, model, feature_offset, feature_scale):
+  # Layout read by firmware/host/bench_elm.c
+  with open(path, 'wb') as f:
+    f.write(b'ELM1' + struct.pack('<5I2f', model['input_size'], model['hidden_size'], model['output_size'], model['seed'],
+                                  model['hidden_shift'], model['input_scale'], model['output_scale']))
+    f.write(feature_offset.astype('<f4').tobytes() + feature_scale.astype('<f4').tobytes())
+    f.write(padded_output_weights(model).astype('<i2').tobytes())
+
+def write_binary_test_set(path, features, labels, float_predictions, quantized_predictions):
+  with open(path, 'wb') as f:
+    f.write(b'ELMT' + struct.pack('<2I', features.shape[0], features.shape[1]))
+    for values in (labels, float_predictions, quantized_predictions):
+      f.write(values.astype(np.uint8).tobytes())
+    f.write(features.astype('<f4').tobytes())
+
+def write_c_header(path, model, feature_offset, feature_scale):
+  # Constant model for the firmware: only the normalization, scales, and readout are stored, never the projection
+  def float_literal(value):
+    text = f'{value:.9g}'
+    return text + ('f' if any(c in text for c in '.e') else '.0f')
+  def float_array(values):
+    return ',\n'.join('   ' + ', '.join(float_literal(v) for v in values[i:i + 8]) for i in range(0, len(values), 8))
+  weights = padded_output_weights(model).ravel()
+  with open(path, 'w') as f:
+    f.write('// Generated by ai/elm/export.py, do not edit\n#include "elm.h"\n\n')
+    f.write(f'static const float elm_model_feature_offset[{model["input_size"]}] = {{\n{float_array(feature_offset)}\n}};\n\n')
+    f.write(f'static const float elm_model_feature_scale[{model["input_size"]}] = {{\n{float_array(feature_scale)}\n}};\n\n')
+    f.write(f'static const int16_t elm_model_output_weights[{weights.size}] __attribute__((aligned(16))) = {{\n')
+    f.write(',\n'.join('   ' + ', '.join(str(int(v)) for v in weights[i:i + 16]) for i in range(0, weights.size, 16)) + '\n};\n\n')
+    f.write('static const elm_model_t elm_model = {\n')
+    f.write(f'   .input_size = {model["input_size"]}, .hidden_size = {model["hidden_size"]}, .output_size = {model["output_size"]},\n')
+    f.write(f'   .projection_seed = {model["seed"]}u, .hidden_shift = {model["hidden_shift"]},\n')
+    f.write(f'   .input_scale = {float_literal(model["input_scale"])}, .output_scale = {float_literal(model["output_scale"])},\n')
+    f.write('   .feature_offset = elm_model_feature_offset, .feature_scale = elm_model_feature_scale,\n')
+    f.write('   .output_weights = elm_model_output_weights\n};\n')
+
+if __name__ == '__main__':
+
+  parser = argparse.ArgumentParser(description='Train and export a quantized ELM for the fixed-point inference engine in firmware/main/dsp/elm.c')
+  parser.add_argument('--train', default='mnist_train.csv', help='training CSV with the label in the first column')
+  parser.add_argument('--test', default='mnist_test.csv', help='test CSV with the label in the first column')
+  parser.add_argument('--hidden-size', type=int, default=1000)
+  parser.add_argument('--seed', type=int, default=12345, help='xorshift32 seed from which the node regenerates the projection')
+  parser.add_argument('--output-dir', default='.')
+  args = parser.parse_args()
+
+  # Load and normalize the dataset as main.py does
+  train = pd.read_csv(args.train)
+  test = pd.read_csv(args.test)
+  onehotencoder = OneHotEncoder(categories='auto')
+  scaler = MinMaxScaler()
+  scaler.fit(train.to_numpy()[:, 1:])
+  y_train = onehotencoder.fit_transform(train.to_numpy()[:, :1]).toarray()
+  x_test_raw = test.to_numpy()[:, 1:].astype(np.float32)
+  y_test = np.argmax(onehotencoder.transform(test.to_numpy()[:, :1]).toarray(), axis=1)
+
+  # Store the scaler as a per-feature offset and scale applied in single precision, exactly as the engine applies it
+  feature_offset = scaler.data_min_.astype(np.float32)
+  feature_scale = scaler.scale_.astype(np.float32)
+  x_train = (train.to_numpy()[:, 1:].astype(np.float32) - feature_offset) * feature_scale
+  x_test = (x_test_raw - feature_offset) * feature_scale
+
+  # Train, quantize, and compare the integer pipeline against the float model
+  model = export_model(x_train, y_train, args.hidden_size, args.seed)
+  start = time.perf_counter()
+  float_predictions = model['float_predict'](x_test)
+  float_seconds = time.perf_counter() - start
+  start = time.perf_counter()
+  quantized_predictions = quantized_predict(x_test, model)
+  quantized_seconds = time.perf_counter() - start
+  print(f'Float model accuracy:     {np.mean(float_predictions == y_test) * 100:.2f}% ({x_test.shape[0] / float_seconds:.0f} inferences/s in NumPy)')
+  print(f'Quantized model accuracy: {np.mean(quantized_predictions == y_test) * 100:.2f}% ({x_test.shape[0] / quantized_seconds:.0f} inferences/s in NumPy)')
+  print(f'Prediction agreement:     {np.mean(float_predictions == quantized_predictions) * 100:.2f}%')
+  print(f'Hidden shift {model["hidden_shift"]}, input scale {model["input_scale"]:.6g}, output scale {model["output_scale"]:.6g}, '
+        f'{padded_output_weights(model).nbytes + 8 * model["input_size"]} bytes stored instead of {model["projection"].nbytes + padded_output_weights(model).nbytes} bytes')
+
+  # Export the model for the firmware and the host build, along with the raw test set for parity checking
+  os.makedirs(args.output_dir, exist_ok=True)
+  write_c_header(os.path.join(args.output_dir, 'elm_model_data.h'), model, feature_offset, feature_scale)
+  write_binary_model(os.path.join(args.output_dir, 'elm_model.bin'), model, feature_offset, feature_scale)
+  write_binary_test_set(os.path.join(args.output_dir, 'elm_test.bin'), x_test_raw, y_test, float_predictions, quantized_predictions)
@@ -0,0 +1,258 @@
+import argparse, csv, heapq, json, os, queue, socket, struct, sys, threading, time
+import numpy as np
+
+import features
+from scan_archive import gunshot_classes
+
+# Aggregator window query protocol (software/aggregator/query_protocol.hpp)
+query_default_port = 5001
+query_segment_header = struct.Struct('<IIdddfI32s')
+num_classes = 521
+
+class DeviceStream:
+  # One node's decimated audio, cut into patches on the node's own patch grid as it arrives; overlapping deliveries are
+  #   trimmed to what is new, and a gap in the audio restarts the grid at the first sample after it
+  def __init__(self, device, name):
+    self.device, self.name = device, name
+    self.samples = np.zeros(0, dtype=np.float32)
+    self.start = self.end = None  # GPS times of the first buffered sample and just past the newest sample received
+
+  def append(self, timestamp, samples):
+    if self.end is not None:
+      new_first = int(round((self.end - timestamp) * features.sample_rate))
+      if new_first >= len(samples):
+        return []
+      if new_first > 0:
+        samples, timestamp = samples[new_first:], timestamp + new_first / features.sample_rate
+      elif new_first < 0:
+        self.samples = self.samples[:0]
+    if not len(self.samples):
+      self.start = timestamp
+    self.samples = np.concatenate([self.samples, samples.astype(np.float32) / 32768.0])
+    self.end = timestamp + len(samples) / features.sample_rate
+    patches = []
+    while len(self.samples) >= features.patch_samples:
+      patches.append((self.start, features.log_mel_patches(self.samples[:features.patch_samples])[0]))
+      self.samples = self.samples[features.patch_hop_samples:]
+      self.start += features.patch_hop_seconds
+    return patches
+
+def receive_exactly(connection, num_bytes):
+  data = bytearray()
+  while len(data) < num_bytes:
+    chunk = connection.recv(num_bytes - len(data))
+    if not chunk:
+      raise ConnectionError('Aggregator closed the connection mid-response')
+    data.extend(chunk)
+  return bytes(data)
+
+def query_aggregator(server, port, start, end):
+  # Every node's decimated audio in a window, as (device, name, timestamp, int16 samples) in device and time order
+  with socket.create_connection((server, port), timeout=10.0) as connection:
+    connection.sendall(b'%.6f %.6f %d\n' % (start, end, features.sample_rate))
+    num_segments, = struct.unpack('<I', receive_exactly(connection, 4))
+    segments = []
+    for _ in range(num_segments):
+      device, _, timestamp, _, _, _, num_samples, name = query_segment_header.unpack(receive_exactly(connection, query_segment_header.size))
+      samples = np.frombuffer(receive_exactly(connection, 2 * num_samples), dtype='<i2')
+      segments.append((device, name.split(b'\0', 1)[0].decode(errors='replace'), timestamp, samples))
+    return segments
+
+class TFLiteBackend:
+  # YAMNet classifier (models/model.py) converted to TensorFlow Lite, with one interpreter per power-of-two batch size so
+  #   that a partial batch is padded to at most twice its size rather than to the largest batch, each running on XNNPACK
+  #   (the default CPU delegate for float models) with the given number of threads
+  def __init__(self, model_path, weights, max_batch, threads):
+    if not os.path.exists(model_path):
+      if not weights:
+        sys.exit('%s does not exist; give --weights to convert it from the Keras model' % model_path)
+      import tensorflow as tf
+      from models.model import yamnet_patches_model
+      model = yamnet_patches_model()
+      model.load_weights(weights, by_name=True)
+      with open(model_path, 'wb') as output:
+        output.write(tf.lite.TFLiteConverter.from_keras_model(model).convert())
+      print('Converted %s to %s' % (weights, model_path))
+    try:
+      from tflite_runtime.interpreter import Interpreter
+    except ImportError:
+      from tensorflow.lite import Interpreter
+    self.make_interpreter = lambda: Interpreter(model_path=model_path, num_threads=threads)
+    self.sizes = sorted({min(1 << i, max_batch) for i in range(max_batch.bit_length() + 1)})
+    self.interpreters = {}
+
+  def interpreter(self, size):
+    if size not in self.interpreters:
+      interpreter = self.make_interpreter()
+      interpreter.resize_tensor_input(interpreter.get_input_details()[0]['index'], [size, features.patch_frames, features.mel_bands])
+      interpreter.allocate_tensors()
+      scores = [output for output in interpreter.get_output_details() if output['shape'][-1] == num_classes]
+      self.interpreters[size] = (interpreter, interpreter.get_input_details()[0]['index'], scores[0]['index'])
+    return self.interpreters[size]
+
+  def __call__(self, patches):
+    size = next(size for size in self.sizes if size >= len(patches))
+    interpreter, input_index, scores_index = self.interpreter(size)
+    batch = np.zeros((size, features.patch_frames, features.mel_bands), dtype=np.float32)
+    batch[:len(patches)] = patches
+    interpreter.set_tensor(input_index, batch)
+    interpreter.invoke()
+    return interpreter.get_tensor(scores_index)[:len(patches)]
+
+class SyntheticBackend:
+  # Stand-in with a fixed cost per call and per patch, for exercising the batcher where TensorFlow Lite is not installed
+  def __init__(self, call_ms, patch_ms):
+    self.call_seconds, self.patch_seconds = call_ms / 1000.0, patch_ms / 1000.0
+
+  def __call__(self, patches):
+    time.sleep(self.call_seconds + (self.patch_seconds * len(patches)))
+    return np.zeros((len(patches), num_classes), dtype=np.float32)
+
+class BatchingService:
+  # Gathers patches from every node into one queue and classifies them in batches of up to "max_batch", each launched as
+  #   soon as it is full or the oldest patch in it has waited "max_wait" seconds, handing every result to "route"
+  def __init__(self, backend, max_batch, max_wait, route):
+    self.backend, self.max_batch, self.max_wait, self.route = backend, max_batch, max_wait, route
+    self.requests = queue.Queue()
+    self.latencies, self.batch_sizes = [], []
+    self.thread = threading.Thread(target=self.run, daemon=True)
+    self.thread.start()
+
+  def submit(self, device, name, timestamp, patch, ready=None):
+    self.requests.put((device, name, timestamp, patch, time.monotonic() if ready is None else ready))
+
+  def stop(self):
+    # Finish everything already submitted, then stop
+    self.requests.put(None)
+    self.thread.join()
+
+  def run(self):
+    stopping = False
+    while not stopping:
+      first = self.requests.get()
+      if first is None:
+        break
+      batch, deadline = [first], first[4] + self.max_wait
+      while len(batch) < self.max_batch:
+        try:
+          request = self.requests.get(timeout=max(deadline - time.monotonic(), 0.0)) if deadline > time.monotonic() else self.requests.get_nowait()
+        except queue.Empty:
+          break
+        if request is None:
+          stopping = True
+          break
+        batch.append(request)
+      scores = self.backend(np.stack([request[3] for request in batch]))
+      finished = time.monotonic()
+      self.batch_sizes.append(len(batch))
+      for request, row in zip(batch, scores):
+        self.latencies.append(finished - request[4])
+        self.route(request[0], request[1], request[2], row)
+
+def latency_summary(latencies):
+  return (1e3 * np.percentile(latencies, 50), 1e3 * np.percentile(latencies, 99)) if latencies else (0.0, 0.0)
+
+def run_benchmark(args, backend):
+  # Simulate each node count delivering one patch per node every patch hop, each node at its own phase, and measure how
+  #   long patches wait for their scores with dynamic batching and with one call per patch
+  print('%6s %9s %12s %10s %10s %10s %8s' % ('nodes', 'max batch', 'patches/s', 'p50 ms', 'p99 ms', 'mean batch', 'backlog'))
+  rng = np.random.default_rng(1)
+  pool = rng.standard_normal((64, features.patch_frames, features.mel_bands)).astype(np.float32)
+  for num_nodes in args.bench_nodes:
+    for max_batch in sorted({1, args.max_batch}):
+      service = BatchingService(backend, max_batch, args.max_wait, lambda *result: None)
+      began = time.monotonic()
+      schedule = [(began + rng.uniform(0.0, features.patch_hop_seconds), node) for node in range(num_nodes)]
+      heapq.heapify(schedule)
+      submitted = 0
+      while schedule[0][0] < began + args.bench_seconds:
+        ready, node = heapq.heappop(schedule)
+        time.sleep(max(ready - time.monotonic(), 0.0))
+        service.submit(node, 'node%d' % node, ready - began, pool[submitted % len(pool)], ready)
+        submitted += 1
+        heapq.heappush(schedule, (ready + features.patch_hop_seconds, node))
+      backlog = service.requests.qsize()
+      service.stop()
+      elapsed = time.monotonic() - began
+      p50, p99 = latency_summary(service.latencies)
+      print('%6d %9d %12.1f %10.1f %10.1f %10.2f %8d%s' % (num_nodes, max_batch, len(service.latencies) / elapsed, p50, p99,
+            np.mean(service.batch_sizes), backlog, '  (cannot keep up)' if backlog > num_nodes else ''), flush=True)
+  return 0
+
+def run_service(args, backend):
+  # Poll the aggregator for new audio from every node, classifying each patch as soon as it is complete and writing each
+  #   result, tagged with its node and GPS time, as a JSON line
+  with open(args.class_map) as names:
+    display_names = [row['display_name'] for row in csv.DictReader(names)]
+  indices = [display_names.index(name) for name in args.classes]
+  output = open(args.output, 'a') if args.output else sys.stdout
+  lock = threading.Lock()
+
+  def route(device, name, timestamp, scores):
+    watched = scores[indices]
+    best = int(np.argmax(watched))
+    result = {'device': device, 'name': name, 'timestamp': round(timestamp, 6), 'top': display_names[int(np.argmax(scores))],
+              'score': round(float(watched[best]), 4), 'class': args.classes[best]}
+    with lock:
+      output.write(json.dumps(result) + '\n')
+      output.flush()
+      if watched[best] >= args.threshold:
+        print('[%.3f] %s: %s (%.2f)' % (timestamp, name, args.classes[best], watched[best]), file=sys.stderr, flush=True)
+
+  service = BatchingService(backend, args.max_batch, args.max_wait, route)
+  streams, start, last_report = {}, -args.lookback, time.monotonic()
+  try:
+    while True:
+      began = time.monotonic()
+      try:
+        segments = query_aggregator(args.server, args.query_port, start, 0.0)
+      except OSError as error:
+        print('Aggregator query failed: %s' % error, file=sys.stderr)
+        segments = []
+      for device, name, timestamp, samples in segments:
+        stream = streams.setdefault(device, DeviceStream(device, name))
+        for patch_timestamp, patch in stream.append(timestamp, samples):
+          service.submit(device, name, patch_timestamp, patch)
+
+      # Ask next for everything after the node that is furthest behind, but never more than the lookback before the newest
+      if streams:
+        newest = max(stream.end for stream in streams.values())
+        active = [stream.end for stream in streams.values() if stream.end >= newest - args.lookback]
+        start = max(min(active), newest - args.lookback)
+      if time.monotonic() - last_report >= args.report_interval:
+        p50, p99 = latency_summary(service.latencies[-10000:])
+        print('%d nodes, %d patches classified, mean batch %.1f, latency p50 %.1f ms, p99 %.1f ms' % (len(streams), len(service.latencies),
+              np.mean(service.batch_sizes) if service.batch_sizes else 0.0, p50, p99), file=sys.stderr, flush=True)
+        last_report = time.monotonic()
+      time.sleep(max(args.poll_interval - (time.monotonic() - began), 0.0))
+  except KeyboardInterrupt:
+    service.stop()
+  return 0
+
+def main():
+  parser = argparse.ArgumentParser(description='Classify live audio from every node with YAMNet, batching patches across nodes')
+  parser.add_argument('--server', default='127.0.0.1', help='Aggregator (software/aggregator) to poll for decimated audio')
+  parser.add_argument('--query-port', type=int, default=query_default_port)
+  parser.add_argument('--model', default='yamnet_patches.tflite', help='TensorFlow Lite model, converted from --weights if it does not exist')
+  parser.add_argument('--weights', help='YAMNet Keras weights (yamnet.h5)')
+  parser.add_argument('--class-map', default='yamnet_class_map.csv', help='YAMNet class map CSV')
+  parser.add_argument('--classes', nargs='+', default=gunshot_classes, help='Display names of the classes to report')
+  parser.add_argument('--threshold', type=float, default=0.3, help='Score at which a result is also logged as a detection')
+  parser.add_argument('--output', help='File to which JSON line results are appended, instead of standard output')
+  parser.add_argument('--max-batch', type=int, default=32, help='Most patches per inference call')
+  parser.add_argument('--max-wait', type=float, default=0.05, help='Longest a patch waits for its batch to fill, in seconds')
+  parser.add_argument('--threads', type=int, default=os.cpu_count(), help='Inference threads')
+  parser.add_argument('--poll-interval', type=float, default=0.25, help='Seconds between aggregator queries')
+  parser.add_argument('--lookback', type=float, default=5.0, help='Seconds of audio a late node may lag the newest and still be classified')
+  parser.add_argument('--report-interval', type=float, default=30.0)
+  parser.add_argument('--bench-nodes', type=int, nargs='+', help='Measure throughput and latency for these node counts with simulated patches instead')
+  parser.add_argument('--bench-seconds', type=float, default=15.0, help='Duration of each benchmark run')
+  parser.add_argument('--synthetic', type=float, nargs=2, metavar=('CALL_MS', 'PATCH_MS'),
+                      help='Replace the model with a fixed per-call and per-patch cost, to exercise batching without TensorFlow Lite')
+  args = parser.parse_args()
+
+  backend = SyntheticBackend(*args.synthetic) if args.synthetic else TFLiteBackend(args.model, args.weights, args.max_batch, args.threads)
+  return run_benchmark(args, backend) if args.bench_nodes else run_service(args, backend)
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,301 @@
+import argparse, concurrent.futures, csv, glob, json, math, os, subprocess, sys, tempfile, time
+import numpy as np
+from scipy.signal import resample_poly
+
+import features
+from scan_archive import describe_recording, gunshot_classes, load_classifier, read_span
+
+full_rate = 48000
+
+# ESC-50 categories (esc50/meta/esc50.csv, as models/model.py loads it) mixed in as continuous urban background, and as
+#   impulsive sounds that a gunshot detector must reject
+background_categories = ['helicopter', 'chainsaw', 'siren', 'engine', 'train', 'airplane', 'hand_saw', 'rain', 'wind', 'crickets']
+distractor_categories = ['fireworks', 'door_wood_knock', 'glass_breaking', 'clapping', 'car_horn', 'can_opening', 'footsteps', 'church_bells']
+onset_fraction = 0.1  # A clip's labelled onset is its first sample within 20 dB of its peak, and its end the last such sample
+onset_lead_seconds = 0.05  # Audio kept ahead of each clip's onset when it is mixed into a scene
+snr_window_seconds = 0.1  # An event's level for its SNR is its mean square over this long after its onset
+warmup_seconds = 3.0  # No events while the trigger's long-term average settles
+crossfade_seconds = 0.01  # Between consecutive background clips, so that their joins do not trigger
+
+def load_clip(path):
+  # Mono float samples of a whole recording at the full node rate
+  recording = describe_recording(path)
+  samples = read_span(recording, 0, recording['frames'])
+  if recording['rate'] != full_rate:
+    divisor = math.gcd(full_rate, recording['rate'])
+    samples = resample_poly(samples, full_rate // divisor, recording['rate'] // divisor).astype(np.float32)
+  return samples
+
+def trim_event(samples, event_seconds):
+  # The labelled part of an event clip, with its onset and end relative to the start of what is kept
+  magnitude = np.abs(samples)
+  loud = np.flatnonzero(magnitude >= onset_fraction * magnitude.max()) if magnitude.max() > 0 else []
+  if not len(loud):
+    return None
+  lead = min(int(onset_lead_seconds * full_rate), loud[0])
+  kept = samples[loud[0] - lead:loud[0] + int(event_seconds * full_rate)]
+  return kept, lead, min(loud[-1] - loud[0] + lead, len(kept))
+
+def load_sources(args):
+  # Background and distractor clips from the ESC-50 metadata, and gunshot clips from the given files and directories
+  #    or from categories of the metadata
+  sources = {'background': [], 'distractor': [], 'gunshot': []}
+  with open(os.path.join(args.esc50, 'meta', 'esc50.csv')) as metadata:
+    for row in csv.DictReader(metadata):
+      if args.folds and int(row['fold']) not in args.folds:
+        continue
+      kind = ('background' if row['category'] in background_categories else 'distractor' if row['category'] in distractor_categories else
+              'gunshot' if row['category'] in args.gunshot_categories else None)
+      if kind:
+        sources[kind].append((row['category'], os.path.join(args.esc50, 'audio', row['filename'])))
+  for name in args.gunshots:
+    paths = sorted(glob.glob(os.path.join(name, '**', '*.wav'), recursive=True)) if os.path.isdir(name) else [name]
+    sources['gunshot'].extend(('gunshot', path) for path in paths)
+  for kind, clips in sources.items():
+    if not clips:
+      sys.exit('No %s clips found' % kind)
+  return sources
+
+def plan_scene(args, sources, scene):
+  # Which clips a scene mixes, where each event begins, and its SNR, drawn from a generator seeded by the scene alone so
+  #    that every run with the same arguments replays identical audio
+  rng = np.random.default_rng([args.seed, scene])
+  num_samples = int(args.scene_seconds * full_rate)
+  background, length = [], 0
+  while length < num_samples:
+    background.append(sources['background'][rng.integers(len(sources['background']))][1])
+    length += 5 * full_rate  # ESC-50 clips are five seconds long; any shortfall is covered again when mixing
+  num_gunshots = int(round(args.events_per_scene * args.gunshot_fraction))
+  kinds = rng.permutation(['gunshot'] * num_gunshots + ['distractor'] * (args.events_per_scene - num_gunshots))
+  slot_seconds = (args.scene_seconds - warmup_seconds) / max(args.events_per_scene, 1)
+  events = []
+  for index, kind in enumerate(kinds):
+    category, path = sources[kind][rng.integers(len(sources[kind]))]
+    start = warmup_seconds + (index * slot_seconds) + rng.uniform(0.0, max(slot_seconds - args.event_seconds, 0.0))
+    snr_db = args.snr_db[((scene * args.events_per_scene) + index) % len(args.snr_db)]
+    events.append({'kind': str(kind), 'category': category, 'path': path, 'start': start, 'snr_db': snr_db})
+  return {'scene': scene, 'num_samples': num_samples, 'background': background, 'events': events}
+
+def mix_scene(args, plan, clips):
+  # Background clips joined end to end at unit RMS, with each event scaled to its SNR against them, then scaled to the
+  #    noise level and quantized as the node's microphone would deliver it
+  num_samples, fade = plan['num_samples'], int(crossfade_seconds * full_rate)
+  audio = np.zeros(num_samples, dtype=np.float64)
+  position = 0
+  while position < num_samples:
+    for path in plan['background']:
+      clip = clips[path]
+      rms = np.sqrt(np.mean(clip.astype(np.float64) ** 2))
+      if (rms <= 0.0) or (position >= num_samples):
+        continue
+      clip = clip / rms
+      ramp = np.minimum(1.0, np.arange(len(clip)) / fade) * np.minimum(1.0, np.arange(len(clip))[::-1] / fade)
+      end = min(position + len(clip), num_samples)
+      audio[position:end] += (clip * ramp)[:end - position]
+      position = num_samples if end == num_samples else end - fade
+    if position <= 0:
+      sys.exit('Background clips are silent')
+  truths = []
+  for event in plan['events']:
+    trimmed = trim_event(clips[event['path']], args.event_seconds)
+    if trimmed is None:
+      continue
+    samples, onset, end = trimmed
+    first = int(event['start'] * full_rate)
+    samples = samples[:num_samples - first].astype(np.float64)
+    level = np.mean(samples[onset:onset + int(snr_window_seconds * full_rate)] ** 2)
+    if level <= 0.0:
+      continue
+    audio[first:first + len(samples)] += samples * np.sqrt(10.0 ** (event['snr_db'] / 10.0) / level)
+    truths.append(dict(event, onset=(first + onset) / full_rate, end=(first + end) / full_rate))
+  scale = 32768.0 * 10.0 ** (args.noise_dbfs / 20.0)
+  return np.clip(np.round(audio * scale), -32768, 32767).astype('<i2'), truths
+
+def replay_scene(args, plan, clips, directory):
+  # Mix a scene and run it through the node's conditioning, trigger, onset picker and decimator (firmware/host/bench_onset)
+  audio, truths = mix_scene(args, plan, clips)
+  prefix = os.path.join(directory, 'scene_%d' % plan['scene'])
+  audio.tofile(prefix + '.raw')
+  command = [args.bench_onset, '--input', prefix + '.raw', '--output', prefix + '.csv', '--decimated', prefix + '_16k.raw']
+  if args.trigger_ratio:
+    command += ['--trigger-ratio', str(args.trigger_ratio)]
+  subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+  with open(prefix + '.csv') as picks:
+    triggers = [{'start': float(row['onset_sample']) / full_rate, 'end': float(row['onset_sample']) / full_rate,
+                 'available': float(row['report_sample']) / full_rate} for row in csv.DictReader(picks)]
+  decimated = np.fromfile(prefix + '_16k.raw', dtype='<i2').astype(np.float32) / 32768.0
+  for suffix in ('.raw', '.csv', '_16k.raw'):
+    os.remove(prefix + suffix)
+  return {'scene': plan['scene'], 'seconds': len(audio) / full_rate, 'truths': truths, 'triggers': triggers, 'decimated': decimated}
+
+def classify_scene(args, scene, classify, timing):
+  # Score every patch on the scene's patch grid, as the classification service does for each node's decimated stream
+  #    (ai/yamnet/classify_service.py), noting when the packet holding each patch's final sample reaches the host
+  if len(scene['decimated']) < features.patch_samples:
+    return []
+  patches = features.log_mel_patches(scene['decimated'])
+  scores = np.zeros(len(patches))
+  batch = np.zeros((args.batch_size, features.patch_frames, features.mel_bands), dtype=np.float32)
+  for first in range(0, len(patches), args.batch_size):
+    rows = min(args.batch_size, len(patches) - first)
+    batch[:rows] = patches[first:first + rows]
+    batch[rows:] = 0.0
+    began = time.monotonic()
+    scores[first:first + rows] = classify(batch)[0][:rows]
+    timing['seconds'] += time.monotonic() - began
+    timing['patches'] += rows
+  packet_samples = args.packet_seconds * features.sample_rate
+  hits = []
+  for index in np.flatnonzero(scores >= args.threshold):
+    start = index * features.patch_hop_samples
+    arrival = math.ceil((start + features.patch_samples) / packet_samples) * args.packet_seconds
+    hits.append({'start': start / features.sample_rate, 'end': (start + features.patch_samples) / features.sample_rate,
+                 'arrival': arrival, 'score': float(scores[index])})
+  return hits
+
+def merge_hits(hits, gap):
+  # Join overlapping or nearly adjacent patch detections into one, keeping its patches so that each event it covers is
+  #    timed from the first patch that covered that event
+  detections = []
+  for hit in sorted(hits, key=lambda hit: hit['start']):
+    if detections and (hit['start'] <= detections[-1]['end'] + gap):
+      detections[-1]['end'] = max(detections[-1]['end'], hit['end'])
+      detections[-1]['parts'].append(hit)
+    else:
+      detections.append({'start': hit['start'], 'end': hit['end'], 'parts': [hit]})
+  return detections
+
+def overlaps(detection, truth, tolerance):
+  return (detection['start'] <= truth['end'] + tolerance) and (detection['end'] >= truth['onset'] - tolerance)
+
+def score_stage(scenes, detections_by_scene, tolerance):
+  # A detection is correct if it overlaps a gunshot's labelled span, give or take the tolerance, and a gunshot is found
+  #    if any detection is; its latency is from its onset until the earliest part of such a detection overlapping it was
+  #    available
+  summary = {'detections': 0, 'true_positives': 0, 'false_positives_on_distractors': 0, 'false_positives_on_background': 0}
+  latencies, found_by_snr, total_by_snr = [], {}, {}
+  for scene, detections in zip(scenes, detections_by_scene):
+    earliest = [None] * len(scene['truths'])
+    for detection in detections:
+      overlapping = [index for index, truth in enumerate(scene['truths']) if overlaps(detection, truth, tolerance)]
+      gunshots = [index for index in overlapping if scene['truths'][index]['kind'] == 'gunshot']
+      summary['detections'] += 1
+      if gunshots:
+        summary['true_positives'] += 1
+        for index in gunshots:
+          for part in detection.get('parts', [detection]):
+            if overlaps(part, scene['truths'][index], tolerance):
+              earliest[index] = part['available'] if earliest[index] is None else min(earliest[index], part['available'])
+      elif overlapping:
+        summary['false_positives_on_distractors'] += 1
+      else:
+        summary['false_positives_on_background'] += 1
+    for truth, available in zip(scene['truths'], earliest):
+      if truth['kind'] != 'gunshot':
+        continue
+      key = '%g' % truth['snr_db']
+      total_by_snr[key] = total_by_snr.get(key, 0) + 1
+      if available is not None:
+        found_by_snr[key] = found_by_snr.get(key, 0) + 1
+        latencies.append(available - truth['onset'])
+  num_gunshots = sum(total_by_snr.values())
+  summary['gunshots_found'] = len(latencies)
+  summary['precision'] = summary['true_positives'] / summary['detections'] if summary['detections'] else None
+  summary['recall'] = len(latencies) / num_gunshots if num_gunshots else None
+  summary['recall_by_snr_db'] = {key: found_by_snr.get(key, 0) / total for key, total in sorted(total_by_snr.items(), key=lambda item: -float(item[0]))}
+  summary['latency_seconds'] = ({'mean': float(np.mean(latencies)), 'p50': float(np.percentile(latencies, 50)),
+                                 'p90': float(np.percentile(latencies, 90)), 'max': float(np.max(latencies))} if latencies else None)
+  return summary
+
+def main():
+  parser = argparse.ArgumentParser(description='Measure gunshot detection precision, recall and latency by replaying labelled scenes through the node trigger and YAMNet')
+  parser.add_argument('--esc50', required=True, help='ESC-50 root, holding meta/esc50.csv and audio/')
+  parser.add_argument('--gunshots', nargs='*', default=[], help='Gunshot WAV files, or directories searched recursively for them')
+  parser.add_argument('--gunshot-categories', nargs='*', default=[], help='Categories of the metadata to use as gunshots as well')
+  parser.add_argument('--folds', type=int, nargs='*', default=[], help='ESC-50 folds to draw clips from, e.g. those held out from training (default all)')
+  parser.add_argument('--bench-onset', required=True, help='Host build of firmware/host/bench_onset, which replays audio through the node')
+  parser.add_argument('--trigger-ratio', type=float, help='Trigger ratio to replay with, instead of the node default')
+  parser.add_argument('--weights', help='YAMNet Keras weights (yamnet.h5); without them only the trigger is evaluated')
+  parser.add_argument('--class-map', default='yamnet_class_map.csv', help='YAMNet class map CSV')
+  parser.add_argument('--classes', nargs='+', default=gunshot_classes, help='Display names of the classes counted as gunshots')
+  parser.add_argument('--threshold', type=float, default=0.3, help='Minimum class score for a patch to count as a detection')
+  parser.add_argument('--batch-size', type=int, default=64, help='Patches per inference call')
+  parser.add_argument('--packet-seconds', type=float, default=1.0, help='Audio per packet sent by the node; a patch is classified once its final packet arrives')
+  parser.add_argument('--scenes', type=int, default=50)
+  parser.add_argument('--scene-seconds', type=float, default=30.0)
+  parser.add_argument('--events-per-scene', type=int, default=6)
+  parser.add_argument('--gunshot-fraction', type=float, default=0.5, help='Share of the events in each scene that are gunshots rather than distractors')
+  parser.add_argument('--event-seconds', type=float, default=1.5, help='Longest part of each event clip mixed in, from just before its onset')
+  parser.add_argument('--snr-db', type=float, nargs='+', default=[20.0, 10.0, 0.0], help='Event SNRs, assigned to events in turn')
+  parser.add_argument('--noise-dbfs', type=float, default=-40.0, help='Background RMS relative to full scale')
+  parser.add_argument('--tolerance', type=float, default=0.05, help='Seconds a detection may fall outside a labelled event and still match it')
+  parser.add_argument('--seed', type=int, default=1)
+  parser.add_argument('--workers', type=int, default=os.cpu_count(), help='Scenes mixed and replayed in parallel')
+  parser.add_argument('--output', help='JSON results file (printed to stdout if not given)')
+  parser.add_argument('--min-precision', type=float, default=0.0, help='Exit with an error if the final stage falls below this precision')
+  parser.add_argument('--min-recall', type=float, default=0.0, help='Exit with an error if the final stage falls below this recall')
+  args = parser.parse_args()
+  if not args.gunshots and not args.gunshot_categories:
+    parser.error('--gunshots or --gunshot-categories is required')
+
+  # Plan every scene, load each clip they use once, then mix and replay the scenes in parallel
+  start_time = time.monotonic()
+  sources = load_sources(args)
+  plans = [plan_scene(args, sources, scene) for scene in range(args.scenes)]
+  paths = sorted({path for plan in plans for path in plan['background']} | {event['path'] for plan in plans for event in plan['events']})
+  with concurrent.futures.ThreadPoolExecutor(max_workers=args.workers) as pool:
+    clips = dict(zip(paths, pool.map(load_clip, paths)))
+    with tempfile.TemporaryDirectory() as directory:
+      scenes = list(pool.map(lambda plan: replay_scene(args, plan, clips, directory), plans))
+
+  # Score the trigger alone, then YAMNet on every patch and on only the patches holding a trigger, as a deployment
+  #    classifying triggered events would
+  stages = {'trigger': [scene['triggers'] for scene in scenes]}
+  timing = {'seconds': 0.0, 'patches': 0}
+  if args.weights:
+    classify = load_classifier(args.weights, args.class_map, args.classes, args.batch_size)
+    hits = [classify_scene(args, scene, classify, timing) for scene in scenes]
+    per_patch = timing['seconds'] / max(timing['patches'], 1)
+    inference = per_patch * math.ceil(args.packet_seconds / features.patch_hop_seconds)  # Patches completed by one packet
+    for scene_hits in hits:
+      for hit in scene_hits:
+        hit['available'] = hit['arrival'] + inference
+    stages['classifier'] = [merge_hits(scene_hits, features.patch_hop_seconds) for scene_hits in hits]
+    gated = []
+    for scene, scene_hits in zip(scenes, hits):
+      gated.append([])
+      for hit in scene_hits:
+        triggers = [trigger['available'] for trigger in scene['triggers'] if hit['start'] <= trigger['start'] <= hit['end']]
+        if triggers:
+          gated[-1].append(dict(hit, available=max(hit['available'], min(triggers))))
+    stages['triggered_classifier'] = [merge_hits(scene_hits, features.patch_hop_seconds) for scene_hits in gated]
+  audio_seconds = sum(scene['seconds'] for scene in scenes)
+  wall_seconds = time.monotonic() - start_time
+  results = {
+    'settings': {key: value for key, value in vars(args).items() if key not in ('output', 'workers', 'bench_onset')},
+    'scenes': len(scenes), 'audio_seconds': audio_seconds, 'wall_seconds': wall_seconds, 'realtime_factor': audio_seconds / wall_seconds,
+    'gunshots': sum(truth['kind'] == 'gunshot' for scene in scenes for truth in scene['truths']),
+    'distractors': sum(truth['kind'] == 'distractor' for scene in scenes for truth in scene['truths']),
+    'inference_seconds_per_patch': timing['seconds'] / timing['patches'] if timing['patches'] else None,
+    'stages': {name: score_stage(scenes, detections, args.tolerance) for name, detections in stages.items()}}
+
+  # Write the results, summarize each stage, and fail if the final stage misses either requirement
+  if args.output:
+    with open(args.output, 'w') as output:
+      json.dump(results, output, indent=2)
+  else:
+    json.dump(results, sys.stdout, indent=2)
+    print()
+  print('%d scenes, %.0f s of audio with %d gunshots and %d distractors, evaluated in %.1f s (%.0fx real time)' %
+        (results['scenes'], audio_seconds, results['gunshots'], results['distractors'], wall_seconds, results['realtime_factor']), file=sys.stderr)
+  for name, stage in results['stages'].items():
+    latency = stage['latency_seconds']
+    print('   %-20s precision %s, recall %s, latency %s' % (name, '%.3f' % stage['precision'] if stage['precision'] is not None else '-',
+          '%.3f' % stage['recall'] if stage['recall'] is not None else '-', '%.3f s median, %.3f s p90' % (latency['p50'], latency['p90']) if latency else '-'),
+          file=sys.stderr)
+  final = results['stages'][list(stages)[-1]]
+  passed = ((final['precision'] or 0.0) >= args.min_precision) and ((final['recall'] or 0.0) >= args.min_recall)
+  return 0 if passed else 1
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,63 @@
+import functools
+import numpy as np
+try:
+  from scipy import fft  # Releases the GIL, so that featurizing scales across threads
+except ImportError:
+  from numpy import fft
+
+# Front end parameters from models/model.py, which firmware/main/dsp/spectral.h mirrors
+sample_rate = 16000
+stft_window_seconds = 0.025
+stft_hop_seconds = 0.010
+mel_bands = 64
+mel_min_hz = 125.0
+mel_max_hz = 7500.0
+log_offset = 0.001
+patch_window_seconds = 0.96
+patch_hop_seconds = 0.48
+
+window_length = int(round(sample_rate * stft_window_seconds))
+hop_length = int(round(sample_rate * stft_hop_seconds))
+fft_length = 2 ** int(np.ceil(np.log(window_length) / np.log(2.0)))
+patch_frames = int(round(patch_window_seconds / stft_hop_seconds))
+patch_hop_frames = int(round(patch_hop_seconds / stft_hop_seconds))
+patch_samples = (patch_frames - 1) * hop_length + window_length  # Waveform samples spanned by one patch
+patch_hop_samples = patch_hop_frames * hop_length
+
+def hz_to_mel(hz):
+  return 1127.0 * np.log(1.0 + (hz / 700.0))
+
+@functools.lru_cache(maxsize=None)
+def mel_weight_matrix():
+  # Same construction as tf.signal.linear_to_mel_weight_matrix(), with the DC bin zeroed
+  num_bins = fft_length // 2 + 1
+  bin_mels = hz_to_mel(np.linspace(0.0, sample_rate / 2.0, num_bins)[1:])[:, np.newaxis]
+  edges = np.linspace(hz_to_mel(mel_min_hz), hz_to_mel(mel_max_hz), mel_bands + 2)
+  lower, center, upper = edges[:-2], edges[1:-1], edges[2:]
+  weights = np.maximum(0.0, np.minimum((bin_mels - lower) / (center - lower), (upper - bin_mels) / (upper - center)))
+  return np.pad(weights, [[1, 0], [0, 0]])
+
+@functools.lru_cache(maxsize=None)
+def hann_window():
+  # Periodic Hann window exactly as _tflite_stft_magnitude() builds it
+  return 0.5 - 0.5 * np.cos(2 * np.pi * np.arange(0, 1.0, 1.0 / window_length))
+
+def stft_power(waveform):
+  # Centered zero padding within each frame exactly as _tflite_stft_magnitude() applies it
+  num_frames = 1 + (len(waveform) - window_length) // hop_length
+  window = hann_window()
+  frames = np.lib.stride_tricks.sliding_window_view(waveform, window_length)[::hop_length][:num_frames] * window
+  half_pad = (fft_length - window_length) // 2
+  padded = np.pad(frames, [[0, 0], [half_pad, fft_length - window_length - half_pad]])
+  return np.abs(fft.rfft(padded, n=fft_length)) ** 2, np.sum(window ** 2)
+
+def log_mel(waveform):
+  power, _ = stft_power(waveform)
+  return np.log(np.sqrt(power) @ mel_weight_matrix() + log_offset)
+
+def log_mel_patches(waveform):
+  # Patches of log-mel frames as waveform_to_features() groups them, for waveforms of at least one patch
+  frames = log_mel(waveform).astype(np.float32)
+  num_patches = 1 + (len(frames) - patch_frames) // patch_hop_frames
+  patches = np.lib.stride_tricks.sliding_window_view(frames, patch_frames, axis=0)[::patch_hop_frames][:num_patches]
+  return np.ascontiguousarray(np.swapaxes(patches, 1, 2))
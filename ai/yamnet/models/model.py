@@ -213,9 +213,16 @@ def yamnet_frames_model():
   return frames_model
 
 
+def yamnet_patches_model(batch_size=None):
+  # Classifier alone, for log-mel patches computed elsewhere (features.py); a fixed batch size keeps every call on one graph
+  features = layers.Input(batch_shape=(batch_size, patch_frames(), mel_bands), dtype=tf.float32)
+  predictions, embeddings = yamnet(features)
+  patches_model = Model(name='yamnet_patches', inputs=features, outputs=[predictions, embeddings])
+  return patches_model
+
+
 
 
-model = yamnet_frames_model()
 
 def preprocess_wav(filename):
   wav_data, sr = sf.read(filename, dtype=np.int16)
@@ -230,21 +237,21 @@ def preprocess_wav(filename):
   #return tf.convert_to_tensor(waveform, dtype=tf.float32)
 
 
-
-
-#
-esc50 = pd.read_csv('esc50/meta/esc50.csv')
-animals = ['dog', 'rooster', 'pig', 'cow', 'frog', 'cat', 'hen', 'insects', 'sheep', 'crow']
-map_class_to_id = {'dog':0,'rooster':1, 'pig':2, 'cow':3, 'frog':4, 'cat':5, 'hen':6, 'insects':7, 'sheep':8, 'crow':9}
-animals = esc50[esc50.category.isin(animals)]
-class_id = animals['category'].apply(lambda name: map_class_to_id[name])
-animals = animals.assign(target=class_id)
-
-esc50 = tf.data.Dataset.from_tensor_slices((animals['filename'], animals['target'], animals['fold']))
-def load_wav_for_map(filename, label, fold):
-  return tf.py_function(preprocess_wav, [filename], tf.float32), label, fold
-esc50 = esc50.map(load_wav_for_map)
-print(esc50.element_spec)
-
-yamnet_model_handle = 'https://tfhub.dev/google/yamnet/1'
-yamnet = hub.load(yamnet_model_handle)
\ No newline at end of file
+# Transfer-learning experiments, kept out of the way of code importing the model and front end above
+if __name__ == '__main__':
+  model = yamnet_frames_model()
+  esc50 = pd.read_csv('esc50/meta/esc50.csv')
+  animals = ['dog', 'rooster', 'pig', 'cow', 'frog', 'cat', 'hen', 'insects', 'sheep', 'crow']
+  map_class_to_id = {'dog':0,'rooster':1, 'pig':2, 'cow':3, 'frog':4, 'cat':5, 'hen':6, 'insects':7, 'sheep':8, 'crow':9}
+  animals = esc50[esc50.category.isin(animals)]
+  class_id = animals['category'].apply(lambda name: map_class_to_id[name])
+  animals = animals.assign(target=class_id)
+
+  esc50 = tf.data.Dataset.from_tensor_slices((animals['filename'], animals['target'], animals['fold']))
+  def load_wav_for_map(filename, label, fold):
+    return tf.py_function(preprocess_wav, [filename], tf.float32), label, fold
+  esc50 = esc50.map(load_wav_for_map)
+  print(esc50.element_spec)
+
+  yamnet_model_handle = 'https://tfhub.dev/google/yamnet/1'
+  yamnet = hub.load(yamnet_model_handle)
@@ -0,0 +1,277 @@
+import argparse, concurrent.futures, csv, glob, json, math, os, re, sys, time, wave
+import numpy as np
+from scipy.signal import resample_poly
+
+import features
+
+# Recordings exported by software/archive/archive_query --output are named <prefix>_<device>_<rate>_<GPS time>.wav
+archive_export_name = re.compile(r'_(?P<device>[^_]+)_(?P<rate>\d+)_(?P<timestamp>\d+(?:\.\d+)?)\.wav$')
+gunshot_classes = ['Gunshot, gunfire', 'Machine gun', 'Fusillade', 'Artillery fire']
+resampler_margin_seconds = 0.004  # Extra audio decoded on each side of a chunk so that resampling has no edge transients
+
+def describe_recording(path):
+  # Node and GPS start time from the archive export name, otherwise the enclosing directory and a relative time
+  try:
+    import soundfile
+    info = soundfile.info(path)
+    rate, num_frames = info.samplerate, info.frames
+  except ImportError:
+    with wave.open(path) as recording:
+      rate, num_frames = recording.getframerate(), recording.getnframes()
+  match = archive_export_name.search(os.path.basename(path))
+  node = match.group('device') if match else os.path.basename(os.path.dirname(os.path.abspath(path)))
+  start = float(match.group('timestamp')) if match else 0.0
+  return {'path': os.path.abspath(path), 'node': node, 'start': start, 'rate': rate, 'frames': num_frames}
+
+def read_span(recording, first, last):
+  # Mono float samples in [-1, 1) from frames [first, last) of a recording, zero-filled beyond either end
+  begin, end = max(first, 0), min(last, recording['frames'])
+  if end <= begin:
+    return np.zeros(last - first, dtype=np.float32)
+  try:
+    import soundfile
+    data = soundfile.read(recording['path'], start=begin, stop=end, dtype='int16', always_2d=True)[0]
+  except ImportError:
+    with wave.open(recording['path']) as source:
+      assert source.getsampwidth() == 2, 'Only 16-bit PCM is supported without soundfile: %s' % recording['path']
+      source.setpos(begin)
+      data = np.frombuffer(source.readframes(end - begin), dtype='<i2').reshape(-1, source.getnchannels())
+  samples = data.mean(axis=1, dtype=np.float32) / 32768.0
+  return np.pad(samples, [begin - first, last - end])
+
+def patch_layout(recording):
+  # 16 kHz samples in a recording and the patches covering them, padding the end to complete the final patch as pad_waveform() does
+  num_samples = int(math.ceil(recording['frames'] * features.sample_rate / recording['rate']))
+  return num_samples, 1 + int(math.ceil(max(num_samples - features.patch_samples, 0) / features.patch_hop_samples))
+
+def num_chunks(recording, chunk_patches):
+  # Chunks start every "chunk_patches" patch hops and overlap by one patch less one hop, so that every patch on the
+  #    recording's global patch grid lies wholly within exactly one chunk
+  return int(math.ceil(patch_layout(recording)[1] / chunk_patches))
+
+def featurize_chunk(recording, chunk, chunk_patches):
+  # Decode and resample one chunk to 16 kHz and return its log-mel patches, along with the seconds of audio it adds to
+  #    those of the chunks before it
+  num_samples, total_patches = patch_layout(recording)
+  num_patches = min(chunk_patches, total_patches - (chunk * chunk_patches))
+  start = chunk * chunk_patches * features.patch_hop_samples
+  length = (num_patches - 1) * features.patch_hop_samples + features.patch_samples
+  last_chunk = (chunk + 1) * chunk_patches >= total_patches
+  audio_seconds = ((num_samples - start) if last_chunk else (chunk_patches * features.patch_hop_samples)) / features.sample_rate
+  rate = recording['rate']
+  if rate == features.sample_rate:
+    waveform = read_span(recording, start, start + length)
+  else:
+    margin = int(math.ceil(resampler_margin_seconds * rate))
+    first = int(round(start * rate / features.sample_rate))
+    source = read_span(recording, first - margin, first + int(math.ceil(length * rate / features.sample_rate)) + margin)
+    divisor = math.gcd(features.sample_rate, rate)
+    resampled = resample_poly(source, features.sample_rate // divisor, rate // divisor).astype(np.float32)
+    offset = int(round(margin * features.sample_rate / rate))
+    waveform = np.pad(resampled[offset:offset + length], [0, max(0, length - len(resampled[offset:]))])
+  return features.log_mel_patches(waveform), audio_seconds
+
+def load_journal(path, settings):
+  # Chunks already scored by an interrupted run, discarding a final line cut short by the interruption
+  completed, valid_bytes = {}, 0
+  if os.path.exists(path):
+    with open(path, 'rb') as journal:
+      for line in journal:
+        try:
+          entry = json.loads(line)
+        except ValueError:
+          break
+        if not line.endswith(b'\n'):
+          break
+        if 'settings' in entry:
+          if entry['settings'] != settings:
+            sys.exit('%s was written with different settings %s; use a new output directory' % (path, entry['settings']))
+        else:
+          completed[(entry['file'], entry['chunk'])] = entry
+        valid_bytes += len(line)
+    with open(path, 'r+b') as journal:
+      journal.truncate(valid_bytes)
+  journal = open(path, 'a')
+  if not valid_bytes:
+    journal.write(json.dumps({'settings': settings}) + '\n')
+  return completed, journal
+
+def merge_detections(entries, recordings, merge_gap):
+  # Merge each node's overlapping or nearly adjacent above-threshold patches into single detections
+  hits = []
+  for entry in entries:
+    recording = recordings[entry['file']]
+    hits.extend((recording['node'], timestamp, score, label, entry['file']) for timestamp, score, label in entry['hits'])
+  hits.sort()
+  detections = []
+  for node, timestamp, score, label, path in hits:
+    if detections and (detections[-1]['node'] == node) and (timestamp <= detections[-1]['end'] + merge_gap):
+      detection = detections[-1]
+      detection['end'] = max(detection['end'], timestamp + features.patch_window_seconds)
+      if score > detection['score']:
+        detection.update(score=score, label=label)
+    else:
+      detections.append({'node': node, 'start': timestamp, 'end': timestamp + features.patch_window_seconds, 'score': score,
+                         'label': label, 'file': path})
+  return detections
+
+def load_classifier(weights, class_map, class_names, batch_size):
+  # Fixed-shape YAMNet patch classifier returning the highest score among the requested classes and which class it was
+  import tensorflow as tf
+  from models.model import yamnet_patches_model
+  with open(class_map) as names:
+    display_names = [row['display_name'] for row in csv.DictReader(names)]
+  missing = [name for name in class_names if name not in display_names]
+  if missing:
+    sys.exit('Classes not in %s: %s' % (class_map, ', '.join(missing)))
+  indices = [display_names.index(name) for name in class_names]
+  model = yamnet_patches_model(batch_size)
+  model.load_weights(weights, by_name=True)
+  @tf.function(input_signature=[tf.TensorSpec([batch_size, features.patch_frames, features.mel_bands], tf.float32)])
+  def classify(patches):
+    scores = tf.gather(model(patches, training=False)[0], indices, axis=1)
+    return tf.reduce_max(scores, axis=1), tf.argmax(scores, axis=1)
+  return lambda patches: tuple(output.numpy() for output in classify(patches))
+
+def main():
+  parser = argparse.ArgumentParser(description='Scan archived recordings (e.g. software/archive/archive_query --output exports) for gunshots with YAMNet')
+  parser.add_argument('inputs', nargs='+', help='WAV files, or directories searched recursively for them')
+  parser.add_argument('--output', required=True, help='Directory for the resumable journal and the detections CSV')
+  parser.add_argument('--weights', help='YAMNet Keras weights (yamnet.h5)')
+  parser.add_argument('--class-map', default='yamnet_class_map.csv', help='YAMNet class map CSV')
+  parser.add_argument('--classes', nargs='+', default=gunshot_classes, help='Display names of the classes to detect')
+  parser.add_argument('--threshold', type=float, default=0.3, help='Minimum class score for a patch to count as a detection')
+  parser.add_argument('--merge-gap', type=float, default=features.patch_hop_seconds, help='Seconds between patches merged into one detection')
+  parser.add_argument('--chunk-seconds', type=float, default=60.0, help='Audio decoded and featurized per task, rounded to whole patch hops')
+  parser.add_argument('--batch-size', type=int, default=512, help='Patches per inference call, padded so that every call has the same shape')
+  parser.add_argument('--workers', type=int, default=os.cpu_count(), help='Decode and featurize threads')
+  parser.add_argument('--report-interval', type=float, default=30.0, help='Seconds between throughput reports')
+  parser.add_argument('--featurize-only', action='store_true', help='Skip inference, to measure decode and front end throughput alone')
+  args = parser.parse_args()
+  if not args.featurize_only and not args.weights:
+    parser.error('--weights is required unless --featurize-only is given')
+
+  # Enumerate every chunk of every recording, skipping those an earlier run already scored
+  paths = sorted({os.path.abspath(path) for name in args.inputs
+                  for path in (glob.glob(os.path.join(name, '**', '*.wav'), recursive=True) if os.path.isdir(name) else [name])})
+  recordings = {recording['path']: recording for recording in map(describe_recording, paths)}
+  chunk_patches = max(1, int(round(args.chunk_seconds / features.patch_hop_seconds)))
+  settings = {'chunk_patches': chunk_patches, 'threshold': args.threshold, 'classes': args.classes, 'featurize_only': args.featurize_only}
+  os.makedirs(args.output, exist_ok=True)
+  completed, journal = load_journal(os.path.join(args.output, 'journal.jsonl'), settings)
+  tasks = [(path, chunk) for path, recording in recordings.items() for chunk in range(num_chunks(recording, chunk_patches))
+           if (path, chunk) not in completed]
+  resumed_seconds = sum(entry['seconds'] for entry in completed.values())
+  print('%d recordings from %d nodes: %d chunks to scan, %d already scanned (%.2f audio hours)' %
+        (len(recordings), len({recording['node'] for recording in recordings.values()}), len(tasks), len(completed), resumed_seconds / 3600.0))
+  classify = None if args.featurize_only else load_classifier(args.weights, args.class_map, args.classes, args.batch_size)
+
+  # Featurize chunks on the thread pool, keeping a bounded number in flight, while this thread batches their patches
+  batch = np.zeros((args.batch_size, features.patch_frames, features.mel_bands), dtype=np.float32)
+  queued, pending = [], []  # Chunks with patches awaiting a batch, and chunks awaiting scores from a batch
+  stats = {'seconds': 0.0, 'chunks': 0, 'patches': 0, 'batches': 0, 'inference': 0.0, 'starved': 0.0}
+  start_time = last_report = time.monotonic()
+
+  def record_chunk(path, chunk, seconds, scores, labels):
+    # Journal a fully scored chunk together with its above-threshold patches
+    recording = recordings[path]
+    first_patch = chunk * chunk_patches
+    hits = [[recording['start'] + (first_patch + i) * features.patch_hop_seconds, round(float(scores[i]), 4), args.classes[int(labels[i])]]
+            for i in np.flatnonzero(scores >= args.threshold)]
+    entry = {'file': path, 'chunk': chunk, 'seconds': seconds, 'hits': hits}
+    journal.write(json.dumps(entry) + '\n')
+    journal.flush()
+    os.fsync(journal.fileno())
+    completed[(path, chunk)] = entry
+    stats['seconds'] += seconds
+    stats['chunks'] += 1
+
+  def run_batch(rows):
+    # Classify one fixed-shape batch, zeroing unused rows, and hand each chunk its scores once all of them are in
+    batch[rows:] = 0.0
+    began = time.monotonic()
+    scores, labels = classify(batch) if classify else (np.zeros(args.batch_size), np.zeros(args.batch_size, dtype=np.int64))
+    stats['inference'] += time.monotonic() - began
+    stats['batches'] += 1
+    row = 0
+    while pending and row < rows:
+      chunk = pending[0]
+      take = min(chunk['remaining_rows'], rows - row)
+      chunk['scores'].append(scores[row:row + take])
+      chunk['labels'].append(labels[row:row + take])
+      chunk['remaining_rows'] -= take
+      row += take
+      if not chunk['remaining_rows']:
+        pending.pop(0)
+        record_chunk(chunk['path'], chunk['chunk'], chunk['seconds'], np.concatenate(chunk['scores']), np.concatenate(chunk['labels']))
+
+  def report(final=False):
+    elapsed = time.monotonic() - start_time
+    audio_hours, wall_hours = stats['seconds'] / 3600.0, elapsed / 3600.0
+    print('%s%.2f audio hours in %.1f s: %.1f audio hours per wall-clock hour, %d chunks, %d patches in %d batches, %.0f%% of the time in inference, '
+          '%.0f%% waiting on featurization' % ('Scanned ' if final else '', audio_hours, elapsed, audio_hours / wall_hours if wall_hours else 0.0,
+          stats['chunks'], stats['patches'], stats['batches'], 100.0 * stats['inference'] / max(elapsed, 1e-9),
+          100.0 * stats['starved'] / max(elapsed, 1e-9)), flush=True)
+
+  fill = 0
+  pool = concurrent.futures.ThreadPoolExecutor(max_workers=args.workers)
+  try:
+    remaining = iter(tasks)
+    in_flight = set()
+    while True:
+      while len(in_flight) < 2 * args.workers:
+        task = next(remaining, None)
+        if task is None:
+          break
+        future = pool.submit(featurize_chunk, recordings[task[0]], task[1], chunk_patches)
+        future.task = task
+        in_flight.add(future)
+      if not in_flight:
+        break
+      began = time.monotonic()
+      done, in_flight = concurrent.futures.wait(in_flight, return_when=concurrent.futures.FIRST_COMPLETED)
+      stats['starved'] += time.monotonic() - began
+      for future in done:
+        patches, seconds = future.result()
+        path, chunk = future.task
+        pending.append({'path': path, 'chunk': chunk, 'seconds': seconds, 'remaining_rows': len(patches), 'scores': [], 'labels': []})
+        stats['patches'] += len(patches)
+        row = 0
+        while row < len(patches):
+          take = min(len(patches) - row, args.batch_size - fill)
+          batch[fill:fill + take] = patches[row:row + take]
+          fill += take
+          row += take
+          if fill == args.batch_size:
+            run_batch(fill)
+            fill = 0
+      if time.monotonic() - last_report >= args.report_interval:
+        report()
+        last_report = time.monotonic()
+    if fill:
+      run_batch(fill)
+  except KeyboardInterrupt:
+    # Every chunk journaled so far is kept, and anything in flight is simply scanned again on the next run
+    pool.shutdown(wait=False, cancel_futures=True)
+    journal.close()
+    report()
+    print('Interrupted, rerun with the same arguments to resume')
+    return 1
+  pool.shutdown()
+  journal.close()
+  report(final=True)
+
+  # Write every detection, including those from earlier runs, in node and time order
+  detections = merge_detections(completed.values(), recordings, args.merge_gap)
+  with open(os.path.join(args.output, 'detections.csv'), 'w', newline='') as output:
+    writer = csv.writer(output)
+    writer.writerow(['node', 'start_timestamp', 'end_timestamp', 'peak_score', 'class', 'recording'])
+    for detection in detections:
+      writer.writerow([detection['node'], '%.3f' % detection['start'], '%.3f' % detection['end'], '%.4f' % detection['score'], detection['label'],
+                       detection['file']])
+  print('%d detections from %d nodes written to %s' % (len(detections), len({detection['node'] for detection in detections}),
+                                                        os.path.join(args.output, 'detections.csv')))
+  return 0
+
+if __name__ == '__main__':
+  sys.exit(main())
@@ -0,0 +1,92 @@
+import argparse, sys
+import numpy as np
+
+from features import fft_length, hop_length, log_mel as log_mel_frames, log_offset, mel_bands, mel_max_hz, mel_min_hz, sample_rate, stft_power, window_length
+
+full_rate = 48000
+
+# Octave bands reported alongside the log-mel summary
+octave_bands = 7
+octave_lowest_hz = 62.5
+
+def tensorflow_log_mel(waveform):
+  # The front end itself, up to the point where it groups frames into patches
+  import tensorflow as tf
+  from models.model import _tflite_stft_magnitude
+  magnitude = _tflite_stft_magnitude(signal=tf.constant(waveform[np.newaxis, :], dtype=tf.float32), frame_length=window_length,
+                                     frame_step=hop_length, fft_length=fft_length)
+  weights = tf.signal.linear_to_mel_weight_matrix(num_mel_bins=mel_bands, num_spectrogram_bins=fft_length // 2 + 1,
+                                                  sample_rate=sample_rate, lower_edge_hertz=mel_min_hz, upper_edge_hertz=mel_max_hz)
+  return tf.math.log(tf.matmul(magnitude, weights) + log_offset).numpy()[0]
+
+def octave_levels(waveform):
+  # Per-frame octave band mean square relative to a full-scale sine, from the one-sided power spectrum
+  power, window_energy = stft_power(waveform)
+  hz = np.arange(fft_length // 2 + 1) * sample_rate / fft_length
+  levels = np.zeros((power.shape[0], octave_bands))
+  for band in range(octave_bands):
+    center = octave_lowest_hz * 2 ** band
+    in_band = (hz >= center / np.sqrt(2.0)) & (hz < center * np.sqrt(2.0))
+    levels[:, band] = 4.0 * power[:, in_band].sum(axis=1) / (fft_length * window_energy)
+  return levels
+
+def decibels(power_ratio):
+  return np.maximum(10.0 * np.log10(np.maximum(power_ratio, 1e-30)), -120.0)
+
+def expected_summaries(decimated, full_rate_audio, log_mel):
+  # Assign each frame to the second in which its final sample falls, as the node does, and average within each second
+  num_seconds = min(len(decimated) // sample_rate, len(full_rate_audio) // full_rate)
+  frame_second = (np.arange(log_mel.shape[0]) * hop_length + window_length - 1) // sample_rate
+  bands = octave_levels(decimated)
+  rows = []
+  for second in range(num_seconds):
+    in_second = frame_second == second
+    samples = full_rate_audio[second * full_rate:(second + 1) * full_rate].astype(np.float64) / 32768.0
+    mean_square, peak = np.mean(samples ** 2), np.max(np.abs(samples))
+    rows.append({
+      'num_frames': int(in_second.sum()),
+      'peak_dbfs': decibels(peak ** 2), 'rms_dbfs': decibels(2.0 * mean_square),
+      'crest_db': 10.0 * np.log10(peak ** 2 / mean_square) if mean_square > 0 else 0.0,
+      'bands': decibels(bands[in_second].mean(axis=0)),
+      'log_mel': log_mel[in_second].mean(axis=0)})
+  return rows
+
+def main():
+  parser = argparse.ArgumentParser(description='Verify node spectral summaries (firmware/host/bench_spectral --input) against the YAMNet front end')
+  parser.add_argument('--full-rate', required=True, help='48 kHz int16 recording given to bench_spectral --input')
+  parser.add_argument('--decimated', required=True, help='16 kHz int16 audio written by bench_spectral --decimated')
+  parser.add_argument('--summary', required=True, help='CSV written by bench_spectral --output')
+  parser.add_argument('--tensorflow', action='store_true', help='Use the TensorFlow front end in models/model.py instead of its NumPy equivalent')
+  parser.add_argument('--log-mel-tolerance', type=float, default=1e-3)
+  parser.add_argument('--db-tolerance', type=float, default=0.01)
+  args = parser.parse_args()
+
+  # Compute the expected summaries from the same audio the node summarized
+  full_rate_audio = np.fromfile(args.full_rate, dtype='<i2')
+  decimated = np.fromfile(args.decimated, dtype='<i2').astype(np.float64) / 32768.0
+  log_mel = tensorflow_log_mel(decimated) if args.tensorflow else log_mel_frames(decimated)
+  expected = expected_summaries(decimated, full_rate_audio, log_mel)
+  summary = np.genfromtxt(args.summary, delimiter=',', names=True)
+  summary = np.atleast_1d(summary)
+
+  # Compare every second, skipping the final one if the node's frames ran past the end of the decimated audio
+  columns = summary.dtype.names
+  band_columns = [name for name in columns if name.startswith('band_')]
+  mel_columns = [name for name in columns if name.startswith('log_mel_')]
+  max_log_mel_error = max_db_error = 0.0
+  frame_mismatches = 0
+  for row, reference in zip(summary, expected):
+    frame_mismatches += int(row['num_frames'] != reference['num_frames'])
+    max_log_mel_error = max(max_log_mel_error, np.max(np.abs(np.array([row[name] for name in mel_columns]) - reference['log_mel'])))
+    levels = np.array([row['peak_dbfs'], row['rms_dbfs'], row['crest_db']] + [row[name] for name in band_columns])
+    reference_levels = np.concatenate([[reference['peak_dbfs'], reference['rms_dbfs'], reference['crest_db']], reference['bands']])
+    audible = reference_levels > -100.0
+    max_db_error = max(max_db_error, np.max(np.abs(levels - reference_levels)[audible], initial=0.0))
+  passed = (max_log_mel_error <= args.log_mel_tolerance) and (max_db_error <= args.db_tolerance) and not frame_mismatches
+  print('Compared %d seconds against the %s front end: max log-mel error %.2e, max level error %.4f dB, %d frame count mismatches: %s' %
+        (min(len(summary), len(expected)), 'TensorFlow' if args.tensorflow else 'NumPy', max_log_mel_error, max_db_error, frame_mismatches,
+         'ok' if passed else 'FAILED'))
+  return 0 if passed else 1
+
+if __name__ == '__main__':
+  sys.exit(main())
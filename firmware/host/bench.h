@@ -0,0 +1,37 @@
+#ifndef __BENCH_HEADER_H__
+#define __BENCH_HEADER_H__
+
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static inline double bench_now_seconds(void)
+{
+   // Monotonic wall-clock time in seconds
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (double)now.tv_sec + ((double)now.tv_nsec * 1.0e-9);
+}
+
+static inline uint64_t bench_cycles(void)
+{
+   // CPU timestamp counter where available, otherwise nanoseconds
+#if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#else
+   return (uint64_t)(bench_now_seconds() * 1.0e9);
+#endif
+}
+
+static inline uint32_t bench_random(uint32_t *state)
+{
+   // Deterministic xorshift32 generator so that every run uses identical inputs
+   *state ^= *state << 13;
+   *state ^= *state >> 17;
+   *state ^= *state << 5;
+   return *state;
+}
+
+#endif  // __BENCH_HEADER_H__
@@ -0,0 +1,81 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "conditioning.h"
+
+#define SAMPLE_RATE_HZ        48000
+#define NUM_SECONDS           10
+#define NUM_SAMPLES           (SAMPLE_RATE_HZ * NUM_SECONDS)
+#define CHUNK_SAMPLES         480
+
+static void generate_input(int16_t *samples, uint32_t num_samples)
+{
+   // DC offset, wind/traffic rumble, a 1 kHz tone, impulsive events and broadband noise
+   uint32_t seed = 0x12345678;
+   for (uint32_t i = 0; i < num_samples; ++i)
+   {
+      const double t = (double)i / SAMPLE_RATE_HZ;
+      double value = 1800.0 + (6000.0 * sin(2.0 * M_PI * 12.0 * t)) + (3000.0 * sin(2.0 * M_PI * 35.0 * t)) + (2500.0 * sin(2.0 * M_PI * 1000.0 * t));
+      value += (double)((int32_t)(bench_random(&seed) & 0x7FF) - 1024);
+      if ((i % SAMPLE_RATE_HZ) < 200)
+         value += ((i & 1) ? 30000.0 : -30000.0);
+      samples[i] = (int16_t)((value > 32767.0) ? 32767.0 : ((value < -32768.0) ? -32768.0 : value));
+   }
+}
+
+static int run_configuration(const char *name, const conditioning_config_t *config, const int16_t *input)
+{
+   // Process the same input with the per-sample reference and the chunked block implementation
+   int16_t *reference = malloc(NUM_SAMPLES * sizeof(int16_t)), *optimized = malloc(NUM_SAMPLES * sizeof(int16_t));
+   conditioning_t reference_conditioner, optimized_conditioner;
+   conditioning_init(&reference_conditioner, config);
+   conditioning_init(&optimized_conditioner, config);
+   memcpy(reference, input, NUM_SAMPLES * sizeof(int16_t));
+   memcpy(optimized, input, NUM_SAMPLES * sizeof(int16_t));
+
+   const uint64_t reference_start = bench_cycles();
+   conditioning_process_reference(&reference_conditioner, reference, NUM_SAMPLES);
+   const uint64_t reference_cycles = bench_cycles() - reference_start;
+   const double optimized_start_time = bench_now_seconds();
+   const uint64_t optimized_start = bench_cycles();
+   for (uint32_t offset = 0; offset < NUM_SAMPLES; offset += CHUNK_SAMPLES)
+      conditioning_process(&optimized_conditioner, optimized + offset, CHUNK_SAMPLES);
+   const uint64_t optimized_cycles = bench_cycles() - optimized_start;
+   const double optimized_seconds = bench_now_seconds() - optimized_start_time;
+
+   // Verify bit-exactness and report the per-sample cost of each implementation
+   uint32_t mismatches = 0;
+   for (uint32_t i = 0; i < NUM_SAMPLES; ++i)
+      mismatches += (reference[i] != optimized[i]);
+   double residual_dc = 0.0;
+   for (uint32_t i = NUM_SAMPLES - SAMPLE_RATE_HZ; i < NUM_SAMPLES; ++i)
+      residual_dc += optimized[i];
+   printf("%-22s reference %7.2f cycles/sample, block %7.2f cycles/sample (%6.1fx real time), residual DC %7.2f, %s\n",
+          name, (double)reference_cycles / NUM_SAMPLES, (double)optimized_cycles / NUM_SAMPLES,
+          NUM_SECONDS / optimized_seconds, residual_dc / SAMPLE_RATE_HZ, mismatches ? "MISMATCH" : "bit-exact");
+   free(reference);
+   free(optimized);
+   return mismatches ? 1 : 0;
+}
+
+int main(void)
+{
+   // Benchmark the conditioning chain in each of its configurations
+   int16_t *input = malloc(NUM_SAMPLES * sizeof(int16_t));
+   generate_input(input, NUM_SAMPLES);
+   const conditioning_config_t configs[] = {
+      { SAMPLE_RATE_HZ, 5.0f, 0.0f, 0, 0.0f },
+      { SAMPLE_RATE_HZ, 0.0f, 80.0f, 2, 0.0f },
+      { SAMPLE_RATE_HZ, 5.0f, 80.0f, 2, 0.0f },
+      { SAMPLE_RATE_HZ, 5.0f, 80.0f, 2, 12.0f },
+      { SAMPLE_RATE_HZ, 5.0f, 150.0f, 4, -6.0f },
+   };
+   const char *names[] = { "dc", "hp80x2", "dc+hp80x2", "dc+hp80x2+12dB", "dc+hp150x4-6dB" };
+   int failures = 0;
+   for (size_t i = 0; i < (sizeof(configs) / sizeof(configs[0])); ++i)
+      failures += run_configuration(names[i], configs + i, input);
+   free(input);
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,99 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "decimator.h"
+
+#define SAMPLE_RATE_HZ        48000
+#define NUM_SECONDS           10
+#define NUM_SAMPLES           (SAMPLE_RATE_HZ * NUM_SECONDS)
+#define CHUNK_SAMPLES         480
+#define ODD_CHUNK_SAMPLES     317
+#define TONE_AMPLITUDE        16000.0
+
+static void generate_input(int16_t *samples, uint32_t num_samples)
+{
+   // Tones across the audio band plus broadband noise and occasional full-scale clicks
+   uint32_t seed = 0x12345678;
+   for (uint32_t i = 0; i < num_samples; ++i)
+   {
+      const double t = (double)i / SAMPLE_RATE_HZ;
+      double value = (4000.0 * sin(2.0 * M_PI * 440.0 * t)) + (3000.0 * sin(2.0 * M_PI * 5000.0 * t)) + (3000.0 * sin(2.0 * M_PI * 11000.0 * t));
+      value += (double)((int32_t)(bench_random(&seed) & 0x1FFF) - 4096);
+      if ((i % SAMPLE_RATE_HZ) < 50)
+         value += ((i & 1) ? 30000.0 : -30000.0);
+      samples[i] = (int16_t)((value > 32767.0) ? 32767.0 : ((value < -32768.0) ? -32768.0 : value));
+   }
+}
+
+static double tone_gain_db(uint32_t output_rate_hz, double frequency_hz)
+{
+   // Measure the steady-state RMS gain of the decimator for a single full-rate tone
+   decimator_t decimator;
+   decimator_init(&decimator, SAMPLE_RATE_HZ, output_rate_hz);
+   int16_t *input = malloc(SAMPLE_RATE_HZ * sizeof(int16_t)), *output = malloc(SAMPLE_RATE_HZ * sizeof(int16_t));
+   for (uint32_t i = 0; i < SAMPLE_RATE_HZ; ++i)
+      input[i] = (int16_t)lround(TONE_AMPLITUDE * sin(2.0 * M_PI * frequency_hz * i / SAMPLE_RATE_HZ));
+   const uint32_t num_output = decimator_process(&decimator, input, SAMPLE_RATE_HZ, output);
+   double power = 0.0;
+   for (uint32_t i = num_output / 10; i < num_output; ++i)
+      power += (double)output[i] * output[i];
+   power /= (num_output - (num_output / 10));
+   free(input);
+   free(output);
+   return 10.0 * log10((power > 0.0 ? power : 1.0e-3) / (TONE_AMPLITUDE * TONE_AMPLITUDE / 2.0));
+}
+
+static int run_configuration(uint32_t output_rate_hz, const int16_t *input)
+{
+   // Decimate with the full-width reference in irregular chunks and the optimized path in audio-task sized chunks
+   decimator_t reference_decimator, optimized_decimator;
+   decimator_init(&reference_decimator, SAMPLE_RATE_HZ, output_rate_hz);
+   decimator_init(&optimized_decimator, SAMPLE_RATE_HZ, output_rate_hz);
+   int16_t *reference = malloc(NUM_SAMPLES * sizeof(int16_t)), *optimized = malloc(NUM_SAMPLES * sizeof(int16_t));
+   uint32_t num_reference = 0, num_optimized = 0;
+   const uint64_t reference_start = bench_cycles();
+   for (uint32_t offset = 0; offset < NUM_SAMPLES; offset += ODD_CHUNK_SAMPLES)
+   {
+      const uint32_t chunk = ((NUM_SAMPLES - offset) < ODD_CHUNK_SAMPLES) ? (NUM_SAMPLES - offset) : ODD_CHUNK_SAMPLES;
+      num_reference += decimator_process_reference(&reference_decimator, input + offset, chunk, reference + num_reference);
+   }
+   const uint64_t reference_cycles = bench_cycles() - reference_start;
+   const double optimized_start_time = bench_now_seconds();
+   const uint64_t optimized_start = bench_cycles();
+   for (uint32_t offset = 0; offset < NUM_SAMPLES; offset += CHUNK_SAMPLES)
+      num_optimized += decimator_process(&optimized_decimator, input + offset, CHUNK_SAMPLES, optimized + num_optimized);
+   const uint64_t optimized_cycles = bench_cycles() - optimized_start;
+   const double optimized_seconds = bench_now_seconds() - optimized_start_time;
+
+   // Verify bit-exactness and report the per-output cost along with the anti-aliasing response
+   uint32_t mismatches = (num_reference != num_optimized) || (num_optimized != (NUM_SECONDS * output_rate_hz));
+   for (uint32_t i = 0; (i < num_reference) && (i < num_optimized); ++i)
+      mismatches += (reference[i] != optimized[i]);
+   const double nyquist_hz = output_rate_hz / 2.0;
+   printf("%5u Hz (%3u taps, delay %.3f ms): reference %7.2f cycles/output, optimized %7.2f cycles/output (%7.1fx real time), "
+          "gain %+.2f dB @ 1 kHz, %+.2f dB @ %.0f Hz",
+          output_rate_hz, optimized_decimator.num_taps, 1000.0 * decimator_group_delay_seconds(&optimized_decimator, SAMPLE_RATE_HZ),
+          (double)reference_cycles / num_reference, (double)optimized_cycles / num_optimized, NUM_SECONDS / optimized_seconds,
+          tone_gain_db(output_rate_hz, 1000.0), tone_gain_db(output_rate_hz, 0.8 * nyquist_hz), 0.8 * nyquist_hz);
+   if (output_rate_hz < SAMPLE_RATE_HZ)
+      printf(", %+.1f dB @ %.0f Hz", tone_gain_db(output_rate_hz, 1.3 * nyquist_hz), 1.3 * nyquist_hz);
+   printf(", %s\n", mismatches ? "MISMATCH" : "bit-exact");
+   free(reference);
+   free(optimized);
+   return mismatches ? 1 : 0;
+}
+
+int main(void)
+{
+   // Benchmark each selectable output rate against its reference implementation
+   int16_t *input = malloc(NUM_SAMPLES * sizeof(int16_t));
+   generate_input(input, NUM_SAMPLES);
+   const uint32_t output_rates[] = { 48000, 24000, 16000 };
+   int failures = 0;
+   for (size_t i = 0; i < (sizeof(output_rates) / sizeof(output_rates[0])); ++i)
+      failures += run_configuration(output_rates[i], input);
+   free(input);
+   return failures ? 1 : 0;
+}
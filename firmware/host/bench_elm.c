@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "elm.h"
+
+#define SYNTHETIC_INPUT_SIZE        784
+#define SYNTHETIC_HIDDEN_SIZE       1000
+#define SYNTHETIC_OUTPUT_SIZE       10
+#define SYNTHETIC_NUM_SAMPLES       500
+
+// Model and test set as written by ai/elm/export.py
+typedef struct
+{
+   elm_model_t model;
+   float *feature_offset, *feature_scale;
+   int16_t *output_weights;
+   uint32_t num_samples;
+   uint8_t *labels, *float_predictions, *quantized_predictions;
+   float *features;
+} elm_dataset_t;
+
+static void* read_exactly(FILE *file, size_t size, void *buffer)
+{
+   // Fill the buffer from the file, returning NULL on a short read
+   return (buffer && (fread(buffer, 1, size, file) == size)) ? buffer : NULL;
+}
+
+static bool load_model(const char *path, elm_dataset_t *data)
+{
+   // Header, per-feature normalization, then the padded int16 readout
+   char magic[4];
+   uint32_t fields[5];
+   float scales[2];
+   FILE *file = fopen(path, "rb");
+   if (!file || !read_exactly(file, sizeof(magic), magic) || memcmp(magic, "ELM1", 4) || !read_exactly(file, sizeof(fields), fields) ||
+       !read_exactly(file, sizeof(scales), scales))
+   {
+      if (file)
+         fclose(file);
+      return false;
+   }
+   elm_model_t *model = &data->model;
+   model->input_size = fields[0];
+   model->hidden_size = fields[1];
+   model->output_size = fields[2];
+   model->projection_seed = fields[3];
+   model->hidden_shift = fields[4];
+   model->input_scale = scales[0];
+   model->output_scale = scales[1];
+   const size_t weights_size = (size_t)model->output_size * ELM_HIDDEN_STRIDE(model->hidden_size) * sizeof(int16_t);
+   data->feature_offset = read_exactly(file, model->input_size * sizeof(float), malloc(model->input_size * sizeof(float)));
+   data->feature_scale = read_exactly(file, model->input_size * sizeof(float), malloc(model->input_size * sizeof(float)));
+   data->output_weights = read_exactly(file, weights_size, aligned_alloc(16, (weights_size + 15) & ~(size_t)15));
+   model->feature_offset = data->feature_offset;
+   model->feature_scale = data->feature_scale;
+   model->output_weights = data->output_weights;
+   fclose(file);
+   return data->feature_offset && data->feature_scale && data->output_weights;
+}
+
+static bool load_test_set(const char *path, elm_dataset_t *data)
+{
+   // Labels, the float and quantized Python predictions, then the raw features
+   char magic[4];
+   uint32_t fields[2];
+   FILE *file = fopen(path, "rb");
+   if (!file || !read_exactly(file, sizeof(magic), magic) || memcmp(magic, "ELMT", 4) || !read_exactly(file, sizeof(fields), fields) ||
+       (fields[1] != data->model.input_size))
+   {
+      if (file)
+         fclose(file);
+      return false;
+   }
+   data->num_samples = fields[0];
+   data->labels = read_exactly(file, data->num_samples, malloc(data->num_samples));
+   data->float_predictions = read_exactly(file, data->num_samples, malloc(data->num_samples));
+   data->quantized_predictions = read_exactly(file, data->num_samples, malloc(data->num_samples));
+   const size_t features_size = (size_t)data->num_samples * data->model.input_size * sizeof(float);
+   data->features = read_exactly(file, features_size, malloc(features_size));
+   fclose(file);
+   return data->labels && data->float_predictions && data->quantized_predictions && data->features;
+}
+
+static void generate_synthetic(elm_dataset_t *data)
+{
+   // Random model and MNIST-sized inputs for timing and SIMD/reference comparison when no exported model is given
+   uint32_t seed = 0x2468ACE1;
+   elm_model_t *model = &data->model;
+   *model = (elm_model_t){ .input_size = SYNTHETIC_INPUT_SIZE, .hidden_size = SYNTHETIC_HIDDEN_SIZE, .output_size = SYNTHETIC_OUTPUT_SIZE,
+                           .projection_seed = 12345, .hidden_shift = 6, .input_scale = 1.0f / 127.0f, .output_scale = 1.0f };
+   const size_t weights_size = (size_t)model->output_size * ELM_HIDDEN_STRIDE(model->hidden_size) * sizeof(int16_t);
+   data->feature_offset = calloc(model->input_size, sizeof(float));
+   data->feature_scale = malloc(model->input_size * sizeof(float));
+   data->output_weights = aligned_alloc(16, (weights_size + 15) & ~(size_t)15);
+   memset(data->output_weights, 0, weights_size);
+   for (uint32_t i = 0; i < model->input_size; ++i)
+      data->feature_scale[i] = 1.0f / 255.0f;
+   for (uint32_t k = 0; k < model->output_size; ++k)
+      for (uint32_t j = 0; j < model->hidden_size; ++j)
+         data->output_weights[(k * ELM_HIDDEN_STRIDE(model->hidden_size)) + j] = (int16_t)((int32_t)(bench_random(&seed) % 32001) - 16000);
+   model->feature_offset = data->feature_offset;
+   model->feature_scale = data->feature_scale;
+   model->output_weights = data->output_weights;
+   data->num_samples = SYNTHETIC_NUM_SAMPLES;
+   data->features = malloc((size_t)data->num_samples * model->input_size * sizeof(float));
+   for (size_t i = 0; i < ((size_t)data->num_samples * model->input_size); ++i)
+      data->features[i] = (float)(bench_random(&seed) & 0xFF);
+}
+
+int main(int argc, char **argv)
+{
+   // Load an exported model and test set, or fall back to a synthetic model of the same size
+   elm_dataset_t data;
+   memset(&data, 0, sizeof(data));
+   if (argc == 3)
+   {
+      if (!load_model(argv[1], &data) || !load_test_set(argv[2], &data))
+      {
+         fprintf(stderr, "Unable to load ELM model \"%s\" and test set \"%s\"\n", argv[1], argv[2]);
+         return 1;
+      }
+   }
+   else if (argc == 1)
+      generate_synthetic(&data);
+   else
+   {
+      fprintf(stderr, "Usage: %s [elm_model.bin elm_test.bin]\n", argv[0]);
+      return 1;
+   }
+
+   // Regenerate the projection into a single workspace, timing how long the node spends doing so at startup
+   elm_t elm;
+   const size_t workspace_size = elm_workspace_size(&data.model);
+   void *workspace = malloc(workspace_size);
+   const double init_start = bench_now_seconds();
+   if (!elm_init(&elm, &data.model, workspace, workspace_size))
+   {
+      fprintf(stderr, "Invalid ELM model\n");
+      return 1;
+   }
+   const double init_seconds = bench_now_seconds() - init_start;
+
+   // Run every sample through the optimized and reference paths, checking that they agree exactly
+   int64_t scores[ELM_MAX_OUTPUTS], reference_scores[ELM_MAX_OUTPUTS];
+   uint32_t correct = 0, float_agreement = 0, quantized_agreement = 0, mismatches = 0;
+   uint64_t cycles = 0;
+   double seconds = 0.0;
+   for (uint32_t n = 0; n < data.num_samples; ++n)
+   {
+      const float *features = data.features + ((size_t)n * data.model.input_size);
+      const double start = bench_now_seconds();
+      const uint64_t start_cycles = bench_cycles();
+      const uint32_t prediction = elm_infer(&elm, features, scores);
+      cycles += bench_cycles() - start_cycles;
+      seconds += bench_now_seconds() - start;
+      mismatches += (elm_infer_reference(&elm, features, reference_scores) != prediction) ||
+                    memcmp(scores, reference_scores, data.model.output_size * sizeof(int64_t));
+      if (data.labels)
+      {
+         correct += (prediction == data.labels[n]);
+         float_agreement += (prediction == data.float_predictions[n]);
+         quantized_agreement += (prediction == data.quantized_predictions[n]);
+      }
+   }
+
+   // Report throughput along with accuracy and parity against the Python float and quantized models
+   printf("ELM %u-%u-%u: projection regenerated in %.1f ms (%zu-byte workspace), %.1f cycles/inference, %.0f inferences/s\n",
+          data.model.input_size, data.model.hidden_size, data.model.output_size, 1000.0 * init_seconds, workspace_size,
+          (double)cycles / data.num_samples, data.num_samples / seconds);
+   if (data.labels)
+      printf("Accuracy %.2f%% over %u samples, %.2f%% agreement with the Python float model, %.2f%% with the Python quantized model\n",
+             100.0 * correct / data.num_samples, data.num_samples, 100.0 * float_agreement / data.num_samples,
+             100.0 * quantized_agreement / data.num_samples);
+   printf("Optimized and reference paths: %s\n", mismatches ? "MISMATCH" : "bit-exact");
+   return (mismatches || (data.labels && (quantized_agreement != data.num_samples))) ? 1 : 0;
+}
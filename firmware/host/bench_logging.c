@@ -0,0 +1,163 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "log_format.h"
+
+#define RING_SIZE_BYTES       (1 << 16)
+#define CALLS_PER_BATCH       256
+#define NUM_BATCHES           4000
+#define NUM_PRODUCERS         4
+#define CALLS_PER_PRODUCER    200000
+#define PRODUCER_BACKLOG_BYTES (RING_SIZE_BYTES / 2)  // Writers yield to the consumer beyond this, so records flow through rather than overflow
+#define MAX_DROPPED_FRACTION  0.01
+#define MAX_LINE_LEN          256
+
+// Representative log statements from the firmware, captured exactly as the deferred print macros capture them
+#define BENCH_CASES(X) \
+   X(no_arguments, "Unable to allocate an audio block for the sink dispatcher") \
+   X(block_dispatch, "[%0.6f]: Dispatching audio block with %u samples", 1234567.25, 48000u) \
+   X(gps_fix, "Timestamp: %0.6f, Latitude: %0.6f, Longitude: %0.6f, Height: %0.3f", 1234567.125, 36.1447f, -86.8027f, 182.5f) \
+   X(string_argument, "Only %lu of %lu audio blocks available for sink \"%s\", captured audio may be dropped", 1ul, 3ul, "network")
+
+static uint8_t ring_buffer[RING_SIZE_BYTES] __attribute__((aligned(LOG_RECORD_ALIGNMENT)));
+static log_ring_t ring;
+static char reference_line[MAX_LINE_LEN], deferred_line[MAX_LINE_LEN];
+
+static void drain_ring(void)
+{
+   // Discard everything captured so far
+   const log_record_t *record;
+   while ((record = log_ring_peek(&ring)))
+      log_ring_consume(&ring, record);
+}
+
+static double drain_and_format(void)
+{
+   // Format and consume everything captured so far, returning the elapsed cycles
+   const log_record_t *record;
+   const uint64_t start = bench_cycles();
+   while ((record = log_ring_peek(&ring)))
+   {
+      log_format_record(record, (const char*)(uintptr_t)record->format, deferred_line, sizeof(deferred_line));
+      log_ring_consume(&ring, record);
+   }
+   return (double)(bench_cycles() - start);
+}
+
+#define BENCH_CASE(name, ...) \
+   static int bench_##name(void) \
+   { \
+      /* Time the deferred capture, the equivalent immediate formatting, and the deferred formatting on the drain side */ \
+      uint64_t capture_cycles = 0, snprintf_cycles = 0; \
+      double drain_cycles = 0.0; \
+      for (int batch = 0; batch < NUM_BATCHES; ++batch) \
+      { \
+         uint64_t start = bench_cycles(); \
+         for (int i = 0; i < CALLS_PER_BATCH; ++i) \
+            log_ring_write(&ring, 3, 0, (uint32_t)batch, LOG_CAPTURE(__VA_ARGS__)); \
+         capture_cycles += bench_cycles() - start; \
+         drain_cycles += drain_and_format(); \
+         start = bench_cycles(); \
+         for (int i = 0; i < CALLS_PER_BATCH; ++i) \
+         { \
+            snprintf(reference_line, sizeof(reference_line), __VA_ARGS__); \
+            __asm__ volatile("" : : "r"(reference_line) : "memory"); \
+         } \
+         snprintf_cycles += bench_cycles() - start; \
+      } \
+      \
+      /* Verify that deferred formatting reproduces the immediate output exactly */ \
+      log_ring_write(&ring, 3, 0, 0, LOG_CAPTURE(__VA_ARGS__)); \
+      const log_record_t *record = log_ring_peek(&ring); \
+      log_format_record(record, (const char*)(uintptr_t)record->format, deferred_line, sizeof(deferred_line)); \
+      const uint32_t record_len = record->length; \
+      log_ring_consume(&ring, record); \
+      const int matches = (strcmp(reference_line, deferred_line) == 0); \
+      const double num_calls = (double)NUM_BATCHES * CALLS_PER_BATCH; \
+      printf("%-16s %3u-byte record: capture %7.1f cycles/call, snprintf %7.1f cycles/call (%5.1fx), drain format %7.1f cycles/record, %s\n", \
+             #name, record_len, capture_cycles / num_calls, snprintf_cycles / num_calls, (double)snprintf_cycles / capture_cycles, \
+             drain_cycles / num_calls, matches ? "output identical" : "OUTPUT MISMATCH"); \
+      if (!matches) \
+         printf("   expected: %s\n   deferred: %s\n", reference_line, deferred_line); \
+      return matches ? 0 : 1; \
+   }
+#define BENCH_CASE_ENTRY(name, ...) bench_##name,
+BENCH_CASES(BENCH_CASE)
+
+static volatile int consumer_running;
+
+static void* producer_thread(void *args)
+{
+   // Capture records as fast as the consumer keeps up from one of several concurrent writers, yielding whenever the ring
+   //    is more than half full so that the integrity check covers nearly every record rather than only the few that fit
+   const uintptr_t producer = (uintptr_t)args;
+   for (uint32_t i = 0; i < CALLS_PER_PRODUCER; ++i)
+   {
+      while ((__atomic_load_n(&ring.head, __ATOMIC_RELAXED) - __atomic_load_n(&ring.tail, __ATOMIC_RELAXED)) > PRODUCER_BACKLOG_BYTES)
+         sched_yield();
+      log_ring_write(&ring, 3, (uint8_t)producer, i, LOG_CAPTURE("[%0.6f]: Dispatching audio block with %u samples", (double)i, (uint32_t)producer));
+   }
+   return NULL;
+}
+
+static void* consumer_thread(void *args)
+{
+   // Drain concurrently, checking that every record arrives intact and in order for its producer
+   uint32_t *counts = (uint32_t*)args, next_expected[NUM_PRODUCERS] = { 0 };
+   const log_record_t *record;
+   while (__atomic_load_n(&consumer_running, __ATOMIC_ACQUIRE) || log_ring_peek(&ring))
+      while ((record = log_ring_peek(&ring)))
+      {
+         log_format_record(record, (const char*)(uintptr_t)record->format, deferred_line, sizeof(deferred_line));
+         snprintf(reference_line, sizeof(reference_line), "[%0.6f]: Dispatching audio block with %u samples", (double)record->timestamp_ms, (uint32_t)record->core);
+         counts[0] += (strcmp(reference_line, deferred_line) != 0) || (record->core >= NUM_PRODUCERS) || (record->timestamp_ms < next_expected[record->core]);
+         ++counts[1];
+         if (record->core < NUM_PRODUCERS)
+            next_expected[record->core] = record->timestamp_ms + 1;
+         log_ring_consume(&ring, record);
+      }
+   return NULL;
+}
+
+static int bench_contention(void)
+{
+   // Measure the per-call capture cost with several writers sharing one ring, as tasks sharing a core do on the device
+   pthread_t producers[NUM_PRODUCERS], consumer;
+   uint32_t counts[2] = { 0, 0 };  // Mismatched and received records
+   consumer_running = 1;
+   pthread_create(&consumer, NULL, consumer_thread, counts);
+   const double start = bench_now_seconds();
+   for (uintptr_t i = 0; i < NUM_PRODUCERS; ++i)
+      pthread_create(producers + i, NULL, producer_thread, (void*)i);
+   for (int i = 0; i < NUM_PRODUCERS; ++i)
+      pthread_join(producers[i], NULL);
+   const double elapsed = bench_now_seconds() - start;
+   __atomic_store_n(&consumer_running, 0, __ATOMIC_RELEASE);
+   pthread_join(consumer, NULL);
+   // Fail if too many records were dropped for the check to mean much, or if any record was lost without being counted
+   const uint32_t total = NUM_PRODUCERS * CALLS_PER_PRODUCER, mismatches = counts[0], received = counts[1];
+   const bool too_many_dropped = ring.dropped > (MAX_DROPPED_FRACTION * total), unaccounted = (received + ring.dropped) != total;
+   printf("%d concurrent writers: %.1f ns/call per writer paced by the consumer, %u of %u records checked, %u dropped on a full ring, %s%s\n", NUM_PRODUCERS,
+          1.0e9 * elapsed / CALLS_PER_PRODUCER, received, total, ring.dropped, mismatches ? "CORRUPT RECORDS" : "all records intact",
+          too_many_dropped ? ", TOO MANY DROPPED" : (unaccounted ? ", RECORDS LOST" : ""));
+   return (mismatches || too_many_dropped || unaccounted) ? 1 : 0;
+}
+
+int main(void)
+{
+   // Compare deferred capture against immediate formatting for each representative statement
+   int (*const cases[])(void) = { BENCH_CASES(BENCH_CASE_ENTRY) };
+   int failures = 0;
+   log_ring_init(&ring, ring_buffer, sizeof(ring_buffer));
+   for (size_t i = 0; i < (sizeof(cases) / sizeof(cases[0])); ++i)
+   {
+      drain_ring();
+      failures += cases[i]();
+   }
+   drain_ring();
+   failures += bench_contention();
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,240 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "conditioning.h"
+#include "decimator.h"
+#include "onset.h"
+#include "signal_config.h"
+
+#define WARMUP_SECONDS              3
+#define NUM_EVENTS                  400
+#define EVENT_SPACING_SAMPLES       12000  // Events arrive every quarter second, each at a random fractional position
+#define EVENT_AMPLITUDE             8000.0
+#define EVENT_DECAY_SECONDS         0.004
+#define EVENT_TONES                 3  // Each event is a decaying sum of tones at random frequencies and phases
+#define EVENT_MIN_HZ                300.0
+#define EVENT_MAX_HZ                3000.0
+#define RESPONSE_HALF_WIDTH         2  // Samples either side of center spanned by the simulated front end's impulse response
+#define RESPONSE_OVERSAMPLING       16
+#define MATCH_TOLERANCE_SAMPLES     48  // Picks further than this from every true onset count as false triggers
+#define MIN_DETECTION_RATE          0.99  // Required for every condition at or above MIN_CHECKED_SNR_DB
+#define MIN_CHECKED_SNR_DB          30.0
+#define MAX_MEAN_ERROR_SAMPLES      0.25  // Largest timing bias tolerated at or above MIN_CHECKED_SNR_DB, where it must not vary with SNR
+#define MAX_ERROR_SPREAD_SAMPLES    1.0   // Largest standard deviation of the timing error tolerated at or above MIN_CHECKED_SNR_DB
+
+static const double snr_conditions_db[] = { 40.0, 30.0, 20.0, 14.0 };
+static uint32_t seed = 0x2468ACE1;
+static onset_trigger_t trigger;
+static onset_picker_t picker;
+static onset_window_t window;
+static conditioning_t conditioner;
+static decimator_t decimator;
+
+static double uniform(void)
+{
+   return ((double)bench_random(&seed) + 0.5) / 4294967296.0;
+}
+
+static double gaussian(void)
+{
+   // Box-Muller transform of two uniform deviates
+   return sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform());
+}
+
+static double front_end_response(double u)
+{
+   // Cubic B-spline spanning four samples, approximating the smooth, ringing-free impulse response of the microphone's
+   //    cascaded-integrator-comb PDM decimation filter, so that onsets arrive smeared across neighboring samples as they
+   //    do from the real front end rather than as ideal steps
+   u = fabs(u);
+   if (u < 1.0)
+      return (2.0 / 3.0) - (u * u) + (0.5 * u * u * u);
+   return (u < 2.0) ? ((2.0 - u) * (2.0 - u) * (2.0 - u) / 6.0) : 0.0;
+}
+
+static double event_waveform(double t, const double *frequencies, const double *phases)
+{
+   // Decaying sum of tones beginning abruptly at time zero
+   double value = 0.0;
+   if (t >= 0.0)
+      for (uint32_t k = 0; k < EVENT_TONES; ++k)
+         value += EVENT_AMPLITUDE * exp(-t / EVENT_DECAY_SECONDS) * sin((2.0 * M_PI * frequencies[k] * t) + phases[k]);
+   return value;
+}
+
+static int run_condition(double snr_db)
+{
+   // Synthesize white noise with events whose continuous-time waveform starts exactly at a fractional sample position
+   //    and passes through the simulated front end, so that each true onset is known to arbitrary precision, at an
+   //    initial RMS this far above the noise
+   const uint32_t num_samples = (WARMUP_SECONDS * AUDIO_SAMPLE_RATE_HZ) + (NUM_EVENTS * EVENT_SPACING_SAMPLES);
+   double *signal = calloc(num_samples, sizeof(double)), *onsets = malloc(NUM_EVENTS * sizeof(double));
+   int16_t *samples = malloc(num_samples * sizeof(int16_t));
+   const double noise_rms = EVENT_AMPLITUDE * sqrt(EVENT_TONES / 2.0) / pow(10.0, snr_db / 20.0);
+   for (uint32_t e = 0; e < NUM_EVENTS; ++e)
+   {
+      double frequencies[EVENT_TONES], phases[EVENT_TONES];
+      for (uint32_t t = 0; t < EVENT_TONES; ++t)
+      {
+         frequencies[t] = EVENT_MIN_HZ + ((EVENT_MAX_HZ - EVENT_MIN_HZ) * uniform());
+         phases[t] = 2.0 * M_PI * uniform();
+      }
+      onsets[e] = (WARMUP_SECONDS * AUDIO_SAMPLE_RATE_HZ) + (e * EVENT_SPACING_SAMPLES) + (0.25 * EVENT_SPACING_SAMPLES * uniform());
+      for (uint32_t n = (uint32_t)floor(onsets[e]) - RESPONSE_HALF_WIDTH; n < (uint32_t)(onsets[e] + (10.0 * EVENT_DECAY_SECONDS * AUDIO_SAMPLE_RATE_HZ)); ++n)
+      {
+         // The response only alters the waveform appreciably around the abrupt onset itself
+         if (n <= (onsets[e] + RESPONSE_HALF_WIDTH))
+            for (int32_t j = -RESPONSE_HALF_WIDTH * RESPONSE_OVERSAMPLING; j <= RESPONSE_HALF_WIDTH * RESPONSE_OVERSAMPLING; ++j)
+            {
+               const double u = (double)j / RESPONSE_OVERSAMPLING;
+               signal[n] += front_end_response(u) * event_waveform((n - onsets[e] - u) / AUDIO_SAMPLE_RATE_HZ, frequencies, phases) / RESPONSE_OVERSAMPLING;
+            }
+         else
+            signal[n] = event_waveform((n - onsets[e]) / AUDIO_SAMPLE_RATE_HZ, frequencies, phases);
+      }
+   }
+   for (uint32_t n = 0; n < num_samples; ++n)
+      samples[n] = (int16_t)fmax(fmin(lround(signal[n] + (noise_rms * gaussian())), 32767.0), -32768.0);
+
+   // Stream the audio through the trigger in capture-sized chunks and pick each window it completes, timing both and
+   //    noting how long after each true onset its report became available at the end of a chunk
+   const onset_config_t config = { .sample_rate_hz = AUDIO_SAMPLE_RATE_HZ, .sta_seconds = TOA_STA_SECONDS, .lta_seconds = TOA_LTA_SECONDS,
+                                   .trigger_ratio = TOA_TRIGGER_RATIO, .release_ratio = TOA_RELEASE_RATIO, .min_level = TOA_MIN_LEVEL };
+   onset_trigger_init(&trigger, &config);
+   onset_pick_t pick;
+   uint32_t num_detected = 0, num_false = 0, num_within_sample = 0, next_event = 0;
+   double error_sum = 0.0, error_squared = 0.0, uncertainty_squared = 0.0, confidence_sum = 0.0, latency_sum = 0.0, max_latency = 0.0;
+   uint64_t trigger_cycles = 0, pick_cycles = 0;
+   for (uint32_t offset = 0; offset + AUDIO_READ_CHUNK_SAMPLES <= num_samples; offset += AUDIO_READ_CHUNK_SAMPLES)
+   {
+      uint64_t start_cycles = bench_cycles();
+      const bool triggered = onset_trigger_process(&trigger, samples + offset, AUDIO_READ_CHUNK_SAMPLES, &window);
+      trigger_cycles += bench_cycles() - start_cycles;
+      if (!triggered)
+         continue;
+      start_cycles = bench_cycles();
+      onset_pick(&picker, window.samples, ONSET_WINDOW_SAMPLES, window.start, &pick);
+      pick_cycles += bench_cycles() - start_cycles;
+      while ((next_event < NUM_EVENTS) && (onsets[next_event] < (pick.sample_position - MATCH_TOLERANCE_SAMPLES)))
+         ++next_event;
+      if ((next_event < NUM_EVENTS) && (fabs(pick.sample_position - onsets[next_event]) <= MATCH_TOLERANCE_SAMPLES))
+      {
+         const double error = pick.sample_position - onsets[next_event];
+         const double latency = (offset + AUDIO_READ_CHUNK_SAMPLES - onsets[next_event]) / AUDIO_SAMPLE_RATE_HZ;
+         error_sum += error;
+         error_squared += error * error;
+         uncertainty_squared += pick.uncertainty_samples * pick.uncertainty_samples;
+         confidence_sum += pick.confidence;
+         latency_sum += latency;
+         max_latency = fmax(max_latency, latency);
+         num_within_sample += (fabs(error) <= 1.0);
+         ++num_detected;
+         ++next_event;
+      }
+      else
+         ++num_false;
+   }
+
+   // Summarize timing accuracy against what the picker itself claimed
+   const double detection_rate = (double)num_detected / NUM_EVENTS;
+   const double rms_error = num_detected ? sqrt(error_squared / num_detected) : INFINITY;
+   const double mean_error = num_detected ? (error_sum / num_detected) : INFINITY;
+   const double error_spread = num_detected ? sqrt(fmax((error_squared / num_detected) - (mean_error * mean_error), 0.0)) : INFINITY;
+   printf("SNR %4.0f dB: %3u/%u detected, %u false; error %+.3f mean, %.3f std, %.3f RMS samples (%.2f us), %.0f%% within 1 sample;"
+          " reported %.3f RMS samples, confidence %.2f; report %.1f ms mean, %.1f ms max after onset\n", snr_db, num_detected, NUM_EVENTS,
+          num_false, num_detected ? mean_error : 0.0, num_detected ? error_spread : 0.0, rms_error, 1.0e6 * rms_error / AUDIO_SAMPLE_RATE_HZ,
+          num_detected ? (100.0 * num_within_sample / num_detected) : 0.0, num_detected ? sqrt(uncertainty_squared / num_detected) : 0.0,
+          num_detected ? (confidence_sum / num_detected) : 0.0, num_detected ? (1.0e3 * latency_sum / num_detected) : 0.0, 1.0e3 * max_latency);
+   printf("   Trigger %.1f cycles/sample, %.0f cycles/pick\n", (double)trigger_cycles / num_samples,
+          (double)pick_cycles / (num_detected + num_false));
+   free(signal);
+   free(onsets);
+   free(samples);
+   return (snr_db >= MIN_CHECKED_SNR_DB) && ((detection_rate < MIN_DETECTION_RATE) || num_false || (fabs(mean_error) > MAX_MEAN_ERROR_SAMPLES) ||
+                                             (error_spread > MAX_ERROR_SPREAD_SAMPLES));
+}
+
+static int replay_file(const char *input_path, const char *output_path, const char *decimated_path, float trigger_ratio)
+{
+   // Run a raw 48 kHz mono int16 recording through the audio task's conditioning, trigger and decimation and the TOA task's
+   //    pick, writing one CSV row per picked event (with the sample at whose chunk its report became available) and
+   //    optionally the decimated stream, for ai/yamnet/evaluate_detection.py
+   FILE *input = fopen(input_path, "rb"), *output = output_path ? fopen(output_path, "w") : stdout;
+   FILE *decimated_output = decimated_path ? fopen(decimated_path, "wb") : NULL;
+   if (!input || !output || (decimated_path && !decimated_output))
+   {
+      fprintf(stderr, "Unable to open input, output, or decimated output file\n");
+      return 1;
+   }
+   const onset_config_t config = { .sample_rate_hz = AUDIO_SAMPLE_RATE_HZ, .sta_seconds = TOA_STA_SECONDS, .lta_seconds = TOA_LTA_SECONDS,
+                                   .trigger_ratio = trigger_ratio, .release_ratio = TOA_RELEASE_RATIO, .min_level = TOA_MIN_LEVEL };
+   conditioning_init(&conditioner, &(conditioning_config_t){ .sample_rate_hz = AUDIO_SAMPLE_RATE_HZ, .dc_blocker_cutoff_hz = CONDITIONING_DC_BLOCKER_CUTOFF_HZ,
+      .highpass_cutoff_hz = CONDITIONING_HIGHPASS_CUTOFF_HZ, .highpass_sections = CONDITIONING_HIGHPASS_SECTIONS, .gain_db = CONDITIONING_GAIN_DB });
+   decimator_init(&decimator, AUDIO_SAMPLE_RATE_HZ, AUDIO_DECIMATED_RATE_HZ);
+   onset_trigger_init(&trigger, &config);
+   fprintf(output, "trigger_sample,onset_sample,uncertainty_samples,confidence,snr_db,peak,report_sample\n");
+   static int16_t chunk[AUDIO_READ_CHUNK_SAMPLES], decimated[AUDIO_READ_CHUNK_SAMPLES];
+   onset_pick_t pick;
+   uint64_t num_samples = 0;
+   uint32_t num_triggers = 0, num_picks = 0;
+   const double start = bench_now_seconds();
+   while (fread(chunk, sizeof(int16_t), AUDIO_READ_CHUNK_SAMPLES, input) == AUDIO_READ_CHUNK_SAMPLES)
+   {
+      conditioning_process(&conditioner, chunk, AUDIO_READ_CHUNK_SAMPLES);
+      num_samples += AUDIO_READ_CHUNK_SAMPLES;
+      if (onset_trigger_process(&trigger, chunk, AUDIO_READ_CHUNK_SAMPLES, &window))
+      {
+         ++num_triggers;
+         if (onset_pick(&picker, window.samples, ONSET_WINDOW_SAMPLES, window.start, &pick))
+         {
+            ++num_picks;
+            fprintf(output, "%llu,%.3f,%.3f,%.3f,%.2f,%d,%llu\n", (unsigned long long)(window.start + ONSET_PRE_TRIGGER_SAMPLES - 1),
+                    pick.sample_position, pick.uncertainty_samples, pick.confidence, pick.snr_db, pick.peak, (unsigned long long)num_samples);
+         }
+      }
+      const uint32_t num_decimated = decimator_process(&decimator, chunk, AUDIO_READ_CHUNK_SAMPLES, decimated);
+      if (decimated_output)
+         fwrite(decimated, sizeof(int16_t), num_decimated, decimated_output);
+   }
+   const double seconds = bench_now_seconds() - start;
+   fprintf(stderr, "Replayed %.1f s of audio in %.3f s (%.0fx real time): %u triggers, %u picks\n", (double)num_samples / AUDIO_SAMPLE_RATE_HZ, seconds,
+          (double)num_samples / (AUDIO_SAMPLE_RATE_HZ * seconds), num_triggers, num_picks);
+   fclose(input);
+   if (output != stdout)
+      fclose(output);
+   if (decimated_output)
+      fclose(decimated_output);
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   // Replay a recording if one is given, otherwise measure detection, sub-sample timing error, and report latency across a
+   //    range of signal-to-noise ratios
+   const char *input_path = NULL, *output_path = NULL, *decimated_path = NULL;
+   float trigger_ratio = TOA_TRIGGER_RATIO;
+   for (int i = 1; i < argc; ++i)
+   {
+      if (!strcmp(argv[i], "--input") && (i + 1 < argc))
+         input_path = argv[++i];
+      else if (!strcmp(argv[i], "--output") && (i + 1 < argc))
+         output_path = argv[++i];
+      else if (!strcmp(argv[i], "--decimated") && (i + 1 < argc))
+         decimated_path = argv[++i];
+      else if (!strcmp(argv[i], "--trigger-ratio") && (i + 1 < argc))
+         trigger_ratio = (float)atof(argv[++i]);
+      else
+      {
+         fprintf(stderr, "Usage: %s [--input <audio_48k.raw> [--output <picks.csv>] [--decimated <audio_16k.raw>] [--trigger-ratio <ratio>]]\n", argv[0]);
+         return 1;
+      }
+   }
+   if (input_path)
+      return replay_file(input_path, output_path, decimated_path, trigger_ratio);
+   int failures = 0;
+   for (uint32_t c = 0; c < (sizeof(snr_conditions_db) / sizeof(snr_conditions_db[0])); ++c)
+      failures += run_condition(snr_conditions_db[c]);
+   return failures ? 1 : 0;
+}
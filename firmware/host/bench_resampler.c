@@ -0,0 +1,239 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "drift.h"
+#include "resampler.h"
+
+#define SAMPLE_RATE_HZ              48000
+#define NUM_SECONDS                 10
+#define NUM_SAMPLES                 (SAMPLE_RATE_HZ * NUM_SECONDS)
+#define CHUNK_SAMPLES               480
+#define TONE_AMPLITUDE              16000.0
+#define TONE_SECONDS                2
+#define TEST_DRIFT_PPM              37.5
+#define START_POSITION              100.3
+#define MIN_TONE_SNR_DB             75.0
+#define MAX_REFERENCE_ERROR_LSB     2
+#define DRIFT_SIMULATION_SECONDS    3600
+#define DRIFT_TIMESTAMP_JITTER_S    0.00025
+#define MAX_DRIFT_PPM_ERROR         2.0
+#define MAX_DRIFT_TIME_ERROR_S      0.0001
+#define DISCIPLINED_SECONDS         300
+#define DISCIPLINED_TONE_HZ         1000.0
+
+static resampler_t resampler;
+
+static uint32_t resample(const int16_t *input, uint32_t num_input, int16_t *output, uint32_t max_output, bool reference)
+{
+   // Feed the input in capture-sized chunks, draining the resampler after every chunk as the dispatch task does
+   uint32_t num_output = 0;
+   for (uint32_t offset = 0; offset < num_input; )
+   {
+      const uint32_t chunk = ((num_input - offset) < CHUNK_SAMPLES) ? (num_input - offset) : CHUNK_SAMPLES;
+      uint32_t written = 0;
+      while (written < chunk)
+      {
+         written += resampler_write(&resampler, input + offset + written, chunk - written);
+         num_output += reference ? resampler_read_reference(&resampler, output + num_output, max_output - num_output) :
+                                   resampler_read(&resampler, output + num_output, max_output - num_output);
+      }
+      offset += chunk;
+   }
+   return num_output;
+}
+
+static double tone_snr_db(double frequency_hz, bool reference)
+{
+   // Resample a tone captured by a fast clock and compare each output with the tone evaluated exactly at its position
+   const double input_rate_hz = SAMPLE_RATE_HZ * (1.0 + (TEST_DRIFT_PPM * 1.0e-6)), ratio = input_rate_hz / SAMPLE_RATE_HZ;
+   const uint32_t num_input = TONE_SECONDS * SAMPLE_RATE_HZ;
+   int16_t *input = malloc(num_input * sizeof(int16_t)), *output = malloc(num_input * sizeof(int16_t));
+   for (uint32_t i = 0; i < num_input; ++i)
+      input[i] = (int16_t)lround(TONE_AMPLITUDE * sin(2.0 * M_PI * frequency_hz * i / input_rate_hz));
+   resampler_reset(&resampler, START_POSITION);
+   resampler_set_ratio(&resampler, ratio);
+   const double step = resampler.step / 4294967296.0;
+   const uint32_t num_output = resample(input, num_input, output, num_input, reference);
+   double signal = 0.0, noise = 0.0;
+   for (uint32_t m = 0; m < num_output; ++m)
+   {
+      const double expected = TONE_AMPLITUDE * sin(2.0 * M_PI * frequency_hz * (START_POSITION + (m * step)) / input_rate_hz);
+      signal += expected * expected;
+      noise += (output[m] - expected) * (output[m] - expected);
+   }
+   free(input);
+   free(output);
+   return 10.0 * log10(signal / (noise > 0.0 ? noise : 1.0e-9));
+}
+
+static int run_resampler(void)
+{
+   // Tones and noise captured at a drifted rate, as in the benchmark suite
+   uint32_t seed = 0x12345678;
+   int16_t *input = malloc(NUM_SAMPLES * sizeof(int16_t)), *optimized = malloc(NUM_SAMPLES * sizeof(int16_t)), *reference = malloc(NUM_SAMPLES * sizeof(int16_t));
+   for (uint32_t i = 0; i < NUM_SAMPLES; ++i)
+   {
+      const double t = (double)i / SAMPLE_RATE_HZ;
+      double value = (4000.0 * sin(2.0 * M_PI * 440.0 * t)) + (3000.0 * sin(2.0 * M_PI * 5000.0 * t)) + (3000.0 * sin(2.0 * M_PI * 11000.0 * t));
+      value += (double)((int32_t)(bench_random(&seed) & 0x1FFF) - 4096);
+      input[i] = (int16_t)((value > 32767.0) ? 32767.0 : ((value < -32768.0) ? -32768.0 : value));
+   }
+
+   // Time the fixed-point path against the double-precision reference on identical input and steering
+   const double ratio = 1.0 + (TEST_DRIFT_PPM * 1.0e-6);
+   resampler_reset(&resampler, START_POSITION);
+   resampler_set_ratio(&resampler, ratio);
+   const uint64_t reference_start = bench_cycles();
+   const uint32_t num_reference = resample(input, NUM_SAMPLES, reference, NUM_SAMPLES, true);
+   const uint64_t reference_cycles = bench_cycles() - reference_start;
+   resampler_reset(&resampler, START_POSITION);
+   resampler_set_ratio(&resampler, ratio);
+   const double optimized_start_time = bench_now_seconds();
+   const uint64_t optimized_start = bench_cycles();
+   const uint32_t num_optimized = resample(input, NUM_SAMPLES, optimized, NUM_SAMPLES, false);
+   const uint64_t optimized_cycles = bench_cycles() - optimized_start;
+   const double optimized_seconds = bench_now_seconds() - optimized_start_time;
+
+   // Compare the two paths and report the per-output cost along with the interpolation accuracy across the band
+   int32_t max_error = (num_reference == num_optimized) ? 0 : INT32_MAX;
+   for (uint32_t i = 0; (i < num_reference) && (i < num_optimized); ++i)
+   {
+      const int32_t error = abs((int32_t)reference[i] - optimized[i]);
+      max_error = (error > max_error) ? error : max_error;
+   }
+   int32_t max_tap_sum = 0;
+   for (uint32_t phase = 0; phase <= RESAMPLER_PHASES; ++phase)
+   {
+      int32_t tap_sum = 0;
+      for (uint32_t k = 0; k < RESAMPLER_TAPS; ++k)
+         tap_sum += abs(resampler.taps[phase][k]);
+      max_tap_sum = (tap_sum > max_tap_sum) ? tap_sum : max_tap_sum;
+   }
+   printf("Resampler (%u taps, %u phases, %+.1f ppm): reference %8.2f cycles/output, optimized %7.2f cycles/output (%7.1fx real time), "
+          "max deviation from reference %d LSB, max absolute tap sum %.3f\n", RESAMPLER_TAPS, RESAMPLER_PHASES, TEST_DRIFT_PPM,
+          (double)reference_cycles / num_reference, (double)optimized_cycles / num_optimized, NUM_SECONDS / optimized_seconds, max_error,
+          (double)max_tap_sum / (1 << RESAMPLER_COEFF_SHIFT));
+   int failures = (max_error > MAX_REFERENCE_ERROR_LSB);
+   const double tones_hz[] = { 100.0, 1000.0, 5000.0, 10000.0, 15000.0, 18000.0 };
+   for (size_t i = 0; i < (sizeof(tones_hz) / sizeof(tones_hz[0])); ++i)
+   {
+      const double snr = tone_snr_db(tones_hz[i], false);
+      printf("   SNR %6.1f dB @ %5.0f Hz (reference %6.1f dB)\n", snr, tones_hz[i], tone_snr_db(tones_hz[i], true));
+      failures += (tones_hz[i] <= 15000.0) && (snr < MIN_TONE_SNR_DB);
+   }
+   free(input);
+   free(optimized);
+   free(reference);
+   return failures;
+}
+
+static int run_drift_estimator(void)
+{
+   // Simulate an hour of one-second blocks from a clock wandering with temperature, each boundary stamped with timing jitter
+   drift_estimator_t estimator;
+   drift_estimator_init(&estimator, SAMPLE_RATE_HZ);
+   uint32_t seed = 0x2468ACE1, num_valid = 0, num_rejected = 0;
+   double true_time = 1400000000.0, ppm_error_squared = 0.0, time_error_squared = 0.0, max_time_error = 0.0;
+   const uint64_t start_cycles = bench_cycles();
+   for (uint32_t block = 0; block < DRIFT_SIMULATION_SECONDS; ++block)
+   {
+      const double true_ppm = TEST_DRIFT_PPM + (3.0 * sin(2.0 * M_PI * block / 1800.0));
+      const double jitter = DRIFT_TIMESTAMP_JITTER_S * (((double)bench_random(&seed) / UINT32_MAX) * 2.0 - 1.0);
+      const uint64_t sample_index = (uint64_t)block * SAMPLE_RATE_HZ;
+      num_rejected += (drift_estimator_update(&estimator, sample_index, true_time + jitter) != DRIFT_UPDATE_ACCEPTED);
+      if (drift_estimator_valid(&estimator) && (block >= DRIFT_WINDOW_BLOCKS))
+      {
+         const double ppm_error = drift_estimator_ppm(&estimator) - true_ppm, time_error = drift_estimator_time_at(&estimator, (double)sample_index) - true_time;
+         ppm_error_squared += ppm_error * ppm_error;
+         time_error_squared += time_error * time_error;
+         max_time_error = (fabs(time_error) > max_time_error) ? fabs(time_error) : max_time_error;
+         ++num_valid;
+      }
+      true_time += 1.0 / (1.0 + (true_ppm * 1.0e-6));
+   }
+   const uint64_t cycles = bench_cycles() - start_cycles;
+
+   // Report how closely the fit tracks the true rate and block times compared with the raw timestamp jitter
+   const double ppm_rms = sqrt(ppm_error_squared / num_valid), time_rms = sqrt(time_error_squared / num_valid);
+   printf("Drift estimator (%u-block window, +/-%.0f us timestamp jitter): rate error %.3f ppm RMS, block time error %.1f us RMS (%.1f us max), "
+          "%u rejected, %.0f cycles/update\n", DRIFT_WINDOW_BLOCKS, 1.0e6 * DRIFT_TIMESTAMP_JITTER_S, ppm_rms, 1.0e6 * time_rms, 1.0e6 * max_time_error,
+          num_rejected, (double)cycles / DRIFT_SIMULATION_SECONDS);
+   return (num_rejected != 0) || (ppm_rms > MAX_DRIFT_PPM_ERROR) || (max_time_error > MAX_DRIFT_TIME_ERROR_S);
+}
+
+static int run_disciplined_capture(void)
+{
+   // Capture a tone with a drifting, jittered clock and correct it exactly as the dispatch task does: estimate the drift at
+   //    each block boundary, start on a whole GPS second once the fit is valid, and steer every output second onto the grid
+   drift_estimator_t estimator;
+   drift_estimator_init(&estimator, SAMPLE_RATE_HZ);
+   uint32_t seed = 0x13579BDF, num_seconds = 0, pending = 0;
+   int16_t *input = malloc(SAMPLE_RATE_HZ * sizeof(int16_t)), *output = malloc(SAMPLE_RATE_HZ * sizeof(int16_t));
+   const double input_rate_hz = SAMPLE_RATE_HZ * (1.0 + (TEST_DRIFT_PPM * 1.0e-6)), start_time = 1400000000.25;
+   double output_time = 0.0, time_error_squared = 0.0, max_time_error = 0.0;
+   uint64_t origin = 0;
+   bool resampling = false;
+   for (uint32_t block = 0; block < DISCIPLINED_SECONDS; ++block)
+   {
+      const uint64_t block_start_sample = (uint64_t)block * SAMPLE_RATE_HZ;
+      for (uint32_t i = 0; i < SAMPLE_RATE_HZ; ++i)
+         input[i] = (int16_t)lround(TONE_AMPLITUDE * sin(2.0 * M_PI * DISCIPLINED_TONE_HZ * (double)(block_start_sample + i) / input_rate_hz));
+      const double jitter = DRIFT_TIMESTAMP_JITTER_S * (((double)bench_random(&seed) / UINT32_MAX) * 2.0 - 1.0);
+      drift_estimator_update(&estimator, block_start_sample, start_time + (block_start_sample / input_rate_hz) + jitter);
+      if (!resampling && drift_estimator_valid(&estimator))
+      {
+         output_time = ceil(drift_estimator_time_at(&estimator, (double)(block_start_sample + RESAMPLER_TAPS)));
+         origin = block_start_sample;
+         resampler_reset(&resampler, drift_estimator_position_at(&estimator, output_time) - (double)block_start_sample);
+         resampling = true;
+      }
+      for (uint32_t offset = 0; resampling && (offset < SAMPLE_RATE_HZ); )
+      {
+         offset += resampler_write(&resampler, input + offset, SAMPLE_RATE_HZ - offset);
+         while (true)
+         {
+            if (!pending)
+               resampler_set_ratio(&resampler, (drift_estimator_position_at(&estimator, output_time + 1.0) - (double)origin - resampler_position(&resampler)) / SAMPLE_RATE_HZ);
+            const uint32_t produced = resampler_read(&resampler, output + pending, SAMPLE_RATE_HZ - pending);
+            pending += produced;
+            if (!produced || (pending < SAMPLE_RATE_HZ))
+               break;
+
+            // Measure where the tone in this output second actually lies relative to the GPS time grid, by quadrature
+            double in_phase = 0.0, quadrature = 0.0;
+            for (uint32_t m = 0; m < SAMPLE_RATE_HZ; ++m)
+            {
+               const double phase = 2.0 * M_PI * DISCIPLINED_TONE_HZ * ((output_time - start_time) + ((double)m / SAMPLE_RATE_HZ));
+               in_phase += output[m] * sin(phase);
+               quadrature += output[m] * cos(phase);
+            }
+            const double time_error = atan2(quadrature, in_phase) / (2.0 * M_PI * DISCIPLINED_TONE_HZ);
+            time_error_squared += time_error * time_error;
+            max_time_error = (fabs(time_error) > max_time_error) ? fabs(time_error) : max_time_error;
+            ++num_seconds;
+            output_time += 1.0;
+            pending = 0;
+         }
+      }
+   }
+
+   // Report how closely the corrected stream follows GPS time compared with the raw block timestamps
+   const double time_rms = num_seconds ? sqrt(time_error_squared / num_seconds) : INFINITY;
+   printf("Disciplined capture (%+.1f ppm, +/-%.0f us timestamp jitter): %u corrected seconds, grid error %.1f us RMS (%.1f us max)\n",
+          TEST_DRIFT_PPM, 1.0e6 * DRIFT_TIMESTAMP_JITTER_S, num_seconds, 1.0e6 * time_rms, 1.0e6 * max_time_error);
+   free(input);
+   free(output);
+   return (num_seconds < (DISCIPLINED_SECONDS - DRIFT_MIN_BLOCKS - 2)) || (max_time_error > MAX_DRIFT_TIME_ERROR_S);
+}
+
+int main(void)
+{
+   // Benchmark the resampler against its reference, then the accuracy of the drift estimator that steers it and of the two together
+   resampler_init(&resampler);
+   int failures = run_resampler();
+   failures += run_drift_estimator();
+   failures += run_disciplined_capture();
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,246 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "decimator.h"
+#include "spectral.h"
+
+#define SAMPLE_RATE_HZ              48000
+#define CHUNK_SAMPLES               480
+#define TEST_SECONDS                10
+#define TEST_FRAMES                 200
+#define MAX_LOG_MEL_ERROR           1.0e-3
+#define MAX_BAND_ERROR_DB           0.01
+#define MAX_CALIBRATION_ERROR_DB    0.1
+
+static spectral_t spectral;
+static decimator_t decimator;
+
+static double hz_to_mel(double hz)
+{
+   return 1127.0 * log(1.0 + (hz / 700.0));
+}
+
+static void reference_frame(const int16_t *frame, double *log_mel, double *band_power)
+{
+   // Direct double-precision DFT of the centered, zero-padded frame followed by the mel weights exactly as written in
+   //    tf.signal.linear_to_mel_weight_matrix(), independent of every table the kernel precomputes
+   double padded[SPECTRAL_FFT_SIZE] = { 0 }, magnitude[SPECTRAL_NUM_BINS], power[SPECTRAL_NUM_BINS], window_energy = 0.0;
+   const uint32_t half_pad = (SPECTRAL_FFT_SIZE - SPECTRAL_FRAME_SAMPLES) / 2;
+   for (uint32_t n = 0; n < SPECTRAL_FRAME_SAMPLES; ++n)
+   {
+      const double window = 0.5 - (0.5 * cos(2.0 * M_PI * n / SPECTRAL_FRAME_SAMPLES));
+      padded[half_pad + n] = (frame[n] / 32768.0) * window;
+      window_energy += window * window;
+   }
+   for (uint32_t k = 0; k < SPECTRAL_NUM_BINS; ++k)
+   {
+      double re = 0.0, im = 0.0;
+      for (uint32_t n = 0; n < SPECTRAL_FFT_SIZE; ++n)
+      {
+         re += padded[n] * cos(2.0 * M_PI * k * n / SPECTRAL_FFT_SIZE);
+         im -= padded[n] * sin(2.0 * M_PI * k * n / SPECTRAL_FFT_SIZE);
+      }
+      power[k] = (re * re) + (im * im);
+      magnitude[k] = sqrt(power[k]);
+   }
+   const double lowest = hz_to_mel(SPECTRAL_MEL_MIN_HZ), highest = hz_to_mel(SPECTRAL_MEL_MAX_HZ);
+   for (uint32_t b = 0; b < SPECTRAL_MEL_BANDS; ++b)
+   {
+      const double lower = lowest + ((highest - lowest) * b / (SPECTRAL_MEL_BANDS + 1));
+      const double center = lowest + ((highest - lowest) * (b + 1) / (SPECTRAL_MEL_BANDS + 1));
+      const double upper = lowest + ((highest - lowest) * (b + 2) / (SPECTRAL_MEL_BANDS + 1));
+      double mel = 0.0;
+      for (uint32_t k = 1; k < SPECTRAL_NUM_BINS; ++k)
+      {
+         const double bin_mel = hz_to_mel((double)k * SPECTRAL_SAMPLE_RATE_HZ / SPECTRAL_FFT_SIZE);
+         const double weight = fmin((bin_mel - lower) / (center - lower), (upper - bin_mel) / (upper - center));
+         mel += (weight > 0.0) ? (weight * magnitude[k]) : 0.0;
+      }
+      log_mel[b] = log(mel + SPECTRAL_LOG_OFFSET);
+   }
+   for (uint32_t b = 0; b < SPECTRAL_OCTAVE_BANDS; ++b)
+   {
+      const double center = SPECTRAL_OCTAVE_LOWEST_HZ * pow(2.0, b);
+      band_power[b] = 0.0;
+      for (uint32_t k = 1; k < (SPECTRAL_NUM_BINS - 1); ++k)
+      {
+         const double hz = (double)k * SPECTRAL_SAMPLE_RATE_HZ / SPECTRAL_FFT_SIZE;
+         if ((hz >= (center / M_SQRT2)) && (hz < (center * M_SQRT2)))
+            band_power[b] += 4.0 * power[k] / (SPECTRAL_FFT_SIZE * window_energy);
+      }
+   }
+}
+
+static void generate_frame(int16_t *frame, uint32_t index, uint32_t *seed)
+{
+   // Mixtures of tones and noise at levels from near silence up to full scale
+   const double level = pow(10.0, -4.0 * (index % 5) / 5.0), tone_hz = 50.0 + (37.3 * index);
+   for (uint32_t n = 0; n < SPECTRAL_FRAME_SAMPLES; ++n)
+   {
+      const double noise = ((double)(bench_random(seed) & 0xFFFF) / 32768.0) - 1.0;
+      const double value = level * ((0.6 * sin(2.0 * M_PI * tone_hz * n / SPECTRAL_SAMPLE_RATE_HZ)) + (0.3 * noise));
+      frame[n] = (int16_t)lrint(value * 32767.0);
+   }
+}
+
+static int compare_reference(void)
+{
+   // Largest deviation of the kernel's per-frame log-mel and octave band levels from the double-precision reference
+   int16_t frame[SPECTRAL_FRAME_SAMPLES];
+   float log_mel[SPECTRAL_MEL_BANDS], band_power[SPECTRAL_OCTAVE_BANDS];
+   double reference_log_mel[SPECTRAL_MEL_BANDS], reference_band_power[SPECTRAL_OCTAVE_BANDS], max_log_mel_error = 0.0, max_band_error = 0.0;
+   uint32_t seed = 0x13579BDF;
+   for (uint32_t f = 0; f < TEST_FRAMES; ++f)
+   {
+      generate_frame(frame, f, &seed);
+      spectral_analyze_frame(&spectral, frame, log_mel, band_power);
+      reference_frame(frame, reference_log_mel, reference_band_power);
+      for (uint32_t b = 0; b < SPECTRAL_MEL_BANDS; ++b)
+         max_log_mel_error = fmax(max_log_mel_error, fabs(log_mel[b] - reference_log_mel[b]));
+      for (uint32_t b = 0; b < SPECTRAL_OCTAVE_BANDS; ++b)
+         if (reference_band_power[b] > 1.0e-9)
+            max_band_error = fmax(max_band_error, fabs(10.0 * log10(spectral.power_scale * band_power[b] / reference_band_power[b])));
+   }
+   const bool passed = (max_log_mel_error <= MAX_LOG_MEL_ERROR) && (max_band_error <= MAX_BAND_ERROR_DB);
+   printf("Reference: max log-mel error %.2e, max octave band error %.4f dB over %u frames: %s\n", max_log_mel_error, max_band_error,
+          TEST_FRAMES, passed ? "ok" : "FAILED");
+   return passed ? 0 : 1;
+}
+
+static int check_calibration(void)
+{
+   // A full-scale 1 kHz sine must read 0 dBFS peak, RMS, and octave band level with a 3.01 dB crest factor
+   static int16_t audio[SAMPLE_RATE_HZ], decimated[SPECTRAL_SAMPLE_RATE_HZ];
+   spectral_summary_t summary;
+   for (uint32_t n = 0; n < SAMPLE_RATE_HZ; ++n)
+      audio[n] = (int16_t)lrint(32767.0 * sin(2.0 * M_PI * 1000.0 * n / SAMPLE_RATE_HZ));
+   decimator_init(&decimator, SAMPLE_RATE_HZ, SPECTRAL_SAMPLE_RATE_HZ);
+   spectral_reset(&spectral);
+   for (uint32_t second = 0; second < 2; ++second)
+   {
+      uint32_t num_decimated = 0;
+      for (uint32_t offset = 0; offset < SAMPLE_RATE_HZ; offset += CHUNK_SAMPLES)
+      {
+         spectral_measure_levels(&spectral, audio + offset, CHUNK_SAMPLES);
+         num_decimated += decimator_process(&decimator, audio + offset, CHUNK_SAMPLES, decimated + num_decimated);
+      }
+      spectral_process(&spectral, decimated, num_decimated);
+      spectral_finish(&spectral, &summary);
+   }
+   const double one_khz_band = summary.band_dbfs[4];
+   const bool passed = (fabs(summary.peak_dbfs) <= MAX_CALIBRATION_ERROR_DB) && (fabs(summary.rms_dbfs) <= MAX_CALIBRATION_ERROR_DB) &&
+                       (fabs(summary.crest_db - 3.0103) <= MAX_CALIBRATION_ERROR_DB) && (fabs(one_khz_band) <= MAX_CALIBRATION_ERROR_DB) &&
+                       (summary.num_frames == (SPECTRAL_SAMPLE_RATE_HZ / SPECTRAL_HOP_SAMPLES));
+   printf("Calibration: %u frames, peak %.3f dBFS, RMS %.3f dBFS, crest %.3f dB, 1 kHz octave %.3f dBFS, 250 Hz octave %.1f dBFS: %s\n",
+          summary.num_frames, summary.peak_dbfs, summary.rms_dbfs, summary.crest_db, one_khz_band, summary.band_dbfs[2], passed ? "ok" : "FAILED");
+   return passed ? 0 : 1;
+}
+
+static void measure_throughput(void)
+{
+   // Cost of summarizing one second as the audio task does, chunk by chunk, excluding the decimator it shares
+   static int16_t audio[SAMPLE_RATE_HZ * TEST_SECONDS], decimated[SPECTRAL_SAMPLE_RATE_HZ * TEST_SECONDS];
+   uint32_t seed = 0x2468ACE1;
+   for (uint32_t n = 0; n < (SAMPLE_RATE_HZ * TEST_SECONDS); ++n)
+      audio[n] = (int16_t)((int32_t)(bench_random(&seed) & 0x3FFF) - 0x2000);
+   for (uint32_t n = 0; n < (SPECTRAL_SAMPLE_RATE_HZ * TEST_SECONDS); ++n)
+      decimated[n] = audio[3 * n];
+   spectral_summary_t summary;
+   double best_seconds = INFINITY, best_cycles = INFINITY;
+   for (uint32_t repeat = 0; repeat < 5; ++repeat)
+   {
+      spectral_reset(&spectral);
+      const double start = bench_now_seconds();
+      const uint64_t start_cycles = bench_cycles();
+      for (uint32_t second = 0; second < TEST_SECONDS; ++second)
+      {
+         for (uint32_t chunk = 0; chunk < (SAMPLE_RATE_HZ / CHUNK_SAMPLES); ++chunk)
+         {
+            spectral_measure_levels(&spectral, audio + (second * SAMPLE_RATE_HZ) + (chunk * CHUNK_SAMPLES), CHUNK_SAMPLES);
+            spectral_process(&spectral, decimated + (second * SPECTRAL_SAMPLE_RATE_HZ) + (chunk * SPECTRAL_HOP_SAMPLES), SPECTRAL_HOP_SAMPLES);
+         }
+         spectral_finish(&spectral, &summary);
+      }
+      best_cycles = fmin(best_cycles, (double)(bench_cycles() - start_cycles));
+      best_seconds = fmin(best_seconds, bench_now_seconds() - start);
+   }
+   const uint32_t frames = (SPECTRAL_SAMPLE_RATE_HZ / SPECTRAL_HOP_SAMPLES) * TEST_SECONDS;
+   printf("Throughput: %.1f us and %.0f cycles per second of audio (%.0f cycles per frame), %zu-byte state\n",
+          1.0e6 * best_seconds / TEST_SECONDS, best_cycles / TEST_SECONDS, best_cycles / frames, sizeof(spectral_t));
+}
+
+static int summarize_file(const char *input_path, const char *output_path, const char *decimated_path)
+{
+   // Run a raw 48 kHz mono int16 recording through the same decimation and summary chain as the audio task, writing one
+   //    CSV row per second (and optionally the decimated audio) for comparison against ai/yamnet/verify_summary.py
+   FILE *input = fopen(input_path, "rb"), *output = output_path ? fopen(output_path, "w") : stdout;
+   FILE *decimated_output = decimated_path ? fopen(decimated_path, "wb") : NULL;
+   if (!input || !output || (decimated_path && !decimated_output))
+   {
+      fprintf(stderr, "Unable to open input, output, or decimated output file\n");
+      return 1;
+   }
+   fprintf(output, "second,num_frames,peak_dbfs,rms_dbfs,crest_db");
+   for (uint32_t b = 0; b < SPECTRAL_OCTAVE_BANDS; ++b)
+      fprintf(output, ",band_%g_hz", SPECTRAL_OCTAVE_LOWEST_HZ * pow(2.0, b));
+   for (uint32_t b = 0; b < SPECTRAL_MEL_BANDS; ++b)
+      fprintf(output, ",log_mel_%u", b);
+   fprintf(output, "\n");
+   static int16_t audio[SAMPLE_RATE_HZ], decimated[SPECTRAL_SAMPLE_RATE_HZ];
+   spectral_summary_t summary;
+   decimator_init(&decimator, SAMPLE_RATE_HZ, SPECTRAL_SAMPLE_RATE_HZ);
+   spectral_reset(&spectral);
+   for (uint32_t second = 0; fread(audio, sizeof(int16_t), SAMPLE_RATE_HZ, input) == SAMPLE_RATE_HZ; ++second)
+   {
+      uint32_t num_decimated = 0;
+      for (uint32_t offset = 0; offset < SAMPLE_RATE_HZ; offset += CHUNK_SAMPLES)
+      {
+         spectral_measure_levels(&spectral, audio + offset, CHUNK_SAMPLES);
+         num_decimated += decimator_process(&decimator, audio + offset, CHUNK_SAMPLES, decimated + num_decimated);
+      }
+      spectral_process(&spectral, decimated, num_decimated);
+      spectral_finish(&spectral, &summary);
+      if (decimated_output)
+         fwrite(decimated, sizeof(int16_t), num_decimated, decimated_output);
+      fprintf(output, "%u,%u,%.4f,%.4f,%.4f", second, summary.num_frames, summary.peak_dbfs, summary.rms_dbfs, summary.crest_db);
+      for (uint32_t b = 0; b < SPECTRAL_OCTAVE_BANDS; ++b)
+         fprintf(output, ",%.4f", summary.band_dbfs[b]);
+      for (uint32_t b = 0; b < SPECTRAL_MEL_BANDS; ++b)
+         fprintf(output, ",%.6f", summary.log_mel[b]);
+      fprintf(output, "\n");
+   }
+   fclose(input);
+   if (output != stdout)
+      fclose(output);
+   if (decimated_output)
+      fclose(decimated_output);
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   // Summarize a recording if one is given, otherwise check the kernel against its references and time it
+   const char *input_path = NULL, *output_path = NULL, *decimated_path = NULL;
+   for (int i = 1; i < argc; ++i)
+   {
+      if (!strcmp(argv[i], "--input") && (i + 1 < argc))
+         input_path = argv[++i];
+      else if (!strcmp(argv[i], "--output") && (i + 1 < argc))
+         output_path = argv[++i];
+      else if (!strcmp(argv[i], "--decimated") && (i + 1 < argc))
+         decimated_path = argv[++i];
+      else
+      {
+         fprintf(stderr, "Usage: %s [--input <audio_48k.raw> [--output <summary.csv>] [--decimated <audio_16k.raw>]]\n", argv[0]);
+         return 1;
+      }
+   }
+   spectral_init(&spectral);
+   if (input_path)
+      return summarize_file(input_path, output_path, decimated_path);
+   const int failures = compare_reference() + check_calibration();
+   measure_throughput();
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,503 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "conditioning.h"
+#include "decimator.h"
+#include "packet.h"
+#include "resampler.h"
+#include "spectral.h"
+#include "spool_format.h"
+#include "ubx.h"
+
+#define SAMPLE_RATE_HZ              48000
+#define CHUNK_SAMPLES               480
+#define AUDIO_SECONDS               10
+#define AUDIO_SAMPLES               (SAMPLE_RATE_HZ * AUDIO_SECONDS)
+#define DECIMATED_RATE_HZ           16000
+#define RESAMPLER_RATIO             (1.0 + 37.5e-6)
+#define RESAMPLER_MAX_ERROR_LSB     8
+#define DECIMATED_SAMPLES           (DECIMATED_RATE_HZ * AUDIO_SECONDS)
+#define SPECTRAL_TONE_DBFS          -22.35  // Level of the 1 kHz input tone
+#define SPECTRAL_MAX_ERROR_DB       0.5
+#define UBX_EPOCHS                  20000
+#define UBX_STREAM_BYTES            (UBX_EPOCHS * (sizeof(ubx_nav_pvt_t) + sizeof(ubx_tim_tm2_t) + (3 * UBX_PACKET_OVERHEAD) + 64))
+#define FRAMING_PACKETS             32
+#define FRAMING_READ_BYTES          512
+#define FRAMING_PACKET_BYTES        (sizeof(packet_header_t) + sizeof(packet_audio_t) + (SAMPLE_RATE_HZ * sizeof(int16_t)))
+#define CRC_BYTES                   (4 * 1024 * 1024)
+#define REFERENCE_ITERATIONS        (1024 * 1024)
+#define DEFAULT_REPEATS             7
+#define MAX_REPEATS                 63
+#define MIN_SAMPLE_SECONDS          0.1  // Each timed sample repeats its kernel for at least this long
+#define DEFAULT_TOLERANCE           0.25
+#define MAX_ATTEMPTS                3  // Measurements of a kernel before a regression is reported
+#define MAX_BENCHMARKS              9
+
+// Result of a single benchmark, measured as the median of several samples, each long enough to average out timer and
+//    scheduling noise; "relative" is the median of its throughput as a multiple of the reference kernel's, timed alongside
+//    it, which is what is compared against the baseline so that a host running faster or slower overall is not a change
+typedef struct
+{
+   const char *name, *unit;
+   uint64_t items;
+   uint32_t runs_per_sample;
+   double seconds, cycles, throughput, relative, baseline;
+   bool valid;
+} bench_result_t;
+
+// Benchmark definition: a timed kernel run on fixed inputs plus an untimed check of its final output
+typedef struct
+{
+   const char *name, *unit;
+   uint64_t items;
+   void (*run)(void);
+   bool (*verify)(void);
+} bench_definition_t;
+
+// Fixed inputs shared by every repetition, along with each kernel's outputs (statically allocated so that the
+//    relative buffer alignment, and therefore cache and store-forwarding behavior, is identical on every run)
+static const conditioning_config_t conditioning_config = { SAMPLE_RATE_HZ, 5.0f, 80.0f, 2, 12.0f };
+static decimator_t decimator;
+static resampler_t resampler;
+static spectral_t spectral;
+static spectral_summary_t spectral_summary;
+static int16_t spectral_input[DECIMATED_SAMPLES];
+static uint32_t spectral_frames;
+static int16_t audio_input[AUDIO_SAMPLES], audio_output[AUDIO_SAMPLES], audio_reference[AUDIO_SAMPLES];
+static uint8_t ubx_stream[UBX_STREAM_BYTES], framing_stream[FRAMING_PACKETS * FRAMING_PACKET_BYTES], framing_buffer[FRAMING_PACKET_BYTES];
+static uint8_t crc_input[CRC_BYTES];
+static size_t ubx_stream_len, framing_stream_len;
+static uint32_t ubx_expected_messages, ubx_messages, framing_packets, decimated_samples, resampled_samples, crc_result, reference_result;
+static bool framing_in_order;
+
+static void usage(void)
+{
+   fprintf(stderr, "Usage: bench_suite [--baseline <results.json> [--record]] [--tolerance <fraction>] [--output <results.json>] [--repeat <n>]\n");
+   exit(1);
+}
+
+static void generate_inputs(void)
+{
+   // Audio: DC offset, low-frequency rumble, in-band tones, broadband noise and periodic full-scale impulses
+   uint32_t seed = 0x12345678;
+   for (uint32_t i = 0; i < AUDIO_SAMPLES; ++i)
+   {
+      const double t = (double)i / SAMPLE_RATE_HZ;
+      double value = 1800.0 + (6000.0 * sin(2.0 * M_PI * 12.0 * t)) + (2500.0 * sin(2.0 * M_PI * 1000.0 * t)) + (2000.0 * sin(2.0 * M_PI * 11000.0 * t));
+      value += (double)((int32_t)(bench_random(&seed) & 0x7FF) - 1024);
+      if ((i % SAMPLE_RATE_HZ) < 200)
+         value += ((i & 1) ? 30000.0 : -30000.0);
+      audio_input[i] = (int16_t)((value > 32767.0) ? 32767.0 : ((value < -32768.0) ? -32768.0 : value));
+   }
+
+   // UBX: one NAV-PVT and one TIM-TM2 per epoch, interleaved with sync-free line noise and occasional corrupted packets
+   ubx_stream_len = ubx_expected_messages = 0;
+   for (uint32_t epoch = 0; epoch < UBX_EPOCHS; ++epoch)
+   {
+      ubx_nav_pvt_t nav_pvt = { .iTOW = epoch * 1000, .year = 2026, .fixType = UBX_FIX_TYPE_3D, .flags = 0x01, .numSV = 18,
+                                .lon = -867800000 + (int32_t)epoch, .lat = 361400000, .height = 180000, .hAcc = 1500, .vAcc = 2500 };
+      ubx_tim_tm2_t tim_tm2 = { .flags = 0xC4, .count = (uint16_t)epoch, .wnR = 2400, .towMsR = epoch * 1000, .towSubMsR = 123456 };
+      ubx_stream_len += ubx_frame_message(0x01, 0x07, &nav_pvt, sizeof(nav_pvt), ubx_stream + ubx_stream_len);
+      ubx_stream_len += ubx_frame_message(0x0D, 0x03, &tim_tm2, sizeof(tim_tm2), ubx_stream + ubx_stream_len);
+      ubx_expected_messages += 2;
+      const uint32_t noise_bytes = bench_random(&seed) & 0x1F;
+      for (uint32_t i = 0; i < noise_bytes; ++i)
+      {
+         const uint8_t noise = (uint8_t)bench_random(&seed);
+         ubx_stream[ubx_stream_len++] = (noise == UBX_SYNC1_CHAR) ? 0 : noise;
+      }
+      if ((epoch % 64) == 0)
+      {
+         const size_t corrupted = ubx_stream_len;
+         ubx_stream_len += ubx_frame_message(0x0D, 0x03, &tim_tm2, sizeof(tim_tm2), ubx_stream + ubx_stream_len);
+         ubx_stream[corrupted + UBX_MSG_PAYLOAD_OFFSET + 4] ^= 0x5A;
+      }
+   }
+
+   // Framing: one-second audio packets exactly as the node sends them
+   framing_stream_len = 0;
+   for (uint32_t i = 0; i < FRAMING_PACKETS; ++i)
+   {
+      packet_header_t header;
+      packet_audio_t audio = { .timestamp = 1400000000.0 + i, .lat = 36.14, .lon = -86.78, .height = 180.0f };
+      packet_init_header(&header, PACKET_TYPE_AUDIO, (uint16_t)i, sizeof(audio) + (SAMPLE_RATE_HZ * sizeof(int16_t)));
+      memcpy(framing_stream + framing_stream_len, &header, sizeof(header));
+      memcpy(framing_stream + framing_stream_len + sizeof(header), &audio, sizeof(audio));
+      memcpy(framing_stream + framing_stream_len + sizeof(header) + sizeof(audio), audio_input + (i * SAMPLE_RATE_HZ % (AUDIO_SAMPLES - SAMPLE_RATE_HZ)),
+             SAMPLE_RATE_HZ * sizeof(int16_t));
+      framing_stream_len += FRAMING_PACKET_BYTES;
+   }
+
+   // Spectral summary: the same audio already decimated, as the summarizer receives it from the decimator
+   decimator_init(&decimator, SAMPLE_RATE_HZ, DECIMATED_RATE_HZ);
+   decimator_process_reference(&decimator, audio_input, AUDIO_SAMPLES, spectral_input);
+
+   // CRC: a spool-sized run of arbitrary bytes
+   for (uint32_t i = 0; i < CRC_BYTES; ++i)
+      crc_input[i] = (uint8_t)bench_random(&seed);
+}
+
+static void run_reference(void)
+{
+   // Fixed scalar work independent of the firmware sources, against which every kernel's throughput is normalized, kept
+   //    in registers so that it leaves the caches as the kernel timed after it expects to find them
+   uint32_t a = 1, b = 0, seed = 0x12345678;
+   for (uint32_t i = 0; i < REFERENCE_ITERATIONS; ++i)
+   {
+      a = (a + (bench_random(&seed) & 0xFF)) % 65521;
+      b = (b + a) % 65521;
+   }
+   reference_result = (b << 16) | a;
+}
+
+static bool verify_reference(void)
+{
+   return reference_result != 0;
+}
+
+static void run_ubx_parser(void)
+{
+   // Feed the stream to the parser byte-by-byte, as the GPS task does, and count recognized messages
+   ubx_parser_t parser;
+   ubx_parser_init(&parser);
+   ubx_messages = 0;
+   for (size_t i = 0; i < ubx_stream_len; ++i)
+      ubx_messages += (ubx_parser_consume(&parser, ubx_stream[i]) >= UBX_NAV_PVT);
+}
+
+static bool verify_ubx_parser(void)
+{
+   // Every intact message must be recognized and every corrupted one rejected
+   return ubx_messages == ubx_expected_messages;
+}
+
+static void run_packet_framing(void)
+{
+   // Reassemble every packet from USB-sized reads, tracking whether any were lost or reordered
+   packet_parser_t parser;
+   packet_parser_init(&parser, framing_buffer, FRAMING_PACKET_BYTES);
+   framing_packets = 0;
+   framing_in_order = true;
+   for (size_t offset = 0; offset < framing_stream_len; offset += FRAMING_READ_BYTES)
+   {
+      const size_t read_len = ((framing_stream_len - offset) < FRAMING_READ_BYTES) ? (framing_stream_len - offset) : FRAMING_READ_BYTES;
+      size_t consumed = 0;
+      while (consumed < read_len)
+      {
+         const packet_header_t *header;
+         const uint8_t *payload;
+         consumed += packet_parser_consume(&parser, framing_stream + offset + consumed, read_len - consumed, &header, &payload);
+         if (header)
+            framing_in_order &= (header->sequence == framing_packets++);
+      }
+   }
+}
+
+static bool verify_packet_framing(void)
+{
+   // Every packet must be reassembled, in order
+   return framing_in_order && (framing_packets == FRAMING_PACKETS);
+}
+
+static void run_conditioning(void)
+{
+   // Condition the audio in capture-sized chunks
+   conditioning_t conditioner;
+   conditioning_init(&conditioner, &conditioning_config);
+   memcpy(audio_output, audio_input, AUDIO_SAMPLES * sizeof(int16_t));
+   for (uint32_t offset = 0; offset < AUDIO_SAMPLES; offset += CHUNK_SAMPLES)
+      conditioning_process(&conditioner, audio_output + offset, CHUNK_SAMPLES);
+}
+
+static bool verify_conditioning(void)
+{
+   // Compare against the per-sample reference implementation
+   conditioning_t conditioner;
+   conditioning_init(&conditioner, &conditioning_config);
+   memcpy(audio_reference, audio_input, AUDIO_SAMPLES * sizeof(int16_t));
+   conditioning_process_reference(&conditioner, audio_reference, AUDIO_SAMPLES);
+   return memcmp(audio_reference, audio_output, AUDIO_SAMPLES * sizeof(int16_t)) == 0;
+}
+
+static void run_decimator(void)
+{
+   // Decimate to the classification rate in capture-sized chunks
+   decimator_init(&decimator, SAMPLE_RATE_HZ, DECIMATED_RATE_HZ);
+   decimated_samples = 0;
+   for (uint32_t offset = 0; offset < AUDIO_SAMPLES; offset += CHUNK_SAMPLES)
+      decimated_samples += decimator_process(&decimator, audio_input + offset, CHUNK_SAMPLES, audio_output + decimated_samples);
+}
+
+static bool verify_decimator(void)
+{
+   // Compare against the wide-accumulator reference implementation
+   decimator_init(&decimator, SAMPLE_RATE_HZ, DECIMATED_RATE_HZ);
+   const uint32_t num_reference = decimator_process_reference(&decimator, audio_input, AUDIO_SAMPLES, audio_reference);
+   return (num_reference == decimated_samples) && (memcmp(audio_reference, audio_output, num_reference * sizeof(int16_t)) == 0);
+}
+
+static uint32_t resample(bool reference, int16_t *output)
+{
+   // Correct a drifted capture in capture-sized chunks, draining the resampler after every chunk as the dispatch task does
+   resampler_reset(&resampler, RESAMPLER_TAPS);
+   resampler_set_ratio(&resampler, RESAMPLER_RATIO);
+   uint32_t num_output = 0;
+   for (uint32_t offset = 0; offset < AUDIO_SAMPLES; )
+   {
+      const uint32_t chunk = ((AUDIO_SAMPLES - offset) < CHUNK_SAMPLES) ? (AUDIO_SAMPLES - offset) : CHUNK_SAMPLES;
+      for (uint32_t written = 0; written < chunk; )
+      {
+         written += resampler_write(&resampler, audio_input + offset + written, chunk - written);
+         num_output += reference ? resampler_read_reference(&resampler, output + num_output, AUDIO_SAMPLES - num_output) :
+                                   resampler_read(&resampler, output + num_output, AUDIO_SAMPLES - num_output);
+      }
+      offset += chunk;
+   }
+   return num_output;
+}
+
+static void run_resampler(void)
+{
+   resampled_samples = resample(false, audio_output);
+}
+
+static bool verify_resampler(void)
+{
+   // The fixed-point path must stay within a few LSB of the double-precision reference, even across the full-scale clicks
+   if (resample(true, audio_reference) != resampled_samples)
+      return false;
+   for (uint32_t i = 0; i < resampled_samples; ++i)
+      if (abs((int32_t)audio_reference[i] - audio_output[i]) > RESAMPLER_MAX_ERROR_LSB)
+         return false;
+   return true;
+}
+
+static void run_spectral_summary(void)
+{
+   // Summarize every second from capture-sized chunks of both streams, as the audio task does
+   spectral_reset(&spectral);
+   spectral_frames = 0;
+   for (uint32_t offset = 0, chunk = 0; offset < AUDIO_SAMPLES; offset += CHUNK_SAMPLES, ++chunk)
+   {
+      spectral_measure_levels(&spectral, audio_input + offset, CHUNK_SAMPLES);
+      spectral_process(&spectral, spectral_input + (chunk * (CHUNK_SAMPLES * DECIMATED_RATE_HZ / SAMPLE_RATE_HZ)), CHUNK_SAMPLES * DECIMATED_RATE_HZ / SAMPLE_RATE_HZ);
+      if (((offset + CHUNK_SAMPLES) % SAMPLE_RATE_HZ) == 0)
+      {
+         spectral_finish(&spectral, &spectral_summary);
+         spectral_frames += spectral_summary.num_frames;
+      }
+   }
+}
+
+static bool verify_spectral_summary(void)
+{
+   // Every hop must produce a frame, and the final second's 1 kHz octave must read the level of the tone within it
+   const uint32_t expected_frames = 1 + ((DECIMATED_SAMPLES - SPECTRAL_FRAME_SAMPLES) / SPECTRAL_HOP_SAMPLES);
+   return (spectral_frames == expected_frames) && (fabs(spectral_summary.band_dbfs[4] - SPECTRAL_TONE_DBFS) <= SPECTRAL_MAX_ERROR_DB);
+}
+
+static void run_spool_crc32(void)
+{
+   // Checksum a spool-sized run of data
+   crc_result = spool_crc32(0, crc_input, CRC_BYTES);
+}
+
+static bool verify_spool_crc32(void)
+{
+   // Known-answer test for CRC-32 plus agreement with an incremental computation over the same input
+   const uint32_t split = spool_crc32(spool_crc32(0, crc_input, CRC_BYTES / 3), crc_input + (CRC_BYTES / 3), CRC_BYTES - (CRC_BYTES / 3));
+   return (spool_crc32(0, (const uint8_t*)"123456789", 9) == 0xCBF43926) && (split == crc_result);
+}
+
+static double read_baseline(const char *baseline_json, const char *name)
+{
+   // Find the relative throughput recorded for the named benchmark in a previous results file
+   char key[64];
+   snprintf(key, sizeof(key), "\"name\": \"%s\"", name);
+   const char *entry = baseline_json ? strstr(baseline_json, key) : NULL;
+   const char *relative = entry ? strstr(entry, "\"relative\":") : NULL;
+   return relative ? atof(relative + strlen("\"relative\":")) : 0.0;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+   const double x = *(const double*)a, y = *(const double*)b;
+   return (x > y) - (x < y);
+}
+
+static double median(double *values, uint32_t num_values)
+{
+   qsort(values, num_values, sizeof(double), compare_doubles);
+   return (num_values & 1) ? values[num_values / 2] : (0.5 * (values[(num_values / 2) - 1] + values[num_values / 2]));
+}
+
+static double time_sample(const bench_definition_t *benchmark, uint32_t runs, double *cycles)
+{
+   // Seconds and cycles per run of a kernel, averaged over enough back-to-back runs to make up one sample
+   const double start_time = bench_now_seconds();
+   const uint64_t start_cycles = bench_cycles();
+   for (uint32_t run = 0; run < runs; ++run)
+      benchmark->run();
+   *cycles = (double)(bench_cycles() - start_cycles) / runs;
+   return (bench_now_seconds() - start_time) / runs;
+}
+
+static double measure(const bench_definition_t *benchmarks, const bench_result_t *results, uint32_t b, uint32_t repeats, double *seconds, double *cycles)
+{
+   // Time each sample of a kernel straight after a sample of the reference, so that the ratio of the two cancels whatever
+   //    else the host was doing at the time, returning the median ratio along with the kernel's median time per run
+   double sample_seconds[MAX_REPEATS], sample_cycles[MAX_REPEATS], sample_relative[MAX_REPEATS], reference_cycles;
+   for (uint32_t r = 0; r < repeats; ++r)
+   {
+      const double reference_seconds = time_sample(benchmarks, results[0].runs_per_sample, &reference_cycles);
+      sample_seconds[r] = b ? time_sample(benchmarks + b, results[b].runs_per_sample, sample_cycles + r) : reference_seconds;
+      sample_cycles[r] = b ? sample_cycles[r] : reference_cycles;
+      sample_relative[r] = (results[b].items / sample_seconds[r]) / (results[0].items / reference_seconds);
+   }
+   *seconds = median(sample_seconds, repeats);
+   *cycles = median(sample_cycles, repeats);
+   return median(sample_relative, repeats);
+}
+
+static char* load_file(const char *path)
+{
+   // Read an entire text file into a null-terminated buffer
+   FILE *file = fopen(path, "rb");
+   if (!file)
+      return NULL;
+   fseek(file, 0, SEEK_END);
+   const long file_len = ftell(file);
+   fseek(file, 0, SEEK_SET);
+   char *contents = malloc(file_len + 1);
+   contents[fread(contents, 1, file_len, file)] = '\0';
+   fclose(file);
+   return contents;
+}
+
+int main(int argc, char **argv)
+{
+   // Parse command-line arguments
+   const char *baseline_path = NULL, *output_path = NULL;
+   double tolerance = DEFAULT_TOLERANCE;
+   uint32_t repeats = DEFAULT_REPEATS;
+   bool record = false;
+   for (int i = 1; i < argc; ++i)
+   {
+      if (!strcmp(argv[i], "--baseline") && (i + 1 < argc))
+         baseline_path = argv[++i];
+      else if (!strcmp(argv[i], "--output") && (i + 1 < argc))
+         output_path = argv[++i];
+      else if (!strcmp(argv[i], "--tolerance") && (i + 1 < argc))
+         tolerance = atof(argv[++i]);
+      else if (!strcmp(argv[i], "--repeat") && (i + 1 < argc))
+         repeats = (uint32_t)atol(argv[++i]);
+      else if (!strcmp(argv[i], "--record"))
+         record = true;
+      else
+         usage();
+   }
+   if (record && !baseline_path)
+      usage();
+   repeats = (repeats < 1) ? 1 : ((repeats > MAX_REPEATS) ? MAX_REPEATS : repeats);
+
+   // Baselines are per host, since kernels do not all speed up or slow down together across machines, so one is only
+   //    ever compared against results recorded on the same host
+   char *baseline_json = (baseline_path && !record) ? load_file(baseline_path) : NULL;
+   if (baseline_path && !record && !baseline_json)
+   {
+      fprintf(stderr, "Unable to read baseline: %s (record one on this host with --record)\n", baseline_path);
+      return 1;
+   }
+
+   // Run every kernel once on its fixed input to check its output, which also sets how many runs make up each sample
+   generate_inputs();
+   resampler_init(&resampler);
+   spectral_init(&spectral);
+   const bench_definition_t benchmarks[MAX_BENCHMARKS] = {
+      { "reference", "iteration", REFERENCE_ITERATIONS, run_reference, verify_reference },
+      { "ubx_parser", "byte", ubx_stream_len, run_ubx_parser, verify_ubx_parser },
+      { "packet_framing", "byte", framing_stream_len, run_packet_framing, verify_packet_framing },
+      { "conditioning", "sample", AUDIO_SAMPLES, run_conditioning, verify_conditioning },
+      { "decimator_48k_16k", "sample", AUDIO_SAMPLES, run_decimator, verify_decimator },
+      { "resampler_drift", "sample", AUDIO_SAMPLES, run_resampler, verify_resampler },
+      { "spectral_summary", "sample", AUDIO_SAMPLES, run_spectral_summary, verify_spectral_summary },
+      { "spool_crc32", "byte", CRC_BYTES, run_spool_crc32, verify_spool_crc32 },
+   };
+   bench_result_t results[MAX_BENCHMARKS];
+   uint32_t num_results = 0;
+   for (uint32_t b = 0; (b < MAX_BENCHMARKS) && benchmarks[b].name; ++b)
+   {
+      bench_result_t *result = results + num_results++;
+      result->name = benchmarks[b].name;
+      result->unit = benchmarks[b].unit;
+      result->items = benchmarks[b].items;
+      const double warmup_start = bench_now_seconds();
+      benchmarks[b].run();
+      const double warmup_seconds = bench_now_seconds() - warmup_start;
+      result->valid = benchmarks[b].verify();
+      result->runs_per_sample = (warmup_seconds >= MIN_SAMPLE_SECONDS) ? 1 : (uint32_t)ceil(MIN_SAMPLE_SECONDS / (warmup_seconds > 1.0e-6 ? warmup_seconds : 1.0e-6));
+   }
+
+   // Time each kernel, and judge it against its baseline, re-measuring any that appears to have regressed so that a
+   //    regression only counts if it reproduces rather than coinciding with a burst of other load on the host
+   for (uint32_t b = 0; b < num_results; ++b)
+   {
+      bench_result_t *result = results + b;
+      result->baseline = read_baseline(baseline_json, result->name);
+      for (uint32_t attempt = 0; attempt < MAX_ATTEMPTS; ++attempt)
+      {
+         double seconds, cycles;
+         const double relative = measure(benchmarks, results, b, repeats, &seconds, &cycles);
+         if (!attempt || (relative > result->relative))
+         {
+            result->seconds = seconds;
+            result->cycles = cycles;
+            result->relative = relative;
+         }
+         if (!b || (result->baseline <= 0.0) || (result->relative >= (result->baseline * (1.0 - tolerance))))
+            break;
+      }
+      result->throughput = result->items / result->seconds;
+   }
+
+   // Report each result, and how it compares with its baseline, in human-readable form
+   bool passed = true;
+   for (uint32_t i = 0; i < num_results; ++i)
+   {
+      const bench_result_t *result = results + i;
+      const bool regressed = (i > 0) && (result->baseline > 0.0) && (result->relative < (result->baseline * (1.0 - tolerance)));
+      passed &= result->valid && !regressed;
+      fprintf(stderr, "%-18s %10.2f M%s/s %8.2f cycles/%s %8.4fx reference", result->name, result->throughput * 1.0e-6, result->unit,
+              result->cycles / result->items, result->unit, result->relative);
+      if ((i > 0) && (result->baseline > 0.0))
+         fprintf(stderr, "  baseline %8.4fx (%+6.1f%%)", result->baseline, 100.0 * ((result->relative / result->baseline) - 1.0));
+      fprintf(stderr, "  %s\n", !result->valid ? "INVALID OUTPUT" : (regressed ? "REGRESSED" : "ok"));
+   }
+
+   // Emit machine-readable results, one benchmark per line so that they can also serve as the next baseline, writing them
+   //    as this host's baseline if recording
+   const char *results_path = record ? baseline_path : output_path;
+   FILE *output = results_path ? fopen(results_path, "w") : stdout;
+   if (!output)
+   {
+      fprintf(stderr, "Unable to write results: %s\n", results_path);
+      return 1;
+   }
+   fprintf(output, "{\n  \"suite\": \"civicalert_firmware_host\",\n  \"tolerance\": %.3f,\n  \"results\": [\n", tolerance);
+   for (uint32_t i = 0; i < num_results; ++i)
+   {
+      const bench_result_t *result = results + i;
+      fprintf(output, "    {\"name\": \"%s\", \"unit\": \"%s\", \"items\": %llu, \"runs_per_sample\": %u, \"seconds\": %.6f, \"throughput\": %.1f, "
+              "\"cycles_per_item\": %.3f, \"relative\": %.5f, \"baseline\": %.5f, \"valid\": %s}%s\n", result->name, result->unit,
+              (unsigned long long)result->items, result->runs_per_sample, result->seconds, result->throughput, result->cycles / result->items,
+              result->relative, result->baseline, result->valid ? "true" : "false", (i + 1 < num_results) ? "," : "");
+   }
+   fprintf(output, "  ],\n  \"passed\": %s\n}\n", passed ? "true" : "false");
+   if (output != stdout)
+      fclose(output);
+   free(baseline_json);
+   return passed ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench.h"
+#include "survey.h"
+
+#define NUM_TRIALS                  200
+#define MAX_TRIAL_SECONDS           (3 * 3600)
+#define TARGET_ACCURACY_M           0.5
+#define MIN_DURATION_SECONDS        900
+#define HEALTH_CHECK_SECONDS        60
+#define TRUE_LAT                    36.1447
+#define TRUE_LON                    -86.8027
+#define TRUE_HEIGHT                 182.0
+#define HORIZONTAL_SIGMA_M          1.5  // 2D RMS error of a single fix
+#define VERTICAL_SIGMA_M            2.5
+#define ERROR_TIME_CONSTANT_S       60.0  // First-order Gauss-Markov correlation time of the simulated fix errors
+#define MULTIPATH_PROBABILITY       0.02
+#define MULTIPATH_SCALE             6.0
+#define NAV_PVT_PACKET_BYTES        (92 + 8)
+#define MIN_COVERAGE                0.5
+#define MAX_ERROR_RATIO             1.25  // Largest tolerated ratio of true to reported RMS error at completion
+
+static uint32_t seed = 0x13579BDF;
+
+static double uniform(void)
+{
+   return ((double)bench_random(&seed) + 0.5) / 4294967296.0;
+}
+
+static double gaussian(void)
+{
+   // Box-Muller transform of two uniform deviates
+   return sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform());
+}
+
+static int run_survey_trials(void)
+{
+   // Survey a node many times over, each fix carrying a slowly wandering error with occasional multipath excursions and a
+   //    receiver accuracy estimate that is only roughly right, exactly as UBX-NAV-PVT would deliver them once per second
+   survey_t survey;
+   survey_init(&survey, TARGET_ACCURACY_M, MIN_DURATION_SECONDS);
+   const double meters_per_degree_lat = SURVEY_EARTH_RADIUS_M * M_PI / 180.0;
+   const double meters_per_degree_lon = meters_per_degree_lat * cos(TRUE_LAT * M_PI / 180.0);
+   const double decay = exp(-1.0 / ERROR_TIME_CONSTANT_S), innovation = sqrt(1.0 - (decay * decay));
+   uint32_t num_completed = 0, num_covered = 0, completion_seconds[NUM_TRIALS];
+   double error_squared = 0.0, reported_squared = 0.0, single_fix_error_squared = 0.0, max_error = 0.0;
+   uint64_t num_fixes = 0, update_cycles = 0;
+   for (uint32_t trial = 0; trial < NUM_TRIALS; ++trial)
+   {
+      survey_reset(&survey);
+      double north = gaussian() * HORIZONTAL_SIGMA_M / sqrt(2.0), east = gaussian() * HORIZONTAL_SIGMA_M / sqrt(2.0), up = gaussian() * VERTICAL_SIGMA_M;
+      for (uint32_t second = 0; second < MAX_TRIAL_SECONDS; ++second)
+      {
+         north = (decay * north) + (innovation * gaussian() * HORIZONTAL_SIGMA_M / sqrt(2.0));
+         east = (decay * east) + (innovation * gaussian() * HORIZONTAL_SIGMA_M / sqrt(2.0));
+         up = (decay * up) + (innovation * gaussian() * VERTICAL_SIGMA_M);
+         const double multipath = (uniform() < MULTIPATH_PROBABILITY) ? MULTIPATH_SCALE : 1.0;
+         const double fix_north = north + ((multipath - 1.0) * gaussian() * HORIZONTAL_SIGMA_M / sqrt(2.0));
+         const double fix_east = east + ((multipath - 1.0) * gaussian() * HORIZONTAL_SIGMA_M / sqrt(2.0));
+         const double fix_up = up + ((multipath - 1.0) * gaussian() * VERTICAL_SIGMA_M);
+         const double horizontal_accuracy = multipath * HORIZONTAL_SIGMA_M * (0.7 + (0.6 * uniform()));
+         const double vertical_accuracy = multipath * VERTICAL_SIGMA_M * (0.7 + (0.6 * uniform()));
+         single_fix_error_squared += (fix_north * fix_north) + (fix_east * fix_east);
+         ++num_fixes;
+         const uint64_t start_cycles = bench_cycles();
+         survey_update(&survey, (double)second, TRUE_LAT + (fix_north / meters_per_degree_lat), TRUE_LON + (fix_east / meters_per_degree_lon),
+                       TRUE_HEIGHT + fix_up, horizontal_accuracy, vertical_accuracy);
+         const bool complete = survey_complete(&survey);
+         update_cycles += bench_cycles() - start_cycles;
+         if (complete)
+         {
+            // Compare the locked position's true error with the accuracy the survey claims for it
+            double lat, lon, height, reported_horizontal, reported_vertical;
+            survey_position(&survey, &lat, &lon, &height);
+            survey_accuracy(&survey, &reported_horizontal, &reported_vertical);
+            const double error = survey_horizontal_distance_m(TRUE_LAT, TRUE_LON, lat, lon);
+            error_squared += error * error;
+            reported_squared += reported_horizontal * reported_horizontal;
+            max_error = fmax(max_error, error);
+            num_covered += (error <= reported_horizontal);
+            completion_seconds[num_completed++] = second + 1;
+            break;
+         }
+      }
+   }
+
+   // Sort the completion times for their median and worst case
+   for (uint32_t i = 1; i < num_completed; ++i)
+      for (uint32_t j = i; (j > 0) && (completion_seconds[j - 1] > completion_seconds[j]); --j)
+      {
+         const uint32_t swap = completion_seconds[j];
+         completion_seconds[j] = completion_seconds[j - 1];
+         completion_seconds[j - 1] = swap;
+      }
+   const double error_rms = num_completed ? sqrt(error_squared / num_completed) : INFINITY;
+   const double reported_rms = num_completed ? sqrt(reported_squared / num_completed) : INFINITY;
+   const double coverage = num_completed ? ((double)num_covered / num_completed) : 0.0;
+   printf("Survey-in (%u trials, %.1f m single-fix error correlated over %.0f s): %u completed, median %.0f s, max %.0f s\n", NUM_TRIALS,
+          HORIZONTAL_SIGMA_M, ERROR_TIME_CONSTANT_S, num_completed, num_completed ? (double)completion_seconds[num_completed / 2] : 0.0,
+          num_completed ? (double)completion_seconds[num_completed - 1] : 0.0);
+   printf("   Locked position error %.3f m RMS (%.2f m max) against %.3f m reported, %.0f%% within the reported accuracy; single fixes %.2f m RMS\n",
+          error_rms, max_error, reported_rms, 100.0 * coverage, sqrt(single_fix_error_squared / num_fixes));
+   printf("   %.0f cycles/fix; UBX-NAV-PVT traffic drops from %u to %.0f bytes/hour once surveyed\n", (double)update_cycles / num_fixes,
+          3600 * NAV_PVT_PACKET_BYTES, 3600.0 * NAV_PVT_PACKET_BYTES / HEALTH_CHECK_SECONDS);
+   return (num_completed != NUM_TRIALS) || (error_rms > (MAX_ERROR_RATIO * reported_rms)) || (coverage < MIN_COVERAGE);
+}
+
+static int run_antimeridian(void)
+{
+   // A node straddling 180 degrees longitude must average to a position beside it rather than halfway around the world
+   survey_t survey;
+   survey_init(&survey, TARGET_ACCURACY_M, 0.0);
+   const double lons[] = { 179.99999, -179.99999, 179.99998, -179.99998 };
+   for (uint32_t i = 0; i < (sizeof(lons) / sizeof(lons[0])); ++i)
+      survey_update(&survey, (double)i, 0.0, lons[i], 0.0, 1.0, 1.0);
+   double lat, lon, height;
+   survey_position(&survey, &lat, &lon, &height);
+   const double error = survey_horizontal_distance_m(0.0, 180.0, lat, lon);
+   printf("Antimeridian survey: mean longitude %.7f, %.3f m from 180 degrees\n", lon, error);
+   return error > 0.01;
+}
+
+int main(void)
+{
+   // Measure how long the survey takes to lock and how honest its accuracy estimate is, then check the longitude wrap
+   int failures = run_survey_trials();
+   failures += run_antimeridian();
+   return failures ? 1 : 0;
+}
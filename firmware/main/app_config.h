@@ -4,14 +4,73 @@
 #include <stdlib.h>
 #include <string.h>
 #include <driver/gpio.h>
+#include "signal_config.h"  // Sample rates and signal processing settings, shared with the host build of the DSP kernels
 
 #define WIFI_CONNECT_FAILURE_MAX_RETRIES     5
 #define BLE_PROOF_OF_POSSESSION_KEY          "sj$a8@;^0fcz"
 
 #define SETUP_MODE_BUTTON_PRESS_SECONDS      5
 
-#define AUDIO_SAMPLE_RATE_HZ                 48000
 #define AUDIO_PACKET_SIZE_BYTES              (AUDIO_SAMPLE_RATE_HZ * sizeof(int16_t))
+#define AUDIO_CAPTURE_QUEUE_DEPTH            2  // Captured seconds awaiting dispatch before capture starts discarding them
+#define AUDIO_FULL_RATE_STREAM_ENABLED       true
+#define AUDIO_DECIMATED_STREAM_ENABLED       true
+#define AUDIO_DECIMATED_PACKET_SIZE_BYTES    (AUDIO_DECIMATED_RATE_HZ * sizeof(int16_t))
+#define AUDIO_SUMMARY_STREAM_ENABLED         false  // Send a spectral summary of every second; disable both streams above to send only summaries, leaving raw audio to history requests
+#define AUDIO_DECIMATED_ENABLED              (AUDIO_DECIMATED_STREAM_ENABLED || AUDIO_SUMMARY_STREAM_ENABLED)  // Summaries are computed from the decimated samples
+#define AUDIO_DRIFT_CORRECTION_ENABLED       true  // Resample the full-rate stream onto the GPS time grid once the sample clock drift is known
+
+#define TOA_ENABLED                          true  // Pick the onset of every triggered event and report its GPS arrival time at once, without waiting for the second to end
+#define TOA_QUEUE_DEPTH                      2  // Triggered windows awaiting a pick before further events are discarded
+#define TOA_STACK_SIZE_BYTES                 3072
+#define TOA_PRIORITY                         8
+
+#define CONDITIONING_ENABLED                 true
+
+#define HISTORY_DURATION_SECONDS             60
+#define HISTORY_MAX_REQUEST_SECONDS          10
+#define HISTORY_RESPONSE_TIMEOUT_MS          2000
+#define HISTORY_RESPONSE_CHUNK_SAMPLES       4800
+#define HISTORY_REQUEST_QUEUE_LENGTH         4
+
+#define NETWORK_SERVER_ADDRESS               "192.168.1.2"
+#define NETWORK_SERVER_PORT                  5000
+#define NETWORK_RECONNECT_DELAY_MS           2000
+#define NETWORK_SEND_TIMEOUT_MS              1000
+#define NETWORK_RX_BUFFER_SIZE               512
+#define NETWORK_UDP_AUDIO_ENABLED            false  // Send audio blocks as FEC-protected UDP datagrams to the same server port, keeping TCP for everything else
+#define NETWORK_FEC_SOURCE_SHARDS            16  // Datagrams per FEC group (at most FEC_MAX_SOURCE_SHARDS)
+#define NETWORK_FEC_PARITY_SHARDS            4  // Parity datagrams per group, each able to replace any one lost datagram (at most FEC_MAX_PARITY_SHARDS)
+#define NETWORK_FEC_SHARD_BYTES              1200  // Stream bytes per datagram (at most FEC_MAX_SHARD_BYTES)
+#define NETWORK_UDP_SEND_RETRIES             10  // Ticks to wait for lwIP to free a buffer before a datagram is dropped
+
+#define BLOCK_POOL_MAX_POOLS                 2
+#define BLOCK_POOL_ALIGNMENT                 16  // Suits both DMA and 128-bit SIMD loads and stores
+#define BLOCK_POOL_REPORT_INTERVAL_SECONDS   300
+#define LATENCY_REPORT_INTERVAL_SECONDS      60  // Period of the per-stage capture-to-output latency histograms sent to the host
+
+#define SINKS_MAX_SINKS                      6
+#define SINKS_MAX_BLOCKS                     16
+#define SINK_STACK_SIZE_BYTES                3072
+#define SINK_HISTORY_QUEUE_DEPTH             1
+#define SINK_HISTORY_PRIORITY                7
+#define SINK_USB_QUEUE_DEPTH                 2
+#define SINK_USB_PRIORITY                    6
+#define SINK_NETWORK_QUEUE_DEPTH             2
+#define SINK_NETWORK_PRIORITY                3
+#define SINK_SPOOL_QUEUE_DEPTH               2
+#define SINK_SPOOL_PRIORITY                  2
+
+#define LOGGING_DEFERRED_ENABLED             true
+#define LOGGING_DEFERRED_RING_SIZE_BYTES     4096  // Per core, must be a power of two no larger than 65536
+#define LOGGING_DEFERRED_DRAIN_INTERVAL_MS   50
+#define LOGGING_DEFERRED_DRAIN_PRIORITY      1
+#define LOGGING_DEFERRED_BINARY_OUTPUT       false  // Send raw records over USB for decoding by firmware/test/decode_log.py
+
+#define SPOOL_PARTITION_LABEL                "spool"
+#define SPOOL_NUM_BATCH_BUFFERS              4
+#define SPOOL_DRAIN_RATE_BYTES_PER_SECOND    (128 * 1024)
+#define SPOOL_IDLE_POLL_MS                   1000
 
 #define BUTTON_SETUP_MODE_PIN                GPIO_NUM_15
 #define BUTTON_SETUP_MODE_ACTIVE_LEVEL       BUTTON_ACTIVE_LOW
@@ -24,7 +83,18 @@
 #define GPS_EXTINT_PIN                       GPIO_NUM_6
 #define GPS_RESET_PIN                        GPIO_NUM_7
 #define GPS_TIMEPULSE_PIN                    GPIO_NUM_8
+#define GPS_STACK_SIZE_BYTES                 4096  // Headroom for NVS writes and double-precision logging of the surveyed position
+#define GPS_STACK_MIN_FREE_BYTES             512  // Warn once the GPS task's stack high-water mark leaves less than this free
+
+#define GPS_SURVEY_ENABLED                   true  // Average fixes into a locked node position, then drop UBX-NAV-PVT to a health check
+#define GPS_SURVEY_TARGET_ACCURACY_M         0.5  // Horizontal error of the mean position at which the survey completes
+#define GPS_SURVEY_MIN_DURATION_SECONDS      900
+#define GPS_SURVEY_HEALTH_CHECK_SECONDS      60  // UBX-NAV-PVT interval once surveyed (at most 255)
+#define GPS_SURVEY_RELOCATION_DISTANCE_M     25.0  // Fixes this far from the surveyed position suggest the node was moved
+#define GPS_SURVEY_RELOCATION_CHECKS         3  // Consecutive distant health-check fixes before the survey restarts
 
 #define USB_VBUS_MONITOR_PIN                 GPIO_NUM_1
 #define USB_SELF_POWERED                     false  // TODO: Change to true for actual HW
-#define USB_PACKET_DELIMITER                 { 0x7E, 0x6F, 0x50, 0x11 }
+#define USB_VENDOR_TRANSPORT_ENABLED         false  // Send framed packets over a vendor-specific bulk interface, read with software/usb, leaving CDC-ACM for the console and commands
+#define USB_BULK_TRANSFER_BYTES              4096  // Size of each of the two staging buffers, and so of each bulk transfer
+#define USB_BULK_TIMEOUT_MS                  100
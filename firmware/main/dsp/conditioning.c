@@ -0,0 +1,172 @@
+#ifdef ESP_PLATFORM
+#include <sdkconfig.h>
+#endif
+#include <math.h>
+#include <string.h>
+#include "conditioning.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+#define CONDITIONING_SIMD_ALIGNMENT    16
+#define CONDITIONING_SIMD_LANES        8
+void conditioning_apply_gain_aes3(int16_t *samples, uint32_t num_samples, int32_t gain, uint32_t shift);
+#endif
+
+static inline int16_t saturate16(int64_t value)
+{
+   // Clamp a wide intermediate value to the int16 sample range
+   return (value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : (int16_t)value);
+}
+
+static inline int16_t conditioning_dc_blocker_step(conditioning_t *conditioner, int16_t x)
+{
+   // y[n] = x[n] - x[n-1] + p * y[n-1], keeping the truncated fraction for the next sample
+   const int64_t acc = ((int64_t)(x - conditioner->dc_x1) << CONDITIONING_DC_POLE_SHIFT) +
+                       ((int64_t)conditioner->dc_pole * conditioner->dc_y1) + conditioner->dc_error;
+   conditioner->dc_error = (int32_t)(acc & ((1 << CONDITIONING_DC_POLE_SHIFT) - 1));
+   conditioner->dc_x1 = x;
+   conditioner->dc_y1 = saturate16(acc >> CONDITIONING_DC_POLE_SHIFT);
+   return conditioner->dc_y1;
+}
+
+static inline int16_t conditioning_biquad_step(conditioning_biquad_t *section, int16_t x)
+{
+   // y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2], keeping the truncated fraction for the next sample
+   const int64_t acc = (int64_t)section->error + ((int64_t)section->b0 * x) + ((int64_t)section->b1 * section->x1) +
+                       ((int64_t)section->b2 * section->x2) - ((int64_t)section->a1 * section->y1) - ((int64_t)section->a2 * section->y2);
+   const int16_t y = saturate16(acc >> CONDITIONING_COEFF_SHIFT);
+   section->error = (int32_t)(acc & ((1 << CONDITIONING_COEFF_SHIFT) - 1));
+   section->x2 = section->x1;
+   section->x1 = x;
+   section->y2 = section->y1;
+   section->y1 = y;
+   return y;
+}
+
+static inline int16_t conditioning_gain_step(int16_t gain, int16_t x)
+{
+   // Apply the fixed gain with truncation and saturation
+   return saturate16(((int32_t)x * gain) >> CONDITIONING_GAIN_SHIFT);
+}
+
+static void conditioning_apply_gain(conditioning_t *conditioner, int16_t *samples, uint32_t num_samples)
+{
+#if CONFIG_IDF_TARGET_ESP32S3
+   // Process the aligned, full-vector portion of the block with the S3 SIMD extensions
+   if (conditioner->use_simd)
+   {
+      const uint32_t misalignment = ((uintptr_t)samples % CONDITIONING_SIMD_ALIGNMENT) / sizeof(int16_t);
+      uint32_t head = misalignment ? ((CONDITIONING_SIMD_ALIGNMENT / sizeof(int16_t)) - misalignment) : 0;
+      head = (head > num_samples) ? num_samples : head;
+      for (uint32_t i = 0; i < head; ++i)
+         samples[i] = conditioning_gain_step(conditioner->gain, samples[i]);
+      samples += head;
+      num_samples -= head;
+      const uint32_t vector_samples = num_samples & ~(CONDITIONING_SIMD_LANES - 1);
+      conditioning_apply_gain_aes3(samples, vector_samples, conditioner->gain, CONDITIONING_GAIN_SHIFT);
+      samples += vector_samples;
+      num_samples -= vector_samples;
+   }
+#endif
+
+   // Process any remaining samples with the portable implementation
+   for (uint32_t i = 0; i < num_samples; ++i)
+      samples[i] = conditioning_gain_step(conditioner->gain, samples[i]);
+}
+
+static void conditioning_design_highpass(conditioning_biquad_t *section, float sample_rate_hz, float cutoff_hz, float q)
+{
+   // Bilinear-transform high-pass section, normalized and quantized to the fixed-point coefficient format
+   const double w0 = 2.0 * M_PI * cutoff_hz / sample_rate_hz;
+   const double alpha = sin(w0) / (2.0 * q), cos_w0 = cos(w0);
+   const double a0 = 1.0 + alpha, scale = (double)(1 << CONDITIONING_COEFF_SHIFT) / a0;
+   section->b0 = (int32_t)lround(((1.0 + cos_w0) / 2.0) * scale);
+   section->b1 = (int32_t)lround(-(1.0 + cos_w0) * scale);
+   section->b2 = section->b0;
+   section->a1 = (int32_t)lround((-2.0 * cos_w0) * scale);
+   section->a2 = (int32_t)lround((1.0 - alpha) * scale);
+}
+
+#if CONFIG_IDF_TARGET_ESP32S3
+static bool conditioning_verify_simd(int16_t gain)
+{
+   // Confirm that the SIMD gain path is bit-exact with the portable implementation before enabling it
+   static int16_t test_vector[4 * CONDITIONING_SIMD_LANES] __attribute__((aligned(CONDITIONING_SIMD_ALIGNMENT)));
+   int16_t expected[4 * CONDITIONING_SIMD_LANES];
+   for (uint32_t i = 0; i < (4 * CONDITIONING_SIMD_LANES); ++i)
+   {
+      test_vector[i] = (int16_t)((i & 1) ? (INT16_MIN + (i * 997)) : (INT16_MAX - (i * 1499)));
+      expected[i] = conditioning_gain_step(gain, test_vector[i]);
+   }
+   conditioning_apply_gain_aes3(test_vector, 4 * CONDITIONING_SIMD_LANES, gain, CONDITIONING_GAIN_SHIFT);
+   return memcmp(test_vector, expected, sizeof(expected)) == 0;
+}
+#endif
+
+void conditioning_init(conditioning_t *conditioner, const conditioning_config_t *config)
+{
+   // Derive the DC blocker pole from its cutoff frequency
+   memset(conditioner, 0, sizeof(*conditioner));
+   conditioner->dc_blocker_enabled = (config->dc_blocker_cutoff_hz > 0.0f);
+   conditioner->dc_pole = (int32_t)lround((1.0 - (2.0 * M_PI * config->dc_blocker_cutoff_hz / config->sample_rate_hz)) * (1 << CONDITIONING_DC_POLE_SHIFT));
+
+   // Design a Butterworth high-pass filter as a cascade of second-order sections
+   conditioner->num_sections = (config->highpass_cutoff_hz > 0.0f) ? config->highpass_sections : 0;
+   if (conditioner->num_sections > CONDITIONING_MAX_SECTIONS)
+      conditioner->num_sections = CONDITIONING_MAX_SECTIONS;
+   for (uint32_t i = 0; i < conditioner->num_sections; ++i)
+   {
+      const double q = 1.0 / (2.0 * sin(((2.0 * i) + 1.0) * M_PI / (4.0 * conditioner->num_sections)));
+      conditioning_design_highpass(conditioner->sections + i, config->sample_rate_hz, config->highpass_cutoff_hz, (float)q);
+   }
+
+   // Quantize the output gain, limiting it to the representable range
+   const double gain = round(pow(10.0, config->gain_db / 20.0) * CONDITIONING_UNITY_GAIN);
+   conditioner->gain = (int16_t)((gain > INT16_MAX) ? INT16_MAX : ((gain < 0.0) ? 0.0 : gain));
+#if CONFIG_IDF_TARGET_ESP32S3
+   conditioner->use_simd = conditioning_verify_simd(conditioner->gain);
+#endif
+}
+
+void conditioning_reset(conditioning_t *conditioner)
+{
+   // Clear all filter history without changing the coefficients
+   conditioner->dc_x1 = conditioner->dc_y1 = 0;
+   conditioner->dc_error = 0;
+   for (uint32_t i = 0; i < conditioner->num_sections; ++i)
+   {
+      conditioning_biquad_t *section = conditioner->sections + i;
+      section->x1 = section->x2 = section->y1 = section->y2 = 0;
+      section->error = 0;
+   }
+}
+
+void conditioning_process(conditioning_t *conditioner, int16_t *samples, uint32_t num_samples)
+{
+   // Run each stage across the whole block so that its state and coefficients stay in registers
+   if (conditioner->dc_blocker_enabled)
+      for (uint32_t i = 0; i < num_samples; ++i)
+         samples[i] = conditioning_dc_blocker_step(conditioner, samples[i]);
+   for (uint32_t s = 0; s < conditioner->num_sections; ++s)
+   {
+      conditioning_biquad_t section = conditioner->sections[s];
+      for (uint32_t i = 0; i < num_samples; ++i)
+         samples[i] = conditioning_biquad_step(&section, samples[i]);
+      conditioner->sections[s] = section;
+   }
+   if (conditioner->gain != CONDITIONING_UNITY_GAIN)
+      conditioning_apply_gain(conditioner, samples, num_samples);
+}
+
+void conditioning_process_reference(conditioning_t *conditioner, int16_t *samples, uint32_t num_samples)
+{
+   // Pass each sample through the entire chain in turn
+   for (uint32_t i = 0; i < num_samples; ++i)
+   {
+      int16_t sample = samples[i];
+      if (conditioner->dc_blocker_enabled)
+         sample = conditioning_dc_blocker_step(conditioner, sample);
+      for (uint32_t s = 0; s < conditioner->num_sections; ++s)
+         sample = conditioning_biquad_step(conditioner->sections + s, sample);
+      samples[i] = (conditioner->gain != CONDITIONING_UNITY_GAIN) ? conditioning_gain_step(conditioner->gain, sample) : sample;
+   }
+}
@@ -0,0 +1,47 @@
+#ifndef __CONDITIONING_HEADER_H__
+#define __CONDITIONING_HEADER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CONDITIONING_MAX_SECTIONS            4
+#define CONDITIONING_COEFF_SHIFT             30
+#define CONDITIONING_DC_POLE_SHIFT           15
+#define CONDITIONING_GAIN_SHIFT              12
+#define CONDITIONING_UNITY_GAIN              (1 << CONDITIONING_GAIN_SHIFT)
+
+// High-pass biquad section in Direct Form I with first-order error feedback
+typedef struct
+{
+   int32_t b0, b1, b2, a1, a2;
+   int32_t error;
+   int16_t x1, x2, y1, y2;
+} conditioning_biquad_t;
+
+// Complete conditioning chain state: DC blocker -> cascaded high-pass biquads -> fixed gain
+typedef struct
+{
+   bool dc_blocker_enabled, use_simd;
+   int32_t dc_pole, dc_error;
+   int16_t dc_x1, dc_y1;
+   int16_t gain;
+   uint32_t num_sections;
+   conditioning_biquad_t sections[CONDITIONING_MAX_SECTIONS];
+} conditioning_t;
+
+// Floating-point design parameters used to derive the fixed-point coefficients
+typedef struct
+{
+   float sample_rate_hz;
+   float dc_blocker_cutoff_hz;
+   float highpass_cutoff_hz;
+   uint32_t highpass_sections;
+   float gain_db;
+} conditioning_config_t;
+
+void conditioning_init(conditioning_t *conditioner, const conditioning_config_t *config);
+void conditioning_reset(conditioning_t *conditioner);
+void conditioning_process(conditioning_t *conditioner, int16_t *samples, uint32_t num_samples);
+void conditioning_process_reference(conditioning_t *conditioner, int16_t *samples, uint32_t num_samples);
+
+#endif  // __CONDITIONING_HEADER_H__
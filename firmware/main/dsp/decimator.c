@@ -0,0 +1,183 @@
+#ifdef ESP_PLATFORM
+#include <sdkconfig.h>
+#endif
+#include <math.h>
+#include <string.h>
+#include "decimator.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+int64_t decimator_dot_aes3(const int16_t *samples, const int16_t *taps, uint32_t num_vectors);
+#endif
+
+static inline int16_t saturate16(int64_t value)
+{
+   // Clamp a wide intermediate value to the int16 sample range
+   return (value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : (int16_t)value);
+}
+
+static inline int16_t decimator_round(int64_t acc)
+{
+   // Round the Q15 accumulator to the nearest output sample with saturation
+   return saturate16((acc + (1 << (DECIMATOR_COEFF_SHIFT - 1))) >> DECIMATOR_COEFF_SHIFT);
+}
+
+static double decimator_bessel_i0(double x)
+{
+   // Zeroth-order modified Bessel function of the first kind, by power series
+   double sum = 1.0, term = 1.0;
+   for (uint32_t k = 1; k < 32; ++k)
+   {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+   }
+   return sum;
+}
+
+static void decimator_design(decimator_t *decimator)
+{
+   // Kaiser-windowed sinc low-pass with its cutoff just below the output Nyquist frequency
+   double ideal[DECIMATOR_MAX_TAPS], sum = 0.0;
+   const double cutoff = DECIMATOR_CUTOFF_FRACTION * 0.5 / decimator->factor, center = (decimator->num_taps - 1) / 2.0;
+   for (uint32_t k = 0; k < decimator->num_taps; ++k)
+   {
+      const double m = k - center, ratio = m / center;
+      const double sinc = (m == 0.0) ? (2.0 * cutoff) : (sin(2.0 * M_PI * cutoff * m) / (M_PI * m));
+      ideal[k] = sinc * decimator_bessel_i0(DECIMATOR_KAISER_BETA * sqrt(1.0 - (ratio * ratio))) / decimator_bessel_i0(DECIMATOR_KAISER_BETA);
+      sum += ideal[k];
+   }
+
+   // Quantize to Q15 and fold any rounding residue into the center tap so that the DC gain is exactly unity
+   int32_t quantized_sum = 0;
+   for (uint32_t k = 0; k < decimator->num_taps; ++k)
+   {
+      decimator->taps[k] = (int16_t)lround(ideal[k] / sum * (1 << DECIMATOR_COEFF_SHIFT));
+      quantized_sum += decimator->taps[k];
+   }
+   decimator->taps[decimator->num_taps / 2] += (int16_t)((1 << DECIMATOR_COEFF_SHIFT) - quantized_sum);
+
+   // Store time-reversed copies of the taps at every offset within a vector so that each dot product starts on an aligned sample
+   memset(decimator->aligned_taps, 0, sizeof(decimator->aligned_taps));
+   for (uint32_t offset = 0; offset < DECIMATOR_VECTOR_LANES; ++offset)
+      for (uint32_t k = 0; k < decimator->num_taps; ++k)
+         decimator->aligned_taps[offset][offset + k] = decimator->taps[decimator->num_taps - 1 - k];
+}
+
+static inline uint32_t decimator_num_vectors(const decimator_t *decimator)
+{
+   // Number of full vectors needed to cover the taps at the largest alignment offset
+   return (decimator->num_taps + (2 * DECIMATOR_VECTOR_LANES) - 2) / DECIMATOR_VECTOR_LANES;
+}
+
+static inline int64_t decimator_dot(const decimator_t *decimator, uint32_t start)
+{
+   // Multiply-accumulate one filter window against the aligned taps for its offset
+   const uint32_t offset = start % DECIMATOR_VECTOR_LANES, aligned_start = start - offset, num_vectors = decimator_num_vectors(decimator);
+   const int16_t *samples = decimator->delay_line + aligned_start, *taps = decimator->aligned_taps[offset];
+#if CONFIG_IDF_TARGET_ESP32S3
+   if (decimator->use_simd)
+      return decimator_dot_aes3(samples, taps, num_vectors);
+#endif
+
+   // The quantized taps sum to unity, so their absolute sum keeps every 32-bit partial sum in range
+   int32_t acc = 0;
+   for (uint32_t k = 0; k < (num_vectors * DECIMATOR_VECTOR_LANES); ++k)
+      acc += (int32_t)samples[k] * taps[k];
+   return acc;
+}
+
+#if CONFIG_IDF_TARGET_ESP32S3
+static bool decimator_verify_simd(decimator_t *decimator)
+{
+   // Confirm that the SIMD dot product is bit-exact with the portable implementation before enabling it
+   for (uint32_t i = 0; i < (DECIMATOR_PADDED_TAPS + DECIMATOR_BLOCK_SAMPLES); ++i)
+      decimator->delay_line[i] = (int16_t)((i & 1) ? (INT16_MIN + (i * 997)) : (INT16_MAX - (i * 1499)));
+   bool exact = true;
+   for (uint32_t start = 0; start < (2 * DECIMATOR_VECTOR_LANES); ++start)
+   {
+      decimator->use_simd = false;
+      const int64_t expected = decimator_dot(decimator, start);
+      decimator->use_simd = true;
+      exact = exact && (decimator_dot(decimator, start) == expected);
+   }
+   return exact;
+}
+#endif
+
+bool decimator_init(decimator_t *decimator, uint32_t input_rate_hz, uint32_t output_rate_hz)
+{
+   // Only integer decimation factors up to the supported maximum are allowed
+   memset(decimator, 0, sizeof(*decimator));
+   if (!output_rate_hz || (input_rate_hz % output_rate_hz) || ((input_rate_hz / output_rate_hz) > DECIMATOR_MAX_FACTOR))
+      return false;
+   decimator->factor = input_rate_hz / output_rate_hz;
+   decimator->num_taps = (decimator->factor > 1) ? (decimator->factor * DECIMATOR_TAPS_PER_PHASE) : 1;
+   if (decimator->factor > 1)
+      decimator_design(decimator);
+#if CONFIG_IDF_TARGET_ESP32S3
+   if (decimator->factor > 1)
+      decimator->use_simd = decimator_verify_simd(decimator);
+#endif
+   decimator_reset(decimator);
+   return true;
+}
+
+void decimator_reset(decimator_t *decimator)
+{
+   // Clear the filter history and restart the output phase
+   memset(decimator->delay_line, 0, sizeof(decimator->delay_line));
+   decimator->phase = 0;
+}
+
+double decimator_group_delay_seconds(const decimator_t *decimator, uint32_t input_rate_hz)
+{
+   // Linear-phase delay of the anti-aliasing filter relative to the input stream
+   return (decimator->num_taps - 1) / (2.0 * input_rate_hz);
+}
+
+static uint32_t decimator_run(decimator_t *decimator, const int16_t *input, uint32_t num_input, int16_t *output, bool reference)
+{
+   // Bypass the filter entirely when no rate change is required
+   if (decimator->factor <= 1)
+   {
+      memmove(output, input, num_input * sizeof(int16_t));
+      return num_input;
+   }
+
+   // Append each block of input after the retained history, producing outputs only at the decimated positions
+   uint32_t num_output = 0;
+   const uint32_t history = decimator->num_taps - 1;
+   while (num_input)
+   {
+      const uint32_t block = (num_input < DECIMATOR_BLOCK_SAMPLES) ? num_input : DECIMATOR_BLOCK_SAMPLES;
+      memcpy(decimator->delay_line + history, input, block * sizeof(int16_t));
+      uint32_t i = decimator->phase;
+      for (; i < block; i += decimator->factor)
+      {
+         if (reference)
+         {
+            // y[n] = sum(h[k] * x[n - k]) with a full-width accumulator
+            int64_t acc = 0;
+            for (uint32_t k = 0; k < decimator->num_taps; ++k)
+               acc += (int64_t)decimator->taps[k] * decimator->delay_line[history + i - k];
+            output[num_output++] = decimator_round(acc);
+         }
+         else
+            output[num_output++] = decimator_round(decimator_dot(decimator, i));
+      }
+      decimator->phase = i - block;
+      memmove(decimator->delay_line, decimator->delay_line + block, history * sizeof(int16_t));
+      input += block;
+      num_input -= block;
+   }
+   return num_output;
+}
+
+uint32_t decimator_process(decimator_t *decimator, const int16_t *input, uint32_t num_input, int16_t *output)
+{
+   return decimator_run(decimator, input, num_input, output, false);
+}
+
+uint32_t decimator_process_reference(decimator_t *decimator, const int16_t *input, uint32_t num_input, int16_t *output)
+{
+   return decimator_run(decimator, input, num_input, output, true);
+}
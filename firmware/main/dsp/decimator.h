@@ -0,0 +1,33 @@
+#ifndef __DECIMATOR_HEADER_H__
+#define __DECIMATOR_HEADER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DECIMATOR_MAX_FACTOR                 3
+#define DECIMATOR_TAPS_PER_PHASE             48
+#define DECIMATOR_MAX_TAPS                   (DECIMATOR_MAX_FACTOR * DECIMATOR_TAPS_PER_PHASE)
+#define DECIMATOR_COEFF_SHIFT                15
+#define DECIMATOR_BLOCK_SAMPLES              480
+#define DECIMATOR_VECTOR_LANES               8
+#define DECIMATOR_PADDED_TAPS                (DECIMATOR_MAX_TAPS + DECIMATOR_VECTOR_LANES)
+#define DECIMATOR_CUTOFF_FRACTION            0.9
+#define DECIMATOR_KAISER_BETA                7.0
+
+// Polyphase anti-aliasing FIR decimator producing one output for every "factor" input samples
+typedef struct
+{
+   bool use_simd;
+   uint32_t factor, num_taps, phase;
+   int16_t taps[DECIMATOR_MAX_TAPS];
+   int16_t aligned_taps[DECIMATOR_VECTOR_LANES][DECIMATOR_PADDED_TAPS] __attribute__((aligned(16)));
+   int16_t delay_line[DECIMATOR_PADDED_TAPS + DECIMATOR_BLOCK_SAMPLES] __attribute__((aligned(16)));
+} decimator_t;
+
+bool decimator_init(decimator_t *decimator, uint32_t input_rate_hz, uint32_t output_rate_hz);
+void decimator_reset(decimator_t *decimator);
+double decimator_group_delay_seconds(const decimator_t *decimator, uint32_t input_rate_hz);
+uint32_t decimator_process(decimator_t *decimator, const int16_t *input, uint32_t num_input, int16_t *output);
+uint32_t decimator_process_reference(decimator_t *decimator, const int16_t *input, uint32_t num_input, int16_t *output);
+
+#endif  // __DECIMATOR_HEADER_H__
@@ -0,0 +1,111 @@
+#include <math.h>
+#include <string.h>
+#include "drift.h"
+
+static void drift_estimator_fit(drift_estimator_t *estimator)
+{
+   // Least-squares line through every retained (sample count, GPS time) pair, with the sample count as the exact regressor
+   double sum_time = 0.0, sum_sample = 0.0;
+   for (uint32_t i = 0; i < estimator->count; ++i)
+   {
+      sum_time += estimator->times[i];
+      sum_sample += estimator->samples[i];
+   }
+   estimator->mean_time = sum_time / estimator->count;
+   estimator->mean_sample = sum_sample / estimator->count;
+   double sxx = 0.0, sxy = 0.0;
+   for (uint32_t i = 0; i < estimator->count; ++i)
+   {
+      const double dx = estimator->samples[i] - estimator->mean_sample;
+      sxx += dx * dx;
+      sxy += dx * (estimator->times[i] - estimator->mean_time);
+   }
+   if (sxx > 0.0)
+      estimator->seconds_per_sample = sxy / sxx;
+}
+
+void drift_estimator_init(drift_estimator_t *estimator, uint32_t nominal_rate_hz)
+{
+   memset(estimator, 0, sizeof(*estimator));
+   estimator->nominal_rate_hz = nominal_rate_hz;
+   drift_estimator_reset(estimator);
+}
+
+void drift_estimator_reset(drift_estimator_t *estimator)
+{
+   // Forget every observation, assuming the nominal rate until enough new ones arrive
+   estimator->count = estimator->next = estimator->outliers = 0;
+   estimator->mean_time = estimator->mean_sample = 0.0;
+   estimator->seconds_per_sample = 1.0 / estimator->nominal_rate_hz;
+}
+
+drift_update_t drift_estimator_update(drift_estimator_t *estimator, uint64_t sample_index, double timestamp)
+{
+   // The first observation after a reset becomes the origin for all that follow
+   if (!estimator->count)
+   {
+      estimator->origin_sample = sample_index;
+      estimator->origin_time = timestamp;
+   }
+   else if (sample_index < estimator->origin_sample)
+   {
+      // The sample count restarted, so nothing retained still applies
+      drift_estimator_reset(estimator);
+      drift_estimator_update(estimator, sample_index, timestamp);
+      return DRIFT_UPDATE_RESET;
+   }
+   const double sample = (double)(sample_index - estimator->origin_sample), time = timestamp - estimator->origin_time;
+
+   // Reject timestamps too far from the current fit, allowing for the worst-case drift until the fit becomes valid,
+   //    and restart entirely if several arrive in a row since the sample count itself must then be wrong
+   if (estimator->count)
+   {
+      const double elapsed = fabs(sample - estimator->mean_sample) * estimator->seconds_per_sample;
+      const double tolerance = DRIFT_MAX_RESIDUAL_SECONDS + (drift_estimator_valid(estimator) ? 0.0 : (DRIFT_MAX_PPM * 1.0e-6 * elapsed));
+      const double residual = time - (estimator->mean_time + (estimator->seconds_per_sample * (sample - estimator->mean_sample)));
+      if (fabs(residual) > tolerance)
+      {
+         if (++estimator->outliers < DRIFT_MAX_CONSECUTIVE_OUTLIERS)
+            return DRIFT_UPDATE_REJECTED;
+         drift_estimator_reset(estimator);
+         drift_estimator_update(estimator, sample_index, timestamp);
+         return DRIFT_UPDATE_RESET;
+      }
+   }
+
+   // Replace the oldest observation once the window is full and refit
+   estimator->outliers = 0;
+   estimator->samples[estimator->next] = sample;
+   estimator->times[estimator->next] = time;
+   estimator->next = (estimator->next + 1) % DRIFT_WINDOW_BLOCKS;
+   if (estimator->count < DRIFT_WINDOW_BLOCKS)
+      ++estimator->count;
+   drift_estimator_fit(estimator);
+   return DRIFT_UPDATE_ACCEPTED;
+}
+
+bool drift_estimator_valid(const drift_estimator_t *estimator)
+{
+   // Enough observations for a stable fit, and a rate within what any real oscillator could produce
+   return (estimator->count >= DRIFT_MIN_BLOCKS) && (fabs(drift_estimator_ppm(estimator)) <= DRIFT_MAX_PPM);
+}
+
+double drift_estimator_ppm(const drift_estimator_t *estimator)
+{
+   // Deviation of the true sample rate from nominal, positive when the sample clock runs fast
+   return ((1.0 / (estimator->seconds_per_sample * estimator->nominal_rate_hz)) - 1.0) * 1.0e6;
+}
+
+double drift_estimator_time_at(const drift_estimator_t *estimator, double sample_position)
+{
+   // GPS time at which the given absolute sample position was captured, according to the current fit
+   return estimator->origin_time + estimator->mean_time +
+          (estimator->seconds_per_sample * ((sample_position - (double)estimator->origin_sample) - estimator->mean_sample));
+}
+
+double drift_estimator_position_at(const drift_estimator_t *estimator, double timestamp)
+{
+   // Absolute (fractional) sample position captured at the given GPS time, according to the current fit
+   return (double)estimator->origin_sample + estimator->mean_sample +
+          (((timestamp - estimator->origin_time) - estimator->mean_time) / estimator->seconds_per_sample);
+}
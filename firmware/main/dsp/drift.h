@@ -0,0 +1,40 @@
+#ifndef __DRIFT_HEADER_H__
+#define __DRIFT_HEADER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DRIFT_WINDOW_BLOCKS                  128
+#define DRIFT_MIN_BLOCKS                     16
+#define DRIFT_MAX_PPM                        500.0
+#define DRIFT_MAX_RESIDUAL_SECONDS           0.002
+#define DRIFT_MAX_CONSECUTIVE_OUTLIERS       3
+
+// Outcome of adding one GPS-timestamped block boundary to the estimator
+typedef enum
+{
+   DRIFT_UPDATE_ACCEPTED = 0,
+   DRIFT_UPDATE_REJECTED,  // Timestamp disagreed with the current fit and was ignored as an outlier
+   DRIFT_UPDATE_RESET      // Sample count and GPS time no longer agree (lost samples or a GPS time jump), so the fit restarted
+} drift_update_t;
+
+// Sample-clock drift estimator: a sliding-window least-squares fit of GPS time against the accumulated sample count,
+//    relative to the first observation since the last reset so that double precision is retained indefinitely
+typedef struct
+{
+   uint32_t nominal_rate_hz, count, next, outliers;
+   uint64_t origin_sample;
+   double origin_time;
+   double times[DRIFT_WINDOW_BLOCKS], samples[DRIFT_WINDOW_BLOCKS];
+   double mean_time, mean_sample, seconds_per_sample;
+} drift_estimator_t;
+
+void drift_estimator_init(drift_estimator_t *estimator, uint32_t nominal_rate_hz);
+void drift_estimator_reset(drift_estimator_t *estimator);
+drift_update_t drift_estimator_update(drift_estimator_t *estimator, uint64_t sample_index, double timestamp);
+bool drift_estimator_valid(const drift_estimator_t *estimator);
+double drift_estimator_ppm(const drift_estimator_t *estimator);
+double drift_estimator_time_at(const drift_estimator_t *estimator, double sample_position);
+double drift_estimator_position_at(const drift_estimator_t *estimator, double timestamp);
+
+#endif  // __DRIFT_HEADER_H__
@@ -0,0 +1,190 @@
+#ifdef ESP_PLATFORM
+#include <sdkconfig.h>
+#endif
+#include <math.h>
+#include <string.h>
+#include "elm.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+int64_t elm_dot_s8_aes3(const int8_t *a, const int8_t *b, uint32_t num_vectors);
+int64_t elm_dot_s16_aes3(const int16_t *a, const int16_t *b, uint32_t num_vectors);
+#endif
+
+#define ELM_WORKSPACE_ALIGNMENT        16
+
+static inline size_t elm_align(size_t size)
+{
+   return (size + ELM_WORKSPACE_ALIGNMENT - 1) & ~(size_t)(ELM_WORKSPACE_ALIGNMENT - 1);
+}
+
+static inline uint32_t elm_random(uint32_t *state)
+{
+   // Same xorshift32 generator as the exporter, so that the projection is reproduced exactly
+   *state ^= *state << 13;
+   *state ^= *state >> 17;
+   *state ^= *state << 5;
+   return *state;
+}
+
+static inline int8_t elm_random_weight(uint32_t *state)
+{
+   // Symmetric int8 weight drawn from the top byte of the generator
+   const int8_t weight = (int8_t)(elm_random(state) >> 24);
+   return (weight == INT8_MIN) ? -ELM_INPUT_MAX_MAGNITUDE : weight;
+}
+
+static void elm_generate_projection(elm_t *elm)
+{
+   // Regenerate the input weights row by row for each hidden neuron, followed by the biases in accumulator units
+   const elm_model_t *model = elm->model;
+   uint32_t state = model->projection_seed ? model->projection_seed : 1;
+   memset(elm->projection, 0, (size_t)model->hidden_size * elm->input_stride);
+   for (uint32_t j = 0; j < model->hidden_size; ++j)
+      for (uint32_t i = 0; i < model->input_size; ++i)
+         elm->projection[((size_t)j * elm->input_stride) + i] = elm_random_weight(&state);
+   for (uint32_t j = 0; j < model->hidden_size; ++j)
+      elm->biases[j] = (int32_t)lrintf((float)elm_random_weight(&state) / model->input_scale);
+}
+
+static inline int64_t elm_dot_s8(const elm_t *elm, const int8_t *a, const int8_t *b, bool use_simd)
+{
+#if CONFIG_IDF_TARGET_ESP32S3
+   if (use_simd)
+      return elm_dot_s8_aes3(a, b, elm->input_stride / ELM_INPUT_VECTOR_LANES);
+#else
+   (void)use_simd;
+#endif
+
+   // Every product fits in 15 bits, so any realistic input size stays within a 32-bit accumulator
+   int32_t acc = 0;
+   for (uint32_t i = 0; i < elm->input_stride; ++i)
+      acc += (int32_t)a[i] * b[i];
+   return acc;
+}
+
+static inline int64_t elm_dot_s16(const elm_t *elm, const int16_t *a, const int16_t *b, bool use_simd)
+{
+#if CONFIG_IDF_TARGET_ESP32S3
+   if (use_simd)
+      return elm_dot_s16_aes3(a, b, elm->hidden_stride / ELM_HIDDEN_VECTOR_LANES);
+#else
+   (void)use_simd;
+#endif
+
+   // The exporter bounds the output weights so that this sum also fits within the 40-bit SIMD accumulator
+   int64_t acc = 0;
+   for (uint32_t j = 0; j < elm->hidden_stride; ++j)
+      acc += (int32_t)a[j] * b[j];
+   return acc;
+}
+
+static uint32_t elm_run(elm_t *elm, const float *features, int64_t *scores, bool use_simd)
+{
+   // Project the quantized input, apply ReLU, and requantize each hidden activation to int16 with rounding
+   const elm_model_t *model = elm->model;
+   const int64_t rounding = model->hidden_shift ? ((int64_t)1 << (model->hidden_shift - 1)) : 0;
+   elm_quantize_input(elm, features);
+   for (uint32_t j = 0; j < model->hidden_size; ++j)
+   {
+      const int64_t acc = elm_dot_s8(elm, elm->input, elm->projection + ((size_t)j * elm->input_stride), use_simd) + elm->biases[j];
+      const int64_t activation = (acc > 0) ? ((acc + rounding) >> model->hidden_shift) : 0;
+      elm->hidden[j] = (int16_t)((activation > ELM_HIDDEN_MAX) ? ELM_HIDDEN_MAX : activation);
+   }
+
+   // Read out every class score and return the most likely class
+   uint32_t best = 0;
+   for (uint32_t k = 0; k < model->output_size; ++k)
+   {
+      scores[k] = elm_dot_s16(elm, elm->hidden, model->output_weights + ((size_t)k * elm->hidden_stride), use_simd);
+      if (scores[k] > scores[best])
+         best = k;
+   }
+   return best;
+}
+
+#if CONFIG_IDF_TARGET_ESP32S3
+static bool elm_verify_simd(elm_t *elm)
+{
+   // Confirm that the SIMD dot products are bit-exact with the portable implementation before enabling them
+   const int16_t *weights = elm->model->output_weights;
+   for (uint32_t i = 0; i < elm->input_stride; ++i)
+      elm->input[i] = (int8_t)((i & 1) ? (-ELM_INPUT_MAX_MAGNITUDE + (i % 61)) : (ELM_INPUT_MAX_MAGNITUDE - (i % 53)));
+   for (uint32_t j = 0; j < elm->hidden_stride; ++j)
+      elm->hidden[j] = (int16_t)((j & 1) ? (j * 997) : (ELM_HIDDEN_MAX - (j * 1499)));
+   bool exact = true;
+   for (uint32_t j = 0; j < elm->model->hidden_size; ++j)
+   {
+      const int8_t *row = elm->projection + ((size_t)j * elm->input_stride);
+      exact = exact && (elm_dot_s8(elm, elm->input, row, true) == elm_dot_s8(elm, elm->input, row, false));
+   }
+   for (uint32_t k = 0; k < elm->model->output_size; ++k)
+   {
+      const int16_t *row = weights + ((size_t)k * elm->hidden_stride);
+      exact = exact && (elm_dot_s16(elm, elm->hidden, row, true) == elm_dot_s16(elm, elm->hidden, row, false));
+   }
+   return exact;
+}
+#endif
+
+size_t elm_workspace_size(const elm_model_t *model)
+{
+   // Projection matrix, quantized input vector, hidden activations, and biases, each individually aligned
+   const size_t input_stride = ELM_INPUT_STRIDE(model->input_size), hidden_stride = ELM_HIDDEN_STRIDE(model->hidden_size);
+   return ELM_WORKSPACE_ALIGNMENT + elm_align((size_t)model->hidden_size * input_stride) + elm_align(input_stride) +
+          elm_align(hidden_stride * sizeof(int16_t)) + elm_align(model->hidden_size * sizeof(int32_t));
+}
+
+bool elm_init(elm_t *elm, const elm_model_t *model, void *workspace, size_t workspace_size)
+{
+   // Validate the model dimensions and the workspace provided for it
+   memset(elm, 0, sizeof(*elm));
+   if (!model->input_size || !model->hidden_size || !model->output_size || (model->output_size > ELM_MAX_OUTPUTS) ||
+       (model->hidden_shift >= 62) || !(model->input_scale > 0.0f) || !workspace || (workspace_size < elm_workspace_size(model)) ||
+       ((uintptr_t)model->output_weights % ELM_WORKSPACE_ALIGNMENT))
+      return false;
+
+   // Carve the aligned buffers out of the workspace
+   uint8_t *next = (uint8_t*)elm_align((uintptr_t)workspace);
+   elm->model = model;
+   elm->input_stride = ELM_INPUT_STRIDE(model->input_size);
+   elm->hidden_stride = ELM_HIDDEN_STRIDE(model->hidden_size);
+   elm->projection = (int8_t*)next;
+   next += elm_align((size_t)model->hidden_size * elm->input_stride);
+   elm->input = (int8_t*)next;
+   next += elm_align(elm->input_stride);
+   elm->hidden = (int16_t*)next;
+   next += elm_align(elm->hidden_stride * sizeof(int16_t));
+   elm->biases = (int32_t*)next;
+   memset(elm->input, 0, elm->input_stride);
+   memset(elm->hidden, 0, elm->hidden_stride * sizeof(int16_t));
+
+   // Regenerate the random projection rather than storing it alongside the model
+   elm_generate_projection(elm);
+#if CONFIG_IDF_TARGET_ESP32S3
+   elm->use_simd = elm_verify_simd(elm);
+   memset(elm->hidden, 0, elm->hidden_stride * sizeof(int16_t));
+#endif
+   return true;
+}
+
+void elm_quantize_input(elm_t *elm, const float *features)
+{
+   // Normalize each feature as the exporter's scaler did and quantize it to int8, leaving the padding lanes at zero
+   const elm_model_t *model = elm->model;
+   const float inverse_scale = 1.0f / model->input_scale;
+   for (uint32_t i = 0; i < model->input_size; ++i)
+   {
+      const long value = lrintf(((features[i] - model->feature_offset[i]) * model->feature_scale[i]) * inverse_scale);
+      elm->input[i] = (int8_t)((value > ELM_INPUT_MAX_MAGNITUDE) ? ELM_INPUT_MAX_MAGNITUDE : ((value < -ELM_INPUT_MAX_MAGNITUDE) ? -ELM_INPUT_MAX_MAGNITUDE : value));
+   }
+}
+
+uint32_t elm_infer(elm_t *elm, const float *features, int64_t *scores)
+{
+   return elm_run(elm, features, scores, elm->use_simd);
+}
+
+uint32_t elm_infer_reference(elm_t *elm, const float *features, int64_t *scores)
+{
+   return elm_run(elm, features, scores, false);
+}
@@ -0,0 +1,46 @@
+#ifndef __ELM_HEADER_H__
+#define __ELM_HEADER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ELM_INPUT_VECTOR_LANES               16
+#define ELM_HIDDEN_VECTOR_LANES              8
+#define ELM_INPUT_MAX_MAGNITUDE              127
+#define ELM_HIDDEN_MAX                       INT16_MAX
+#define ELM_MAX_OUTPUTS                      64
+
+// Quantized extreme learning machine exported by ai/elm/export.py: features are normalized and quantized to int8,
+//    projected through an int8 random matrix regenerated from "projection_seed" (so that it never needs to be stored),
+//    passed through ReLU and requantized to int16, then read out through int16 output weights
+typedef struct
+{
+   uint32_t input_size, hidden_size, output_size;
+   uint32_t projection_seed, hidden_shift;
+   float input_scale, output_scale;
+   const float *feature_offset, *feature_scale;
+   const int16_t *output_weights;  // [output_size][ELM_HIDDEN_STRIDE(hidden_size)], 16-byte aligned
+} elm_model_t;
+
+#define ELM_INPUT_STRIDE(input_size)         ((((input_size) + ELM_INPUT_VECTOR_LANES - 1) / ELM_INPUT_VECTOR_LANES) * ELM_INPUT_VECTOR_LANES)
+#define ELM_HIDDEN_STRIDE(hidden_size)       ((((hidden_size) + ELM_HIDDEN_VECTOR_LANES - 1) / ELM_HIDDEN_VECTOR_LANES) * ELM_HIDDEN_VECTOR_LANES)
+
+// Inference state, with every buffer carved out of a single caller-provided workspace
+typedef struct
+{
+   const elm_model_t *model;
+   bool use_simd;
+   uint32_t input_stride, hidden_stride;
+   int8_t *projection, *input;
+   int16_t *hidden;
+   int32_t *biases;
+} elm_t;
+
+size_t elm_workspace_size(const elm_model_t *model);
+bool elm_init(elm_t *elm, const elm_model_t *model, void *workspace, size_t workspace_size);
+void elm_quantize_input(elm_t *elm, const float *features);
+uint32_t elm_infer(elm_t *elm, const float *features, int64_t *scores);
+uint32_t elm_infer_reference(elm_t *elm, const float *features, int64_t *scores);
+
+#endif  // __ELM_HEADER_H__
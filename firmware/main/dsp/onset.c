@@ -0,0 +1,273 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "onset.h"
+
+static float onset_variance(float sum, float sum_squares, uint32_t count)
+{
+   // Variance of a segment from its running sums, floored so that its logarithm stays finite
+   const float mean = sum / (float)count;
+   return fmaxf((sum_squares / (float)count) - (mean * mean), ONSET_MIN_VARIANCE);
+}
+
+void onset_trigger_init(onset_trigger_t *trigger, const onset_config_t *config)
+{
+   // Exponential averaging coefficients for the short- and long-term energy time constants
+   memset(trigger, 0, sizeof(*trigger));
+   trigger->config = *config;
+   trigger->sta_coefficient = 1.0f - expf(-1.0f / (config->sta_seconds * (float)config->sample_rate_hz));
+   trigger->lta_coefficient = 1.0f - expf(-1.0f / (config->lta_seconds * (float)config->sample_rate_hz));
+   onset_trigger_reset(trigger);
+}
+
+void onset_trigger_reset(onset_trigger_t *trigger)
+{
+   // Hold off triggering until the long-term average has settled and the window has filled
+   const uint32_t lta_samples = (uint32_t)(trigger->config.lta_seconds * (float)trigger->config.sample_rate_hz);
+   trigger->sta = trigger->lta = 0.0f;
+   trigger->warmup_remaining = (lta_samples > ONSET_WINDOW_SAMPLES) ? lta_samples : ONSET_WINDOW_SAMPLES;
+   trigger->post_trigger_remaining = 0;
+   trigger->armed = true;
+   trigger->triggered = false;
+   trigger->num_samples = 0;
+   trigger->history_next = 0;
+   memset(trigger->history, 0, sizeof(trigger->history));
+}
+
+bool onset_trigger_process(onset_trigger_t *trigger, const int16_t *samples, uint32_t num_samples, onset_window_t *window)
+{
+   // Track short- and long-term energy through every sample, freezing the long-term average while an event is being
+   //    captured so that the event cannot raise its own threshold; at most one window is completed per call, so an
+   //    event triggering in the remainder of a call that already completed one is ignored
+   bool completed = false;
+   const float scale = 1.0f / 32768.0f;
+   for (uint32_t i = 0; i < num_samples; ++i)
+   {
+      const float sample = (float)samples[i] * scale, energy = sample * sample;
+      trigger->sta += trigger->sta_coefficient * (energy - trigger->sta);
+      if (!trigger->triggered)
+         trigger->lta += trigger->lta_coefficient * (energy - trigger->lta);
+      trigger->history[trigger->history_next] = trigger->history[trigger->history_next + ONSET_WINDOW_SAMPLES] = samples[i];
+      trigger->history_next = (trigger->history_next + 1) & (ONSET_WINDOW_SAMPLES - 1);
+      ++trigger->num_samples;
+
+      // Hand over the window once it holds enough of the event, otherwise trigger or re-arm against the LTA
+      const float reference = fmaxf(trigger->lta, trigger->config.min_level);
+      if (trigger->triggered)
+      {
+         if (--trigger->post_trigger_remaining == 0)
+         {
+            trigger->triggered = false;
+            window->start = trigger->num_samples - ONSET_WINDOW_SAMPLES;
+            memcpy(window->samples, trigger->history + trigger->history_next, sizeof(window->samples));
+            completed = true;
+         }
+      }
+      else if (trigger->warmup_remaining)
+         --trigger->warmup_remaining;
+      else if (trigger->armed && !completed && (trigger->sta > (trigger->config.trigger_ratio * reference)))
+      {
+         trigger->triggered = true;
+         trigger->armed = false;
+         trigger->post_trigger_remaining = ONSET_POST_TRIGGER_SAMPLES;
+      }
+      else if (!trigger->armed && (trigger->sta < (trigger->config.release_ratio * reference)))
+         trigger->armed = true;
+   }
+   return completed;
+}
+
+static float onset_response_table[ONSET_RESPONSE_TABLE_SIZE][ONSET_RESPONSE_TERMS];
+static bool onset_response_initialized;
+
+static float onset_response_kernel(float u)
+{
+   // Cubic B-spline spanning four samples, the smooth impulse response of the microphone's PDM decimation filter
+   u = fabsf(u);
+   if (u < 1.0f)
+      return (2.0f / 3.0f) - (u * u) + (0.5f * u * u * u);
+   return (u < 2.0f) ? ((2.0f - u) * (2.0f - u) * (2.0f - u) / 6.0f) : 0.0f;
+}
+
+static void onset_initialize_response(void)
+{
+   // Tabulate the front end's response to an onset whose waveform starts as a constant, a ramp, or a parabola, at every
+   //    fraction of a sample across the span over which the filter smears it, by integrating the kernel numerically
+   if (onset_response_initialized)
+      return;
+   for (uint32_t i = 0; i < ONSET_RESPONSE_TABLE_SIZE; ++i)
+   {
+      const float d = ((float)i / ONSET_RESPONSE_STEPS) - ONSET_RESPONSE_HALF_WIDTH;
+      float terms[ONSET_RESPONSE_TERMS] = { 0.0f };
+      for (int32_t j = -ONSET_RESPONSE_HALF_WIDTH * ONSET_RESPONSE_INTEGRATION_STEPS; j <= ONSET_RESPONSE_HALF_WIDTH * ONSET_RESPONSE_INTEGRATION_STEPS; ++j)
+      {
+         const float u = (float)j / ONSET_RESPONSE_INTEGRATION_STEPS, t = d - u;
+         if (t >= 0.0f)
+         {
+            const float weight = onset_response_kernel(u) / ONSET_RESPONSE_INTEGRATION_STEPS;
+            terms[0] += weight;
+            terms[1] += weight * t;
+            terms[2] += weight * t * t;
+         }
+      }
+      for (uint32_t k = 0; k < ONSET_RESPONSE_TERMS; ++k)
+         onset_response_table[i][k] = terms[k];
+   }
+   onset_response_initialized = true;
+}
+
+static void onset_response(int32_t steps, float *terms)
+{
+   // Response at "steps" fractions of a sample after the onset, continuing as the unsmoothed polynomial beyond the kernel
+   const int32_t index = steps + (ONSET_RESPONSE_HALF_WIDTH * ONSET_RESPONSE_STEPS);
+   if (index < 0)
+      terms[0] = terms[1] = terms[2] = 0.0f;
+   else if (index < ONSET_RESPONSE_TABLE_SIZE)
+      memcpy(terms, onset_response_table[index], sizeof(onset_response_table[index]));
+   else
+   {
+      const float t = (float)steps / ONSET_RESPONSE_STEPS;
+      terms[0] = 1.0f;
+      terms[1] = t;
+      terms[2] = (t * t) + ONSET_RESPONSE_VARIANCE;
+   }
+}
+
+static float onset_fit_response(const float *x, uint32_t num_samples, uint32_t best)
+{
+   // Fit the front end's smoothed response to an onset at every fraction of a sample near the boundary the criterion
+   //    chose, with the waveform after it modeled as a parabola and only noise before it, returning the offset of the
+   //    best fit from that boundary: this finds the onset itself rather than the first sample at which its smeared
+   //    leading edge rises out of the noise, which would otherwise come earlier the cleaner the signal
+   const int32_t first = ((int32_t)best - ONSET_FIT_PRE_SAMPLES > 0) ? ((int32_t)best - ONSET_FIT_PRE_SAMPLES) : 0;
+   const int32_t last = ((best + ONSET_FIT_POST_SAMPLES) < num_samples) ? (int32_t)(best + ONSET_FIT_POST_SAMPLES) : (int32_t)num_samples - 1;
+   const int32_t boundary_steps = (int32_t)(((float)best + 0.5f) * ONSET_RESPONSE_STEPS);
+   float best_residual = INFINITY;
+   int32_t best_shift = 0;
+   for (int32_t shift = -ONSET_FIT_SEARCH_STEPS; shift <= ONSET_FIT_SEARCH_STEPS; ++shift)
+   {
+      // Solve the normal equations for the three waveform terms, then score the fit by the energy it leaves unexplained
+      float gram[ONSET_RESPONSE_TERMS][ONSET_RESPONSE_TERMS] = { { 0.0f } }, projection[ONSET_RESPONSE_TERMS] = { 0.0f }, energy = 0.0f;
+      for (int32_t n = first; n <= last; ++n)
+      {
+         float terms[ONSET_RESPONSE_TERMS];
+         onset_response((n * ONSET_RESPONSE_STEPS) - (boundary_steps + shift), terms);
+         for (uint32_t a = 0; a < ONSET_RESPONSE_TERMS; ++a)
+         {
+            projection[a] += terms[a] * x[n];
+            for (uint32_t b = 0; b < ONSET_RESPONSE_TERMS; ++b)
+               gram[a][b] += terms[a] * terms[b];
+         }
+         energy += x[n] * x[n];
+      }
+      for (uint32_t column = 0; column < ONSET_RESPONSE_TERMS; ++column)
+      {
+         if (gram[column][column] <= 0.0f)
+            break;
+         for (uint32_t a = column + 1; a < ONSET_RESPONSE_TERMS; ++a)
+         {
+            const float factor = gram[a][column] / gram[column][column];
+            for (uint32_t b = column; b < ONSET_RESPONSE_TERMS; ++b)
+               gram[a][b] -= factor * gram[column][b];
+            projection[a] -= factor * projection[column];
+         }
+      }
+      float explained = 0.0f;
+      for (uint32_t a = 0; a < ONSET_RESPONSE_TERMS; ++a)
+         if (gram[a][a] > 0.0f)
+            explained += projection[a] * projection[a] / gram[a][a];
+      const float residual = energy - explained;
+      if (residual < best_residual)
+      {
+         best_residual = residual;
+         best_shift = shift;
+      }
+   }
+   return (float)best_shift / ONSET_RESPONSE_STEPS;
+}
+
+bool onset_pick(onset_picker_t *picker, const int16_t *window, uint32_t num_samples, uint64_t window_start, onset_pick_t *pick)
+{
+   // The window must leave room for a meaningful segment either side of every candidate onset
+   if ((num_samples > ONSET_WINDOW_SAMPLES) || (num_samples < (2 * ONSET_MIN_SEGMENT_SAMPLES) + 2))
+      return false;
+
+   // Normalize the window and remove its mean, so that single-precision running sums keep their accuracy
+   float *x = picker->window, *aic = picker->aic, mean = 0.0f;
+   for (uint32_t i = 0; i < num_samples; ++i)
+      mean += (float)window[i];
+   mean /= (float)num_samples;
+   for (uint32_t i = 0; i < num_samples; ++i)
+      x[i] = ((float)window[i] - mean) * (1.0f / 32768.0f);
+
+   // Akaike information criterion of splitting the window after sample k into two stationary segments (Maeda's
+   //    variance-only form): (k + 1) * log(var(x[0..k])) + (N - k - 1) * log(var(x[k+1..N-1])), from a forward and a backward pass
+   const uint32_t first = ONSET_MIN_SEGMENT_SAMPLES - 1, last = num_samples - ONSET_MIN_SEGMENT_SAMPLES - 1;
+   float sum = 0.0f, sum_squares = 0.0f;
+   for (uint32_t k = 0; k <= last; ++k)
+   {
+      sum += x[k];
+      sum_squares += x[k] * x[k];
+      if (k >= first)
+         aic[k] = (float)(k + 1) * logf(onset_variance(sum, sum_squares, k + 1));
+   }
+   sum = sum_squares = 0.0f;
+   for (uint32_t k = num_samples - 1; k > first; --k)
+   {
+      sum += x[k];
+      sum_squares += x[k] * x[k];
+      if (k <= (last + 1))
+         aic[k - 1] += (float)(num_samples - k) * logf(onset_variance(sum, sum_squares, num_samples - k));
+   }
+
+   // The onset lies near the criterion's minimum, refined to a fraction of a sample by fitting the front end's response
+   uint32_t best = first;
+   for (uint32_t k = first + 1; k <= last; ++k)
+      if (aic[k] < aic[best])
+         best = k;
+   onset_initialize_response();
+   const float offset = onset_fit_response(x, num_samples, best);
+
+   // Weigh every candidate by its relative likelihood exp(-dAIC / 2), taking the spread of those weights about the pick
+   //    as the noise's contribution to its timing uncertainty and the share of them close to it as its confidence
+   float total = 0.0f, near = 0.0f, moment = 0.0f, second_moment = 0.0f;
+   for (uint32_t k = first; k <= last; ++k)
+   {
+      const float weight = expf(-0.5f * (aic[k] - aic[best])), distance = (float)k - ((float)best + offset);
+      total += weight;
+      moment += weight * distance;
+      second_moment += weight * distance * distance;
+      if (fabsf(distance) <= (float)ONSET_CONFIDENCE_SAMPLES)
+         near += weight;
+   }
+   moment /= total;
+   const float noise_variance = fmaxf((second_moment / total) - (moment * moment), 0.0f);
+   pick->uncertainty_samples = sqrtf(noise_variance + (ONSET_BASE_UNCERTAINTY_SAMPLES * ONSET_BASE_UNCERTAINTY_SAMPLES));
+   pick->confidence = near / total;
+
+   // Compare the power either side of the onset and find the event's peak, then keep a snippet starting just before it
+   float noise_squares = 0.0f, signal_squares = 0.0f;
+   int32_t peak = 0;
+   for (uint32_t i = 0; i <= best; ++i)
+      noise_squares += x[i] * x[i];
+   for (uint32_t i = best + 1; i < num_samples; ++i)
+   {
+      signal_squares += x[i] * x[i];
+      peak = (abs(window[i]) > abs(peak)) ? window[i] : peak;
+   }
+   const float noise_power = fmaxf(noise_squares / (float)(best + 1), ONSET_MIN_VARIANCE);
+   const float signal_power = fmaxf(signal_squares / (float)(num_samples - best - 1), ONSET_MIN_VARIANCE);
+   pick->snr_db = 10.0f * log10f(signal_power / noise_power);
+   pick->peak = (int16_t)peak;
+
+   // The split after sample k places the onset on the boundary half a sample later
+   pick->sample_position = (double)window_start + (double)best + 0.5 + (double)offset;
+   uint32_t snippet_offset = (best + 1 > ONSET_SNIPPET_PRE_ONSET_SAMPLES) ? (best + 1 - ONSET_SNIPPET_PRE_ONSET_SAMPLES) : 0;
+   if ((snippet_offset + ONSET_SNIPPET_SAMPLES) > num_samples)
+      snippet_offset = (num_samples > ONSET_SNIPPET_SAMPLES) ? (num_samples - ONSET_SNIPPET_SAMPLES) : 0;
+   const uint32_t snippet_samples = (num_samples < ONSET_SNIPPET_SAMPLES) ? num_samples : ONSET_SNIPPET_SAMPLES;
+   memset(pick->snippet, 0, sizeof(pick->snippet));
+   memcpy(pick->snippet, window + snippet_offset, snippet_samples * sizeof(int16_t));
+   pick->snippet_start = window_start + snippet_offset;
+   return true;
+}
@@ -0,0 +1,82 @@
+#ifndef __ONSET_HEADER_H__
+#define __ONSET_HEADER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Window searched for the onset of each triggered event: the samples leading up to and including the trigger, where the
+//    onset must lie since the trigger can only fire after it, and enough samples after the trigger to characterize the event
+#define ONSET_PRE_TRIGGER_SAMPLES            768
+#define ONSET_POST_TRIGGER_SAMPLES           256
+#define ONSET_WINDOW_SAMPLES                 (ONSET_PRE_TRIGGER_SAMPLES + ONSET_POST_TRIGGER_SAMPLES)  // Must be a power of two
+#define ONSET_MIN_SEGMENT_SAMPLES            16  // Fewest samples either side of an onset for their variances to mean anything
+#define ONSET_CONFIDENCE_SAMPLES             2  // Onset likelihood within this many samples of the pick counts toward its confidence
+#define ONSET_SNIPPET_SAMPLES                192
+#define ONSET_SNIPPET_PRE_ONSET_SAMPLES      32
+#define ONSET_BASE_UNCERTAINTY_SAMPLES       0.25f // Onset ambiguity of a band-limited event beyond what noise alone explains (firmware/host/bench_onset)
+#define ONSET_MIN_VARIANCE                   1.0e-12f  // Keeps the logarithm finite over digital silence
+#define ONSET_RESPONSE_HALF_WIDTH            2  // Samples either side of center spanned by the front end's impulse response
+#define ONSET_RESPONSE_VARIANCE              (1.0f / 3.0f)  // Second moment of that response, a cubic B-spline, in samples squared
+#define ONSET_RESPONSE_STEPS                 16  // Fractions of a sample to which the onset is fit
+#define ONSET_RESPONSE_TABLE_SIZE            ((2 * ONSET_RESPONSE_HALF_WIDTH * ONSET_RESPONSE_STEPS) + 1)
+#define ONSET_RESPONSE_TERMS                 3  // Waveform modeled as a parabola just after the onset
+#define ONSET_RESPONSE_INTEGRATION_STEPS     64
+#define ONSET_FIT_PRE_SAMPLES                4
+#define ONSET_FIT_POST_SAMPLES               6
+#define ONSET_FIT_SEARCH_STEPS               (3 * ONSET_RESPONSE_STEPS)  // Farthest from the criterion's choice the fit may move the onset
+
+// STA/LTA energy trigger settings, with levels as mean squares relative to full scale
+typedef struct
+{
+   uint32_t sample_rate_hz;
+   float sta_seconds, lta_seconds;
+   float trigger_ratio, release_ratio;  // Fires when STA exceeds LTA by the first, re-arms once it falls below the second
+   float min_level;  // Floor applied to the LTA, so that near-silence cannot trigger on faint sounds
+} onset_config_t;
+
+// One picked onset: its absolute (fractional) sample position counted from the first sample processed, the spread of the
+//    Akaike weights about it (combined with the base uncertainty) as a timing uncertainty, the share of that weight lying
+//    close to the pick as a confidence, and a short snippet of the event beginning just before it
+typedef struct
+{
+   double sample_position;
+   float uncertainty_samples, confidence;
+   float snr_db;  // Power after the onset relative to the noise before it, within the picking window
+   int16_t peak;
+   uint64_t snippet_start;
+   int16_t snippet[ONSET_SNIPPET_SAMPLES];
+} onset_pick_t;
+
+// A window of samples around a triggered event, the first of them at absolute position "start"
+typedef struct
+{
+   uint64_t start;
+   int16_t samples[ONSET_WINDOW_SAMPLES];
+} onset_window_t;
+
+// Streaming trigger state: exponential short- and long-term energy averages and the trailing window of samples (written
+//    twice over so that it can always be read contiguously)
+typedef struct
+{
+   onset_config_t config;
+   float sta_coefficient, lta_coefficient;
+   float sta, lta;
+   uint32_t warmup_remaining, post_trigger_remaining;
+   bool armed, triggered;
+   uint64_t num_samples;
+   uint32_t history_next;
+   int16_t history[2 * ONSET_WINDOW_SAMPLES];
+} onset_trigger_t;
+
+// Picker scratch space: the normalized window and the Akaike information criterion computed over it
+typedef struct
+{
+   float window[ONSET_WINDOW_SAMPLES], aic[ONSET_WINDOW_SAMPLES];
+} onset_picker_t;
+
+void onset_trigger_init(onset_trigger_t *trigger, const onset_config_t *config);
+void onset_trigger_reset(onset_trigger_t *trigger);
+bool onset_trigger_process(onset_trigger_t *trigger, const int16_t *samples, uint32_t num_samples, onset_window_t *window);
+bool onset_pick(onset_picker_t *picker, const int16_t *window, uint32_t num_samples, uint64_t window_start, onset_pick_t *pick);
+
+#endif  // __ONSET_HEADER_H__
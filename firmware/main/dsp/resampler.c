@@ -0,0 +1,163 @@
+#include <math.h>
+#include <string.h>
+#include "resampler.h"
+
+#define RESAMPLER_HISTORY              ((RESAMPLER_TAPS / 2) - 1)
+#define RESAMPLER_CAPACITY             (RESAMPLER_TAPS + RESAMPLER_BLOCK_SAMPLES)
+#define RESAMPLER_FRACTION_SCALE       4294967296.0
+
+static inline int16_t saturate16(int64_t value)
+{
+   // Clamp a wide intermediate value to the int16 sample range
+   return (value > INT16_MAX) ? INT16_MAX : ((value < INT16_MIN) ? INT16_MIN : (int16_t)value);
+}
+
+static double resampler_bessel_i0(double x)
+{
+   // Zeroth-order modified Bessel function of the first kind, by power series
+   double sum = 1.0, term = 1.0;
+   for (uint32_t k = 1; k < 32; ++k)
+   {
+      term *= (x / (2.0 * k)) * (x / (2.0 * k));
+      sum += term;
+   }
+   return sum;
+}
+
+static double resampler_kernel(double x)
+{
+   // Kaiser-windowed sinc low-pass with its cutoff just below Nyquist, spanning RESAMPLER_TAPS input samples
+   const double half_width = RESAMPLER_TAPS / 2.0, cutoff = RESAMPLER_CUTOFF_FRACTION * 0.5, ratio = x / half_width;
+   if (fabs(ratio) >= 1.0)
+      return 0.0;
+   const double sinc = (x == 0.0) ? (2.0 * cutoff) : (sin(2.0 * M_PI * cutoff * x) / (M_PI * x));
+   return sinc * resampler_bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1.0 - (ratio * ratio))) / resampler_bessel_i0(RESAMPLER_KAISER_BETA);
+}
+
+static void resampler_design(resampler_t *resampler)
+{
+   // Sample the kernel at every phase (plus one extra so that interpolation never wraps), quantize each phase to Q15,
+   //    and fold any rounding residue into the tap nearest the interpolation point so that every phase has unity DC gain
+   for (uint32_t phase = 0; phase <= RESAMPLER_PHASES; ++phase)
+   {
+      double ideal[RESAMPLER_TAPS], sum = 0.0;
+      const double fraction = (double)phase / RESAMPLER_PHASES;
+      for (uint32_t k = 0; k < RESAMPLER_TAPS; ++k)
+      {
+         ideal[k] = resampler_kernel(fraction + RESAMPLER_HISTORY - k);
+         sum += ideal[k];
+      }
+      int32_t quantized_sum = 0;
+      for (uint32_t k = 0; k < RESAMPLER_TAPS; ++k)
+      {
+         resampler->taps[phase][k] = (int16_t)lround(ideal[k] / sum * (1 << RESAMPLER_COEFF_SHIFT));
+         quantized_sum += resampler->taps[phase][k];
+      }
+      resampler->taps[phase][RESAMPLER_HISTORY + ((2 * phase) >= RESAMPLER_PHASES)] += (int16_t)((1 << RESAMPLER_COEFF_SHIFT) - quantized_sum);
+   }
+}
+
+static inline int16_t resampler_interpolate(const resampler_t *resampler, const int16_t *window, uint32_t fraction)
+{
+   // Filter the window with the two phases bracketing the fractional position, then interpolate linearly between them;
+   //    every phase's absolute tap sum stays well below 2.0 in Q15, so both dot products fit in 32 bits
+   const uint32_t phase = fraction >> (32 - RESAMPLER_PHASE_BITS), weight = (fraction >> (32 - RESAMPLER_PHASE_BITS - 16)) & 0xFFFF;
+   const int16_t *taps0 = resampler->taps[phase], *taps1 = resampler->taps[phase + 1];
+   int32_t acc0 = 0, acc1 = 0;
+   for (uint32_t k = 0; k < RESAMPLER_TAPS; ++k)
+   {
+      acc0 += (int32_t)window[k] * taps0[k];
+      acc1 += (int32_t)window[k] * taps1[k];
+   }
+   const int64_t acc = acc0 + ((((int64_t)acc1 - acc0) * weight) >> 16);
+   return saturate16((acc + (1 << (RESAMPLER_COEFF_SHIFT - 1))) >> RESAMPLER_COEFF_SHIFT);
+}
+
+static inline int16_t resampler_interpolate_reference(const int16_t *window, uint32_t fraction)
+{
+   // Evaluate the kernel directly at the exact fractional position in double precision
+   double acc = 0.0, sum = 0.0;
+   for (uint32_t k = 0; k < RESAMPLER_TAPS; ++k)
+   {
+      const double h = resampler_kernel((fraction / RESAMPLER_FRACTION_SCALE) + RESAMPLER_HISTORY - k);
+      acc += h * window[k];
+      sum += h;
+   }
+   return saturate16(llround(acc / sum));
+}
+
+void resampler_init(resampler_t *resampler)
+{
+   memset(resampler, 0, sizeof(*resampler));
+   resampler_design(resampler);
+   resampler_reset(resampler, RESAMPLER_TAPS);
+   resampler_set_ratio(resampler, 1.0);
+}
+
+void resampler_reset(resampler_t *resampler, double start_position)
+{
+   // Discard all buffered input and place the next output at the given position relative to the next sample written,
+   //    preceded by silence in case that position is too early for a complete filter window
+   memset(resampler->delay_line, 0, sizeof(resampler->delay_line));
+   resampler->num_buffered = RESAMPLER_HISTORY;
+   resampler->discarded = 0;
+   resampler->position = (uint64_t)llround(((start_position > 0.0) ? (start_position + RESAMPLER_HISTORY) : RESAMPLER_HISTORY) * RESAMPLER_FRACTION_SCALE);
+}
+
+void resampler_set_ratio(resampler_t *resampler, double input_samples_per_output)
+{
+   // Step applied between consecutive outputs, in Q32.32 input samples
+   resampler->step = (uint64_t)llround(input_samples_per_output * RESAMPLER_FRACTION_SCALE);
+}
+
+double resampler_position(const resampler_t *resampler)
+{
+   // Position of the next output relative to the first sample written since the last reset
+   return (double)resampler->discarded + (resampler->position / RESAMPLER_FRACTION_SCALE) - RESAMPLER_HISTORY;
+}
+
+uint32_t resampler_write(resampler_t *resampler, const int16_t *input, uint32_t num_input)
+{
+   // Drop buffered input that lies entirely before the next output window, skipping new input that does as well
+   const uint64_t first_needed = (resampler->position >> 32) - RESAMPLER_HISTORY;
+   const uint32_t discard = (first_needed < resampler->num_buffered) ? (uint32_t)first_needed : resampler->num_buffered;
+   const uint32_t skip = ((first_needed - discard) < num_input) ? (uint32_t)(first_needed - discard) : num_input;
+   if (discard)
+      memmove(resampler->delay_line, resampler->delay_line + discard, (resampler->num_buffered - discard) * sizeof(int16_t));
+   resampler->num_buffered -= discard;
+   resampler->discarded += discard + skip;
+   resampler->position -= (uint64_t)(discard + skip) << 32;
+
+   // Append as much of the remaining input as fits after the retained history
+   const uint32_t accepted = ((num_input - skip) < (RESAMPLER_CAPACITY - resampler->num_buffered)) ? (num_input - skip) : (RESAMPLER_CAPACITY - resampler->num_buffered);
+   memcpy(resampler->delay_line + resampler->num_buffered, input + skip, accepted * sizeof(int16_t));
+   resampler->num_buffered += accepted;
+   return skip + accepted;
+}
+
+static uint32_t resampler_run(resampler_t *resampler, int16_t *output, uint32_t max_output, bool reference)
+{
+   // Produce outputs until either the output buffer is full or the next window extends past the buffered input
+   uint32_t num_output = 0;
+   while (num_output < max_output)
+   {
+      const uint32_t index = (uint32_t)(resampler->position >> 32);
+      if ((index + (RESAMPLER_TAPS / 2)) >= resampler->num_buffered)
+         break;
+      const int16_t *window = resampler->delay_line + index - RESAMPLER_HISTORY;
+      output[num_output++] = reference ? resampler_interpolate_reference(window, (uint32_t)resampler->position) :
+                                         resampler_interpolate(resampler, window, (uint32_t)resampler->position);
+      resampler->position += resampler->step;
+   }
+   return num_output;
+}
+
+uint32_t resampler_read(resampler_t *resampler, int16_t *output, uint32_t max_output)
+{
+   return resampler_run(resampler, output, max_output, false);
+}
+
+uint32_t resampler_read_reference(resampler_t *resampler, int16_t *output, uint32_t max_output)
+{
+   return resampler_run(resampler, output, max_output, true);
+}
@@ -0,0 +1,34 @@
+#ifndef __RESAMPLER_HEADER_H__
+#define __RESAMPLER_HEADER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RESAMPLER_TAPS                       24
+#define RESAMPLER_PHASE_BITS                 8
+#define RESAMPLER_PHASES                     (1 << RESAMPLER_PHASE_BITS)
+#define RESAMPLER_COEFF_SHIFT                15
+#define RESAMPLER_BLOCK_SAMPLES              480
+#define RESAMPLER_CUTOFF_FRACTION            0.85
+#define RESAMPLER_KAISER_BETA                8.0
+
+// Streaming fractional resampler for ratios close to unity: each output is a windowed-sinc interpolation of the input
+//    at a Q32.32 position advancing by "step" input samples, using a polyphase table with linear interpolation between phases
+typedef struct
+{
+   uint64_t position, step;
+   uint64_t discarded;
+   uint32_t num_buffered;
+   int16_t taps[RESAMPLER_PHASES + 1][RESAMPLER_TAPS];
+   int16_t delay_line[RESAMPLER_TAPS + RESAMPLER_BLOCK_SAMPLES];
+} resampler_t;
+
+void resampler_init(resampler_t *resampler);
+void resampler_reset(resampler_t *resampler, double start_position);
+void resampler_set_ratio(resampler_t *resampler, double input_samples_per_output);
+double resampler_position(const resampler_t *resampler);
+uint32_t resampler_write(resampler_t *resampler, const int16_t *input, uint32_t num_input);
+uint32_t resampler_read(resampler_t *resampler, int16_t *output, uint32_t max_output);
+uint32_t resampler_read_reference(resampler_t *resampler, int16_t *output, uint32_t max_output);
+
+#endif  // __RESAMPLER_HEADER_H__
@@ -0,0 +1,21 @@
+#ifndef __SIGNAL_CONFIG_HEADER_H__
+#define __SIGNAL_CONFIG_HEADER_H__
+
+// Settings of the audio signal chain, kept free of platform headers so that host builds replay audio exactly as the
+//    firmware processes it
+#define AUDIO_SAMPLE_RATE_HZ                 48000
+#define AUDIO_READ_CHUNK_SAMPLES             480
+#define AUDIO_DECIMATED_RATE_HZ              16000
+
+#define TOA_STA_SECONDS                      0.001f
+#define TOA_LTA_SECONDS                      2.0f
+#define TOA_TRIGGER_RATIO                    10.0f  // Short- to long-term energy ratio at which an event triggers
+#define TOA_RELEASE_RATIO                    2.0f  // Ratio below which the trigger re-arms after an event
+#define TOA_MIN_LEVEL                        1.0e-7f  // Floor on the long-term mean square (relative to full scale) so that near-silence cannot trigger
+
+#define CONDITIONING_DC_BLOCKER_CUTOFF_HZ    5.0f
+#define CONDITIONING_HIGHPASS_CUTOFF_HZ      80.0f
+#define CONDITIONING_HIGHPASS_SECTIONS       2
+#define CONDITIONING_GAIN_DB                 0.0f
+
+#endif  // __SIGNAL_CONFIG_HEADER_H__
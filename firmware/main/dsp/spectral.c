@@ -0,0 +1,302 @@
+#ifdef ESP_PLATFORM
+#include <sdkconfig.h>
+#endif
+#include <math.h>
+#include <string.h>
+#include "spectral.h"
+
+#if CONFIG_IDF_TARGET_ESP32S3
+int64_t spectral_levels_aes3(const int16_t *samples, uint32_t num_vectors, int16_t *extremes);
+#endif
+
+#define SPECTRAL_HALF_SIZE             (SPECTRAL_FFT_SIZE / 2)
+#define SPECTRAL_FULL_SCALE            32768.0f
+
+static double spectral_hz_to_mel(double hz)
+{
+   // HTK mel scale, as used by tf.signal.linear_to_mel_weight_matrix()
+   return 1127.0 * log(1.0 + (hz / 700.0));
+}
+
+static void spectral_design_mel(spectral_t *spectral)
+{
+   // Place the triangular bands evenly in mel between the front end's limits, each rising from the center of the band
+   //    below it to its own center and falling to the center of the band above; the DC bin is excluded just as in the
+   //    front end, and so is any bin outside the outermost band edges
+   double edges[SPECTRAL_MEL_BANDS + 2];
+   const double lowest = spectral_hz_to_mel(SPECTRAL_MEL_MIN_HZ), highest = spectral_hz_to_mel(SPECTRAL_MEL_MAX_HZ);
+   for (uint32_t j = 0; j < (SPECTRAL_MEL_BANDS + 2); ++j)
+      edges[j] = lowest + ((highest - lowest) * j / (SPECTRAL_MEL_BANDS + 1));
+   for (uint32_t k = 0; k < SPECTRAL_NUM_BINS; ++k)
+   {
+      const double mel = spectral_hz_to_mel((double)k * SPECTRAL_SAMPLE_RATE_HZ / SPECTRAL_FFT_SIZE);
+      spectral->mel_band[k] = -1;
+      spectral->mel_lower_weight[k] = spectral->mel_upper_weight[k] = 0.0f;
+      if ((k == 0) || (mel <= edges[0]) || (mel >= edges[SPECTRAL_MEL_BANDS + 1]))
+         continue;
+      uint32_t j = 0;
+      while (mel >= edges[j + 1])
+         ++j;
+      const double rising = (mel - edges[j]) / (edges[j + 1] - edges[j]);
+      spectral->mel_band[k] = (int8_t)((int32_t)j - 1);
+      spectral->mel_lower_weight[k] = (j >= 1) ? (float)(1.0 - rising) : 0.0f;
+      spectral->mel_upper_weight[k] = (j < SPECTRAL_MEL_BANDS) ? (float)rising : 0.0f;
+   }
+}
+
+static void spectral_measure_levels_portable(spectral_t *spectral, const int16_t *samples, uint32_t num_samples)
+{
+   // Accumulate the sum of squares and the absolute peak of the raw samples
+   int64_t sum_squares = 0;
+   int32_t peak = spectral->peak;
+   for (uint32_t i = 0; i < num_samples; ++i)
+   {
+      const int32_t sample = samples[i], magnitude = (sample < 0) ? -sample : sample;
+      sum_squares += sample * sample;
+      if (magnitude > peak)
+         peak = magnitude;
+   }
+   spectral->sum_squares += sum_squares;
+   spectral->num_samples += num_samples;
+   spectral->peak = peak;
+}
+
+#if CONFIG_IDF_TARGET_ESP32S3
+static void spectral_measure_levels_simd(spectral_t *spectral, const int16_t *samples, uint32_t num_vectors)
+{
+   // Square and track the extremes of eight samples per instruction, bounding each call so that its sum cannot overflow
+   int16_t extremes[2 * SPECTRAL_LEVELS_VECTOR_LANES] __attribute__((aligned(16)));
+   for (uint32_t offset = 0; offset < num_vectors; offset += SPECTRAL_LEVELS_MAX_VECTORS)
+   {
+      const uint32_t count = ((num_vectors - offset) < SPECTRAL_LEVELS_MAX_VECTORS) ? (num_vectors - offset) : SPECTRAL_LEVELS_MAX_VECTORS;
+      spectral->sum_squares += spectral_levels_aes3(samples + (offset * SPECTRAL_LEVELS_VECTOR_LANES), count, extremes);
+      for (uint32_t lane = 0; lane < SPECTRAL_LEVELS_VECTOR_LANES; ++lane)
+      {
+         if (extremes[lane] > spectral->peak)
+            spectral->peak = extremes[lane];
+         if (-(int32_t)extremes[SPECTRAL_LEVELS_VECTOR_LANES + lane] > spectral->peak)
+            spectral->peak = -(int32_t)extremes[SPECTRAL_LEVELS_VECTOR_LANES + lane];
+      }
+   }
+   spectral->num_samples += num_vectors * SPECTRAL_LEVELS_VECTOR_LANES;
+}
+
+static bool spectral_verify_simd(spectral_t *spectral)
+{
+   // Confirm that the SIMD level measurement is exact against the portable implementation, including both extremes of
+   //    the sample range, before enabling it
+   int16_t *samples = (int16_t*)spectral->fft;
+   const uint32_t num_samples = (SPECTRAL_FFT_SIZE * sizeof(float)) / sizeof(int16_t);
+   for (uint32_t i = 0; i < num_samples; ++i)
+      samples[i] = (int16_t)((i & 1) ? (INT16_MIN + (i * 37)) : (INT16_MAX - (i * 53)));
+   samples[num_samples / 3] = INT16_MIN;
+   spectral_reset(spectral);
+   spectral_measure_levels_simd(spectral, samples, num_samples / SPECTRAL_LEVELS_VECTOR_LANES);
+   const int64_t simd_sum_squares = spectral->sum_squares;
+   const int32_t simd_peak = spectral->peak;
+   spectral_reset(spectral);
+   spectral_measure_levels_portable(spectral, samples, num_samples);
+   const bool exact = (simd_sum_squares == spectral->sum_squares) && (simd_peak == spectral->peak);
+   spectral_reset(spectral);
+   return exact;
+}
+#endif
+
+static void spectral_fft(spectral_t *spectral)
+{
+   // In-place radix-2 complex FFT of the bit-reversed, interleaved buffer, in single precision for the S3's FPU; a
+   //    butterfly span of "size" uses every (SPECTRAL_FFT_SIZE / size)th twiddle of the full-size table
+   float *data = spectral->fft;
+   const float *twiddles = spectral->twiddles;
+   for (uint32_t size = 2; size <= SPECTRAL_HALF_SIZE; size <<= 1)
+   {
+      const uint32_t half = size >> 1, stride = SPECTRAL_FFT_SIZE / size;
+      for (uint32_t j = 0; j < half; ++j)
+      {
+         const float wr = twiddles[2 * j * stride], wi = -twiddles[(2 * j * stride) + 1];
+         for (uint32_t a = j; a < SPECTRAL_HALF_SIZE; a += size)
+         {
+            float *x = data + (2 * a), *y = data + (2 * (a + half));
+            const float tr = (wr * y[0]) - (wi * y[1]), ti = (wr * y[1]) + (wi * y[0]);
+            y[0] = x[0] - tr;
+            y[1] = x[1] - ti;
+            x[0] += tr;
+            x[1] += ti;
+         }
+      }
+   }
+}
+
+static inline void spectral_accumulate_bin(const spectral_t *spectral, uint32_t k, float power, float *mel, float *band_power, uint32_t *octave)
+{
+   // Add one bin's magnitude to its (at most two) mel bands and its power to the octave band containing it; "mel" is
+   //    offset by one so that bins outside every band land harmlessly, with zero weight, in its padding
+   const float magnitude = sqrtf(power);
+   const int32_t band = spectral->mel_band[k] + 1;
+   mel[band] += magnitude * spectral->mel_lower_weight[k];
+   mel[band + 1] += magnitude * spectral->mel_upper_weight[k];
+   while ((*octave < SPECTRAL_OCTAVE_BANDS) && (k >= spectral->octave_first_bin[*octave + 1]))
+      ++*octave;
+   if ((*octave < SPECTRAL_OCTAVE_BANDS) && (k >= spectral->octave_first_bin[*octave]))
+      band_power[*octave] += power;
+}
+
+void spectral_init(spectral_t *spectral)
+{
+   // Periodic Hann window, folded together with the conversion of samples to full scale
+   memset(spectral, 0, sizeof(*spectral));
+   for (uint32_t n = 0; n < SPECTRAL_FRAME_SAMPLES; ++n)
+      spectral->window[n] = (float)((0.5 - (0.5 * cos(2.0 * M_PI * n / SPECTRAL_FRAME_SAMPLES))) / SPECTRAL_FULL_SCALE);
+
+   // Twiddles for the half-size complex FFT and for splitting its output into the spectrum of the real frame
+   for (uint32_t k = 0; k < SPECTRAL_HALF_SIZE; ++k)
+   {
+      spectral->twiddles[2 * k] = (float)cos(2.0 * M_PI * k / SPECTRAL_FFT_SIZE);
+      spectral->twiddles[(2 * k) + 1] = (float)sin(2.0 * M_PI * k / SPECTRAL_FFT_SIZE);
+      uint32_t reversed = 0;
+      for (uint32_t bit = 1, mirror = SPECTRAL_HALF_SIZE >> 1; bit < SPECTRAL_HALF_SIZE; bit <<= 1, mirror >>= 1)
+         if (k & bit)
+            reversed |= mirror;
+      spectral->bit_reverse[k] = (uint16_t)reversed;
+   }
+
+   // Mel weights, octave band boundaries, and the scale converting summed bin power into mean square relative to a
+   //    full-scale sine (Parseval's theorem over the one-sided spectrum, corrected for the window's energy)
+   spectral_design_mel(spectral);
+   for (uint32_t i = 0; i <= SPECTRAL_OCTAVE_BANDS; ++i)
+      spectral->octave_first_bin[i] = (uint16_t)ceil(SPECTRAL_OCTAVE_LOWEST_HZ * pow(2.0, i - 0.5) * SPECTRAL_FFT_SIZE / SPECTRAL_SAMPLE_RATE_HZ);
+   double window_energy = 0.0;
+   for (uint32_t n = 0; n < SPECTRAL_FRAME_SAMPLES; ++n)
+      window_energy += pow(spectral->window[n] * SPECTRAL_FULL_SCALE, 2.0);
+   spectral->power_scale = (float)(4.0 / (SPECTRAL_FFT_SIZE * window_energy));
+#if CONFIG_IDF_TARGET_ESP32S3
+   spectral->use_simd = spectral_verify_simd(spectral);
+#endif
+   spectral_reset(spectral);
+}
+
+static void spectral_clear_interval(spectral_t *spectral)
+{
+   // Clear the accumulators for the interval in progress
+   spectral->num_frames = 0;
+   memset(spectral->log_mel_sum, 0, sizeof(spectral->log_mel_sum));
+   memset(spectral->band_power_sum, 0, sizeof(spectral->band_power_sum));
+   spectral->sum_squares = 0;
+   spectral->num_samples = 0;
+   spectral->peak = 0;
+}
+
+void spectral_reset(spectral_t *spectral)
+{
+   // Discard the analysis window along with every accumulator
+   spectral->history_fill = 0;
+   spectral_clear_interval(spectral);
+}
+
+void spectral_measure_levels(spectral_t *spectral, const int16_t *samples, uint32_t num_samples)
+{
+#if CONFIG_IDF_TARGET_ESP32S3
+   if (spectral->use_simd && !((uintptr_t)samples % 16))
+   {
+      const uint32_t num_vectors = num_samples / SPECTRAL_LEVELS_VECTOR_LANES;
+      spectral_measure_levels_simd(spectral, samples, num_vectors);
+      samples += num_vectors * SPECTRAL_LEVELS_VECTOR_LANES;
+      num_samples -= num_vectors * SPECTRAL_LEVELS_VECTOR_LANES;
+   }
+#endif
+   spectral_measure_levels_portable(spectral, samples, num_samples);
+}
+
+void spectral_measure_levels_reference(spectral_t *spectral, const int16_t *samples, uint32_t num_samples)
+{
+   spectral_measure_levels_portable(spectral, samples, num_samples);
+}
+
+void spectral_analyze_frame(spectral_t *spectral, const int16_t *frame, float *log_mel, float *band_power)
+{
+   // Window the frame straight into bit-reversed order, treating consecutive sample pairs as the real and imaginary
+   //    parts of a half-size complex sequence; zero padding at the end rather than centering the frame, as the front end
+   //    does, only changes the phase of each bin and so leaves every magnitude unchanged
+   float *data = spectral->fft;
+   memset(data, 0, sizeof(spectral->fft));
+   for (uint32_t n = 0; n < (SPECTRAL_FRAME_SAMPLES / 2); ++n)
+   {
+      float *destination = data + (2 * spectral->bit_reverse[n]);
+      destination[0] = (float)frame[2 * n] * spectral->window[2 * n];
+      destination[1] = (float)frame[(2 * n) + 1] * spectral->window[(2 * n) + 1];
+   }
+   spectral_fft(spectral);
+
+   // Split the complex result into the real frame's spectrum one mirrored pair of bins at a time, folding each bin into
+   //    the mel and octave bands in ascending order rather than storing the spectrum (only the upper half of each pair
+   //    needs to wait, as a power)
+   float mel[SPECTRAL_MEL_BANDS + 2] = { 0 };
+   uint32_t octave = 0;
+   memset(band_power, 0, SPECTRAL_OCTAVE_BANDS * sizeof(float));
+   const float dc = data[0] + data[1], nyquist = data[0] - data[1];
+   spectral_accumulate_bin(spectral, 0, dc * dc, mel, band_power, &octave);
+   float upper_power[SPECTRAL_HALF_SIZE / 2];
+   for (uint32_t k = 1; k <= (SPECTRAL_HALF_SIZE / 2); ++k)
+   {
+      const float *zk = data + (2 * k), *zm = data + (2 * (SPECTRAL_HALF_SIZE - k));
+      const float even_r = 0.5f * (zk[0] + zm[0]), even_i = 0.5f * (zk[1] - zm[1]);
+      const float odd_r = 0.5f * (zk[0] - zm[0]), odd_i = 0.5f * (zk[1] + zm[1]);
+      const float c = spectral->twiddles[2 * k], s = spectral->twiddles[(2 * k) + 1];
+      const float xr = even_r - (s * odd_r) + (c * odd_i), xi = even_i - (s * odd_i) - (c * odd_r);
+      spectral_accumulate_bin(spectral, k, (xr * xr) + (xi * xi), mel, band_power, &octave);
+      const float mr = even_r + (s * odd_r) - (c * odd_i), mi = even_i + (c * odd_r) + (s * odd_i);
+      upper_power[(SPECTRAL_HALF_SIZE / 2) - k] = (mr * mr) + (mi * mi);
+   }
+   for (uint32_t k = (SPECTRAL_HALF_SIZE / 2) + 1; k < SPECTRAL_HALF_SIZE; ++k)
+      spectral_accumulate_bin(spectral, k, upper_power[k - (SPECTRAL_HALF_SIZE / 2)], mel, band_power, &octave);
+   spectral_accumulate_bin(spectral, SPECTRAL_HALF_SIZE, nyquist * nyquist, mel, band_power, &octave);
+   for (uint32_t b = 0; b < SPECTRAL_MEL_BANDS; ++b)
+      log_mel[b] = logf(mel[b + 1] + SPECTRAL_LOG_OFFSET);
+}
+
+void spectral_process(spectral_t *spectral, const int16_t *samples, uint32_t num_samples)
+{
+   // Analyze a frame every time the trailing window fills, then slide it along by one hop
+   float log_mel[SPECTRAL_MEL_BANDS], band_power[SPECTRAL_OCTAVE_BANDS];
+   while (num_samples)
+   {
+      const uint32_t count = ((SPECTRAL_FRAME_SAMPLES - spectral->history_fill) < num_samples) ? (SPECTRAL_FRAME_SAMPLES - spectral->history_fill) : num_samples;
+      memcpy(spectral->history + spectral->history_fill, samples, count * sizeof(int16_t));
+      spectral->history_fill += count;
+      samples += count;
+      num_samples -= count;
+      if (spectral->history_fill == SPECTRAL_FRAME_SAMPLES)
+      {
+         spectral_analyze_frame(spectral, spectral->history, log_mel, band_power);
+         for (uint32_t b = 0; b < SPECTRAL_MEL_BANDS; ++b)
+            spectral->log_mel_sum[b] += log_mel[b];
+         for (uint32_t b = 0; b < SPECTRAL_OCTAVE_BANDS; ++b)
+            spectral->band_power_sum[b] += band_power[b];
+         ++spectral->num_frames;
+         memmove(spectral->history, spectral->history + SPECTRAL_HOP_SAMPLES, (SPECTRAL_FRAME_SAMPLES - SPECTRAL_HOP_SAMPLES) * sizeof(int16_t));
+         spectral->history_fill = SPECTRAL_FRAME_SAMPLES - SPECTRAL_HOP_SAMPLES;
+      }
+   }
+}
+
+static inline float spectral_decibels(float power_ratio)
+{
+   return (power_ratio > 0.0f) ? fmaxf(10.0f * log10f(power_ratio), SPECTRAL_FLOOR_DB) : SPECTRAL_FLOOR_DB;
+}
+
+void spectral_finish(spectral_t *spectral, spectral_summary_t *summary)
+{
+   // Convert the interval's accumulators into levels, then clear them while keeping the analysis window so that the next
+   //    interval's frames continue seamlessly
+   const float mean_square = spectral->num_samples ? ((float)spectral->sum_squares / (float)spectral->num_samples / (SPECTRAL_FULL_SCALE * SPECTRAL_FULL_SCALE)) : 0.0f;
+   const float peak = (float)spectral->peak / SPECTRAL_FULL_SCALE;
+   summary->num_frames = spectral->num_frames;
+   summary->peak_dbfs = spectral_decibels(peak * peak);
+   summary->rms_dbfs = spectral_decibels(2.0f * mean_square);
+   summary->crest_db = (mean_square > 0.0f) ? (10.0f * log10f((peak * peak) / mean_square)) : 0.0f;
+   for (uint32_t b = 0; b < SPECTRAL_OCTAVE_BANDS; ++b)
+      summary->band_dbfs[b] = spectral->num_frames ? spectral_decibels(spectral->power_scale * spectral->band_power_sum[b] / (float)spectral->num_frames) : SPECTRAL_FLOOR_DB;
+   for (uint32_t b = 0; b < SPECTRAL_MEL_BANDS; ++b)
+      summary->log_mel[b] = spectral->num_frames ? (spectral->log_mel_sum[b] / (float)spectral->num_frames) : logf(SPECTRAL_LOG_OFFSET);
+   spectral_clear_interval(spectral);
+}
@@ -0,0 +1,68 @@
+#ifndef __SPECTRAL_HEADER_H__
+#define __SPECTRAL_HEADER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Log-mel front end matching ai/yamnet/models/model.py: 25 ms periodic Hann window, 10 ms hop, 512-point FFT magnitude,
+//    64 HTK mel bands from 125 Hz to 7.5 kHz, and a natural log with a small offset, all at 16 kHz
+#define SPECTRAL_SAMPLE_RATE_HZ              16000
+#define SPECTRAL_FRAME_SAMPLES               400
+#define SPECTRAL_HOP_SAMPLES                 160
+#define SPECTRAL_FFT_SIZE                    512
+#define SPECTRAL_NUM_BINS                    ((SPECTRAL_FFT_SIZE / 2) + 1)
+#define SPECTRAL_MEL_BANDS                   64
+#define SPECTRAL_MEL_MIN_HZ                  125.0
+#define SPECTRAL_MEL_MAX_HZ                  7500.0
+#define SPECTRAL_LOG_OFFSET                  0.001f
+
+// Octave bands centered on 62.5 Hz to 4 kHz, each covering the FFT bins within half an octave of its center
+#define SPECTRAL_OCTAVE_BANDS                7
+#define SPECTRAL_OCTAVE_LOWEST_HZ            62.5
+
+#define SPECTRAL_FLOOR_DB                    -120.0f  // Reported for any level at or below digital silence
+#define SPECTRAL_LEVELS_VECTOR_LANES         8
+#define SPECTRAL_LEVELS_MAX_VECTORS          32  // Keeps each sum of squares within the 40-bit SIMD accumulator
+
+// Summary of one interval: time-domain peak and RMS levels relative to a full-scale sine, so that a full-scale sine reads
+//    0 dBFS with a 3.01 dB crest factor, octave band levels on the same scale, and the mean of the per-frame log-mel
+//    spectrogram exactly as the Python front end computes it
+typedef struct
+{
+   uint32_t num_frames;
+   float peak_dbfs, rms_dbfs, crest_db;
+   float band_dbfs[SPECTRAL_OCTAVE_BANDS];
+   float log_mel[SPECTRAL_MEL_BANDS];
+} spectral_summary_t;
+
+// Streaming summarizer state: the window, FFT twiddles, and sparse mel weights computed once at initialization, the
+//    trailing analysis window, and the accumulators for the interval in progress
+typedef struct
+{
+   bool use_simd;
+   float window[SPECTRAL_FRAME_SAMPLES];
+   float twiddles[SPECTRAL_FFT_SIZE];  // Interleaved cos/sin of 2*pi*k/SPECTRAL_FFT_SIZE for the first half of the circle
+   uint16_t bit_reverse[SPECTRAL_FFT_SIZE / 2];
+   int8_t mel_band[SPECTRAL_NUM_BINS];  // Bins feed the falling slope of "mel_band" and the rising slope of the band above it
+   float mel_lower_weight[SPECTRAL_NUM_BINS], mel_upper_weight[SPECTRAL_NUM_BINS];
+   uint16_t octave_first_bin[SPECTRAL_OCTAVE_BANDS + 1];
+   float fft[SPECTRAL_FFT_SIZE] __attribute__((aligned(16)));
+   float power_scale;
+   int16_t history[SPECTRAL_FRAME_SAMPLES];
+   uint32_t history_fill, num_frames;
+   float log_mel_sum[SPECTRAL_MEL_BANDS];
+   float band_power_sum[SPECTRAL_OCTAVE_BANDS];
+   int64_t sum_squares;
+   uint64_t num_samples;
+   int32_t peak;
+} spectral_t;
+
+void spectral_init(spectral_t *spectral);
+void spectral_reset(spectral_t *spectral);
+void spectral_measure_levels(spectral_t *spectral, const int16_t *samples, uint32_t num_samples);
+void spectral_measure_levels_reference(spectral_t *spectral, const int16_t *samples, uint32_t num_samples);
+void spectral_process(spectral_t *spectral, const int16_t *samples, uint32_t num_samples);
+void spectral_analyze_frame(spectral_t *spectral, const int16_t *frame, float *log_mel, float *band_power);
+void spectral_finish(spectral_t *spectral, spectral_summary_t *summary);
+
+#endif  // __SPECTRAL_HEADER_H__
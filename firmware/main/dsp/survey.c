@@ -0,0 +1,108 @@
+#include <math.h>
+#include <string.h>
+#include "survey.h"
+
+static void survey_accumulate(double *mean, double *spread, double total_weight, double weight, double value)
+{
+   // Weighted running mean and sum of squared deviations (West's incremental algorithm), given the total weight
+   //    including this value
+   const double delta = value - *mean;
+   *mean += (weight / total_weight) * delta;
+   *spread += weight * delta * (value - *mean);
+}
+
+static double survey_epoch_error(const survey_t *survey, double spread, double total_weight)
+{
+   // Error of the mean from the larger of the spread actually observed and the mean variance the receiver reported, with
+   //    only one effectively independent epoch per decorrelation interval since consecutive fixes share most of their error
+   const double observed_variance = spread / total_weight, reported_variance = survey->num_epochs / total_weight;
+   const double independent_epochs = fmin((double)survey->num_epochs, 1.0 + ((survey->last_time - survey->first_time) / SURVEY_DECORRELATION_SECONDS));
+   return sqrt(fmax(observed_variance, reported_variance) / independent_epochs);
+}
+
+void survey_init(survey_t *survey, double target_accuracy_m, double min_duration_s)
+{
+   memset(survey, 0, sizeof(*survey));
+   survey->target_accuracy_m = target_accuracy_m;
+   survey->min_duration_s = min_duration_s;
+   survey_reset(survey);
+}
+
+void survey_reset(survey_t *survey)
+{
+   // Forget every fix, keeping only the completion criteria
+   const double target_accuracy_m = survey->target_accuracy_m, min_duration_s = survey->min_duration_s;
+   memset(survey, 0, sizeof(*survey));
+   survey->target_accuracy_m = target_accuracy_m;
+   survey->min_duration_s = min_duration_s;
+}
+
+bool survey_update(survey_t *survey, double time_s, double lat, double lon, double height, double horizontal_accuracy_m, double vertical_accuracy_m)
+{
+   // Ignore fixes too poor to improve the mean, and any without a usable accuracy estimate
+   if ((horizontal_accuracy_m <= 0.0) || (vertical_accuracy_m <= 0.0) || (horizontal_accuracy_m > SURVEY_MAX_EPOCH_ACCURACY_M))
+   {
+      ++survey->num_rejected;
+      return false;
+   }
+
+   // The first accepted fix becomes the origin of the local north/east frame for all that follow
+   if (!survey->num_epochs)
+   {
+      survey->origin_lat = lat;
+      survey->origin_lon = lon;
+      survey->meters_per_degree_lat = SURVEY_EARTH_RADIUS_M * M_PI / 180.0;
+      survey->meters_per_degree_lon = survey->meters_per_degree_lat * cos(lat * M_PI / 180.0);
+      survey->first_time = time_s;
+   }
+   const double delta_lon = remainder(lon - survey->origin_lon, 360.0);
+   const double north = (lat - survey->origin_lat) * survey->meters_per_degree_lat, east = delta_lon * survey->meters_per_degree_lon;
+
+   // Fold the fix into the weighted means, horizontally and vertically by the inverse of its reported variance
+   const double horizontal_weight = 1.0 / (horizontal_accuracy_m * horizontal_accuracy_m);
+   const double vertical_weight = 1.0 / (vertical_accuracy_m * vertical_accuracy_m);
+   ++survey->num_epochs;
+   survey->last_time = time_s;
+   survey->horizontal_weight += horizontal_weight;
+   survey->vertical_weight += vertical_weight;
+   survey_accumulate(&survey->mean_north, &survey->spread_north, survey->horizontal_weight, horizontal_weight, north);
+   survey_accumulate(&survey->mean_east, &survey->spread_east, survey->horizontal_weight, horizontal_weight, east);
+   survey_accumulate(&survey->mean_up, &survey->spread_up, survey->vertical_weight, vertical_weight, height);
+   return true;
+}
+
+bool survey_complete(const survey_t *survey)
+{
+   // Surveyed for at least the minimum duration and to within the target horizontal accuracy
+   double horizontal_m, vertical_m;
+   survey_accuracy(survey, &horizontal_m, &vertical_m);
+   return survey->num_epochs && ((survey->last_time - survey->first_time) >= survey->min_duration_s) && (horizontal_m <= survey->target_accuracy_m);
+}
+
+void survey_position(const survey_t *survey, double *lat, double *lon, double *height)
+{
+   // Weighted mean position, converted back from the local north/east frame
+   *lat = survey->origin_lat + (survey->mean_north / survey->meters_per_degree_lat);
+   *lon = remainder(survey->origin_lon + (survey->mean_east / survey->meters_per_degree_lon), 360.0);
+   *height = survey->mean_up;
+}
+
+void survey_accuracy(const survey_t *survey, double *horizontal_m, double *vertical_m)
+{
+   // Estimated horizontal (2D RMS) and vertical errors of the mean position, or infinite before any fix is accepted
+   if (!survey->num_epochs)
+   {
+      *horizontal_m = *vertical_m = INFINITY;
+      return;
+   }
+   *horizontal_m = survey_epoch_error(survey, survey->spread_north + survey->spread_east, survey->horizontal_weight);
+   *vertical_m = survey_epoch_error(survey, survey->spread_up, survey->vertical_weight);
+}
+
+double survey_horizontal_distance_m(double lat1, double lon1, double lat2, double lon2)
+{
+   // Equirectangular approximation, which is ample over the tens of meters at which a node is judged to have moved
+   const double mean_lat = 0.5 * (lat1 + lat2) * M_PI / 180.0;
+   const double north = (lat2 - lat1) * M_PI / 180.0, east = remainder(lon2 - lon1, 360.0) * M_PI / 180.0 * cos(mean_lat);
+   return SURVEY_EARTH_RADIUS_M * sqrt((north * north) + (east * east));
+}
@@ -0,0 +1,33 @@
+#ifndef __SURVEY_HEADER_H__
+#define __SURVEY_HEADER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SURVEY_EARTH_RADIUS_M                6371008.8
+#define SURVEY_MAX_EPOCH_ACCURACY_M          10.0   // Fixes reporting a worse horizontal accuracy are ignored as unusable
+#define SURVEY_DECORRELATION_SECONDS         120.0  // Epochs closer together than this share most of their error (multipath, ionosphere)
+
+// Position survey-in: a running mean of 3D fixes weighted by the inverse of each fix's reported variance (horizontal
+//    and vertical separately), held as north/east offsets in meters from the first accepted fix so that double precision
+//    is retained indefinitely, along with the weighted spread of the fixes about that mean
+typedef struct
+{
+   double target_accuracy_m, min_duration_s;
+   double origin_lat, origin_lon, meters_per_degree_lat, meters_per_degree_lon;
+   double first_time, last_time;
+   uint32_t num_epochs, num_rejected;
+   double horizontal_weight, vertical_weight;  // Sums of the inverse reported variances
+   double mean_north, mean_east, mean_up;
+   double spread_north, spread_east, spread_up;  // Weighted sums of squared deviations from the running mean
+} survey_t;
+
+void survey_init(survey_t *survey, double target_accuracy_m, double min_duration_s);
+void survey_reset(survey_t *survey);
+bool survey_update(survey_t *survey, double time_s, double lat, double lon, double height, double horizontal_accuracy_m, double vertical_accuracy_m);
+bool survey_complete(const survey_t *survey);
+void survey_position(const survey_t *survey, double *lat, double *lon, double *height);
+void survey_accuracy(const survey_t *survey, double *horizontal_m, double *vertical_m);
+double survey_horizontal_distance_m(double lat1, double lon1, double lat2, double lon2);
+
+#endif  // __SURVEY_HEADER_H__
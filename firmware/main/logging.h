@@ -1,7 +1,24 @@
+#include <stdbool.h>
 #include <esp_log.h>
+#include "app_config.h"
+
+#if LOGGING_DEFERRED_ENABLED
+
+// Capture only the format string address and raw arguments, leaving formatting to the drain task or the host
+#include "deferred_log.h"
+#define DEFERRED_LOG(level, ...) do { if ((level) <= LOG_LOCAL_LEVEL) deferred_log_write(level, LOG_CAPTURE(__VA_ARGS__)); } while (0)
+#define printe(format, ...) DEFERRED_LOG(ESP_LOG_ERROR, format, ##__VA_ARGS__)
+#define printw(format, ...) DEFERRED_LOG(ESP_LOG_WARN, format, ##__VA_ARGS__)
+#define print(format, ...) DEFERRED_LOG(ESP_LOG_INFO, format, ##__VA_ARGS__)
+#define printd(format, ...) DEFERRED_LOG(ESP_LOG_DEBUG, format, ##__VA_ARGS__)
+#define printv(format, ...) DEFERRED_LOG(ESP_LOG_VERBOSE, format, ##__VA_ARGS__)
+
+#else
 
 #define printe(format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR, "CivicAlert", format, ##__VA_ARGS__)
 #define printw(format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN, "CivicAlert", format, ##__VA_ARGS__)
 #define print(format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO, "CivicAlert", format, ##__VA_ARGS__)
 #define printd(format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG, "CivicAlert", format, ##__VA_ARGS__)
 #define printv(format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, "CivicAlert", format, ##__VA_ARGS__)
+
+#endif
@@ -4,17 +4,30 @@
 #include <nvs_flash.h>
 #include <wifi_provisioning/manager.h>
 #include <wifi_provisioning/scheme_ble.h>
+#include <esp_timer.h>
+#include <math.h>
 #include "audio.h"
+#include "block_pool.h"
+#include "boot_profile.h"
 #include "button.h"
+#include "commands.h"
+#include "drift.h"
 #include "gps.h"
+#include "history.h"
+#include "latency_trace.h"
 #include "logging.h"
 #include "network.h"
+#include "onset.h"
+#include "resampler.h"
+#include "sinks.h"
+#include "spool.h"
 #include "usb.h"
 
 // Static global variables
 static bool provisioned = false;
 static EventGroupHandle_t wifi_event_group;
 static volatile bool wifi_connected;
+static sink_handle_t spool_sink;
 
 // Setup-mode button press handler
 static void setup_button_pressed(void)
@@ -81,6 +94,7 @@ static void provisioning_event_handler(void* arg, esp_event_base_t event_base, i
          case WIFI_EVENT_STA_DISCONNECTED:
             print("Disconnected. Reconnecting to Wi-Fi...");
             wifi_connected = false;
+            network_set_ip_acquired(false);
             esp_wifi_connect();
             break;
          default:
@@ -92,6 +106,8 @@ static void provisioning_event_handler(void* arg, esp_event_base_t event_base, i
       wifi_connected = true;
       ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
       print("Connected with IP Address:" IPSTR, IP2STR(&event->ip_info.ip));
+      network_set_ip_acquired(true);
+      spool_resume_drain();
    }
    else if (event_base == PROTOCOMM_TRANSPORT_BLE_EVENT)
    {
@@ -126,9 +142,408 @@ static void provisioning_event_handler(void* arg, esp_event_base_t event_base, i
    }
 }
 
+// Writes each requested stream of a captured block as its own packet, returning the streams which could not be written
+typedef bool (*packet_writer_t)(packet_type_t type, uint8_t flags, const void *header, size_t header_len, const uint8_t *data, size_t data_len);
+static uint32_t write_block_packets(const sink_block_t *block, uint32_t streams, packet_writer_t writer)
+{
+   uint32_t failed_streams = 0;
+   const uint8_t flags = (block->synchronized ? 0 : PACKET_FLAG_UNSYNCHRONIZED) | (block->surveyed ? PACKET_FLAG_SURVEYED : 0);
+   if (streams & SINK_STREAM_FULL_RATE)
+   {
+      const packet_audio_t audio_header = { .timestamp = block->timestamp, .lat = block->lat, .lon = block->lon, .height = block->height,
+                                            .drift_ppm = block->drift_ppm, .horizontal_accuracy = block->horizontal_accuracy,
+                                            .vertical_accuracy = block->vertical_accuracy };
+      if (!writer(PACKET_TYPE_AUDIO, flags | (block->resampled ? PACKET_FLAG_RESAMPLED : 0), &audio_header, sizeof(audio_header), (const uint8_t*)block->samples, AUDIO_PACKET_SIZE_BYTES))
+         failed_streams |= SINK_STREAM_FULL_RATE;
+   }
+   if (streams & SINK_STREAM_DECIMATED)
+   {
+      const packet_audio_decimated_t decimated_header = { .timestamp = block->decimated_timestamp, .lat = block->lat, .lon = block->lon,
+                                                          .height = block->height, .sample_rate_hz = AUDIO_DECIMATED_RATE_HZ, .drift_ppm = block->drift_ppm,
+                                                          .horizontal_accuracy = block->horizontal_accuracy, .vertical_accuracy = block->vertical_accuracy };
+      if (!writer(PACKET_TYPE_AUDIO_DECIMATED, flags, &decimated_header, sizeof(decimated_header), (const uint8_t*)block->decimated_samples, AUDIO_DECIMATED_PACKET_SIZE_BYTES))
+         failed_streams |= SINK_STREAM_DECIMATED;
+   }
+   if (streams & SINK_STREAM_SUMMARY)
+   {
+      // Quantize the summary's levels and log-mel values to int16, a few hundred bytes in place of a second of audio
+      const spectral_summary_t *summary = &block->summary;
+      const packet_spectral_summary_t summary_header = { .timestamp = block->decimated_timestamp, .lat = block->lat, .lon = block->lon,
+            .height = block->height, .drift_ppm = block->drift_ppm, .num_frames = (uint16_t)summary->num_frames, .num_bands = SPECTRAL_OCTAVE_BANDS,
+            .num_mel_bands = SPECTRAL_MEL_BANDS, .peak_level = (int16_t)lrintf(summary->peak_dbfs * PACKET_SUMMARY_LEVEL_SCALE),
+            .rms_level = (int16_t)lrintf(summary->rms_dbfs * PACKET_SUMMARY_LEVEL_SCALE), .crest_factor = (int16_t)lrintf(summary->crest_db * PACKET_SUMMARY_LEVEL_SCALE),
+            .horizontal_accuracy = block->horizontal_accuracy, .vertical_accuracy = block->vertical_accuracy };
+      int16_t summary_values[SPECTRAL_OCTAVE_BANDS + SPECTRAL_MEL_BANDS];
+      for (uint32_t b = 0; b < SPECTRAL_OCTAVE_BANDS; ++b)
+         summary_values[b] = (int16_t)lrintf(summary->band_dbfs[b] * PACKET_SUMMARY_LEVEL_SCALE);
+      for (uint32_t b = 0; b < SPECTRAL_MEL_BANDS; ++b)
+         summary_values[SPECTRAL_OCTAVE_BANDS + b] = (int16_t)lrintf(summary->log_mel[b] * PACKET_SUMMARY_LOG_MEL_SCALE);
+      if (!writer(PACKET_TYPE_SPECTRAL_SUMMARY, flags, &summary_header, sizeof(summary_header), (const uint8_t*)summary_values, sizeof(summary_values)))
+         failed_streams |= SINK_STREAM_SUMMARY;
+   }
+   return failed_streams;
+}
+
+// Audio sink handlers, each running on its own task
+static bool usb_packet_writer(packet_type_t type, uint8_t flags, const void *header, size_t header_len, const uint8_t *data, size_t data_len)
+{
+   usb_write_packet(type, flags, header, header_len, data, data_len);
+   return true;
+}
+
+static void history_sink_handler(const sink_block_t *block, uint32_t streams, void *context)
+{
+   // History is only ever requested by GPS time, so blocks stamped from the local clock could never be retrieved
+   if (block->synchronized)
+      history_store(block->timestamp, block->samples, AUDIO_SAMPLE_RATE_HZ);
+}
+
+static void trace_block_output(const sink_block_t *block, int64_t start_us, latency_stage_t enqueue_stage, latency_stage_t transmit_stage, latency_stage_t total_stage)
+{
+   // Trace how long a block waited for a sink after dispatch, how long its packets took to hand to the transport, and so
+   //    how long it took to leave the node after its final samples were captured
+   const int64_t end_us = esp_timer_get_time();
+   latency_trace_record(enqueue_stage, block->trace.dispatched_us, start_us);
+   latency_trace_record(transmit_stage, start_us, end_us);
+   latency_trace_record(total_stage, block->trace.dma_complete_us, end_us);
+}
+
+static void usb_sink_handler(const sink_block_t *block, uint32_t streams, void *context)
+{
+   const int64_t start_us = esp_timer_get_time();
+   write_block_packets(block, streams, usb_packet_writer);
+   trace_block_output(block, start_us, LATENCY_STAGE_USB_ENQUEUE, LATENCY_STAGE_USB_TRANSMIT, LATENCY_STAGE_USB_TOTAL);
+}
+
+static void network_sink_handler(const sink_block_t *block, uint32_t streams, void *context)
+{
+   // Spool any stream that could not be delivered to the server, tracing only blocks which were delivered in full
+   const int64_t start_us = esp_timer_get_time();
+   const uint32_t failed_streams = write_block_packets(block, streams, network_write_packet);
+   if (failed_streams)
+      sinks_forward(spool_sink, block, failed_streams);
+   else
+      trace_block_output(block, start_us, LATENCY_STAGE_NETWORK_ENQUEUE, LATENCY_STAGE_NETWORK_TRANSMIT, LATENCY_STAGE_NETWORK_TOTAL);
+}
+
+static void spool_sink_handler(const sink_block_t *block, uint32_t streams, void *context)
+{
+   write_block_packets(block, streams, spool_write_packet);
+}
+
+static void register_audio_sinks(void)
+{
+   // The spool only receives blocks the network sink failed to deliver or had to drop, so that a slow or absent
+   //    uplink degrades into store-and-forward without ever delaying capture, history, or USB output
+   const uint32_t output_streams = (AUDIO_FULL_RATE_STREAM_ENABLED ? SINK_STREAM_FULL_RATE : 0) | (AUDIO_DECIMATED_STREAM_ENABLED ? SINK_STREAM_DECIMATED : 0) |
+                                   (AUDIO_SUMMARY_STREAM_ENABLED ? SINK_STREAM_SUMMARY : 0);
+   spool_sink = sinks_register(&(sink_config_t){ .name = "spool_sink", .handler = spool_sink_handler, .streams = 0,
+      .queue_depth = SINK_SPOOL_QUEUE_DEPTH, .stack_size = SINK_STACK_SIZE_BYTES, .drop_policy = SINK_DROP_NEWEST, .priority = SINK_SPOOL_PRIORITY, .core = 0 });
+   sinks_register(&(sink_config_t){ .name = "history_sink", .handler = history_sink_handler, .streams = SINK_STREAM_FULL_RATE,
+      .queue_depth = SINK_HISTORY_QUEUE_DEPTH, .stack_size = SINK_STACK_SIZE_BYTES, .drop_policy = SINK_DROP_OLDEST, .priority = SINK_HISTORY_PRIORITY, .core = 0 });
+   sinks_register(&(sink_config_t){ .name = "usb_sink", .handler = usb_sink_handler, .streams = output_streams,
+      .queue_depth = SINK_USB_QUEUE_DEPTH, .stack_size = SINK_STACK_SIZE_BYTES, .drop_policy = SINK_DROP_OLDEST, .priority = SINK_USB_PRIORITY, .core = 0 });
+   sinks_register(&(sink_config_t){ .name = "network_sink", .handler = network_sink_handler, .streams = output_streams,
+      .queue_depth = SINK_NETWORK_QUEUE_DEPTH, .stack_size = SINK_STACK_SIZE_BYTES, .drop_policy = SINK_DROP_OLDEST, .priority = SINK_NETWORK_PRIORITY,
+      .core = 0, .overflow_sink = spool_sink });
+}
+
+// Dispatch state, owned entirely by the dispatch task: the sample clock drift estimate, the resampler correcting for it,
+//    and the GPS second currently being assembled from its output
+static drift_estimator_t dispatch_drift;
+static resampler_t dispatch_resampler;
+static int16_t dispatch_discard[RESAMPLER_BLOCK_SAMPLES];
+static sink_block_t *dispatch_pending_block;
+static uint32_t dispatch_pending_samples;
+static uint64_t dispatch_resampler_origin;
+static double dispatch_output_time;
+static bool dispatch_resampling;
+
+// Latest mapping from absolute sample position to GPS time, published by the dispatch task at every block boundary so
+//    that the TOA task can time each event onset as soon as it is picked rather than once its second is dispatched
+typedef struct
+{
+   uint64_t sample_index;
+   double timestamp, seconds_per_sample;
+   float drift_ppm;
+   bool synchronized, valid;
+} sample_clock_t;
+static sample_clock_t dispatch_clock;
+static portMUX_TYPE dispatch_clock_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool attach_decimated_block(sink_block_t *block, const sink_block_t *captured, double timestamp)
+{
+   // Carry the decimated counterpart of a captured second, along with the spectral summary computed from it, copying
+   //    both out of the captured block unless that block is the one being published
+   if (!(captured->streams & SINK_STREAM_DECIMATED))
+      return false;
+   block->decimated_timestamp = timestamp - audio_decimated_delay_seconds();
+   if (block != captured)
+   {
+      memcpy(block->decimated_samples, captured->decimated_samples, AUDIO_DECIMATED_PACKET_SIZE_BYTES);
+      block->summary = captured->summary;
+   }
+   block->streams |= captured->streams & (SINK_STREAM_DECIMATED | SINK_STREAM_SUMMARY);
+   return true;
+}
+
+static void stop_drift_correction(void)
+{
+   // Abandon the partially assembled output second so that correction can later restart from a clean GPS second
+   if (dispatch_pending_block)
+      sinks_release_block(dispatch_pending_block);
+   dispatch_pending_block = NULL;
+   dispatch_resampling = false;
+}
+
+static void publish_sample_clock(uint64_t block_start_sample, double timestamp, bool synchronized, float drift_ppm)
+{
+   // Anchor the clock at the start of the latest block, placed by the drift fit whenever it is valid since that smooths over
+   //    the jitter of individual timestamps and bridges short GPS outages, advancing at the fitted rate or else the nominal one
+   const bool fitted = drift_estimator_valid(&dispatch_drift);
+   const sample_clock_t clock = { .sample_index = block_start_sample,
+      .timestamp = fitted ? drift_estimator_time_at(&dispatch_drift, (double)block_start_sample) : timestamp,
+      .seconds_per_sample = fitted ? dispatch_drift.seconds_per_sample : (1.0 / AUDIO_SAMPLE_RATE_HZ),
+      .drift_ppm = drift_ppm, .synchronized = synchronized, .valid = true };
+   portENTER_CRITICAL(&dispatch_clock_lock);
+   dispatch_clock = clock;
+   portEXIT_CRITICAL(&dispatch_clock_lock);
+}
+
+static void stamp_block_position(sink_block_t *block)
+{
+   // Record where the node is, and how well that is known, at the time of publishing
+   gps_get_llh(&block->lat, &block->lon, &block->height);
+   block->surveyed = gps_get_llh_accuracy(&block->horizontal_accuracy, &block->vertical_accuracy);
+}
+
+static void publish_block(sink_block_t *block)
+{
+   // Hand the block to every sink without waiting on any of them
+   const bool boot_milestone = !boot_profile_reached(BOOT_PHASE_FIRST_BLOCK) || (block->synchronized && !boot_profile_reached(BOOT_PHASE_FIRST_SYNCHRONIZED_BLOCK));
+   boot_profile_mark(BOOT_PHASE_FIRST_BLOCK);
+   if (block->synchronized)
+      boot_profile_mark(BOOT_PHASE_FIRST_SYNCHRONIZED_BLOCK);
+   print("[%0.6f]: Dispatching %s%saudio block (%+.2f ppm) from %s<%0.6f, %0.6f, %0.3f> (+/-%0.1f m)...", block->timestamp,
+         block->synchronized ? "" : "unsynchronized ", block->resampled ? "drift-corrected " : "", block->drift_ppm, block->surveyed ? "surveyed " : "",
+         block->lat, block->lon, block->height, block->horizontal_accuracy);
+   sinks_publish(block);
+
+   // Report the boot profile once capture is flowing and again once the first GPS-timestamped block goes out
+   if (boot_milestone)
+      boot_profile_report();
+}
+
+static void dispatch_captured_block(sink_block_t *block, double timestamp, bool synchronized, float drift_ppm)
+{
+   // Publish the captured block itself, with no copy of its samples
+   block->timestamp = timestamp;
+   block->synchronized = synchronized;
+   block->resampled = false;
+   block->drift_ppm = drift_ppm;
+   stamp_block_position(block);
+   attach_decimated_block(block, block, timestamp);
+   publish_block(block);
+}
+
+static void dispatch_resampled_block(const sink_block_t *captured, uint64_t block_start_sample, double timestamp, bool synchronized, float drift_ppm)
+{
+   // When correction starts, begin the output at the first whole GPS second late enough for a complete filter window,
+   //    dropping whatever part of this second precedes it
+   if (!dispatch_resampling)
+   {
+      dispatch_output_time = ceil(drift_estimator_time_at(&dispatch_drift, (double)(block_start_sample + RESAMPLER_TAPS)));
+      dispatch_resampler_origin = block_start_sample;
+      resampler_reset(&dispatch_resampler, drift_estimator_position_at(&dispatch_drift, dispatch_output_time) - (double)block_start_sample);
+      dispatch_pending_samples = 0;
+      dispatch_resampling = true;
+   }
+
+   // Resample the captured second onto the GPS time grid, publishing each output second as soon as it is complete
+   const int16_t *samples = captured->samples;
+   bool decimated_attached = false;
+   for (uint32_t offset = 0; offset < AUDIO_SAMPLE_RATE_HZ; )
+   {
+      offset += resampler_write(&dispatch_resampler, samples + offset, AUDIO_SAMPLE_RATE_HZ - offset);
+      while (true)
+      {
+         // Steer each output second so that it ends exactly where the latest fit places the next GPS second, which corrects
+         //    both the rate and any accumulated phase error (bounded so that a bad fit cannot produce a wild pitch shift)
+         if (!dispatch_pending_samples)
+         {
+            if (!dispatch_pending_block)
+               dispatch_pending_block = sinks_acquire_block();
+            const double end_position = drift_estimator_position_at(&dispatch_drift, dispatch_output_time + 1.0) - (double)dispatch_resampler_origin;
+            const double ratio = (end_position - resampler_position(&dispatch_resampler)) / AUDIO_SAMPLE_RATE_HZ, max_deviation = 2.0e-6 * DRIFT_MAX_PPM;
+            resampler_set_ratio(&dispatch_resampler, (ratio > (1.0 + max_deviation)) ? (1.0 + max_deviation) : ((ratio < (1.0 - max_deviation)) ? (1.0 - max_deviation) : ratio));
+         }
+
+         // Without a free block the output is still produced, and discarded, so that the GPS time grid is maintained
+         const uint32_t wanted = AUDIO_SAMPLE_RATE_HZ - dispatch_pending_samples;
+         const uint32_t produced = dispatch_pending_block ?
+               resampler_read(&dispatch_resampler, dispatch_pending_block->samples + dispatch_pending_samples, wanted) :
+               resampler_read(&dispatch_resampler, dispatch_discard, (wanted < RESAMPLER_BLOCK_SAMPLES) ? wanted : RESAMPLER_BLOCK_SAMPLES);
+         dispatch_pending_samples += produced;
+         if (dispatch_pending_samples < AUDIO_SAMPLE_RATE_HZ)
+         {
+            if (!produced)
+               break;
+            continue;
+         }
+
+         // Publish the completed second, carrying this second's decimated stream unless it already carries an earlier one
+         sink_block_t *block = dispatch_pending_block;
+         if (block)
+         {
+            block->timestamp = dispatch_output_time;
+            block->synchronized = synchronized;
+            block->resampled = true;
+            block->drift_ppm = drift_ppm;
+            block->trace = captured->trace;
+            stamp_block_position(block);
+            block->streams |= SINK_STREAM_FULL_RATE;
+            if (!decimated_attached && !(block->streams & SINK_STREAM_DECIMATED))
+               decimated_attached = attach_decimated_block(block, captured, timestamp);
+            dispatch_pending_block = NULL;
+            publish_block(block);
+         }
+         else
+            printw("[%0.6f]: No free audio block, dropping this second of audio", dispatch_output_time);
+         dispatch_output_time += 1.0;
+         dispatch_pending_samples = 0;
+      }
+   }
+
+   // The output and capture seconds slip past each other occasionally, leaving a captured second during which no output
+   //    second completed, so its decimated stream travels with the next one instead
+   if (!decimated_attached && dispatch_pending_block && !(dispatch_pending_block->streams & SINK_STREAM_DECIMATED))
+      attach_decimated_block(dispatch_pending_block, captured, timestamp);
+}
+
+// Audio dispatch task, stamping and publishing each captured second to every registered sink
+static void dispatch_task(void *args)
+{
+   QueueHandle_t capture_queue = (QueueHandle_t)args;
+   audio_capture_t capture;
+   uint32_t seconds_since_synchronized = 0, seconds_since_report = 0, seconds_since_latency_report = 0;
+   double last_synchronized_timestamp = 0.0;
+   drift_estimator_init(&dispatch_drift, AUDIO_SAMPLE_RATE_HZ);
+   resampler_init(&dispatch_resampler);
+   while (true)
+   {
+      // Wait for the next second of audio data, tracing how long it took to be read, timestamped, and received here
+      xQueueReceive(capture_queue, &capture, portMAX_DELAY);
+      gps_timestamp_t audio_timestamp = capture.timestamp;
+      capture.trace.dispatched_us = esp_timer_get_time();
+      latency_trace_record(LATENCY_STAGE_DMA_TO_READ, capture.trace.dma_complete_us, capture.trace.read_return_us);
+      latency_trace_record(LATENCY_STAGE_TIMESTAMP, capture.trace.timestamp_requested_us, capture.trace.timestamp_resolved_us);
+      latency_trace_record(LATENCY_STAGE_READ_TO_DISPATCH, capture.trace.read_return_us, capture.trace.dispatched_us);
+      if (capture.block)
+         capture.block->trace = capture.trace;
+
+      // Until GPS time is available, stamp blocks from the local clock (extrapolated from the last GPS time, if any) and
+      //    flag them as unsynchronized rather than dropping them
+      const bool synchronized = (audio_timestamp.gps_timestamp > 0.0);
+      if (synchronized)
+      {
+         last_synchronized_timestamp = audio_timestamp.gps_timestamp;
+         seconds_since_synchronized = 0;
+      }
+      else if (last_synchronized_timestamp > 0.0)
+         audio_timestamp.gps_timestamp = last_synchronized_timestamp + (double)(++seconds_since_synchronized);
+      else
+         audio_timestamp.gps_timestamp = (double)esp_timer_get_time() * 1.0e-6;
+
+      // Track the sample clock against GPS time at every block boundary, restarting correction if the two ever disagree
+      //    (a lost capture buffer or a GPS time jump) since the resampler's position along the GPS time grid is then wrong
+      if (synchronized && (drift_estimator_update(&dispatch_drift, capture.sample_index, audio_timestamp.gps_timestamp) == DRIFT_UPDATE_RESET) && dispatch_resampling)
+      {
+         printw("[%0.6f]: Sample count no longer agrees with GPS time, restarting drift correction", audio_timestamp.gps_timestamp);
+         stop_drift_correction();
+      }
+      const float drift_ppm = drift_estimator_valid(&dispatch_drift) ? (float)drift_estimator_ppm(&dispatch_drift) : 0.0f;
+      publish_sample_clock(capture.sample_index, audio_timestamp.gps_timestamp, synchronized, drift_ppm);
+
+      // Once the drift is known, resample the full-rate stream to exactly AUDIO_SAMPLE_RATE_HZ in GPS time; the fit keeps
+      //    extrapolating the grid through short GPS outages, but a second whose samples were discarded leaves a gap that
+      //    correction cannot bridge
+      if (!capture.block)
+      {
+         printw("[%0.6f]: No free audio block, dropping this second of audio", audio_timestamp.gps_timestamp);
+         stop_drift_correction();
+      }
+      else if (AUDIO_DRIFT_CORRECTION_ENABLED && (dispatch_resampling || (synchronized && drift_estimator_valid(&dispatch_drift))))
+      {
+         dispatch_resampled_block(capture.block, capture.sample_index, audio_timestamp.gps_timestamp, synchronized, drift_ppm);
+         sinks_release_block(capture.block);
+      }
+      else
+         dispatch_captured_block(capture.block, audio_timestamp.gps_timestamp, synchronized, drift_ppm);
+
+      // Periodically report how full the block pools run and how long blocks take to pass through each stage
+      if (++seconds_since_report >= BLOCK_POOL_REPORT_INTERVAL_SECONDS)
+      {
+         block_pool_report();
+         seconds_since_report = 0;
+      }
+      if (++seconds_since_latency_report >= LATENCY_REPORT_INTERVAL_SECONDS)
+      {
+         latency_trace_report();
+         seconds_since_latency_report = 0;
+      }
+   }
+}
+
+// Edge TOA task, picking the onset within each window the audio task triggered on and reporting its GPS arrival time
+//    straight away, leaving localization to the server without waiting on (or needing) the audio streams
+static void toa_task(void *args)
+{
+   static onset_window_t window;
+   static onset_picker_t picker;
+   static onset_pick_t pick;
+   QueueHandle_t onset_queue = (QueueHandle_t)args;
+   while (true)
+   {
+      // Wait for the next triggered window and pick the onset within it
+      xQueueReceive(onset_queue, &window, portMAX_DELAY);
+      if (!onset_pick(&picker, window.samples, ONSET_WINDOW_SAMPLES, window.start, &pick))
+         continue;
+
+      // Time the onset by extrapolating from the start of the latest dispatched block, at most a few seconds earlier
+      sample_clock_t clock;
+      portENTER_CRITICAL(&dispatch_clock_lock);
+      clock = dispatch_clock;
+      portEXIT_CRITICAL(&dispatch_clock_lock);
+      if (!clock.valid)
+      {
+         printw("Discarding an event onset picked before capture was first timed");
+         continue;
+      }
+      const double timestamp = clock.timestamp + ((pick.sample_position - (double)clock.sample_index) * clock.seconds_per_sample);
+      packet_toa_report_t report = { .timestamp = timestamp, .drift_ppm = clock.drift_ppm,
+         .uncertainty = (float)(pick.uncertainty_samples * clock.seconds_per_sample), .confidence = pick.confidence, .snr_db = pick.snr_db,
+         .peak = pick.peak, .num_snippet_samples = ONSET_SNIPPET_SAMPLES, .sample_rate_hz = AUDIO_SAMPLE_RATE_HZ,
+         .snippet_offset = (float)(((double)pick.snippet_start - pick.sample_position) * clock.seconds_per_sample) };
+      gps_get_llh(&report.lat, &report.lon, &report.height);
+      const bool surveyed = gps_get_llh_accuracy(&report.horizontal_accuracy, &report.vertical_accuracy);
+      const uint8_t flags = (clock.synchronized ? 0 : PACKET_FLAG_UNSYNCHRONIZED) | (surveyed ? PACKET_FLAG_SURVEYED : 0);
+      print("[%0.6f]: Event onset (+/-%0.1f us, %0.0f%% confidence, %0.1f dB SNR)", timestamp, 1.0e6f * report.uncertainty,
+            100.0f * pick.confidence, pick.snr_db);
+
+      // Send the report over every output at once, spooling it if the server cannot be reached
+      usb_write_packet(PACKET_TYPE_TOA_REPORT, flags, &report, sizeof(report), (const uint8_t*)pick.snippet, sizeof(pick.snippet));
+      if (!network_write_packet(PACKET_TYPE_TOA_REPORT, flags, &report, sizeof(report), (const uint8_t*)pick.snippet, sizeof(pick.snippet)))
+         spool_write_packet(PACKET_TYPE_TOA_REPORT, flags, &report, sizeof(report), (const uint8_t*)pick.snippet, sizeof(pick.snippet));
+   }
+}
+
 // Application entry point
 void app_main(void)
 {
+   // Start GPS bring-up immediately, since its module resets and configuration take seconds but depend on nothing else
+   boot_profile_mark(BOOT_PHASE_APP_START);
+   xTaskCreatePinnedToCore(gps_task, "gps_task", GPS_STACK_SIZE_BYTES, NULL, 8, NULL, 0);
+
    // Initialize the main flash partition
    esp_err_t ret = nvs_flash_init();
    if ((ret == ESP_ERR_NVS_NO_FREE_PAGES) || (ret == ESP_ERR_NVS_NEW_VERSION_FOUND))
@@ -137,11 +552,42 @@ void app_main(void)
       ESP_ERROR_CHECK(nvs_flash_erase());
       ESP_ERROR_CHECK(nvs_flash_init());
    }
+   boot_profile_mark(BOOT_PHASE_STORAGE_READY);
 
    // Initialize the setup-mode button press handler
    button_handle_t setup_mode_button = button_initialize(BUTTON_SETUP_MODE_PIN, BUTTON_SETUP_MODE_ACTIVE_LEVEL);
    button_add_event_callback(setup_mode_button, BUTTON_CALLBACK_LONG_PRESS, setup_button_pressed, SETUP_MODE_BUTTON_PRESS_SECONDS);
 
+   // Initialize the USB and networking peripherals along with the flash spool for network outages
+   usb_initialize(USB_SELF_POWERED);
+#if LOGGING_DEFERRED_ENABLED
+   deferred_log_initialize();
+#endif
+   boot_profile_mark(BOOT_PHASE_USB_READY);
+   network_initialize();
+   spool_initialize();
+
+   // Register every consumer of captured audio before the history buffer claims the remaining PSRAM
+   sinks_initialize();
+   register_audio_sinks();
+   history_initialize();
+   boot_profile_mark(BOOT_PHASE_SINKS_READY);
+
+   block_pool_report();
+
+   // Start capturing audio as soon as there is somewhere to deliver it, leaving Wi-Fi to come up in parallel (the capture
+   //    task's queues are static since this task is deleted once app_main returns)
+   static audio_queues_t audio_queues;
+   audio_queues.capture_queue = xQueueCreate(AUDIO_CAPTURE_QUEUE_DEPTH, sizeof(audio_capture_t));
+   audio_queues.onset_queue = TOA_ENABLED ? xQueueCreate(TOA_QUEUE_DEPTH, sizeof(onset_window_t)) : NULL;
+   xTaskCreatePinnedToCore(dispatch_task, "dispatch_task", 3072, audio_queues.capture_queue, 9, NULL, 1);
+   if (audio_queues.onset_queue)
+      xTaskCreatePinnedToCore(toa_task, "toa_task", TOA_STACK_SIZE_BYTES, audio_queues.onset_queue, TOA_PRIORITY, NULL, 0);
+   xTaskCreatePinnedToCore(audio_task, "audio_task", 2048, &audio_queues, 10, NULL, 1);
+
+   // Initialize the command interface used to retrieve audio history
+   commands_initialize();
+
    // Initialize the TCP/IP networking interface and register event handlers
    ESP_ERROR_CHECK(esp_netif_init());
    ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -151,6 +597,7 @@ void app_main(void)
    ESP_ERROR_CHECK(esp_event_handler_register(PROTOCOMM_SECURITY_SESSION_EVENT, ESP_EVENT_ANY_ID, &provisioning_event_handler, NULL));
    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &provisioning_event_handler, NULL));
    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &provisioning_event_handler, NULL));
+   boot_profile_mark(BOOT_PHASE_NETWORK_STACK_READY);
 
    // Initialize the Wi-Fi stack and provisioning manager
    esp_netif_create_default_wifi_sta();
@@ -184,29 +631,7 @@ void app_main(void)
       ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
       ESP_ERROR_CHECK(esp_wifi_start());
    }
+   boot_profile_mark(BOOT_PHASE_WIFI_STARTED);
 
-   // Initialize the USB and networking peripherals
-   usb_initialize(USB_SELF_POWERED);
-   network_initialize();
-
-   // Create the GPS and audio processing tasks
-   xTaskCreatePinnedToCore(gps_task, "gps_task", 2048, NULL, 8, NULL, 0);
-   xTaskCreatePinnedToCore(audio_task, "audio_task", 2048, xTaskGetCurrentTaskHandle(), 10, NULL, 1);
-
-   // Start the main application loop
-   float lat, lon, height;
-   gps_timestamp_t audio_timestamp;
-   uint32_t audio_data_ptr;
-   while (true)
-   {
-      // Wait for the next second of audio data
-      xTaskNotifyWaitIndexed(0, 0, ULONG_MAX, &audio_timestamp.timestamp_parts[0], portMAX_DELAY);
-      xTaskNotifyWaitIndexed(1, 0, ULONG_MAX, &audio_timestamp.timestamp_parts[1], portMAX_DELAY);
-      xTaskNotifyWaitIndexed(2, 0, ULONG_MAX, &audio_data_ptr, portMAX_DELAY);
-      gps_get_llh(&lat, &lon, &height);
-
-      // Write the audio data out over USB
-      print("[%0.6f]: Writing audio packet from <%0.6f, %0.6f, %0.3f> over USB...", audio_timestamp.gps_timestamp, lat, lon, height);
-      usb_write_audio_packet(audio_timestamp.gps_timestamp, lat, lon, height, (uint8_t*)audio_data_ptr, AUDIO_PACKET_SIZE_BYTES);
-   }
+   // Capture, dispatch, and networking all continue on their own tasks, so the main task is no longer needed
 }
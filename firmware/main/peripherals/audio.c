@@ -1,11 +1,39 @@
 #include <freertos/FreeRTOS.h>
 #include <driver/i2s_pdm.h>
+#include <esp_timer.h>
 #include "audio.h"
+#include "boot_profile.h"
+#include "conditioning.h"
+#include "decimator.h"
 #include "logging.h"
 #include "gps.h"
+#include "onset.h"
+#include "spectral.h"
 
-// Global shared audio buffer
-static int16_t audio_buffer[2 * AUDIO_SAMPLE_RATE_HZ];
+// Frames per I2S DMA buffer, sized so that a buffer completes every 0.5ms, and so buffers per second of audio
+#define AUDIO_DMA_FRAMES                 (AUDIO_SAMPLE_RATE_HZ / 2000)
+#define AUDIO_DMA_BUFFERS_PER_SECOND     (AUDIO_SAMPLE_RATE_HZ / AUDIO_DMA_FRAMES)
+
+// Internal-RAM landing buffer into which each chunk is read from the I2S DMA buffers and conditioned with SIMD, before
+//    being promoted into the PSRAM block holding the rest of its second, along with the signal processing state
+static int16_t audio_landing_buffer[AUDIO_READ_CHUNK_SAMPLES] __attribute__((aligned(BLOCK_POOL_ALIGNMENT)));
+static conditioning_t audio_conditioner;
+static decimator_t audio_decimator;
+static spectral_t audio_spectral;
+static onset_trigger_t audio_onset_trigger;
+static onset_window_t audio_onset_window;
+static bool audio_decimator_enabled, audio_summary_enabled;
+static volatile uint32_t audio_dma_buffers_received;
+static volatile int64_t audio_second_dma_complete_us;
+
+// I2S receive interrupt, counting each DMA buffer as it fills and noting when the one ending each second of audio did so,
+//    since reads consume buffers in the order they complete, so that the delay before the audio task reads it can be traced
+static IRAM_ATTR bool audio_dma_received(i2s_chan_handle_t handle, i2s_event_data_t *event, void *user_ctx)
+{
+   if ((++audio_dma_buffers_received % AUDIO_DMA_BUFFERS_PER_SECOND) == 0)
+      audio_second_dma_complete_us = esp_timer_get_time();
+   return false;
+}
 
 // Audio peripheral initialization
 static i2s_chan_handle_t audio_init(void)
@@ -16,7 +44,7 @@ static i2s_chan_handle_t audio_init(void)
       .id = I2S_NUM_0,
       .role = I2S_ROLE_MASTER,
       .dma_desc_num = 6,
-      .dma_frame_num = AUDIO_SAMPLE_RATE_HZ / 2000,
+      .dma_frame_num = AUDIO_DMA_FRAMES,
       .auto_clear_after_cb = false,
       .auto_clear_before_cb = false,
       .intr_priority = 3,
@@ -34,6 +62,7 @@ static i2s_chan_handle_t audio_init(void)
       }
    };
    i2s_channel_init_pdm_rx_mode(rx_channel, &pdm_rx_config);
+   i2s_channel_register_event_callback(rx_channel, &(i2s_event_callbacks_t){ .on_recv = audio_dma_received }, NULL);
    return rx_channel;
 }
 
@@ -42,25 +71,105 @@ void audio_task(void *args)
 {
    // Initialize the audio peripheral
    size_t bytes_read = 0;
-   TaskHandle_t main_task = (TaskHandle_t)args;
-   uint32_t audio_buffer_index = AUDIO_SAMPLE_RATE_HZ;
+   const audio_queues_t *queues = (const audio_queues_t*)args;
+   audio_capture_t capture = { .sample_index = 0 };
    i2s_chan_handle_t audio_channel = audio_init();
 
+   // Initialize the signal conditioning chain
+   const conditioning_config_t conditioning_config = {
+      .sample_rate_hz = AUDIO_SAMPLE_RATE_HZ,
+      .dc_blocker_cutoff_hz = CONDITIONING_DC_BLOCKER_CUTOFF_HZ,
+      .highpass_cutoff_hz = CONDITIONING_HIGHPASS_CUTOFF_HZ,
+      .highpass_sections = CONDITIONING_HIGHPASS_SECTIONS,
+      .gain_db = CONDITIONING_GAIN_DB,
+   };
+   conditioning_init(&audio_conditioner, &conditioning_config);
+
+   // Initialize the decimator used to produce the reduced-rate classification stream
+   if (AUDIO_DECIMATED_ENABLED)
+   {
+      audio_decimator_enabled = decimator_init(&audio_decimator, AUDIO_SAMPLE_RATE_HZ, AUDIO_DECIMATED_RATE_HZ);
+      if (!audio_decimator_enabled)
+         printe("Unsupported decimated audio rate of %lu Hz, decimated stream disabled", (uint32_t)AUDIO_DECIMATED_RATE_HZ);
+   }
+
+   // Initialize the spectral summarizer, which analyzes the decimated stream exactly as the classifier's front end does
+   if (AUDIO_SUMMARY_STREAM_ENABLED)
+   {
+      audio_summary_enabled = audio_decimator_enabled && (AUDIO_DECIMATED_RATE_HZ == SPECTRAL_SAMPLE_RATE_HZ);
+      if (audio_summary_enabled)
+         spectral_init(&audio_spectral);
+      else
+         printe("Spectral summaries require a %u Hz decimated stream, summary stream disabled", SPECTRAL_SAMPLE_RATE_HZ);
+   }
+
+   // Initialize the edge TOA trigger, which watches the conditioned full-rate stream and hands the window around each
+   //    event to the TOA task for the comparatively costly onset pick, keeping this task's per-chunk work bounded
+   if (queues->onset_queue)
+      onset_trigger_init(&audio_onset_trigger, &(onset_config_t){ .sample_rate_hz = AUDIO_SAMPLE_RATE_HZ, .sta_seconds = TOA_STA_SECONDS,
+         .lta_seconds = TOA_LTA_SECONDS, .trigger_ratio = TOA_TRIGGER_RATIO, .release_ratio = TOA_RELEASE_RATIO, .min_level = TOA_MIN_LEVEL });
+
    // Enable the I2S RX channel and send the first timestamp request
    i2s_channel_enable(audio_channel);
+   boot_profile_mark(BOOT_PHASE_CAPTURE_STARTED);
    gps_timestamp_t audio_timestamp = gps_request_timestamp();
 
    // Read audio in a loop forever
    while (true)
    {
-      // Read one second of audio and immediately request a new timestamp
-      audio_buffer_index = (audio_buffer_index + AUDIO_SAMPLE_RATE_HZ) % (2 * AUDIO_SAMPLE_RATE_HZ);
-      i2s_channel_read(audio_channel, audio_buffer + audio_buffer_index, 2 * AUDIO_SAMPLE_RATE_HZ, &bytes_read, 1000);
-      audio_timestamp = gps_request_timestamp();
+      // Capture each second directly into a pool block, still reading and timing it if no block is free so that the
+      //    sample count stays true to the hardware
+      capture.block = sinks_acquire_block();
+      int16_t *decimated_block = capture.block ? capture.block->decimated_samples : NULL;
+      for (uint32_t offset = 0; offset < AUDIO_SAMPLE_RATE_HZ; offset += AUDIO_READ_CHUNK_SAMPLES)
+      {
+         // Request a new timestamp immediately after the final chunk of the second arrives, only then noting when the DMA
+         //    buffer holding the second's final sample completed and the read returned so as not to delay the request
+         i2s_channel_read(audio_channel, audio_landing_buffer, AUDIO_READ_CHUNK_SAMPLES * sizeof(int16_t), &bytes_read, 1000);
+         if ((offset + AUDIO_READ_CHUNK_SAMPLES) >= AUDIO_SAMPLE_RATE_HZ)
+         {
+            audio_timestamp = gps_request_timestamp();
+            capture.trace.read_return_us = esp_timer_get_time();
+            capture.trace.dma_complete_us = audio_second_dma_complete_us;
+            gps_get_timestamp_latency(&capture.trace.timestamp_requested_us, &capture.trace.timestamp_resolved_us);
+         }
+         if (CONDITIONING_ENABLED)
+            conditioning_process(&audio_conditioner, audio_landing_buffer, AUDIO_READ_CHUNK_SAMPLES);
+         if (queues->onset_queue && onset_trigger_process(&audio_onset_trigger, audio_landing_buffer, AUDIO_READ_CHUNK_SAMPLES, &audio_onset_window))
+            xQueueSend(queues->onset_queue, &audio_onset_window, 0);
+         if (capture.block)
+         {
+            memcpy(capture.block->samples + offset, audio_landing_buffer, AUDIO_READ_CHUNK_SAMPLES * sizeof(int16_t));
+            if (audio_decimator_enabled)
+            {
+               const uint32_t num_decimated = decimator_process(&audio_decimator, audio_landing_buffer, AUDIO_READ_CHUNK_SAMPLES, decimated_block);
+               if (audio_summary_enabled)
+                  spectral_process(&audio_spectral, decimated_block, num_decimated);
+               decimated_block += num_decimated;
+            }
+            if (audio_summary_enabled)
+               spectral_measure_levels(&audio_spectral, audio_landing_buffer, AUDIO_READ_CHUNK_SAMPLES);
+         }
+      }
 
-      // Send the audio data and timestamp to the main task for processing
-      xTaskNotifyIndexed(main_task, 0, audio_timestamp.timestamp_parts[0], eSetValueWithOverwrite);
-      xTaskNotifyIndexed(main_task, 1, audio_timestamp.timestamp_parts[1], eSetValueWithOverwrite);
-      xTaskNotifyIndexed(main_task, 2, (uint32_t)(audio_buffer + audio_buffer_index), eSetValueWithOverwrite);
+      // Send the second and its timestamp to the dispatch task, giving its block back if the dispatcher has fallen behind
+      capture.timestamp = audio_timestamp;
+      if (capture.block)
+      {
+         capture.block->streams = SINK_STREAM_FULL_RATE | (audio_decimator_enabled ? SINK_STREAM_DECIMATED : 0) | (audio_summary_enabled ? SINK_STREAM_SUMMARY : 0);
+         if (audio_summary_enabled)
+            spectral_finish(&audio_spectral, &capture.block->summary);
+      }
+      else if (audio_summary_enabled)
+         spectral_reset(&audio_spectral);
+      if ((xQueueSend(queues->capture_queue, &capture, 0) != pdTRUE) && capture.block)
+         sinks_release_block(capture.block);
+      capture.sample_index += AUDIO_SAMPLE_RATE_HZ;
    }
 }
+
+double audio_decimated_delay_seconds(void)
+{
+   // Delay of the decimated stream behind the full-rate stream it was derived from
+   return audio_decimator_enabled ? decimator_group_delay_seconds(&audio_decimator, AUDIO_SAMPLE_RATE_HZ) : 0.0;
+}
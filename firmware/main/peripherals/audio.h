@@ -1,8 +1,31 @@
 #ifndef __AUDIO_HEADER_H__
 #define __AUDIO_HEADER_H__
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
 #include "app_config.h"
+#include "gps.h"
+#include "sinks.h"
+
+// One captured second handed from the audio task to the dispatcher, which takes over the block's reference; "block" is
+//    NULL when no block was free to capture into, in which case the second was timed but its samples were discarded, and
+//    "trace" holds the times it was read and timestamped for the dispatcher to complete
+typedef struct
+{
+   gps_timestamp_t timestamp;
+   uint64_t sample_index;
+   sink_block_t *block;
+   latency_trace_t trace;
+} audio_capture_t;
+
+// Queues fed by the audio task: captured seconds for the dispatcher, and windows around triggered events for the TOA
+//    task, or NULL if edge TOA reporting is disabled
+typedef struct
+{
+   QueueHandle_t capture_queue, onset_queue;
+} audio_queues_t;
 
 void audio_task(void *args);
+double audio_decimated_delay_seconds(void);
 
 #endif  //__AUDIO_HEADER_H__
@@ -1,20 +1,14 @@
 #include <freertos/FreeRTOS.h>
 #include <driver/uart.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <nvs.h>
+#include "boot_profile.h"
 #include "gps.h"
+#include "logging.h"
+#include "survey.h"
+#include "ubx.h"
 
-#define UBX_MSG_SYNC1_OFFSET           0
-#define UBX_MSG_SYNC2_OFFSET           1
-#define UBX_MSG_CLASS_OFFSET           2
-#define UBX_MSG_ID_OFFSET              3
-#define UBX_MSG_LEN_OFFSET             4
-#define UBX_MSG_PAYLOAD_OFFSET         6
-#define UBX_MAX_PAYLOAD_SIZE           255
-#define UBX_MSG_CHKSUM_LEN             2
-#define UBX_PACKET_OVERHEAD            (UBX_MSG_PAYLOAD_OFFSET + UBX_MSG_CHKSUM_LEN)
-#define UBX_MAX_PACKET_SIZE            (UBX_MAX_PAYLOAD_SIZE + UBX_PACKET_OVERHEAD)
-
-#define UBX_SYNC1_CHAR                 0xB5
-#define UBX_SYNC2_CHAR                 0x62
 #define UBX_SYNC                       UBX_SYNC1_CHAR, UBX_SYNC2_CHAR
 
 #define UBX_CFG_VALGET_MSG             0x06, 0x8B
@@ -69,37 +63,14 @@
                                        0x21, 0x30, 0x02, 0x00, 0x03, 0x00, 0x21, 0x20, 0x01, 0x0C, 0x00, 0x05, \
                                        0x20, 0x01
 #define UBX_SET_GEN_CFG_CHKSUM         0x03, 0x64
+#define UBX_CFG_VALSET_RAM_BEGIN       0x00, 0x01, 0x00, 0x00
+#define UBX_NAV_PVT_UART1_RATE_KEY     0x07, 0x00, 0x91, 0x20
 
-#define FIX_TYPE_2D                    0x02
-#define FIX_TYPE_3D                    0x03
+#define GPS_SURVEY_NVS_NAMESPACE       "gps"
+#define GPS_SURVEY_NVS_KEY             "survey"
 
 #define LNA_MSG_GAIN_OFFSET     4
 
-// UBX received packet state
-typedef enum
-{
-   UBX_PACKET_INIT_STATE,
-   UBX_PACKET_SYNC_STATE,
-   UBX_PACKET_CLASS_STATE,
-   UBX_PACKET_ID_STATE,
-   UBX_PACKET_LEN1_STATE,
-   UBX_PACKET_LEN2_STATE,
-   UBX_PACKET_PAYLOAD_STATE,
-   UBX_PACKET_CK_A_STATE,
-   UBX_PACKET_CK_B_STATE
-} ubx_packet_state_t;
-
-// UBX packet type
-typedef enum
-{
-   UBX_MSG_UNKNOWN,
-   UBX_MON_VER,
-   UBX_NAV_PVT,
-   UBX_TIM_TM2,
-   UBX_CFG_VALGET,
-   UBX_ACK_ACK
-} ubx_message_type_t;
-
 // LNA gain settings
 typedef enum
 {
@@ -108,224 +79,144 @@ typedef enum
    LNA_GAIN_BYPASS = 2
 } lna_gain_t;
 
-// Relevant UBX message structures
-#pragma pack(push, 1)
-typedef struct {
-   uint32_t iTOW;
-   uint16_t year;
-   uint8_t month, day, hour, min, sec;
-   union {
-      uint8_t valid;
-      struct {
-         uint8_t validDate: 1;
-         uint8_t validTime: 1;
-         uint8_t fullyResolved: 1;
-         uint8_t validMag: 1;
-      };
-   };
-   uint32_t tAcc;
-   int32_t nano;
-   uint8_t fixType;
-   union {
-      uint8_t flags;
-      struct {
-         uint8_t gnssFixOK: 1;
-         uint8_t diffSoln: 1;
-         uint8_t psmState: 3;
-         uint8_t headVehValid: 1;
-         uint8_t carrSoln: 2;
-      };
-   };
-   union {
-      uint8_t flags2;
-      struct {
-         uint8_t confirmedAvai: 1;
-         uint8_t confirmedDate: 1;
-         uint8_t confirmedTime: 1;
-      };
-   };
-   uint8_t numSV;
-   int32_t lon, lat, height, hMSL;
-   uint32_t hAcc, vAcc;
-   int32_t velN, velE, velD, gSpeed, headMot;
-   uint32_t sAcc, headAcc;
-   uint16_t pDOP;
-   uint8_t reserved1[6];
-   int32_t headVeh;
-   union {
-      uint16_t flags3;
-      struct {
-         uint8_t invalidLlh: 1;
-         uint8_t lastCorrectionAge: 4;
-         uint8_t unused: 8;
-         uint8_t authTime: 1;
-         uint8_t nmaFixStatus: 1;
-      };
-   };
-} __attribute__((packed)) ubx_nav_pvt_t;
-
-typedef struct {
-   uint8_t ch;
-   union {
-      uint8_t flags;
-      struct {
-         uint8_t mode: 1;
-         uint8_t run: 1;
-         uint8_t newFallingEdge: 1;
-         uint8_t timeBase: 2;
-         uint8_t utc: 1;
-         uint8_t time: 1;
-         uint8_t newRisingEdge: 1;
-      };
-   };
-   uint16_t count, wnR, wnF;
-   uint32_t towMsR, towSubMsR, towMsF, towSubMsF;
-   int32_t accEst;
-} __attribute__((packed)) ubx_tim_tm2_t;
-#pragma pack(pop)
+// Surveyed node position as persisted in NVS
+typedef struct
+{
+   double lat, lon;
+   float height, horizontal_accuracy, vertical_accuracy;
+} gps_surveyed_position_t;
 
 // Global state variables
 static bool initial_fix_found;
-static ubx_packet_state_t ubx_packet_state;
-static uint8_t gps_rx_buffer[UBX_MAX_PACKET_SIZE];
-static uint16_t gps_rx_idx, gps_rx_len;
-static uint8_t gps_rx_ck_a, gps_rx_ck_b;
+static ubx_parser_t ubx_parser;
 static ubx_nav_pvt_t ubx_nav_pvt_message;
 static ubx_tim_tm2_t ubx_tim_tm2_message;
-static float lat_degrees, lon_degrees, height_meters;
+static double lat_degrees, lon_degrees;
+static float height_meters;
+static float horizontal_accuracy_meters, vertical_accuracy_meters;
 static volatile double requested_timestamp;
+static volatile int64_t timestamp_requested_us, timestamp_resolved_us, returned_requested_us, returned_resolved_us;
+#if GPS_SURVEY_ENABLED
+static survey_t survey;
+static gps_surveyed_position_t surveyed_position;
+static volatile bool position_surveyed, survey_state_changed;
+static uint32_t relocation_checks;
+#endif
+
+static void gps_set_position(double lat, double lon, double height, double horizontal_accuracy, double vertical_accuracy)
+{
+   // Publish the position and its estimated accuracy for inclusion in outgoing packets
+   lat_degrees = lat;
+   lon_degrees = lon;
+   height_meters = (float)height;
+   horizontal_accuracy_meters = (float)horizontal_accuracy;
+   vertical_accuracy_meters = (float)vertical_accuracy;
+}
+
+#if GPS_SURVEY_ENABLED
+
+static void gps_update_survey(void)
+{
+   // Fold every 3D fix into the survey, reporting its running mean once there is one and the latest fix until then
+   const double lat = (double)ubx_nav_pvt_message.lat * 1.0e-7, lon = (double)ubx_nav_pvt_message.lon * 1.0e-7;
+   const double height = (double)ubx_nav_pvt_message.height * 1.0e-3;
+   const double horizontal_accuracy = (double)ubx_nav_pvt_message.hAcc * 1.0e-3, vertical_accuracy = (double)ubx_nav_pvt_message.vAcc * 1.0e-3;
+   if ((ubx_nav_pvt_message.fixType != UBX_FIX_TYPE_3D) ||
+       !survey_update(&survey, (double)esp_timer_get_time() * 1.0e-6, lat, lon, height, horizontal_accuracy, vertical_accuracy))
+   {
+      if (!survey.num_epochs)
+         gps_set_position(lat, lon, height, horizontal_accuracy, vertical_accuracy);
+      return;
+   }
+   double mean_lat, mean_lon, mean_height, mean_horizontal_accuracy, mean_vertical_accuracy;
+   survey_position(&survey, &mean_lat, &mean_lon, &mean_height);
+   survey_accuracy(&survey, &mean_horizontal_accuracy, &mean_vertical_accuracy);
+   gps_set_position(mean_lat, mean_lon, mean_height, mean_horizontal_accuracy, mean_vertical_accuracy);
+
+   // Lock the position once the survey completes, leaving the GPS task to persist it and slow UBX-NAV-PVT down
+   if (survey_complete(&survey))
+   {
+      surveyed_position = (gps_surveyed_position_t){ .lat = mean_lat, .lon = mean_lon, .height = (float)mean_height,
+                                                     .horizontal_accuracy = (float)mean_horizontal_accuracy, .vertical_accuracy = (float)mean_vertical_accuracy };
+      relocation_checks = 0;
+      position_surveyed = survey_state_changed = true;
+   }
+}
 
-// Time conversion helper function
-inline static double tm2_to_gps_timestamp(uint16_t week_number, uint32_t tow_ms, uint32_t tow_sub_ms)
+static void gps_check_surveyed_position(void)
 {
-   return ((double)week_number * 604800.0) + ((double)tow_ms * 0.001) + ((double)tow_sub_ms * 0.000000001);
+   // Keep the surveyed position unless several health-check fixes in a row place the node well away from it, even
+   //    allowing for three times their own reported error, in which case the node was moved and must be surveyed again
+   const double lat = (double)ubx_nav_pvt_message.lat * 1.0e-7, lon = (double)ubx_nav_pvt_message.lon * 1.0e-7;
+   const double horizontal_accuracy = (double)ubx_nav_pvt_message.hAcc * 1.0e-3;
+   const double distance = survey_horizontal_distance_m(surveyed_position.lat, surveyed_position.lon, lat, lon);
+   const bool distant = (ubx_nav_pvt_message.fixType == UBX_FIX_TYPE_3D) && ((distance - (3.0 * horizontal_accuracy)) > GPS_SURVEY_RELOCATION_DISTANCE_M);
+   relocation_checks = distant ? (relocation_checks + 1) : 0;
+   if (relocation_checks >= GPS_SURVEY_RELOCATION_CHECKS)
+   {
+      survey_reset(&survey);
+      relocation_checks = 0;
+      position_surveyed = false;
+      survey_state_changed = true;
+      gps_update_survey();
+   }
 }
 
+#endif  // GPS_SURVEY_ENABLED
 
 // Full UBX message processing function
-static ubx_message_type_t gps_process_message(uint8_t* msg, uint16_t len)
+static ubx_message_type_t gps_process_message(ubx_message_type_t type)
 {
-   // Identify the type of message received and copy it to the appropriate global location
-   if ((msg[UBX_MSG_CLASS_OFFSET] == 0x01) && (msg[UBX_MSG_ID_OFFSET] == 0x07) && (len == sizeof(ubx_nav_pvt_t)))
+   // Copy position and timing messages to the appropriate global location
+   const uint8_t *payload = ubx_parser_payload(&ubx_parser);
+   if (type == UBX_NAV_PVT)
    {
-      memcpy(&ubx_nav_pvt_message, msg, len);
-      if (ubx_nav_pvt_message.gnssFixOK && ((ubx_nav_pvt_message.fixType == FIX_TYPE_3D) || ((ubx_nav_pvt_message.fixType == FIX_TYPE_2D) && !initial_fix_found)))
+      memcpy(&ubx_nav_pvt_message, payload, sizeof(ubx_nav_pvt_message));
+      if (ubx_nav_pvt_message.gnssFixOK && ((ubx_nav_pvt_message.fixType == UBX_FIX_TYPE_3D) || ((ubx_nav_pvt_message.fixType == UBX_FIX_TYPE_2D) && !initial_fix_found)))
       {
-         initial_fix_found |= (ubx_nav_pvt_message.fixType == FIX_TYPE_3D);
-         lat_degrees = (float)ubx_nav_pvt_message.lat * 1.0e-7f;
-         lon_degrees = (float)ubx_nav_pvt_message.lon * 1.0e-7f;
-         height_meters = (float)ubx_nav_pvt_message.height * 1.0e-3f;
+         initial_fix_found |= (ubx_nav_pvt_message.fixType == UBX_FIX_TYPE_3D);
+         if (initial_fix_found)
+            boot_profile_mark(BOOT_PHASE_GPS_FIX);
+#if GPS_SURVEY_ENABLED
+         if (position_surveyed)
+            gps_check_surveyed_position();
+         else
+            gps_update_survey();
+#else
+         gps_set_position((double)ubx_nav_pvt_message.lat * 1.0e-7, (double)ubx_nav_pvt_message.lon * 1.0e-7, (double)ubx_nav_pvt_message.height * 1.0e-3,
+                          (double)ubx_nav_pvt_message.hAcc * 1.0e-3, (double)ubx_nav_pvt_message.vAcc * 1.0e-3);
+#endif
       }
-      return UBX_NAV_PVT;
    }
-   else if ((msg[UBX_MSG_CLASS_OFFSET] == 0x0D) && (msg[UBX_MSG_ID_OFFSET] == 0x03) && (len == sizeof(ubx_tim_tm2_t)))
+   else if (type == UBX_TIM_TM2)
    {
-      memcpy(&ubx_tim_tm2_message, msg, len);
+      memcpy(&ubx_tim_tm2_message, payload, sizeof(ubx_tim_tm2_message));
       if (ubx_tim_tm2_message.time)
       {
+         boot_profile_mark(BOOT_PHASE_GPS_TIME_VALID);
          if (ubx_tim_tm2_message.newRisingEdge)
-            requested_timestamp = tm2_to_gps_timestamp(ubx_tim_tm2_message.wnR, ubx_tim_tm2_message.towMsR, ubx_tim_tm2_message.towSubMsR);
+            requested_timestamp = ubx_tm2_to_gps_timestamp(ubx_tim_tm2_message.wnR, ubx_tim_tm2_message.towMsR, ubx_tim_tm2_message.towSubMsR);
          else if (ubx_tim_tm2_message.newFallingEdge)
-            requested_timestamp = tm2_to_gps_timestamp(ubx_tim_tm2_message.wnF, ubx_tim_tm2_message.towMsF, ubx_tim_tm2_message.towSubMsF);
+            requested_timestamp = ubx_tm2_to_gps_timestamp(ubx_tim_tm2_message.wnF, ubx_tim_tm2_message.towMsF, ubx_tim_tm2_message.towSubMsF);
+         if (ubx_tim_tm2_message.newRisingEdge || ubx_tim_tm2_message.newFallingEdge)
+            timestamp_resolved_us = esp_timer_get_time();
       }
-      return UBX_TIM_TM2;
    }
-   else if ((msg[UBX_MSG_CLASS_OFFSET] == 0x06) && (msg[UBX_MSG_ID_OFFSET] == 0x8B))
-      return UBX_CFG_VALGET;
-   else if ((msg[UBX_MSG_CLASS_OFFSET] == 0x0A) && (msg[UBX_MSG_ID_OFFSET] == 0x04))
-      return UBX_MON_VER;
-   else if ((msg[UBX_MSG_CLASS_OFFSET] == 0x05) && ((msg[UBX_MSG_ID_OFFSET] == 0x00) || (msg[UBX_MSG_ID_OFFSET] == 0x01)))
-      return UBX_ACK_ACK;
-   return UBX_MSG_UNKNOWN;
+   return type;
 }
 
-// UBX message processing state machine
+// UBX message processing loop
 static ubx_message_type_t gps_process_next_char(void)
 {
-   // Process incoming UBX bytes character-by-character
-   static uint8_t rx_byte;
+   // Feed incoming UBX bytes to the parser character-by-character
+   uint8_t rx_byte;
    if (uart_read_bytes(UART_NUM_1, &rx_byte, 1, pdMS_TO_TICKS(1000)) > 0)
    {
-      switch(ubx_packet_state)
-      {
-         case UBX_PACKET_INIT_STATE:
-            if (rx_byte == UBX_SYNC1_CHAR)
-            {
-               ubx_packet_state = UBX_PACKET_SYNC_STATE;
-               gps_rx_idx = gps_rx_ck_a = gps_rx_ck_b = 0;
-                  gps_rx_buffer[gps_rx_idx++] = rx_byte;
-            }
-            break;
-         case UBX_PACKET_SYNC_STATE:
-            if (rx_byte == UBX_SYNC2_CHAR)
-            {
-               gps_rx_buffer[gps_rx_idx++] = rx_byte;
-               ubx_packet_state = UBX_PACKET_CLASS_STATE;
-            }
-            else
-               ubx_packet_state = UBX_PACKET_INIT_STATE;
-            break;
-         case UBX_PACKET_CLASS_STATE:
-            gps_rx_buffer[gps_rx_idx++] = rx_byte;
-            gps_rx_ck_a += rx_byte;
-            gps_rx_ck_b += gps_rx_ck_a;
-            ubx_packet_state = UBX_PACKET_ID_STATE;
-            break;
-         case UBX_PACKET_ID_STATE:
-            gps_rx_buffer[gps_rx_idx++] = rx_byte;
-            gps_rx_ck_a += rx_byte;
-            gps_rx_ck_b += gps_rx_ck_a;
-            ubx_packet_state = UBX_PACKET_LEN1_STATE;
-            break;
-         case UBX_PACKET_LEN1_STATE:
-            gps_rx_buffer[gps_rx_idx++] = rx_byte;
-            gps_rx_ck_a += rx_byte;
-            gps_rx_ck_b += gps_rx_ck_a;
-            gps_rx_len = rx_byte;
-            ubx_packet_state = UBX_PACKET_LEN2_STATE;
-            break;
-         case UBX_PACKET_LEN2_STATE:
-            gps_rx_buffer[gps_rx_idx++] = rx_byte;
-            gps_rx_ck_a += rx_byte;
-            gps_rx_ck_b += gps_rx_ck_a;
-            gps_rx_len |= (rx_byte << 8);
-            if (gps_rx_len > 0)
-               ubx_packet_state = UBX_PACKET_PAYLOAD_STATE;
-            else
-               ubx_packet_state = UBX_PACKET_CK_A_STATE;
-            break;
-         case UBX_PACKET_PAYLOAD_STATE:
-            if ((gps_rx_idx - UBX_MSG_PAYLOAD_OFFSET) < UBX_MAX_PAYLOAD_SIZE)
-            {
-               gps_rx_buffer[gps_rx_idx++] = rx_byte;
-               gps_rx_ck_a += rx_byte;
-               gps_rx_ck_b += gps_rx_ck_a;
-            }
-            if ((gps_rx_idx - UBX_MSG_PAYLOAD_OFFSET) == gps_rx_len)
-               ubx_packet_state = UBX_PACKET_CK_A_STATE;
-            break;
-         case UBX_PACKET_CK_A_STATE:
-            if (gps_rx_ck_a != rx_byte)
-               ubx_packet_state = UBX_PACKET_INIT_STATE;
-            else
-            {
-               gps_rx_buffer[gps_rx_idx++] = rx_byte;
-               ubx_packet_state = UBX_PACKET_CK_B_STATE;
-            }
-            break;
-         case UBX_PACKET_CK_B_STATE:
-            if (gps_rx_ck_b == rx_byte)
-            {
-               gps_rx_buffer[gps_rx_idx++] = rx_byte;
-               return gps_process_message(gps_rx_buffer, gps_rx_idx);
-            }
-            ubx_packet_state = UBX_PACKET_INIT_STATE;
-            break;
-         default:
-            ubx_packet_state = UBX_PACKET_INIT_STATE;
-      }
+      const ubx_message_type_t type = ubx_parser_consume(&ubx_parser, rx_byte);
+      if (type != UBX_MSG_NONE)
+         return gps_process_message(type);
    }
-   return UBX_MSG_UNKNOWN;
+   return UBX_MSG_NONE;
 }
 
 static void gps_reset(void)
@@ -341,7 +232,7 @@ static void gps_wait_until_ready(void)
 {
    // Test the communication interface by polling the UBX-MON-VER message
    uart_flush(UART_NUM_1);
-   ubx_packet_state = UBX_PACKET_INIT_STATE;
+   ubx_parser_init(&ubx_parser);
    const uint8_t ubx_mon_ver[] = {UBX_SYNC, UBX_MON_VER_MSG, 0, 0, UBX_MON_VER_CHKSUM};
    uart_write_bytes(UART_NUM_1, ubx_mon_ver, sizeof(ubx_mon_ver));
    while (gps_process_next_char() != UBX_MON_VER);
@@ -353,7 +244,7 @@ static lna_gain_t gps_get_lna_gain(void)
    const uint8_t ubx_valget_lna[] = {UBX_SYNC, UBX_CFG_VALGET_MSG, 0x08, 0x00, UBX_CFG_VALGET_BEGIN, UBX_GET_LNA_DATA, UBX_GET_LNA_CHKSUM};
    uart_write_bytes(UART_NUM_1, ubx_valget_lna, sizeof(ubx_valget_lna));
    while (gps_process_next_char() != UBX_CFG_VALGET);
-   return (lna_gain_t)gps_rx_buffer[UBX_MSG_PAYLOAD_OFFSET + LNA_MSG_GAIN_OFFSET];
+   return (lna_gain_t)ubx_parser_payload(&ubx_parser)[LNA_MSG_GAIN_OFFSET];
 }
 
 static void gps_set_lna_gain(void)
@@ -449,6 +340,79 @@ static void gps_verify_or_set_configuration(void)
    }
 }
 
+#if GPS_SURVEY_ENABLED
+
+static void gps_set_position_rate(uint8_t navigation_epochs)
+{
+   // Output UBX-NAV-PVT once every given number of navigation epochs (RAM layer only, so that a power cycle restores
+   //    the 1 Hz rate until the stored survey is reloaded), leaving UBX-TIM-TM2 untouched
+   const uint8_t valset_payload[] = {UBX_CFG_VALSET_RAM_BEGIN, UBX_NAV_PVT_UART1_RATE_KEY, navigation_epochs};
+   uint8_t ubx_nav_pvt_rate_set[UBX_PACKET_OVERHEAD + sizeof(valset_payload)];
+   const uint16_t packet_len = ubx_frame_message(UBX_CFG_VALSET_MSG, valset_payload, sizeof(valset_payload), ubx_nav_pvt_rate_set);
+   uart_write_bytes(UART_NUM_1, ubx_nav_pvt_rate_set, packet_len);
+   while (gps_process_next_char() != UBX_ACK_ACK);
+}
+
+static bool gps_open_storage(nvs_handle_t *storage)
+{
+   // The GPS task starts before the main task initializes NVS, so wait for it if necessary
+   esp_err_t err;
+   while ((err = nvs_open(GPS_SURVEY_NVS_NAMESPACE, NVS_READWRITE, storage)) == ESP_ERR_NVS_NOT_INITIALIZED)
+      vTaskDelay(pdMS_TO_TICKS(100));
+   return err == ESP_OK;
+}
+
+static void gps_load_surveyed_position(void)
+{
+   // Lock the position surveyed before the last restart, if any, and go straight to health-check fixes
+   nvs_handle_t storage;
+   size_t stored_len = sizeof(surveyed_position);
+   if (!gps_open_storage(&storage))
+      return;
+   if ((nvs_get_blob(storage, GPS_SURVEY_NVS_KEY, &surveyed_position, &stored_len) == ESP_OK) && (stored_len == sizeof(surveyed_position)))
+   {
+      gps_set_position(surveyed_position.lat, surveyed_position.lon, surveyed_position.height,
+                       surveyed_position.horizontal_accuracy, surveyed_position.vertical_accuracy);
+      position_surveyed = true;
+      gps_set_position_rate(GPS_SURVEY_HEALTH_CHECK_SECONDS);
+      print("GPS: Using stored surveyed position <%0.7f, %0.7f, %0.3f> (+/-%0.2f m horizontal, +/-%0.2f m vertical)", surveyed_position.lat,
+            surveyed_position.lon, surveyed_position.height, surveyed_position.horizontal_accuracy, surveyed_position.vertical_accuracy);
+   }
+   nvs_close(storage);
+}
+
+static void gps_apply_survey_state(void)
+{
+   // Persist a newly completed survey and slow UBX-NAV-PVT to a health check, or forget a survey invalidated by relocation
+   //    and return UBX-NAV-PVT to every navigation epoch
+   nvs_handle_t storage;
+   survey_state_changed = false;
+   const bool storage_open = gps_open_storage(&storage);
+   if (position_surveyed)
+   {
+      print("GPS: Survey complete after %lu fixes, locked position <%0.7f, %0.7f, %0.3f> (+/-%0.2f m horizontal, +/-%0.2f m vertical)",
+            survey.num_epochs, surveyed_position.lat, surveyed_position.lon, surveyed_position.height,
+            surveyed_position.horizontal_accuracy, surveyed_position.vertical_accuracy);
+      if (storage_open)
+         nvs_set_blob(storage, GPS_SURVEY_NVS_KEY, &surveyed_position, sizeof(surveyed_position));
+      gps_set_position_rate(GPS_SURVEY_HEALTH_CHECK_SECONDS);
+   }
+   else
+   {
+      printw("GPS: Fixes no longer agree with the surveyed position, restarting the survey");
+      if (storage_open)
+         nvs_erase_key(storage, GPS_SURVEY_NVS_KEY);
+      gps_set_position_rate(1);
+   }
+   if (storage_open)
+   {
+      nvs_commit(storage);
+      nvs_close(storage);
+   }
+}
+
+#endif  // GPS_SURVEY_ENABLED
+
 static void gps_init(void)
 {
    // Set up the GPIO pins for the GPS module
@@ -489,9 +453,10 @@ static void gps_init(void)
    uart_set_pin(UART_NUM_1, GPS_TX_PIN, GPS_RX_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
    uart_flush(UART_NUM_1);
 
-   // Ensure that the GPS is in its default startup configuration
+   // Ensure that the GPS is in its default startup configuration, which it already is if both were just powered on
    requested_timestamp = 0.0;
-   gps_reset();
+   if (esp_reset_reason() != ESP_RST_POWERON)
+      gps_reset();
 
    // Loop to ensure that all configuration parameters requiring a reset are correctly set
    bool was_reset = true;
@@ -499,6 +464,7 @@ static void gps_init(void)
    {
       // Ensure that the internal GPS LNA gain is in the correct state
       gps_wait_until_ready();
+      boot_profile_mark(BOOT_PHASE_GPS_RESPONDING);
       if (gps_get_lna_gain() != LNA_GAIN_NORMAL)
       {
          gps_set_lna_gain();
@@ -516,6 +482,7 @@ static void gps_init(void)
 
    // Validate all non-reset-requiring configuration parameters
    gps_verify_or_set_configuration();
+   boot_profile_mark(BOOT_PHASE_GPS_CONFIGURED);
 }
 
 gps_timestamp_t gps_request_timestamp(void)
@@ -524,6 +491,10 @@ gps_timestamp_t gps_request_timestamp(void)
    static uint32_t next_extint_level = 1;
    gps_timestamp_t gps_timestamp = { .gps_timestamp = requested_timestamp };
    requested_timestamp = 0.0;
+   returned_requested_us = timestamp_requested_us;
+   returned_resolved_us = timestamp_resolved_us;
+   timestamp_resolved_us = 0;
+   timestamp_requested_us = esp_timer_get_time();
    gpio_set_level(GPS_EXTINT_PIN, next_extint_level);
    next_extint_level = !next_extint_level;
 
@@ -531,20 +502,57 @@ gps_timestamp_t gps_request_timestamp(void)
    return gps_timestamp;
 }
 
-void gps_get_llh(float *lat, float *lon, float *ht)
+void gps_get_timestamp_latency(int64_t *requested_us, int64_t *resolved_us)
+{
+   // Return when the timestamp most recently handed out was requested and when the GPS module reported it, if it did
+   *requested_us = returned_requested_us;
+   *resolved_us = returned_resolved_us;
+}
+
+void gps_get_llh(double *lat, double *lon, float *ht)
 {
-   // Return the most recently received GPS position
+   // Return the surveyed position once locked, otherwise the survey's running mean or most recent fix
    *lat = lat_degrees;
    *lon = lon_degrees;
    *ht = height_meters;
 }
 
+bool gps_get_llh_accuracy(float *horizontal, float *vertical)
+{
+   // Return the estimated error of the position above, and whether it is a completed survey
+   *horizontal = horizontal_accuracy_meters;
+   *vertical = vertical_accuracy_meters;
+#if GPS_SURVEY_ENABLED
+   return position_surveyed;
+#else
+   return false;
+#endif
+}
+
 void gps_task(void *args)
 {
-   // Initialize the GPS module
+   // Initialize the GPS module and restore any previously surveyed position
    gps_init();
+#if GPS_SURVEY_ENABLED
+   survey_init(&survey, GPS_SURVEY_TARGET_ACCURACY_M, GPS_SURVEY_MIN_DURATION_SECONDS);
+   gps_load_surveyed_position();
+#endif
 
-   // Loop forever listening for GPS messages
+   // Loop forever listening for GPS messages, acting on survey completion or relocation between messages
    while (true)
+   {
       gps_process_next_char();
+#if GPS_SURVEY_ENABLED
+      if (survey_state_changed)
+      {
+         // Persisting the survey is the deepest call chain this task runs, so check the stack headroom it left behind
+         gps_apply_survey_state();
+         const UBaseType_t stack_free = uxTaskGetStackHighWaterMark(NULL);
+         if (stack_free < GPS_STACK_MIN_FREE_BYTES)
+            printw("GPS: Task stack nearly exhausted, only %u of %u bytes left unused", stack_free, GPS_STACK_SIZE_BYTES);
+         else
+            print("GPS: Task stack high-water mark leaves %u of %u bytes free", stack_free, GPS_STACK_SIZE_BYTES);
+      }
+#endif
+   }
 }
@@ -1,12 +1,16 @@
 #ifndef __GPS_HEADER_H__
 #define __GPS_HEADER_H__
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "app_config.h"
 
 typedef union { double gps_timestamp; uint32_t timestamp_parts[2]; } gps_timestamp_t;
 
 void gps_task(void *args);
 gps_timestamp_t gps_request_timestamp(void);
-void gps_get_llh(float *lat, float *lon, float *ht);
+void gps_get_timestamp_latency(int64_t *requested_us, int64_t *resolved_us);
+void gps_get_llh(double *lat, double *lon, float *ht);
+bool gps_get_llh_accuracy(float *horizontal, float *vertical);
 
 #endif  // __GPS_HEADER_H__
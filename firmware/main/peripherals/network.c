@@ -1,12 +1,179 @@
+#include <errno.h>
+#include <freertos/FreeRTOS.h>
+#include <lwip/sockets.h>
+#include "commands.h"
+#include "fec.h"
+#include "logging.h"
 #include "network.h"
 
-//static QueueHandle_t data_queue;
+#define NETWORK_IP_ACQUIRED_BIT        BIT0
+#define NETWORK_CONNECTED_BIT          BIT1
 
-// INIT: data_queue = xQueueCreate(5, sizeof(usb_data_t));
-// TO SEND: xQueueSend(data_queue, &packet, 0);
-// TO RECEIVE: usb_data_t packet;packet.data_len = 0;if (xQueueReceive(usb_data_queue, &packet, portMAX_DELAY) && packet.data_len)
+// Static global variables
+static EventGroupHandle_t network_event_group;
+static SemaphoreHandle_t network_write_mutex;
+static volatile int network_socket, network_udp_socket;
+static uint16_t network_tcp_sequence, network_udp_sequence;
+static fec_encoder_t network_fec_encoder;
+
+static void network_disconnect(void)
+{
+   // Shut down the socket so that the receiving task notices and reconnects
+   xEventGroupClearBits(network_event_group, NETWORK_CONNECTED_BIT);
+   if (network_socket >= 0)
+      shutdown(network_socket, SHUT_RDWR);
+}
+
+static bool network_write_data(const uint8_t *data, size_t data_len)
+{
+   // Send bytes to the socket until all bytes have been written or an error occurs
+   while (data_len)
+   {
+      const int bytes_written = send(network_socket, data, data_len, 0);
+      if (bytes_written <= 0)
+      {
+         network_disconnect();
+         return false;
+      }
+      data_len -= bytes_written;
+      data += bytes_written;
+   }
+   return true;
+}
+
+static void network_send_datagram(void *context, const uint8_t *datagram, size_t datagram_len)
+{
+   // Hand a datagram to lwIP, briefly waiting out exhausted buffers since a burst of one audio block can outrun them
+   for (uint32_t retries = 0; (send(network_udp_socket, datagram, datagram_len, 0) < 0) && (errno == ENOMEM) && (retries < NETWORK_UDP_SEND_RETRIES); ++retries)
+      vTaskDelay(1);
+}
+
+static int network_connect(int type, int protocol)
+{
+   // Open a connection (or, for UDP, fix the destination) to the data collection server
+   struct sockaddr_in server_address = {
+      .sin_family = AF_INET,
+      .sin_port = htons(NETWORK_SERVER_PORT),
+   };
+   inet_pton(AF_INET, NETWORK_SERVER_ADDRESS, &server_address.sin_addr);
+   int sock = socket(AF_INET, type, protocol);
+   if (sock < 0)
+      return -1;
+   const struct timeval send_timeout = { .tv_sec = NETWORK_SEND_TIMEOUT_MS / 1000, .tv_usec = (NETWORK_SEND_TIMEOUT_MS % 1000) * 1000 };
+   setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+   if (connect(sock, (struct sockaddr*)&server_address, sizeof(server_address)) != 0)
+   {
+      close(sock);
+      return -1;
+   }
+   return sock;
+}
+
+static void network_task(void *args)
+{
+   // Maintain a connection to the server whenever an IP address is available
+   static uint8_t rx_buffer[NETWORK_RX_BUFFER_SIZE];
+   while (true)
+   {
+      xEventGroupWaitBits(network_event_group, NETWORK_IP_ACQUIRED_BIT, pdFALSE, pdTRUE, portMAX_DELAY);
+      const int sock = network_connect(SOCK_STREAM, IPPROTO_TCP);
+      if (sock < 0)
+      {
+         vTaskDelay(pdMS_TO_TICKS(NETWORK_RECONNECT_DELAY_MS));
+         continue;
+      }
+      print("Connected to server at %s:%d", NETWORK_SERVER_ADDRESS, NETWORK_SERVER_PORT);
+      network_socket = sock;
+      if (NETWORK_UDP_AUDIO_ENABLED)
+         network_udp_socket = network_connect(SOCK_DGRAM, IPPROTO_UDP);
+      xEventGroupSetBits(network_event_group, NETWORK_CONNECTED_BIT);
+
+      // Forward all received data to the command processor until the connection drops
+      int bytes_read;
+      while ((bytes_read = recv(sock, rx_buffer, sizeof(rx_buffer), 0)) > 0)
+         commands_process_data(COMMAND_SOURCE_NETWORK, rx_buffer, bytes_read);
+      printw("Lost connection to server");
+      xEventGroupClearBits(network_event_group, NETWORK_CONNECTED_BIT);
+      xSemaphoreTake(network_write_mutex, portMAX_DELAY);
+      network_socket = -1;
+      close(sock);
+      if (network_udp_socket >= 0)
+         close(network_udp_socket);
+      network_udp_socket = -1;
+      xSemaphoreGive(network_write_mutex);
+   }
+}
 
 void network_initialize(void)
 {
-  ;
+   // Initialize all static variables and start the connection management task
+   network_socket = network_udp_socket = -1;
+   network_tcp_sequence = network_udp_sequence = 0;
+   fec_encoder_init(&network_fec_encoder, NETWORK_FEC_SOURCE_SHARDS, NETWORK_FEC_PARITY_SHARDS, NETWORK_FEC_SHARD_BYTES, network_send_datagram, NULL);
+   network_event_group = xEventGroupCreate();
+   network_write_mutex = xSemaphoreCreateMutex();
+   xTaskCreatePinnedToCore(network_task, "network_task", 3072, NULL, 5, NULL, 0);
+}
+
+void network_set_ip_acquired(bool acquired)
+{
+   // Allow or prevent server connection attempts based on the Wi-Fi state
+   if (acquired)
+      xEventGroupSetBits(network_event_group, NETWORK_IP_ACQUIRED_BIT);
+   else
+   {
+      xEventGroupClearBits(network_event_group, NETWORK_IP_ACQUIRED_BIT);
+      network_disconnect();
+   }
+}
+
+bool network_is_connected(void)
+{
+   // Return whether a server connection is currently established
+   return (xEventGroupGetBits(network_event_group) & NETWORK_CONNECTED_BIT) != 0;
+}
+
+bool network_write_packet(packet_type_t type, uint8_t flags, const void *header, size_t header_len, const uint8_t *data, size_t data_len)
+{
+   // Write a framed packet atomically with respect to other writing tasks
+   bool success = false;
+   packet_header_t packet_header;
+   if (!network_is_connected())
+      return false;
+   xSemaphoreTake(network_write_mutex, portMAX_DELAY);
+   if ((network_udp_socket >= 0) && ((type == PACKET_TYPE_AUDIO) || (type == PACKET_TYPE_AUDIO_DECIMATED)))
+   {
+      // Stream audio over UDP where a lost datagram is rebuilt from parity rather than stalling everything behind it,
+      //    treating the block as delivered while the TCP connection shows that the server is reachable, and numbering
+      //    datagrams separately from the TCP stream so that a gap in either sequence reflects only its own transport
+      packet_init_header(&packet_header, type, network_udp_sequence++, header_len + data_len);
+      packet_header.flags = flags;
+      fec_encoder_write(&network_fec_encoder, (const uint8_t*)&packet_header, sizeof(packet_header));
+      fec_encoder_write(&network_fec_encoder, (const uint8_t*)header, header_len);
+      fec_encoder_write(&network_fec_encoder, data, data_len);
+      fec_encoder_end_packet(&network_fec_encoder);
+      success = true;
+   }
+   else if (network_socket >= 0)
+   {
+      packet_init_header(&packet_header, type, network_tcp_sequence++, header_len + data_len);
+      packet_header.flags = flags;
+      success = network_write_data((const uint8_t*)&packet_header, sizeof(packet_header)) &&
+                network_write_data((const uint8_t*)header, header_len) && network_write_data(data, data_len);
+   }
+   xSemaphoreGive(network_write_mutex);
+   return success;
+}
+
+bool network_write_framed_packet(const uint8_t *packet, size_t packet_len)
+{
+   // Write a packet which already includes its framing header
+   bool success = false;
+   if (!network_is_connected())
+      return false;
+   xSemaphoreTake(network_write_mutex, portMAX_DELAY);
+   if (network_socket >= 0)
+      success = network_write_data(packet, packet_len);
+   xSemaphoreGive(network_write_mutex);
+   return success;
 }
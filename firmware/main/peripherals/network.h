@@ -2,7 +2,12 @@
 #define __NETWORK_HEADER_H__
 
 #include "app_config.h"
+#include "packet.h"
 
 void network_initialize(void);
+void network_set_ip_acquired(bool acquired);
+bool network_is_connected(void);
+bool network_write_packet(packet_type_t type, uint8_t flags, const void *header, size_t header_len, const uint8_t *data, size_t data_len);
+bool network_write_framed_packet(const uint8_t *packet, size_t packet_len);
 
 #endif // __NETWORK_HEADER_H__
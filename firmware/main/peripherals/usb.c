@@ -3,7 +3,154 @@
 #include <tusb_cdc_acm.h>
 #include "usb.h"
 
+#if USB_VENDOR_TRANSPORT_ENABLED
+
+#include <device/usbd_pvt.h>
+
+// Composite configuration: CDC-ACM for the console and commands, alongside a vendor-specific interface whose single bulk
+//    IN endpoint carries every framed packet
+enum { USB_ITF_CDC = 0, USB_ITF_CDC_DATA, USB_ITF_BULK, USB_ITF_COUNT };
+
+#define USB_EP_CDC_NOTIFY                    0x81
+#define USB_EP_CDC_OUT                       0x02
+#define USB_EP_CDC_IN                        0x82
+#define USB_EP_BULK_IN                       0x83
+#define USB_BULK_PACKET_SIZE                 64
+#define USB_BULK_DESC_LEN                    (9 + 7)
+#define USB_CONFIG_TOTAL_LEN                 (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + USB_BULK_DESC_LEN)
+
+static const uint8_t usb_configuration_descriptor[] = {
+   TUD_CONFIG_DESCRIPTOR(1, USB_ITF_COUNT, 0, USB_CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+   TUD_CDC_DESCRIPTOR(USB_ITF_CDC, 4, USB_EP_CDC_NOTIFY, 8, USB_EP_CDC_OUT, USB_EP_CDC_IN, 64),
+   9, TUSB_DESC_INTERFACE, USB_ITF_BULK, 0, 1, TUSB_CLASS_VENDOR_SPECIFIC, 0x00, 0x00, 0,
+   7, TUSB_DESC_ENDPOINT, USB_EP_BULK_IN, TUSB_XFER_BULK, U16_TO_U8S_LE(USB_BULK_PACKET_SIZE), 0
+};
+
+// Double-buffered staging in internal RAM, where the USB DMA can reach it, so that one buffer fills while the other is
+//    being transferred
+static uint8_t usb_bulk_buffers[2][USB_BULK_TRANSFER_BYTES] __attribute__((aligned(4)));
+static uint32_t usb_bulk_fill, usb_bulk_index;
+static uint8_t usb_bulk_endpoint;
+static volatile bool usb_bulk_opened, usb_bulk_stalled;
+static SemaphoreHandle_t usb_bulk_idle;
+
+#endif
+
 static usb_data_callback_t usb_data_callback;
+static SemaphoreHandle_t usb_write_mutex;
+static uint16_t usb_packet_sequence;
+
+#if USB_VENDOR_TRANSPORT_ENABLED
+
+static void usb_bulk_init(void) {}
+
+static void usb_bulk_reset(uint8_t rhport)
+{
+   // Any transfer in flight is abandoned by a bus reset
+   usb_bulk_opened = false;
+}
+
+static uint16_t usb_bulk_open(uint8_t rhport, const tusb_desc_interface_t *interface, uint16_t max_len)
+{
+   // Claim only the vendor-specific interface, opening its bulk endpoint
+   const uint16_t length = sizeof(tusb_desc_interface_t) + sizeof(tusb_desc_endpoint_t);
+   if ((interface->bInterfaceClass != TUSB_CLASS_VENDOR_SPECIFIC) || (interface->bNumEndpoints != 1) || (max_len < length))
+      return 0;
+   const tusb_desc_endpoint_t *endpoint = (const tusb_desc_endpoint_t*)tu_desc_next(interface);
+   if (!usbd_edpt_open(rhport, endpoint))
+      return 0;
+   usb_bulk_endpoint = endpoint->bEndpointAddress;
+   usb_bulk_stalled = false;
+   xSemaphoreGive(usb_bulk_idle);
+   usb_bulk_opened = true;
+   return length;
+}
+
+static bool usb_bulk_control_xfer_cb(uint8_t rhport, uint8_t stage, const tusb_control_request_t *request)
+{
+   // The interface has no class or vendor requests
+   return false;
+}
+
+static bool usb_bulk_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+   // Let the writer start its next transfer, resuming normal waits if the host had stopped reading
+   if (ep_addr != usb_bulk_endpoint)
+      return false;
+   usb_bulk_stalled = false;
+   xSemaphoreGive(usb_bulk_idle);
+   return true;
+}
+
+static const usbd_class_driver_t usb_bulk_driver = {
+#if CFG_TUSB_DEBUG >= 2
+   .name = "civicalert_bulk",
+#endif
+   .init = usb_bulk_init,
+   .reset = usb_bulk_reset,
+   .open = usb_bulk_open,
+   .control_xfer_cb = usb_bulk_control_xfer_cb,
+   .xfer_cb = usb_bulk_xfer_cb,
+   .sof = NULL
+};
+
+const usbd_class_driver_t* usbd_app_driver_get_cb(uint8_t *driver_count)
+{
+   // Offer the bulk interface driver to TinyUSB ahead of its built-in classes
+   *driver_count = 1;
+   return &usb_bulk_driver;
+}
+
+static void usb_bulk_submit(uint32_t length)
+{
+   // Transfer the current staging buffer once the previous transfer completes, or drop its contents if the host is not
+   //    reading, waiting only briefly the first time so that an absent reader cannot hold up every writer
+   const TickType_t timeout = usb_bulk_stalled ? 0 : pdMS_TO_TICKS(USB_BULK_TIMEOUT_MS);
+   if (usb_bulk_opened && (xSemaphoreTake(usb_bulk_idle, timeout) == pdTRUE))
+   {
+      if (usbd_edpt_claim(0, usb_bulk_endpoint))
+      {
+         if (usbd_edpt_xfer(0, usb_bulk_endpoint, usb_bulk_buffers[usb_bulk_index], length))
+            usb_bulk_index ^= 1;
+         else
+         {
+            usbd_edpt_release(0, usb_bulk_endpoint);
+            xSemaphoreGive(usb_bulk_idle);
+         }
+      }
+      else
+         xSemaphoreGive(usb_bulk_idle);
+   }
+   else if (usb_bulk_opened)
+      usb_bulk_stalled = true;
+   usb_bulk_fill = 0;
+}
+
+static void usb_bulk_write(const uint8_t *data, size_t data_len)
+{
+   // Append data to the staging buffer, starting a transfer each time one fills
+   while (data_len)
+   {
+      const size_t length = ((USB_BULK_TRANSFER_BYTES - usb_bulk_fill) < data_len) ? (USB_BULK_TRANSFER_BYTES - usb_bulk_fill) : data_len;
+      memcpy(usb_bulk_buffers[usb_bulk_index] + usb_bulk_fill, data, length);
+      usb_bulk_fill += length;
+      data += length;
+      data_len -= length;
+      if (usb_bulk_fill == USB_BULK_TRANSFER_BYTES)
+         usb_bulk_submit(usb_bulk_fill);
+   }
+}
+
+static void usb_bulk_flush(void)
+{
+   // End every packet with a short (or zero-length) transfer so that the host's read completes without waiting for more
+   const uint32_t length = usb_bulk_fill;
+   usb_bulk_submit(length);
+   if (length && !(length % USB_BULK_PACKET_SIZE))
+      usb_bulk_submit(0);
+}
+
+#endif
 
 static void rx_callback(int itf, cdcacm_event_t*)
 {
@@ -18,6 +165,13 @@ void usb_initialize(bool self_powered)
 {
    // Initialize all static variables
    usb_data_callback = NULL;
+   usb_packet_sequence = 0;
+   usb_write_mutex = xSemaphoreCreateMutex();
+#if USB_VENDOR_TRANSPORT_ENABLED
+   usb_bulk_fill = usb_bulk_index = 0;
+   usb_bulk_opened = usb_bulk_stalled = false;
+   usb_bulk_idle = xSemaphoreCreateBinary();
+#endif
 
    // Configure a GPIO pin for VBUS monitoring
    if (self_powered)
@@ -32,13 +186,17 @@ void usb_initialize(bool self_powered)
       ESP_ERROR_CHECK(gpio_config(&vbus_gpio_config));
    }
 
-   // Install the TinyUSB driver
+   // Install the TinyUSB driver, adding the bulk interface to the default CDC-only configuration if enabled
    const tinyusb_config_t usb_config = {
       .device_descriptor = NULL,
       .string_descriptor = NULL,
       .string_descriptor_count = 0,
       .external_phy = false,
+#if USB_VENDOR_TRANSPORT_ENABLED
+      .configuration_descriptor = usb_configuration_descriptor,
+#else
       .configuration_descriptor = NULL,
+#endif
       .self_powered = self_powered,
       .vbus_monitor_io = USB_VBUS_MONITOR_PIN
    };
@@ -76,14 +234,29 @@ void usb_write_data(const uint8_t *data, size_t data_len)
       tud_cdc_write_clear();
 }
 
-void usb_write_audio_packet(double timestamp, float lat, float lon, float height, const uint8_t *audio, size_t audio_len)
+void usb_write_packet(packet_type_t type, uint8_t flags, const void *header, size_t header_len, const uint8_t *data, size_t data_len)
 {
-   // Write a packet delimiter, timestamp, and audio data to the USB queue
-   static const uint8_t usb_packet_delimiter[] = USB_PACKET_DELIMITER;
-   usb_write_data((const uint8_t*)&usb_packet_delimiter, sizeof(usb_packet_delimiter));
-   usb_write_data((const uint8_t*)&timestamp, sizeof(timestamp));
-   usb_write_data((const uint8_t*)&lat, sizeof(lat));
-   usb_write_data((const uint8_t*)&lon, sizeof(lon));
-   usb_write_data((const uint8_t*)&height, sizeof(height));
-   usb_write_data(audio, audio_len);
-}
\ No newline at end of file
+   // Write a framed packet atomically with respect to other writing tasks, over the bulk interface if enabled
+   packet_header_t packet_header;
+   xSemaphoreTake(usb_write_mutex, portMAX_DELAY);
+   packet_init_header(&packet_header, type, usb_packet_sequence++, header_len + data_len);
+   packet_header.flags = flags;
+#if USB_VENDOR_TRANSPORT_ENABLED
+   usb_bulk_write((const uint8_t*)&packet_header, sizeof(packet_header));
+   usb_bulk_write((const uint8_t*)header, header_len);
+   usb_bulk_write(data, data_len);
+   usb_bulk_flush();
+#else
+   usb_write_data((const uint8_t*)&packet_header, sizeof(packet_header));
+   usb_write_data((const uint8_t*)header, header_len);
+   usb_write_data(data, data_len);
+#endif
+   xSemaphoreGive(usb_write_mutex);
+}
+
+void usb_write_audio_packet(double timestamp, double lat, double lon, float height, const uint8_t *audio, size_t audio_len)
+{
+   // Write a packet containing the timestamp, location, and audio data to the USB queue
+   const packet_audio_t audio_header = { .timestamp = timestamp, .lat = lat, .lon = lon, .height = height };
+   usb_write_packet(PACKET_TYPE_AUDIO, 0, &audio_header, sizeof(audio_header), audio, audio_len);
+}
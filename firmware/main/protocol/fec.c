@@ -0,0 +1,399 @@
+#include <string.h>
+#include "fec.h"
+
+// GF(2^8) tables for the polynomial x^8 + x^4 + x^3 + x^2 + 1, with the exponentials doubled so products need no modulo
+static uint8_t fec_exp[510], fec_log[256];
+static bool fec_tables_ready = false;
+
+static void fec_initialize_tables(void)
+{
+   // Powers of the generator 2 and their inverse mapping
+   if (fec_tables_ready)
+      return;
+   uint32_t value = 1;
+   for (uint32_t i = 0; i < 255; ++i)
+   {
+      fec_exp[i] = fec_exp[i + 255] = (uint8_t)value;
+      fec_log[value] = (uint8_t)i;
+      value <<= 1;
+      if (value & 0x100)
+         value ^= 0x11D;
+   }
+   fec_tables_ready = true;
+}
+
+static inline uint8_t fec_multiply(uint8_t a, uint8_t b)
+{
+   return (a && b) ? fec_exp[fec_log[a] + fec_log[b]] : 0;
+}
+
+static inline uint8_t fec_divide(uint8_t a, uint8_t b)
+{
+   return a ? fec_exp[fec_log[a] + 255 - fec_log[b]] : 0;
+}
+
+static uint8_t fec_coefficient(uint32_t parity, uint32_t source)
+{
+   // Cauchy matrix 1 / (x_j + y_i) with x_j = j and y_i = FEC_MAX_PARITY_SHARDS + i, its columns scaled so that the first
+   //    parity shard is the plain XOR of the group; every square submatrix stays invertible, so any "num_parity" parity
+   //    shards can stand in for any as many lost source shards
+   const uint8_t y = (uint8_t)(FEC_MAX_PARITY_SHARDS + source);
+   return fec_divide(y, (uint8_t)(parity ^ y));
+}
+
+static void fec_multiply_add(uint8_t *destination, const uint8_t *source, size_t len, uint8_t coefficient)
+{
+   // destination += coefficient * source, through a product table built for this coefficient
+   if (coefficient == 1)
+   {
+      for (size_t i = 0; i < len; ++i)
+         destination[i] ^= source[i];
+      return;
+   }
+   uint8_t product[256];
+   product[0] = 0;
+   for (uint32_t v = 1; v < 256; ++v)
+      product[v] = fec_exp[fec_log[v] + fec_log[coefficient]];
+   for (size_t i = 0; i < len; ++i)
+      destination[i] ^= product[source[i]];
+}
+
+static void fec_send_parity(fec_encoder_t *encoder, uint8_t num_source)
+{
+   // Send the group's parity shards in the datagram buffer, which is free once its last source shard has gone
+   fec_header_t *header = (fec_header_t*)encoder->datagram;
+   for (uint8_t j = 0; j < encoder->num_parity; ++j)
+   {
+      *header = (fec_header_t){ .group = encoder->group, .index = num_source + j, .num_source = num_source, .num_parity = encoder->num_parity };
+      memcpy(encoder->datagram + sizeof(fec_header_t), encoder->parity[j], encoder->parity_len);
+      encoder->send(encoder->context, encoder->datagram, sizeof(fec_header_t) + encoder->parity_len);
+      memset(encoder->parity[j], 0, encoder->parity_len);
+   }
+   encoder->parity_len = 0;
+}
+
+static void fec_send_shard(fec_encoder_t *encoder, bool last)
+{
+   // Send the filled shard at once, then fold it into the group's parity
+   const uint8_t index = encoder->num_sent;
+   last = last || ((index + 1) == encoder->num_source);
+   fec_header_t *header = (fec_header_t*)encoder->datagram;
+   uint8_t *coded = encoder->datagram + sizeof(fec_header_t);
+   const uint16_t prefix = encoder->fill | (encoder->packet_start ? FEC_PREFIX_PACKET_START : 0), coded_len = FEC_PREFIX_BYTES + encoder->fill;
+   *header = (fec_header_t){ .group = encoder->group, .index = index, .num_source = last ? (index + 1) : 0, .num_parity = encoder->num_parity };
+   coded[0] = (uint8_t)prefix;
+   coded[1] = (uint8_t)(prefix >> 8);
+   encoder->send(encoder->context, encoder->datagram, sizeof(fec_header_t) + coded_len);
+   for (uint8_t j = 0; j < encoder->num_parity; ++j)
+      fec_multiply_add(encoder->parity[j], coded, coded_len, fec_coefficient(j, index));
+   encoder->parity_len = (coded_len > encoder->parity_len) ? coded_len : encoder->parity_len;
+   encoder->fill = 0;
+   encoder->packet_start = false;
+
+   // Close the group after its last source shard
+   if (last)
+   {
+      fec_send_parity(encoder, index + 1);
+      encoder->num_sent = 0;
+      ++encoder->group;
+   }
+   else
+      ++encoder->num_sent;
+}
+
+void fec_encoder_init(fec_encoder_t *encoder, uint8_t num_source, uint8_t num_parity, uint16_t shard_bytes, fec_send_t send, void *context)
+{
+   // Clamp the code to the supported limits and start a fresh group at a packet boundary
+   fec_initialize_tables();
+   memset(encoder, 0, sizeof(*encoder));
+   encoder->num_source = (num_source < 1) ? 1 : ((num_source > FEC_MAX_SOURCE_SHARDS) ? FEC_MAX_SOURCE_SHARDS : num_source);
+   encoder->num_parity = (num_parity > FEC_MAX_PARITY_SHARDS) ? FEC_MAX_PARITY_SHARDS : num_parity;
+   encoder->shard_bytes = (shard_bytes < 1) ? 1 : ((shard_bytes > FEC_MAX_SHARD_BYTES) ? FEC_MAX_SHARD_BYTES : shard_bytes);
+   encoder->packet_start = true;
+   encoder->send = send;
+   encoder->context = context;
+}
+
+void fec_encoder_write(fec_encoder_t *encoder, const uint8_t *data, size_t data_len)
+{
+   // Append bytes of the current packet, sending a full shard only once more data shows that it is not the packet's last
+   uint8_t *shard = encoder->datagram + sizeof(fec_header_t) + FEC_PREFIX_BYTES;
+   while (data_len)
+   {
+      if (encoder->fill == encoder->shard_bytes)
+         fec_send_shard(encoder, false);
+      const size_t space = (size_t)(encoder->shard_bytes - encoder->fill), len = (space < data_len) ? space : data_len;
+      memcpy(shard + encoder->fill, data, len);
+      encoder->fill += (uint16_t)len;
+      data += len;
+      data_len -= len;
+   }
+}
+
+void fec_encoder_end_packet(fec_encoder_t *encoder)
+{
+   // Send the packet's final shard as the last of its group, followed by the group's parity
+   if (encoder->fill)
+      fec_send_shard(encoder, true);
+   encoder->packet_start = true;
+}
+
+static void fec_deliver_shard(fec_decoder_t *decoder, const uint8_t *coded, uint16_t coded_len)
+{
+   // Pass a shard's data on, unless it continues a packet that lost earlier shards, never passing more than was received
+   //    or recovered whatever length its prefix claims
+   const uint16_t prefix = coded[0] | ((uint16_t)coded[1] << 8), len = prefix & (FEC_PREFIX_PACKET_START - 1);
+   const uint16_t available = (coded_len > FEC_PREFIX_BYTES) ? (coded_len - FEC_PREFIX_BYTES) : 0;
+   if (decoder->in_gap && !(prefix & FEC_PREFIX_PACKET_START))
+      return;
+   decoder->in_gap = false;
+   decoder->deliver(decoder->context, coded + FEC_PREFIX_BYTES, (len < available) ? len : available);
+}
+
+static void fec_mark_gap(fec_decoder_t *decoder)
+{
+   if (!decoder->in_gap)
+      decoder->deliver(decoder->context, NULL, 0);
+   decoder->in_gap = true;
+}
+
+static uint8_t fec_recover(fec_group_t *group)
+{
+   // Rebuild the missing source shards from as many parity shards, once the group's size is known and enough have arrived
+   uint8_t missing[FEC_MAX_PARITY_SHARDS], parity[FEC_MAX_PARITY_SHARDS], num_missing = 0, num_parity = 0;
+   if (!group->num_source)
+      return 0;
+   for (uint8_t i = group->num_delivered; i < group->num_source; ++i)
+      if (!group->coded_len[i])
+      {
+         if (num_missing == FEC_MAX_PARITY_SHARDS)
+            return 0;
+         missing[num_missing++] = i;
+      }
+   for (uint8_t j = 0; (j < group->num_parity) && (num_parity < num_missing); ++j)
+      if (group->coded_len[group->num_source + j])
+         parity[num_parity++] = j;
+   if (!num_missing || (num_parity < num_missing))
+      return 0;
+
+   // Remove the received source shards' contributions from the chosen parity shards, leaving only the missing shards' terms
+   const uint16_t coded_len = group->coded_len[group->num_source + parity[0]];
+   for (uint8_t a = 0; a < num_parity; ++a)
+   {
+      uint8_t *syndrome = group->shards[group->num_source + parity[a]];
+      for (uint8_t i = 0; i < group->num_source; ++i)
+         if (group->coded_len[i])
+            fec_multiply_add(syndrome, group->shards[i], group->coded_len[i], fec_coefficient(parity[a], i));
+   }
+
+   // Invert the square submatrix relating the missing shards to the chosen parity shards by Gauss-Jordan elimination
+   uint8_t matrix[FEC_MAX_PARITY_SHARDS][FEC_MAX_PARITY_SHARDS], inverse[FEC_MAX_PARITY_SHARDS][FEC_MAX_PARITY_SHARDS];
+   for (uint8_t a = 0; a < num_missing; ++a)
+      for (uint8_t b = 0; b < num_missing; ++b)
+      {
+         matrix[a][b] = fec_coefficient(parity[a], missing[b]);
+         inverse[a][b] = (a == b);
+      }
+   for (uint8_t column = 0; column < num_missing; ++column)
+   {
+      uint8_t pivot = column;
+      while ((pivot < num_missing) && !matrix[pivot][column])
+         ++pivot;
+      if (pivot == num_missing)
+         return 0;
+      for (uint8_t b = 0; b < num_missing; ++b)
+      {
+         uint8_t swap = matrix[column][b];
+         matrix[column][b] = matrix[pivot][b];
+         matrix[pivot][b] = swap;
+         swap = inverse[column][b];
+         inverse[column][b] = inverse[pivot][b];
+         inverse[pivot][b] = swap;
+      }
+      const uint8_t scale = fec_divide(1, matrix[column][column]);
+      for (uint8_t b = 0; b < num_missing; ++b)
+      {
+         matrix[column][b] = fec_multiply(matrix[column][b], scale);
+         inverse[column][b] = fec_multiply(inverse[column][b], scale);
+      }
+      for (uint8_t a = 0; a < num_missing; ++a)
+         if ((a != column) && matrix[a][column])
+         {
+            const uint8_t factor = matrix[a][column];
+            for (uint8_t b = 0; b < num_missing; ++b)
+            {
+               matrix[a][b] ^= fec_multiply(factor, matrix[column][b]);
+               inverse[a][b] ^= fec_multiply(factor, inverse[column][b]);
+            }
+         }
+   }
+
+   // Each missing shard is a combination of the syndromes, carrying its own length in its recovered prefix
+   for (uint8_t b = 0; b < num_missing; ++b)
+   {
+      uint8_t *shard = group->shards[missing[b]];
+      memset(shard, 0, coded_len);
+      for (uint8_t a = 0; a < num_parity; ++a)
+         fec_multiply_add(shard, group->shards[group->num_source + parity[a]], coded_len, inverse[b][a]);
+      const uint16_t len = (shard[0] | ((uint16_t)shard[1] << 8)) & (FEC_PREFIX_PACKET_START - 1);
+      group->coded_len[missing[b]] = ((FEC_PREFIX_BYTES + len) <= coded_len) ? (FEC_PREFIX_BYTES + len) : FEC_PREFIX_BYTES;
+   }
+   for (uint8_t a = 0; a < num_parity; ++a)
+      group->coded_len[group->num_source + parity[a]] = 0;
+   return num_missing;
+}
+
+static void fec_retire_head(fec_decoder_t *decoder, bool abandon)
+{
+   // Move on to the next group, first delivering whatever of an abandoned group survived after its first lost shard
+   fec_group_t *group = &decoder->groups[decoder->next_group % FEC_DECODER_MAX_GROUPS];
+   if (abandon)
+   {
+      const uint8_t num_source = group->active ? (group->num_source ? group->num_source : group->max_source_seen) : 0;
+      for (uint8_t i = group->num_delivered; i < num_source; ++i)
+         if (group->coded_len[i])
+            fec_deliver_shard(decoder, group->shards[i], group->coded_len[i]);
+         else
+         {
+            ++decoder->stats.lost_shards;
+            fec_mark_gap(decoder);
+         }
+      if (!group->active || !group->num_source)
+         fec_mark_gap(decoder);
+   }
+   group->active = false;
+   ++decoder->next_group;
+}
+
+static void fec_advance(fec_decoder_t *decoder)
+{
+   // Deliver the oldest group's shards in order, recovering lost ones as soon as enough parity has arrived
+   while (true)
+   {
+      fec_group_t *group = &decoder->groups[decoder->next_group % FEC_DECODER_MAX_GROUPS];
+      if (!group->active || (group->group != decoder->next_group))
+         return;
+      while ((group->num_delivered < FEC_MAX_SOURCE_SHARDS) && group->coded_len[group->num_delivered] &&
+             (!group->num_source || (group->num_delivered < group->num_source)))
+      {
+         fec_deliver_shard(decoder, group->shards[group->num_delivered], group->coded_len[group->num_delivered]);
+         ++group->num_delivered;
+      }
+      if (group->num_source && (group->num_delivered == group->num_source))
+         fec_retire_head(decoder, false);
+      else
+      {
+         const uint8_t num_recovered = fec_recover(group);
+         if (!num_recovered)
+            return;
+         decoder->stats.recovered_shards += num_recovered;
+      }
+   }
+}
+
+void fec_decoder_init(fec_decoder_t *decoder, fec_deliver_t deliver, void *context)
+{
+   fec_initialize_tables();
+   memset(decoder, 0, sizeof(*decoder));
+   decoder->deliver = deliver;
+   decoder->context = context;
+   decoder->in_gap = true;
+}
+
+void fec_decoder_receive(fec_decoder_t *decoder, const uint8_t *datagram, size_t datagram_len, uint64_t now_us)
+{
+   // Validate the datagram against the code's limits
+   ++decoder->stats.datagrams;
+   fec_header_t header;
+   if ((datagram_len < (sizeof(header) + FEC_PREFIX_BYTES)) || (datagram_len > FEC_MAX_DATAGRAM_BYTES))
+   {
+      ++decoder->stats.invalid_datagrams;
+      return;
+   }
+   memcpy(&header, datagram, sizeof(header));
+   const bool is_parity = header.num_source && (header.index >= header.num_source);
+   const uint16_t coded_len = (uint16_t)(datagram_len - sizeof(header));
+   if ((header.num_source > FEC_MAX_SOURCE_SHARDS) || (header.num_parity > FEC_MAX_PARITY_SHARDS) ||
+       (header.index >= (is_parity ? (header.num_source + header.num_parity) : FEC_MAX_SOURCE_SHARDS)))
+   {
+      ++decoder->stats.invalid_datagrams;
+      return;
+   }
+   if (!is_parity)
+   {
+      // A source shard must hold all the data its prefix claims, or a truncated or forged datagram could pass on bytes
+      //    that were never received
+      const uint16_t prefix = datagram[sizeof(header)] | ((uint16_t)datagram[sizeof(header) + 1] << 8);
+      if ((FEC_PREFIX_BYTES + (prefix & (FEC_PREFIX_PACKET_START - 1))) > coded_len)
+      {
+         ++decoder->stats.invalid_datagrams;
+         return;
+      }
+   }
+   decoder->stats.parity_datagrams += is_parity;
+
+   // Place the group relative to the oldest one still awaited, treating a jump far backward as the sender restarting
+   if (!decoder->started)
+   {
+      decoder->started = true;
+      decoder->next_group = header.group;
+   }
+   int32_t offset = (int32_t)(header.group - decoder->next_group);
+   if (offset < -FEC_DECODER_MAX_GROUPS)
+   {
+      ++decoder->stats.restarts;
+      for (uint32_t g = 0; g < FEC_DECODER_MAX_GROUPS; ++g)
+         decoder->groups[g].active = false;
+      fec_mark_gap(decoder);
+      decoder->next_group = header.group;
+      offset = 0;
+   }
+   else if (offset < 0)
+   {
+      ++decoder->stats.late_datagrams;
+      return;
+   }
+   for (; offset >= FEC_DECODER_MAX_GROUPS; --offset)
+   {
+      fec_retire_head(decoder, true);
+      fec_advance(decoder);
+   }
+
+   // Store the shard in its group, ignoring duplicates
+   fec_group_t *group = &decoder->groups[header.group % FEC_DECODER_MAX_GROUPS];
+   if (!group->active || (group->group != header.group))
+   {
+      memset(group->coded_len, 0, sizeof(group->coded_len));
+      group->active = true;
+      group->group = header.group;
+      group->num_source = group->num_delivered = group->max_source_seen = 0;
+      group->first_arrival_us = now_us;
+   }
+   if (group->coded_len[header.index] || (header.index < group->num_delivered))
+      return;
+   memcpy(group->shards[header.index], datagram + sizeof(header), coded_len);
+   group->coded_len[header.index] = coded_len;
+   group->num_source = header.num_source ? header.num_source : group->num_source;
+   group->num_parity = header.num_parity;
+   if (!is_parity && (header.index >= group->max_source_seen))
+      group->max_source_seen = header.index + 1;
+   fec_advance(decoder);
+}
+
+void fec_decoder_expire(fec_decoder_t *decoder, uint64_t now_us)
+{
+   // Give up on the oldest group once a later group has been arriving for longer than reordering could explain
+   while (decoder->started)
+   {
+      bool later_started = false;
+      for (uint32_t g = 1; g < FEC_DECODER_MAX_GROUPS; ++g)
+      {
+         const fec_group_t *group = &decoder->groups[(decoder->next_group + g) % FEC_DECODER_MAX_GROUPS];
+         later_started = later_started || (group->active && ((now_us - group->first_arrival_us) >= FEC_DECODER_REORDER_US));
+      }
+      if (!later_started)
+         return;
+      fec_retire_head(decoder, true);
+      fec_advance(decoder);
+   }
+}
@@ -0,0 +1,89 @@
+#ifndef __FEC_HEADER_H__
+#define __FEC_HEADER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Packet-level forward error correction for the UDP uplink: the stream of framed packets is cut into shards of up to a
+//    configured size, each sent as one datagram, and every group of up to "num_source" consecutive shards is followed by
+//    "num_parity" Reed-Solomon (Cauchy, GF(2^8)) parity shards, from which any "num_parity" lost shards of the group can be
+//    rebuilt without a retransmission; a group also ends with the last shard of every packet so that no packet waits on
+//    the next one for its parity
+#define FEC_MAX_SOURCE_SHARDS                32
+#define FEC_MAX_PARITY_SHARDS                8
+#define FEC_MAX_SHARD_BYTES                  1400  // Keeps every datagram within a 1500-byte MTU
+#define FEC_PREFIX_BYTES                     2  // Shard length and packet-start flag, coded along with the shard's data
+#define FEC_PREFIX_PACKET_START              0x8000
+#define FEC_MAX_CODED_BYTES                  (FEC_PREFIX_BYTES + FEC_MAX_SHARD_BYTES)
+#define FEC_MAX_DATAGRAM_BYTES               (sizeof(fec_header_t) + FEC_MAX_CODED_BYTES)
+#define FEC_DECODER_MAX_GROUPS               4  // Groups held for reordering and recovery before the oldest is given up
+#define FEC_DECODER_REORDER_US               20000  // Time after a later group starts arriving that an incomplete group is given up
+
+// Header of every datagram, followed by the coded shard: the prefix and data of source shard "index", or the parity of
+//    the group's coded source shards (each zero-padded to the longest) for index "num_source + j"
+#pragma pack(push, 1)
+typedef struct {
+   uint32_t group;
+   uint8_t index;
+   uint8_t num_source;  // Source shards in the group, or 0 on source shards before its last
+   uint8_t num_parity;
+   uint8_t reserved;
+} fec_header_t;
+#pragma pack(pop)
+
+typedef void (*fec_send_t)(void *context, const uint8_t *datagram, size_t datagram_len);
+
+// Reassembled stream bytes in order, or NULL after shards were lost so that any partial packet must be discarded
+typedef void (*fec_deliver_t)(void *context, const uint8_t *data, size_t data_len);
+
+// Encoder state: the shard being filled (already laid out as a datagram) and the parity accumulated over the group so far
+typedef struct
+{
+   uint8_t num_source, num_parity;
+   uint16_t shard_bytes, fill;
+   uint32_t group;
+   uint8_t num_sent;
+   uint16_t parity_len;
+   bool packet_start;
+   fec_send_t send;
+   void *context;
+   uint8_t datagram[FEC_MAX_DATAGRAM_BYTES];
+   uint8_t parity[FEC_MAX_PARITY_SHARDS][FEC_MAX_CODED_BYTES];
+} fec_encoder_t;
+
+// One group being received, its coded shards indexed as on the wire with a length of zero until received
+typedef struct
+{
+   bool active;
+   uint32_t group;
+   uint8_t num_source, num_parity, num_delivered, max_source_seen;
+   uint64_t first_arrival_us;
+   uint16_t coded_len[FEC_MAX_SOURCE_SHARDS + FEC_MAX_PARITY_SHARDS];
+   uint8_t shards[FEC_MAX_SOURCE_SHARDS + FEC_MAX_PARITY_SHARDS][FEC_MAX_CODED_BYTES];
+} fec_group_t;
+
+typedef struct
+{
+   uint64_t datagrams, parity_datagrams, recovered_shards, lost_shards, late_datagrams, invalid_datagrams, restarts;
+} fec_statistics_t;
+
+// Decoder state for a single sender
+typedef struct
+{
+   fec_deliver_t deliver;
+   void *context;
+   bool started, in_gap;
+   uint32_t next_group;
+   fec_statistics_t stats;
+   fec_group_t groups[FEC_DECODER_MAX_GROUPS];
+} fec_decoder_t;
+
+void fec_encoder_init(fec_encoder_t *encoder, uint8_t num_source, uint8_t num_parity, uint16_t shard_bytes, fec_send_t send, void *context);
+void fec_encoder_write(fec_encoder_t *encoder, const uint8_t *data, size_t data_len);
+void fec_encoder_end_packet(fec_encoder_t *encoder);
+void fec_decoder_init(fec_decoder_t *decoder, fec_deliver_t deliver, void *context);
+void fec_decoder_receive(fec_decoder_t *decoder, const uint8_t *datagram, size_t datagram_len, uint64_t now_us);
+void fec_decoder_expire(fec_decoder_t *decoder, uint64_t now_us);
+
+#endif  // __FEC_HEADER_H__
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <string.h>
+#include "log_format.h"
+
+#define LOG_LEVEL_PADDING              0xFF
+#define LOG_MAX_SPEC_LEN               24
+
+static inline uint32_t log_padded_length(uint32_t length)
+{
+   return (length + LOG_RECORD_ALIGNMENT - 1) & ~(LOG_RECORD_ALIGNMENT - 1);
+}
+
+void log_ring_init(log_ring_t *ring, uint8_t *buffer, uint32_t size)
+{
+   // The ring size must be a power of two no larger than the largest representable record length
+   memset(buffer, 0, size);
+   ring->buffer = buffer;
+   ring->size = size;
+   ring->mask = size - 1;
+   ring->head = ring->tail = ring->dropped = 0;
+}
+
+bool log_ring_write(log_ring_t *ring, uint8_t level, uint8_t core, uint32_t timestamp_ms, const char *format, const log_arg_t *args, uint32_t num_args)
+{
+   // Size the record, truncating string arguments and any arguments beyond the maximum
+   uint8_t string_lengths[LOG_MAX_ARGS];
+   uint32_t length = sizeof(log_record_t), arg_types = 0;
+   if (num_args > LOG_MAX_ARGS)
+      num_args = LOG_MAX_ARGS;
+   for (uint32_t i = 0; i < num_args; ++i)
+   {
+      arg_types |= (uint32_t)args[i].type << (i * LOG_ARG_TYPE_BITS);
+      if (args[i].type == LOG_ARG_STRING)
+      {
+         string_lengths[i] = args[i].string ? (uint8_t)strnlen(args[i].string, LOG_MAX_STRING_ARG_LEN) : 0;
+         length += 1 + string_lengths[i];
+      }
+      else
+         length += sizeof(uint64_t);
+   }
+   length = log_padded_length(length);
+
+   // Reserve contiguous space with a single compare-and-swap, padding out the end of the ring if the record would wrap
+   uint32_t head, padding;
+   do
+   {
+      head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+      const uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE), offset = head & ring->mask;
+      padding = ((ring->size - offset) < length) ? (ring->size - offset) : 0;
+      if ((head + padding + length - tail) > ring->size)
+      {
+         __atomic_add_fetch(&ring->dropped, 1, __ATOMIC_RELAXED);
+         return false;
+      }
+   } while (!__atomic_compare_exchange_n(&ring->head, &head, head + padding + length, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+   if (padding)
+   {
+      // Only the first 8 bytes of a padding record are ever touched, since it may be shorter than a record header
+      log_record_t *padding_record = (log_record_t*)(ring->buffer + (head & ring->mask));
+      padding_record->length = (uint16_t)padding;
+      padding_record->level = LOG_LEVEL_PADDING;
+      __atomic_store_n(&padding_record->committed, 1, __ATOMIC_RELEASE);
+   }
+
+   // Fill in the record and its arguments, publishing it to the reader last
+   uint8_t *record_bytes = ring->buffer + ((head + padding) & ring->mask);
+   log_record_t *record = (log_record_t*)record_bytes;
+   record->length = (uint16_t)length;
+   record->level = level;
+   record->num_args = (uint8_t)num_args;
+   record->core = core;
+   record->arg_types = arg_types;
+   record->timestamp_ms = timestamp_ms;
+   record->format = (uint64_t)(uintptr_t)format;
+   uint8_t *payload = record_bytes + sizeof(log_record_t);
+   for (uint32_t i = 0; i < num_args; ++i)
+   {
+      if (args[i].type == LOG_ARG_STRING)
+      {
+         *payload++ = string_lengths[i];
+         memcpy(payload, args[i].string, string_lengths[i]);
+         payload += string_lengths[i];
+      }
+      else
+      {
+         memcpy(payload, &args[i].integer, sizeof(uint64_t));
+         payload += sizeof(uint64_t);
+      }
+   }
+   __atomic_store_n(&record->committed, 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+const log_record_t* log_ring_peek(log_ring_t *ring)
+{
+   // Return the oldest fully written record, skipping any padding, or NULL if none is ready
+   while (ring->tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+   {
+      const log_record_t *record = (const log_record_t*)(ring->buffer + (ring->tail & ring->mask));
+      if (!__atomic_load_n(&record->committed, __ATOMIC_ACQUIRE))
+         return NULL;
+      if (record->level != LOG_LEVEL_PADDING)
+         return record;
+      log_ring_consume(ring, record);
+   }
+   return NULL;
+}
+
+void log_ring_consume(log_ring_t *ring, const log_record_t *record)
+{
+   // Clear the whole record, not just its header, before releasing the space: records vary in length, so a future header
+   //    may land on any part of this one, and a writer publishes its reservation before it writes that header
+   const uint32_t length = record->length;
+   memset((void*)record, 0, length);
+   __atomic_store_n(&ring->tail, ring->tail + length, __ATOMIC_RELEASE);
+}
+
+static size_t log_append(size_t output_len, size_t position, int written)
+{
+   // Advance the output position by the number of characters actually stored
+   if (written <= 0)
+      return position;
+   return ((position + (size_t)written) < output_len) ? (position + (size_t)written) : (output_len ? (output_len - 1) : 0);
+}
+
+size_t log_format_record(const log_record_t *record, const char *format, char *output, size_t output_len)
+{
+   // Decode the argument slots that follow the record header
+   log_arg_t args[LOG_MAX_ARGS];
+   char strings[LOG_MAX_ARGS][LOG_MAX_STRING_ARG_LEN + 1];
+   const uint8_t *payload = (const uint8_t*)(record + 1);
+   for (uint32_t i = 0; i < record->num_args; ++i)
+   {
+      args[i].type = (log_arg_type_t)((record->arg_types >> (i * LOG_ARG_TYPE_BITS)) & ((1 << LOG_ARG_TYPE_BITS) - 1));
+      if (args[i].type == LOG_ARG_STRING)
+      {
+         const uint8_t string_len = *payload++;
+         memcpy(strings[i], payload, string_len);
+         strings[i][string_len] = '\0';
+         args[i].string = strings[i];
+         payload += string_len;
+      }
+      else
+      {
+         memcpy(&args[i].integer, payload, sizeof(uint64_t));
+         payload += sizeof(uint64_t);
+      }
+   }
+
+   // Walk the format string, formatting one conversion at a time with the type actually captured for it
+   size_t position = 0;
+   uint32_t next_arg = 0;
+   if (output_len)
+      output[0] = '\0';
+   while (*format && ((position + 1) < output_len))
+   {
+      if ((format[0] != '%') || (format[1] == '%'))
+      {
+         output[position++] = *format;
+         format += (format[0] == '%') ? 2 : 1;
+         continue;
+      }
+
+      // Copy flags, width and precision, discard length modifiers, and substitute ones matching the captured type
+      char spec[LOG_MAX_SPEC_LEN];
+      size_t spec_len = 0;
+      const char *spec_start = format++;
+      spec[spec_len++] = '%';
+      while (*format && strchr("-+ #0123456789.", *format) && (spec_len < (LOG_MAX_SPEC_LEN - 4)))
+         spec[spec_len++] = *format++;
+      while (*format && strchr("hlLqjzt", *format))
+         ++format;
+      const char conversion = *format ? *format++ : '\0';
+      if (!conversion || (next_arg >= record->num_args))
+      {
+         position = log_append(output_len, position, snprintf(output + position, output_len - position, "%.*s", (int)(format - spec_start), spec_start));
+         continue;
+      }
+      const log_arg_t *arg = args + next_arg++;
+      if (strchr("diouxXc", conversion))
+      {
+         if (conversion != 'c')
+         {
+            spec[spec_len++] = 'l';
+            spec[spec_len++] = 'l';
+         }
+         spec[spec_len++] = conversion;
+         spec[spec_len] = '\0';
+         const long long value = (arg->type == LOG_ARG_DOUBLE) ? (long long)arg->real : (long long)arg->integer;
+         position = log_append(output_len, position, (conversion == 'c') ? snprintf(output + position, output_len - position, spec, (int)value) :
+                                                                                   snprintf(output + position, output_len - position, spec, value));
+      }
+      else if (strchr("fFeEgGaA", conversion))
+      {
+         spec[spec_len++] = conversion;
+         spec[spec_len] = '\0';
+         const double value = (arg->type == LOG_ARG_DOUBLE) ? arg->real : (double)arg->integer;
+         position = log_append(output_len, position, snprintf(output + position, output_len - position, spec, value));
+      }
+      else if (conversion == 's')
+      {
+         spec[spec_len++] = 's';
+         spec[spec_len] = '\0';
+         position = log_append(output_len, position, snprintf(output + position, output_len - position, spec, (arg->type == LOG_ARG_STRING) ? arg->string : "(?)"));
+      }
+      else
+      {
+         spec[spec_len++] = 'p';
+         spec[spec_len] = '\0';
+         position = log_append(output_len, position, snprintf(output + position, output_len - position, spec, (void*)(uintptr_t)arg->integer));
+      }
+   }
+   if (output_len)
+      output[position] = '\0';
+   return position;
+}
@@ -0,0 +1,100 @@
+#ifndef __LOG_FORMAT_HEADER_H__
+#define __LOG_FORMAT_HEADER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LOG_MAX_ARGS                         12
+#define LOG_MAX_STRING_ARG_LEN               63
+#define LOG_RECORD_ALIGNMENT                 8
+#define LOG_ARG_TYPE_BITS                    2
+
+// Argument types captured alongside each record (integers are widened to 64 bits, floats to doubles)
+typedef enum
+{
+   LOG_ARG_INTEGER = 0,
+   LOG_ARG_DOUBLE,
+   LOG_ARG_STRING,
+   LOG_ARG_POINTER
+} log_arg_type_t;
+
+// Binary log record as stored in a ring and sent to the host: header, then one 8-byte slot per numeric argument or
+//    a length byte plus the characters for each string argument, padded to LOG_RECORD_ALIGNMENT
+#pragma pack(push, 1)
+typedef struct {
+   uint16_t length;
+   uint8_t level, num_args;
+   uint8_t committed, core;
+   uint16_t reserved;
+   uint32_t arg_types;
+   uint32_t timestamp_ms;
+   uint64_t format;
+} log_record_t;
+#pragma pack(pop)
+
+// Single captured argument
+typedef struct
+{
+   log_arg_type_t type;
+   union {
+      int64_t integer;
+      double real;
+      const char *string;
+      const void *pointer;
+   };
+} log_arg_t;
+
+// Lock-free multi-producer, single-consumer byte ring of log records
+typedef struct
+{
+   uint8_t *buffer;
+   uint32_t size, mask;
+   uint32_t head, tail, dropped;
+} log_ring_t;
+
+static inline log_arg_t log_arg_integer(int64_t value) { return (log_arg_t){ .type = LOG_ARG_INTEGER, .integer = value }; }
+static inline log_arg_t log_arg_unsigned(uint64_t value) { return (log_arg_t){ .type = LOG_ARG_INTEGER, .integer = (int64_t)value }; }
+static inline log_arg_t log_arg_double(double value) { return (log_arg_t){ .type = LOG_ARG_DOUBLE, .real = value }; }
+static inline log_arg_t log_arg_string(const char *value) { return (log_arg_t){ .type = LOG_ARG_STRING, .string = value }; }
+static inline log_arg_t log_arg_pointer(const void *value) { return (log_arg_t){ .type = LOG_ARG_POINTER, .pointer = value }; }
+
+// Compile-time capture of a format string and its arguments as (format, args, num_args)
+#define LOG_ARG(x) _Generic((x), \
+   float: log_arg_double, double: log_arg_double, \
+   char*: log_arg_string, const char*: log_arg_string, \
+   void*: log_arg_pointer, const void*: log_arg_pointer, \
+   unsigned long long: log_arg_unsigned, unsigned long: log_arg_unsigned, \
+   default: log_arg_integer)(x)
+#define LOG_CONCAT_(a, b) a##b
+#define LOG_CONCAT(a, b) LOG_CONCAT_(a, b)
+#define LOG_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, N, ...) N
+#define LOG_COUNT(...) LOG_COUNT_(__VA_ARGS__, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_CAPTURE(...) LOG_CONCAT(LOG_CAPTURE_, LOG_COUNT(__VA_ARGS__))(__VA_ARGS__)
+#define LOG_CAPTURE_1(f) f, NULL, 0
+#define LOG_CAPTURE_2(f, a) f, (const log_arg_t[]){ LOG_ARG(a) }, 1
+#define LOG_CAPTURE_3(f, a, b) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b) }, 2
+#define LOG_CAPTURE_4(f, a, b, c) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c) }, 3
+#define LOG_CAPTURE_5(f, a, b, c, d) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d) }, 4
+#define LOG_CAPTURE_6(f, a, b, c, d, e) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e) }, 5
+#define LOG_CAPTURE_7(f, a, b, c, d, e, g) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(g) }, 6
+#define LOG_CAPTURE_8(f, a, b, c, d, e, g, h) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(g), \
+                                                                     LOG_ARG(h) }, 7
+#define LOG_CAPTURE_9(f, a, b, c, d, e, g, h, i) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(g), \
+                                                                        LOG_ARG(h), LOG_ARG(i) }, 8
+#define LOG_CAPTURE_10(f, a, b, c, d, e, g, h, i, j) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(g), \
+                                                                            LOG_ARG(h), LOG_ARG(i), LOG_ARG(j) }, 9
+#define LOG_CAPTURE_11(f, a, b, c, d, e, g, h, i, j, k) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(g), \
+                                                                               LOG_ARG(h), LOG_ARG(i), LOG_ARG(j), LOG_ARG(k) }, 10
+#define LOG_CAPTURE_12(f, a, b, c, d, e, g, h, i, j, k, l) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(g), \
+                                                                                  LOG_ARG(h), LOG_ARG(i), LOG_ARG(j), LOG_ARG(k), LOG_ARG(l) }, 11
+#define LOG_CAPTURE_13(f, a, b, c, d, e, g, h, i, j, k, l, m) f, (const log_arg_t[]){ LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(g), \
+                                                                                     LOG_ARG(h), LOG_ARG(i), LOG_ARG(j), LOG_ARG(k), LOG_ARG(l), LOG_ARG(m) }, 12
+
+void log_ring_init(log_ring_t *ring, uint8_t *buffer, uint32_t size);
+bool log_ring_write(log_ring_t *ring, uint8_t level, uint8_t core, uint32_t timestamp_ms, const char *format, const log_arg_t *args, uint32_t num_args);
+const log_record_t* log_ring_peek(log_ring_t *ring);
+void log_ring_consume(log_ring_t *ring, const log_record_t *record);
+size_t log_format_record(const log_record_t *record, const char *format, char *output, size_t output_len);
+
+#endif  // __LOG_FORMAT_HEADER_H__
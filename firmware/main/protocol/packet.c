@@ -0,0 +1,63 @@
+#include <string.h>
+#include "packet.h"
+
+static const uint8_t packet_delimiter[PACKET_DELIMITER_LEN] = PACKET_DELIMITER;
+
+void packet_init_header(packet_header_t *header, packet_type_t type, uint16_t sequence, uint32_t payload_len)
+{
+   // Fill in a header for a packet with the specified payload length
+   memcpy(header->delimiter, packet_delimiter, sizeof(packet_delimiter));
+   header->type = (uint8_t)type;
+   header->flags = 0;
+   header->sequence = sequence;
+   header->length = payload_len;
+}
+
+void packet_parser_init(packet_parser_t *parser, uint8_t *buffer, size_t buffer_size)
+{
+   // Reset the parser to search for the next packet delimiter
+   parser->buffer = buffer;
+   parser->buffer_size = buffer_size;
+   parser->index = parser->expected_len = 0;
+}
+
+size_t packet_parser_consume(packet_parser_t *parser, const uint8_t *data, size_t data_len, const packet_header_t **header, const uint8_t **payload)
+{
+   // Consume bytes until a full packet has been assembled or the input is exhausted
+   *header = NULL;
+   *payload = NULL;
+   for (size_t i = 0; i < data_len; ++i)
+   {
+      const uint8_t rx_byte = data[i];
+      if (parser->index < PACKET_DELIMITER_LEN)
+      {
+         // Resynchronize on any byte that does not continue the delimiter
+         if (rx_byte == packet_delimiter[parser->index])
+            parser->buffer[parser->index++] = rx_byte;
+         else
+            parser->index = (rx_byte == packet_delimiter[0]) ? 1 : 0;
+         continue;
+      }
+      parser->buffer[parser->index++] = rx_byte;
+      if (parser->index == sizeof(packet_header_t))
+      {
+         // Drop packets which would overflow the receive buffer
+         const packet_header_t *rx_header = (const packet_header_t*)parser->buffer;
+         if (rx_header->length > (parser->buffer_size - sizeof(packet_header_t)))
+         {
+            parser->index = 0;
+            continue;
+         }
+         parser->expected_len = sizeof(packet_header_t) + rx_header->length;
+      }
+      if ((parser->index >= sizeof(packet_header_t)) && (parser->index == parser->expected_len))
+      {
+         // Return the fully assembled packet and reset for the next one
+         *header = (const packet_header_t*)parser->buffer;
+         *payload = parser->buffer + sizeof(packet_header_t);
+         parser->index = parser->expected_len = 0;
+         return i + 1;
+      }
+   }
+   return data_len;
+}
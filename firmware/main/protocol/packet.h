@@ -0,0 +1,179 @@
+#ifndef __PACKET_HEADER_H__
+#define __PACKET_HEADER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PACKET_DELIMITER                     { 0x7E, 0x6F, 0x50, 0x11 }
+#define PACKET_DELIMITER_LEN                 4
+#define PACKET_MAX_COMMAND_PAYLOAD_BYTES     64
+
+#define PACKET_FLAG_SPOOLED                  0x01
+#define PACKET_FLAG_UNSYNCHRONIZED           0x02  // Audio timestamp comes from the local clock, GPS time was not yet available
+#define PACKET_FLAG_RESAMPLED                0x04  // Audio was resampled onto the GPS time grid at exactly the nominal sample rate
+#define PACKET_FLAG_SURVEYED                 0x08  // Position is the node's completed survey-in result rather than a running estimate
+
+#define PACKET_SUMMARY_LEVEL_SCALE           100.0f  // Spectral summary levels are sent in hundredths of a decibel
+#define PACKET_SUMMARY_LOG_MEL_SCALE         256.0f  // Spectral summary log-mel values are sent in 1/256ths of a natural-log unit
+#define PACKET_LATENCY_BUCKETS               24  // Bucket "b" of a latency histogram counts latencies of [2^b, 2^(b+1)) us, the first and last open-ended
+
+// Packet types (device -> host below 0x80, host -> device at or above 0x80)
+typedef enum
+{
+   PACKET_TYPE_AUDIO = 0x01,
+   PACKET_TYPE_HISTORY_AUDIO = 0x02,
+   PACKET_TYPE_HISTORY_STATUS = 0x03,
+   PACKET_TYPE_AUDIO_DECIMATED = 0x04,
+   PACKET_TYPE_LOG = 0x05,
+   PACKET_TYPE_BOOT_PROFILE = 0x06,
+   PACKET_TYPE_SPECTRAL_SUMMARY = 0x07,
+   PACKET_TYPE_TOA_REPORT = 0x08,
+   PACKET_TYPE_LATENCY_PROFILE = 0x09,
+   PACKET_TYPE_HISTORY_REQUEST = 0x80
+} packet_type_t;
+
+// History request completion status
+typedef enum
+{
+   HISTORY_STATUS_OK = 0,
+   HISTORY_STATUS_TRUNCATED,
+   HISTORY_STATUS_NOT_AVAILABLE,
+   HISTORY_STATUS_BUSY,
+   HISTORY_STATUS_TIMEOUT
+} history_status_t;
+
+// Boot phases reported in a boot profile packet, in the order they appear on the wire
+typedef enum
+{
+   BOOT_PHASE_APP_START = 0,
+   BOOT_PHASE_STORAGE_READY,
+   BOOT_PHASE_USB_READY,
+   BOOT_PHASE_SINKS_READY,
+   BOOT_PHASE_CAPTURE_STARTED,
+   BOOT_PHASE_FIRST_BLOCK,
+   BOOT_PHASE_GPS_RESPONDING,
+   BOOT_PHASE_GPS_CONFIGURED,
+   BOOT_PHASE_GPS_TIME_VALID,
+   BOOT_PHASE_GPS_FIX,
+   BOOT_PHASE_FIRST_SYNCHRONIZED_BLOCK,
+   BOOT_PHASE_NETWORK_STACK_READY,
+   BOOT_PHASE_WIFI_STARTED,
+   BOOT_PHASE_COUNT
+} boot_phase_t;
+
+// Stages of a block's path from capture to output reported in a latency profile packet, in the order they appear on the
+//    wire; the totals run from the DMA completion of a second's final samples until its packets were handed to the transport
+typedef enum
+{
+   LATENCY_STAGE_DMA_TO_READ = 0,
+   LATENCY_STAGE_TIMESTAMP,
+   LATENCY_STAGE_READ_TO_DISPATCH,
+   LATENCY_STAGE_USB_ENQUEUE,
+   LATENCY_STAGE_USB_TRANSMIT,
+   LATENCY_STAGE_NETWORK_ENQUEUE,
+   LATENCY_STAGE_NETWORK_TRANSMIT,
+   LATENCY_STAGE_USB_TOTAL,
+   LATENCY_STAGE_NETWORK_TOTAL,
+   LATENCY_STAGE_COUNT
+} latency_stage_t;
+
+// Wire structures (little-endian, packed)
+#pragma pack(push, 1)
+typedef struct {
+   uint8_t delimiter[PACKET_DELIMITER_LEN];
+   uint8_t type, flags;
+   uint16_t sequence;
+   uint32_t length;
+} packet_header_t;
+
+typedef struct {
+   double timestamp;
+   double lat, lon;
+   float height;
+   float drift_ppm;  // Estimated deviation of the node's sample clock from nominal, or 0 until known
+   float horizontal_accuracy, vertical_accuracy;  // Estimated error of the position in meters, or 0 before the first fix
+} packet_audio_t;
+
+typedef struct {
+   double timestamp;
+   double lat, lon;
+   float height;
+   uint32_t sample_rate_hz;
+   float drift_ppm;
+   float horizontal_accuracy, vertical_accuracy;
+} packet_audio_decimated_t;
+
+typedef struct {
+   uint32_t request_id;
+   double start_timestamp, end_timestamp;
+} packet_history_request_t;
+
+typedef struct {
+   uint32_t request_id;
+   double timestamp;
+} packet_history_audio_t;
+
+typedef struct {
+   uint32_t request_id;
+   uint8_t status;
+   uint32_t num_samples;
+} packet_history_status_t;
+
+// Followed by "num_bands" int16 octave band levels and then "num_mel_bands" int16 log-mel values, all scaled as above
+typedef struct {
+   double timestamp;
+   double lat, lon;
+   float height;
+   float drift_ppm;
+   uint16_t num_frames;
+   uint8_t num_bands, num_mel_bands;
+   int16_t peak_level, rms_level, crest_factor;
+   float horizontal_accuracy, vertical_accuracy;
+} packet_spectral_summary_t;
+
+// Followed by "num_snippet_samples" int16 full-rate samples of the event, the first captured "snippet_offset" seconds after
+//    (so usually before) the onset at "timestamp"
+typedef struct {
+   double timestamp;  // GPS time of the event's onset
+   double lat, lon;
+   float height;
+   float horizontal_accuracy, vertical_accuracy;
+   float drift_ppm;
+   float uncertainty;  // Estimated 1-sigma error of the onset time in seconds
+   float confidence;  // Share of the onset's likelihood lying within a couple of samples of the pick, from 0 to 1
+   float snr_db;
+   int16_t peak;
+   uint16_t num_snippet_samples;
+   uint32_t sample_rate_hz;
+   float snippet_offset;
+} packet_toa_report_t;
+
+typedef struct {
+   uint32_t phase_us[BOOT_PHASE_COUNT];  // Microseconds since power-on at which each phase was reached, or 0 if not yet reached
+} packet_boot_profile_t;
+
+typedef struct {
+   uint32_t count, max_us;
+   uint64_t total_us;
+   uint32_t buckets[PACKET_LATENCY_BUCKETS];
+} packet_latency_stage_t;
+
+typedef struct {
+   uint32_t uptime_s;
+   packet_latency_stage_t stages[LATENCY_STAGE_COUNT];  // Every block traced since power-on
+} packet_latency_profile_t;
+#pragma pack(pop)
+
+// Incremental packet parser state
+typedef struct
+{
+   uint8_t *buffer;
+   size_t buffer_size, index, expected_len;
+} packet_parser_t;
+
+void packet_init_header(packet_header_t *header, packet_type_t type, uint16_t sequence, uint32_t payload_len);
+void packet_parser_init(packet_parser_t *parser, uint8_t *buffer, size_t buffer_size);
+size_t packet_parser_consume(packet_parser_t *parser, const uint8_t *data, size_t data_len, const packet_header_t **header, const uint8_t **payload);
+
+#endif  // __PACKET_HEADER_H__
@@ -0,0 +1,60 @@
+#include "spool_format.h"
+
+static uint32_t spool_batch_crc32(const spool_batch_header_t *header)
+{
+   // Compute the CRC over the identifying header fields and the batch data that follows the header
+   uint32_t crc = spool_crc32(0, (const uint8_t*)header, offsetof(spool_batch_header_t, crc32));
+   return spool_crc32(crc, (const uint8_t*)(header + 1), header->data_len);
+}
+
+uint32_t spool_crc32(uint32_t crc, const uint8_t *data, size_t data_len)
+{
+   // Standard reflected CRC-32 (IEEE 802.3) using a nibble-wide lookup table
+   static const uint32_t crc32_table[16] = {
+      0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+      0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+   };
+   crc = ~crc;
+   for (size_t i = 0; i < data_len; ++i)
+   {
+      crc = crc32_table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+      crc = crc32_table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+   }
+   return ~crc;
+}
+
+void spool_finalize_batch(spool_batch_header_t *header, uint32_t sequence, uint32_t data_len, uint32_t first_packet_offset)
+{
+   // Fill in the batch header for the data already placed directly after it
+   header->magic = SPOOL_BATCH_MAGIC;
+   header->sequence = sequence;
+   header->data_len = data_len;
+   header->first_packet_offset = first_packet_offset;
+   header->drained = SPOOL_BATCH_NOT_DRAINED;
+   for (int i = 0; i < SPOOL_NUM_RESUME_SLOTS; ++i)
+      header->resume_offsets[i] = SPOOL_NO_RESUME_OFFSET;
+   header->crc32 = spool_batch_crc32(header);
+}
+
+bool spool_batch_header_is_valid(const spool_batch_header_t *header)
+{
+   // Check only the header fields, allowing a quick scan without reading batch data
+   return (header->magic == SPOOL_BATCH_MAGIC) && (header->data_len <= SPOOL_BATCH_DATA_BYTES) &&
+          ((header->first_packet_offset == SPOOL_NO_PACKET_START) || (header->first_packet_offset < header->data_len));
+}
+
+bool spool_batch_is_valid(const spool_batch_header_t *header)
+{
+   // Verify a batch header and its data, which must directly follow the header in memory
+   return spool_batch_header_is_valid(header) && (spool_batch_crc32(header) == header->crc32);
+}
+
+uint32_t spool_batch_resume_offset(const spool_batch_header_t *header)
+{
+   // Return the furthest recorded offset up to which the batch has already been delivered, if any
+   uint32_t resume_offset = SPOOL_NO_RESUME_OFFSET;
+   for (int i = 0; i < SPOOL_NUM_RESUME_SLOTS; ++i)
+      if ((header->resume_offsets[i] <= header->data_len) && ((resume_offset == SPOOL_NO_RESUME_OFFSET) || (header->resume_offsets[i] > resume_offset)))
+         resume_offset = header->resume_offsets[i];
+   return resume_offset;
+}
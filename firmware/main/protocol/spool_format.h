@@ -0,0 +1,36 @@
+#ifndef __SPOOL_FORMAT_HEADER_H__
+#define __SPOOL_FORMAT_HEADER_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SPOOL_BATCH_SIZE_BYTES               (64 * 1024)
+#define SPOOL_BATCH_MAGIC                    0x4C4F5053
+#define SPOOL_BATCH_DRAINED                  0x00000000
+#define SPOOL_BATCH_NOT_DRAINED              0xFFFFFFFF
+#define SPOOL_NO_PACKET_START                0xFFFFFFFF
+#define SPOOL_NO_RESUME_OFFSET               0xFFFFFFFF
+#define SPOOL_NUM_RESUME_SLOTS               4
+#define SPOOL_BATCH_DATA_BYTES               (SPOOL_BATCH_SIZE_BYTES - sizeof(spool_batch_header_t))
+
+// Header at the start of every erase-block-sized batch in the spool partition
+#pragma pack(push, 1)
+typedef struct {
+   uint32_t magic;
+   uint32_t sequence;
+   uint32_t data_len;
+   uint32_t first_packet_offset;
+   uint32_t crc32;
+   uint32_t drained;
+   uint32_t resume_offsets[SPOOL_NUM_RESUME_SLOTS];   // Write-once offsets past the last delivered packet, left erased until used
+} spool_batch_header_t;
+#pragma pack(pop)
+
+uint32_t spool_crc32(uint32_t crc, const uint8_t *data, size_t data_len);
+void spool_finalize_batch(spool_batch_header_t *header, uint32_t sequence, uint32_t data_len, uint32_t first_packet_offset);
+bool spool_batch_header_is_valid(const spool_batch_header_t *header);
+bool spool_batch_is_valid(const spool_batch_header_t *header);
+uint32_t spool_batch_resume_offset(const spool_batch_header_t *header);
+
+#endif  // __SPOOL_FORMAT_HEADER_H__
@@ -0,0 +1,135 @@
+#include <string.h>
+#include "ubx.h"
+
+static inline void ubx_parser_store(ubx_parser_t *parser, uint8_t rx_byte)
+{
+   // Append a checksummed byte to the packet buffer
+   parser->buffer[parser->index++] = rx_byte;
+   parser->ck_a += rx_byte;
+   parser->ck_b += parser->ck_a;
+}
+
+void ubx_parser_init(ubx_parser_t *parser)
+{
+   // Reset the parser to search for the next sync sequence
+   parser->state = UBX_PACKET_INIT_STATE;
+   parser->index = parser->payload_len = 0;
+   parser->ck_a = parser->ck_b = 0;
+}
+
+ubx_message_type_t ubx_parser_consume(ubx_parser_t *parser, uint8_t rx_byte)
+{
+   // Process incoming UBX bytes character-by-character
+   switch (parser->state)
+   {
+      case UBX_PACKET_INIT_STATE:
+         if (rx_byte == UBX_SYNC1_CHAR)
+         {
+            parser->state = UBX_PACKET_SYNC_STATE;
+            parser->index = parser->ck_a = parser->ck_b = 0;
+            parser->buffer[parser->index++] = rx_byte;
+         }
+         break;
+      case UBX_PACKET_SYNC_STATE:
+         if (rx_byte == UBX_SYNC2_CHAR)
+         {
+            parser->buffer[parser->index++] = rx_byte;
+            parser->state = UBX_PACKET_CLASS_STATE;
+         }
+         else
+            parser->state = (rx_byte == UBX_SYNC1_CHAR) ? UBX_PACKET_SYNC_STATE : UBX_PACKET_INIT_STATE;
+         break;
+      case UBX_PACKET_CLASS_STATE:
+         ubx_parser_store(parser, rx_byte);
+         parser->state = UBX_PACKET_ID_STATE;
+         break;
+      case UBX_PACKET_ID_STATE:
+         ubx_parser_store(parser, rx_byte);
+         parser->state = UBX_PACKET_LEN1_STATE;
+         break;
+      case UBX_PACKET_LEN1_STATE:
+         ubx_parser_store(parser, rx_byte);
+         parser->payload_len = rx_byte;
+         parser->state = UBX_PACKET_LEN2_STATE;
+         break;
+      case UBX_PACKET_LEN2_STATE:
+         // Drop packets which would overflow the receive buffer instead of waiting for them forever
+         ubx_parser_store(parser, rx_byte);
+         parser->payload_len |= (uint16_t)(rx_byte << 8);
+         if (parser->payload_len > UBX_MAX_PAYLOAD_SIZE)
+            parser->state = UBX_PACKET_INIT_STATE;
+         else
+            parser->state = parser->payload_len ? UBX_PACKET_PAYLOAD_STATE : UBX_PACKET_CK_A_STATE;
+         break;
+      case UBX_PACKET_PAYLOAD_STATE:
+         ubx_parser_store(parser, rx_byte);
+         if ((parser->index - UBX_MSG_PAYLOAD_OFFSET) == parser->payload_len)
+            parser->state = UBX_PACKET_CK_A_STATE;
+         break;
+      case UBX_PACKET_CK_A_STATE:
+         if (parser->ck_a != rx_byte)
+            parser->state = UBX_PACKET_INIT_STATE;
+         else
+         {
+            parser->buffer[parser->index++] = rx_byte;
+            parser->state = UBX_PACKET_CK_B_STATE;
+         }
+         break;
+      case UBX_PACKET_CK_B_STATE:
+         parser->state = UBX_PACKET_INIT_STATE;
+         if (parser->ck_b == rx_byte)
+         {
+            parser->buffer[parser->index++] = rx_byte;
+            return ubx_identify_message(parser->buffer, parser->payload_len);
+         }
+         break;
+      default:
+         parser->state = UBX_PACKET_INIT_STATE;
+   }
+   return UBX_MSG_NONE;
+}
+
+ubx_message_type_t ubx_identify_message(const uint8_t *msg, uint16_t payload_len)
+{
+   // Identify the type of a complete, checksum-verified message
+   const uint8_t msg_class = msg[UBX_MSG_CLASS_OFFSET], msg_id = msg[UBX_MSG_ID_OFFSET];
+   if ((msg_class == 0x01) && (msg_id == 0x07) && (payload_len == sizeof(ubx_nav_pvt_t)))
+      return UBX_NAV_PVT;
+   else if ((msg_class == 0x0D) && (msg_id == 0x03) && (payload_len == sizeof(ubx_tim_tm2_t)))
+      return UBX_TIM_TM2;
+   else if ((msg_class == 0x06) && (msg_id == 0x8B))
+      return UBX_CFG_VALGET;
+   else if ((msg_class == 0x0A) && (msg_id == 0x04))
+      return UBX_MON_VER;
+   else if ((msg_class == 0x05) && ((msg_id == 0x00) || (msg_id == 0x01)))
+      return UBX_ACK_ACK;
+   return UBX_MSG_UNKNOWN;
+}
+
+uint16_t ubx_frame_message(uint8_t msg_class, uint8_t msg_id, const void *payload, uint16_t payload_len, uint8_t *packet)
+{
+   // Wrap a payload with the sync characters, header, and Fletcher checksum
+   packet[UBX_MSG_SYNC1_OFFSET] = UBX_SYNC1_CHAR;
+   packet[UBX_MSG_SYNC2_OFFSET] = UBX_SYNC2_CHAR;
+   packet[UBX_MSG_CLASS_OFFSET] = msg_class;
+   packet[UBX_MSG_ID_OFFSET] = msg_id;
+   packet[UBX_MSG_LEN_OFFSET] = (uint8_t)(payload_len & 0xFF);
+   packet[UBX_MSG_LEN_OFFSET + 1] = (uint8_t)(payload_len >> 8);
+   if (payload_len)
+      memcpy(packet + UBX_MSG_PAYLOAD_OFFSET, payload, payload_len);
+   uint8_t ck_a = 0, ck_b = 0;
+   for (uint16_t i = UBX_MSG_CLASS_OFFSET; i < (UBX_MSG_PAYLOAD_OFFSET + payload_len); ++i)
+   {
+      ck_a += packet[i];
+      ck_b += ck_a;
+   }
+   packet[UBX_MSG_PAYLOAD_OFFSET + payload_len] = ck_a;
+   packet[UBX_MSG_PAYLOAD_OFFSET + payload_len + 1] = ck_b;
+   return payload_len + UBX_PACKET_OVERHEAD;
+}
+
+double ubx_tm2_to_gps_timestamp(uint16_t week_number, uint32_t tow_ms, uint32_t tow_sub_ms)
+{
+   // Convert a TIM-TM2 week number and time of week into seconds since the GPS epoch
+   return ((double)week_number * 604800.0) + ((double)tow_ms * 0.001) + ((double)tow_sub_ms * 0.000000001);
+}
@@ -0,0 +1,143 @@
+#ifndef __UBX_HEADER_H__
+#define __UBX_HEADER_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define UBX_MSG_SYNC1_OFFSET           0
+#define UBX_MSG_SYNC2_OFFSET           1
+#define UBX_MSG_CLASS_OFFSET           2
+#define UBX_MSG_ID_OFFSET              3
+#define UBX_MSG_LEN_OFFSET             4
+#define UBX_MSG_PAYLOAD_OFFSET         6
+#define UBX_MAX_PAYLOAD_SIZE           255
+#define UBX_MSG_CHKSUM_LEN             2
+#define UBX_PACKET_OVERHEAD            (UBX_MSG_PAYLOAD_OFFSET + UBX_MSG_CHKSUM_LEN)
+#define UBX_MAX_PACKET_SIZE            (UBX_MAX_PAYLOAD_SIZE + UBX_PACKET_OVERHEAD)
+
+#define UBX_SYNC1_CHAR                 0xB5
+#define UBX_SYNC2_CHAR                 0x62
+
+#define UBX_FIX_TYPE_2D                0x02
+#define UBX_FIX_TYPE_3D                0x03
+
+// UBX received packet state
+typedef enum
+{
+   UBX_PACKET_INIT_STATE,
+   UBX_PACKET_SYNC_STATE,
+   UBX_PACKET_CLASS_STATE,
+   UBX_PACKET_ID_STATE,
+   UBX_PACKET_LEN1_STATE,
+   UBX_PACKET_LEN2_STATE,
+   UBX_PACKET_PAYLOAD_STATE,
+   UBX_PACKET_CK_A_STATE,
+   UBX_PACKET_CK_B_STATE
+} ubx_packet_state_t;
+
+// UBX packet type
+typedef enum
+{
+   UBX_MSG_NONE,
+   UBX_MSG_UNKNOWN,
+   UBX_MON_VER,
+   UBX_NAV_PVT,
+   UBX_TIM_TM2,
+   UBX_CFG_VALGET,
+   UBX_ACK_ACK
+} ubx_message_type_t;
+
+// Relevant UBX message structures
+#pragma pack(push, 1)
+typedef struct {
+   uint32_t iTOW;
+   uint16_t year;
+   uint8_t month, day, hour, min, sec;
+   union {
+      uint8_t valid;
+      struct {
+         uint8_t validDate: 1;
+         uint8_t validTime: 1;
+         uint8_t fullyResolved: 1;
+         uint8_t validMag: 1;
+      };
+   };
+   uint32_t tAcc;
+   int32_t nano;
+   uint8_t fixType;
+   union {
+      uint8_t flags;
+      struct {
+         uint8_t gnssFixOK: 1;
+         uint8_t diffSoln: 1;
+         uint8_t psmState: 3;
+         uint8_t headVehValid: 1;
+         uint8_t carrSoln: 2;
+      };
+   };
+   union {
+      uint8_t flags2;
+      struct {
+         uint8_t confirmedAvai: 1;
+         uint8_t confirmedDate: 1;
+         uint8_t confirmedTime: 1;
+      };
+   };
+   uint8_t numSV;
+   int32_t lon, lat, height, hMSL;
+   uint32_t hAcc, vAcc;
+   int32_t velN, velE, velD, gSpeed, headMot;
+   uint32_t sAcc, headAcc;
+   uint16_t pDOP;
+   uint8_t reserved1[6];
+   int32_t headVeh;
+   union {
+      uint16_t flags3;
+      struct {
+         uint8_t invalidLlh: 1;
+         uint8_t lastCorrectionAge: 4;
+         uint8_t unused: 8;
+         uint8_t authTime: 1;
+         uint8_t nmaFixStatus: 1;
+      };
+   };
+} __attribute__((packed)) ubx_nav_pvt_t;
+
+typedef struct {
+   uint8_t ch;
+   union {
+      uint8_t flags;
+      struct {
+         uint8_t mode: 1;
+         uint8_t run: 1;
+         uint8_t newFallingEdge: 1;
+         uint8_t timeBase: 2;
+         uint8_t utc: 1;
+         uint8_t time: 1;
+         uint8_t newRisingEdge: 1;
+      };
+   };
+   uint16_t count, wnR, wnF;
+   uint32_t towMsR, towSubMsR, towMsF, towSubMsF;
+   int32_t accEst;
+} __attribute__((packed)) ubx_tim_tm2_t;
+#pragma pack(pop)
+
+// Byte-at-a-time UBX receive state machine; the most recently completed packet stays in the buffer until the next sync
+typedef struct
+{
+   ubx_packet_state_t state;
+   uint8_t buffer[UBX_MAX_PACKET_SIZE];
+   uint16_t index, payload_len;
+   uint8_t ck_a, ck_b;
+} ubx_parser_t;
+
+void ubx_parser_init(ubx_parser_t *parser);
+ubx_message_type_t ubx_parser_consume(ubx_parser_t *parser, uint8_t rx_byte);
+ubx_message_type_t ubx_identify_message(const uint8_t *msg, uint16_t payload_len);
+uint16_t ubx_frame_message(uint8_t msg_class, uint8_t msg_id, const void *payload, uint16_t payload_len, uint8_t *packet);
+double ubx_tm2_to_gps_timestamp(uint16_t week_number, uint32_t tow_ms, uint32_t tow_sub_ms);
+
+static inline const uint8_t* ubx_parser_payload(const ubx_parser_t *parser) { return parser->buffer + UBX_MSG_PAYLOAD_OFFSET; }
+
+#endif  // __UBX_HEADER_H__
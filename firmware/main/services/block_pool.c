@@ -0,0 +1,129 @@
+#include <esp_heap_caps.h>
+#include "block_pool.h"
+#include "logging.h"
+
+// Bookkeeping stored immediately before every block, padded so that the block itself keeps the slab's alignment
+typedef struct
+{
+   void *pool;
+   uint32_t references;
+} block_header_t;
+
+#define BLOCK_HEADER_SIZE                    ((sizeof(block_header_t) + BLOCK_POOL_ALIGNMENT - 1) & ~(size_t)(BLOCK_POOL_ALIGNMENT - 1))
+
+// Fixed-size slab pool with its free list
+typedef struct
+{
+   block_pool_config_t config;
+   QueueHandle_t free_blocks;
+   block_pool_statistics_t statistics;
+} block_pool_t;
+
+// Static global variables
+static block_pool_t block_pools[BLOCK_POOL_MAX_POOLS];
+static uint32_t block_pools_num_created;
+
+static inline block_header_t* block_pool_header(void *block)
+{
+   return (block_header_t*)((uint8_t*)block - BLOCK_HEADER_SIZE);
+}
+
+block_pool_handle_t block_pool_create(const block_pool_config_t *config, uint32_t num_blocks)
+{
+   // Reserve a slot and a free list able to hold every block the pool may ever grow to
+   if (block_pools_num_created >= BLOCK_POOL_MAX_POOLS)
+   {
+      printe("Unable to create block pool \"%s\", increase BLOCK_POOL_MAX_POOLS", config->name);
+      return NULL;
+   }
+   block_pool_t *pool = block_pools + block_pools_num_created++;
+   memset(pool, 0, sizeof(block_pool_t));
+   pool->config = *config;
+   pool->free_blocks = xQueueCreate(config->max_blocks, sizeof(void*));
+   if (block_pool_grow(pool, num_blocks) < num_blocks)
+      printw("Only %lu of %lu blocks available for block pool \"%s\"", pool->statistics.num_blocks, num_blocks, config->name);
+   if (num_blocks && !pool->statistics.num_blocks)
+   {
+      printe("Unable to allocate any PSRAM for block pool \"%s\", is PSRAM present?", config->name);
+      vQueueDelete(pool->free_blocks);
+      --block_pools_num_created;
+      return NULL;
+   }
+   return pool;
+}
+
+uint32_t block_pool_grow(block_pool_handle_t pool_handle, uint32_t num_blocks)
+{
+   // Allocate each slab from PSRAM only, stopping short rather than taking internal RAM once PSRAM runs out
+   block_pool_t *pool = (block_pool_t*)pool_handle;
+   const size_t slab_size = BLOCK_HEADER_SIZE + pool->config.block_size;
+   uint32_t num_allocated = 0;
+   for (; (num_allocated < num_blocks) && (pool->statistics.num_blocks < pool->config.max_blocks); ++num_allocated)
+   {
+      block_header_t *header = (block_header_t*)heap_caps_aligned_alloc(BLOCK_POOL_ALIGNMENT, slab_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      if (!header)
+         break;
+      header->pool = pool;
+      header->references = 0;
+      pool->statistics.psram_bytes += slab_size;
+      ++pool->statistics.num_blocks;
+      void *block = (uint8_t*)header + BLOCK_HEADER_SIZE;
+      xQueueSend(pool->free_blocks, &block, 0);
+   }
+   return num_allocated;
+}
+
+void* block_pool_acquire(block_pool_handle_t pool_handle)
+{
+   // Take a free block holding a single reference, counting the attempt if none is available
+   block_pool_t *pool = (block_pool_t*)pool_handle;
+   void *block = NULL;
+   if (xQueueReceive(pool->free_blocks, &block, 0) != pdTRUE)
+   {
+      __atomic_add_fetch(&pool->statistics.exhausted, 1, __ATOMIC_RELAXED);
+      return NULL;
+   }
+   block_pool_header(block)->references = 1;
+   const uint32_t in_use = __atomic_add_fetch(&pool->statistics.in_use, 1, __ATOMIC_RELAXED);
+   if (in_use > pool->statistics.high_water)
+      pool->statistics.high_water = in_use;
+   return block;
+}
+
+void block_pool_retain(void *block)
+{
+   __atomic_add_fetch(&block_pool_header(block)->references, 1, __ATOMIC_ACQ_REL);
+}
+
+void block_pool_release(void *block)
+{
+   // Return the block to its pool once its last reference is released
+   block_header_t *header = block_pool_header(block);
+   if (__atomic_sub_fetch(&header->references, 1, __ATOMIC_ACQ_REL) == 0)
+   {
+      block_pool_t *pool = (block_pool_t*)header->pool;
+      __atomic_sub_fetch(&pool->statistics.in_use, 1, __ATOMIC_RELAXED);
+      xQueueSend(pool->free_blocks, &block, 0);
+   }
+}
+
+void block_pool_get_statistics(block_pool_handle_t pool, block_pool_statistics_t *statistics)
+{
+   // Return a snapshot of the pool's occupancy and footprint
+   *statistics = ((const block_pool_t*)pool)->statistics;
+}
+
+void block_pool_report(void)
+{
+   // Log the occupancy of every pool along with how much internal RAM remains for DMA, Wi-Fi, and task stacks
+   for (uint32_t i = 0; i < block_pools_num_created; ++i)
+   {
+      block_pool_statistics_t statistics;
+      block_pool_get_statistics(block_pools + i, &statistics);
+      print("Block pool \"%s\": %lu of %lu blocks in use, high water %lu, exhausted %lu times, %u KB PSRAM",
+            block_pools[i].config.name, statistics.in_use, statistics.num_blocks, statistics.high_water, statistics.exhausted,
+            (unsigned)(statistics.psram_bytes / 1024));
+   }
+   print("Internal RAM: %u KB free, %u KB minimum free, %u KB largest block", (unsigned)(heap_caps_get_free_size(MALLOC_CAP_INTERNAL) / 1024),
+         (unsigned)(heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL) / 1024), (unsigned)(heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL) / 1024));
+}
@@ -0,0 +1,35 @@
+#ifndef __BLOCK_POOL_HEADER_H__
+#define __BLOCK_POOL_HEADER_H__
+
+#include <freertos/FreeRTOS.h>
+#include "app_config.h"
+
+// Pools of blocks that live long enough to be handed between tasks, always placed in PSRAM and never falling back to
+//    internal RAM, which is left to DMA, Wi-Fi, BLE, USB and task stacks; a pool is created short of blocks (or not at
+//    all) rather than taking internal RAM when PSRAM is absent or exhausted
+typedef struct
+{
+   const char *name;
+   size_t block_size;
+   uint32_t max_blocks;
+} block_pool_config_t;
+
+typedef struct
+{
+   uint32_t num_blocks, in_use, high_water, exhausted;
+   size_t psram_bytes;
+} block_pool_statistics_t;
+
+typedef void* block_pool_handle_t;
+
+// Pools are created and grown only during initialization; acquiring, retaining, and releasing blocks never allocate,
+//    never block, and may be done from any task
+block_pool_handle_t block_pool_create(const block_pool_config_t *config, uint32_t num_blocks);
+uint32_t block_pool_grow(block_pool_handle_t pool, uint32_t num_blocks);
+void* block_pool_acquire(block_pool_handle_t pool);
+void block_pool_retain(void *block);
+void block_pool_release(void *block);
+void block_pool_get_statistics(block_pool_handle_t pool, block_pool_statistics_t *statistics);
+void block_pool_report(void);
+
+#endif  // __BLOCK_POOL_HEADER_H__
@@ -0,0 +1,37 @@
+#include <esp_timer.h>
+#include "boot_profile.h"
+#include "logging.h"
+#include "usb.h"
+
+// Static global variables
+static packet_boot_profile_t boot_profile;
+static const char * const boot_phase_names[BOOT_PHASE_COUNT] = {
+   "app_main entered", "NVS storage ready", "USB ready", "Audio sinks ready", "Audio capture started", "First audio block",
+   "GPS responding", "GPS configured", "GPS time valid", "GPS 3D fix", "First synchronized audio block",
+   "Network stack ready", "Wi-Fi started"
+};
+
+void boot_profile_mark(boot_phase_t phase)
+{
+   // Record only the first time each phase is reached, from whichever task reaches it
+   uint32_t unset = 0;
+   const uint32_t now_us = (uint32_t)esp_timer_get_time();
+   __atomic_compare_exchange_n(&boot_profile.phase_us[phase], &unset, now_us ? now_us : 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+bool boot_profile_reached(boot_phase_t phase)
+{
+   return __atomic_load_n(&boot_profile.phase_us[phase], __ATOMIC_RELAXED) != 0;
+}
+
+void boot_profile_report(void)
+{
+   // Send the phase timestamps to the host and log every phase reached so far
+   packet_boot_profile_t snapshot;
+   for (int i = 0; i < BOOT_PHASE_COUNT; ++i)
+      snapshot.phase_us[i] = __atomic_load_n(&boot_profile.phase_us[i], __ATOMIC_RELAXED);
+   usb_write_packet(PACKET_TYPE_BOOT_PROFILE, 0, &snapshot, sizeof(snapshot), NULL, 0);
+   for (int i = 0; i < BOOT_PHASE_COUNT; ++i)
+      if (snapshot.phase_us[i])
+         print("Boot profile: %-32s %9.3f ms", boot_phase_names[i], snapshot.phase_us[i] * 1.0e-3);
+}
@@ -0,0 +1,11 @@
+#ifndef __BOOT_PROFILE_HEADER_H__
+#define __BOOT_PROFILE_HEADER_H__
+
+#include "app_config.h"
+#include "packet.h"
+
+void boot_profile_mark(boot_phase_t phase);
+bool boot_profile_reached(boot_phase_t phase);
+void boot_profile_report(void);
+
+#endif  // __BOOT_PROFILE_HEADER_H__
@@ -0,0 +1,123 @@
+#include <freertos/FreeRTOS.h>
+#include "commands.h"
+#include "history.h"
+#include "logging.h"
+#include "network.h"
+#include "packet.h"
+#include "usb.h"
+
+// Queued command structure
+typedef struct
+{
+   command_source_t source;
+   TickType_t deadline;
+   packet_history_request_t request;
+} command_t;
+
+// Static global variables
+static QueueHandle_t command_queue;
+static packet_parser_t command_parsers[COMMAND_SOURCE_NETWORK + 1];
+static uint8_t command_parser_buffers[COMMAND_SOURCE_NETWORK + 1][sizeof(packet_header_t) + PACKET_MAX_COMMAND_PAYLOAD_BYTES];
+static int16_t history_chunk_buffer[HISTORY_RESPONSE_CHUNK_SAMPLES];
+
+static void commands_write_packet(command_source_t source, packet_type_t type, const void *header, size_t header_len, const uint8_t *data, size_t data_len)
+{
+   // Route a response packet back over the channel on which its command arrived
+   switch (source)
+   {
+      case COMMAND_SOURCE_USB:
+         usb_write_packet(type, 0, header, header_len, data, data_len);
+         break;
+      case COMMAND_SOURCE_NETWORK:
+         network_write_packet(type, 0, header, header_len, data, data_len);
+         break;
+      default:
+         break;
+   }
+}
+
+static void usb_data_received(const uint8_t *data, size_t data_len)
+{
+   // Forward all incoming USB data to the command parser
+   commands_process_data(COMMAND_SOURCE_USB, data, data_len);
+}
+
+static bool history_segment_ready(double timestamp, const int16_t *samples, uint32_t num_samples, void *context)
+{
+   // Send a contiguous segment of historical audio and stop early if the response deadline has passed
+   const command_t *command = (const command_t*)context;
+   const packet_history_audio_t segment_header = { .request_id = command->request.request_id, .timestamp = timestamp };
+   commands_write_packet(command->source, PACKET_TYPE_HISTORY_AUDIO, &segment_header, sizeof(segment_header), (const uint8_t*)samples, num_samples * sizeof(int16_t));
+   return (int32_t)(command->deadline - xTaskGetTickCount()) > 0;
+}
+
+static void commands_handle_history_request(command_t *command)
+{
+   // Clamp the requested window to the maximum allowable response size
+   bool truncated = false;
+   uint32_t num_samples = 0;
+   double end_timestamp = command->request.end_timestamp;
+   if ((end_timestamp - command->request.start_timestamp) > HISTORY_MAX_REQUEST_SECONDS)
+   {
+      end_timestamp = command->request.start_timestamp + HISTORY_MAX_REQUEST_SECONDS;
+      truncated = true;
+   }
+
+   // Stream all available audio within the window followed by a completion status
+   print("Retrieving audio history for window [%0.6f, %0.6f]", command->request.start_timestamp, end_timestamp);
+   history_status_t status = history_read(command->request.start_timestamp, end_timestamp, history_chunk_buffer,
+                                          HISTORY_RESPONSE_CHUNK_SAMPLES, history_segment_ready, command, &num_samples);
+   if (truncated && (status == HISTORY_STATUS_OK))
+      status = HISTORY_STATUS_TRUNCATED;
+   const packet_history_status_t status_packet = { .request_id = command->request.request_id, .status = status, .num_samples = num_samples };
+   commands_write_packet(command->source, PACKET_TYPE_HISTORY_STATUS, &status_packet, sizeof(status_packet), NULL, 0);
+}
+
+static void commands_task(void *args)
+{
+   // Service queued commands one at a time in order of arrival
+   command_t command;
+   while (true)
+      if (xQueueReceive(command_queue, &command, portMAX_DELAY))
+      {
+         command.deadline = xTaskGetTickCount() + pdMS_TO_TICKS(HISTORY_RESPONSE_TIMEOUT_MS);
+         commands_handle_history_request(&command);
+      }
+}
+
+void commands_initialize(void)
+{
+   // Initialize the command parsers and processing queue
+   for (int i = 0; i <= COMMAND_SOURCE_NETWORK; ++i)
+      packet_parser_init(&command_parsers[i], command_parser_buffers[i], sizeof(command_parser_buffers[i]));
+   command_queue = xQueueCreate(HISTORY_REQUEST_QUEUE_LENGTH, sizeof(command_t));
+
+   // Listen for commands over USB and start the command processing task
+   usb_add_data_callback(usb_data_received);
+   xTaskCreatePinnedToCore(commands_task, "commands_task", 3072, NULL, 4, NULL, 0);
+}
+
+void commands_process_data(command_source_t source, const uint8_t *data, size_t data_len)
+{
+   // Parse incoming bytes into command packets and queue any complete commands
+   const packet_header_t *header;
+   const uint8_t *payload;
+   while (data_len)
+   {
+      const size_t bytes_consumed = packet_parser_consume(&command_parsers[source], data, data_len, &header, &payload);
+      data += bytes_consumed;
+      data_len -= bytes_consumed;
+      if (header && (header->type == PACKET_TYPE_HISTORY_REQUEST) && (header->length == sizeof(packet_history_request_t)))
+      {
+         command_t command = { .source = source };
+         memcpy(&command.request, payload, sizeof(command.request));
+         if (xQueueSend(command_queue, &command, 0) != pdTRUE)
+         {
+            // Tell the requester to retry later rather than leaving it to wait out its own timeout
+            printw("Command queue full, rejecting history request %lu as busy", command.request.request_id);
+            const packet_history_status_t status_packet = { .request_id = command.request.request_id, .status = HISTORY_STATUS_BUSY, .num_samples = 0 };
+            commands_write_packet(source, PACKET_TYPE_HISTORY_STATUS, &status_packet, sizeof(status_packet), NULL, 0);
+         }
+      }
+   }
+}
@@ -0,0 +1,14 @@
+#ifndef __COMMANDS_HEADER_H__
+#define __COMMANDS_HEADER_H__
+
+#include "app_config.h"
+
+typedef enum {
+   COMMAND_SOURCE_USB = 0,
+   COMMAND_SOURCE_NETWORK
+} command_source_t;
+
+void commands_initialize(void);
+void commands_process_data(command_source_t source, const uint8_t *data, size_t data_len);
+
+#endif  // __COMMANDS_HEADER_H__
@@ -0,0 +1,88 @@
+#include <freertos/FreeRTOS.h>
+#include "deferred_log.h"
+#include "usb.h"
+
+#define DEFERRED_LOG_NUM_CORES         2
+#define DEFERRED_LOG_TAG               "CivicAlert"
+#define DEFERRED_LOG_MAX_LINE_LEN      256
+
+// Per-core record rings, usable before the drain task has been started
+static uint8_t deferred_log_buffers[DEFERRED_LOG_NUM_CORES][LOGGING_DEFERRED_RING_SIZE_BYTES] __attribute__((aligned(LOG_RECORD_ALIGNMENT)));
+static log_ring_t deferred_log_rings[DEFERRED_LOG_NUM_CORES] = {
+   { .buffer = deferred_log_buffers[0], .size = LOGGING_DEFERRED_RING_SIZE_BYTES, .mask = LOGGING_DEFERRED_RING_SIZE_BYTES - 1 },
+   { .buffer = deferred_log_buffers[1], .size = LOGGING_DEFERRED_RING_SIZE_BYTES, .mask = LOGGING_DEFERRED_RING_SIZE_BYTES - 1 }
+};
+static uint32_t deferred_log_reported_drops;
+static bool deferred_log_started;
+
+static void deferred_log_emit(const log_record_t *record)
+{
+   // Either forward the raw record for decoding on the host or format it here in the usual ESP-IDF style
+   if (LOGGING_DEFERRED_BINARY_OUTPUT)
+      usb_write_packet(PACKET_TYPE_LOG, 0, NULL, 0, (const uint8_t*)record, record->length);
+   else
+   {
+      static const char level_letters[] = { 'N', 'E', 'W', 'I', 'D', 'V' };
+      char line[DEFERRED_LOG_MAX_LINE_LEN];
+      log_format_record(record, (const char*)(uintptr_t)record->format, line, sizeof(line));
+      esp_log_write((esp_log_level_t)record->level, DEFERRED_LOG_TAG, "%c (%lu) %s: %s\n", level_letters[record->level % sizeof(level_letters)],
+                    (unsigned long)record->timestamp_ms, DEFERRED_LOG_TAG, line);
+   }
+}
+
+static void deferred_log_task(void *args)
+{
+   while (true)
+   {
+      // Drain both rings in timestamp order until neither has a committed record remaining
+      const log_record_t *records[DEFERRED_LOG_NUM_CORES];
+      for (int i = 0; i < DEFERRED_LOG_NUM_CORES; ++i)
+         records[i] = log_ring_peek(deferred_log_rings + i);
+      while (records[0] || records[1])
+      {
+         const int core = (!records[1] || (records[0] && ((int32_t)(records[0]->timestamp_ms - records[1]->timestamp_ms) <= 0))) ? 0 : 1;
+         deferred_log_emit(records[core]);
+         log_ring_consume(deferred_log_rings + core, records[core]);
+         records[core] = log_ring_peek(deferred_log_rings + core);
+      }
+
+      // Report any records lost to full rings since the last pass
+      const uint32_t dropped = deferred_log_get_dropped();
+      if (dropped != deferred_log_reported_drops)
+      {
+         esp_log_write(ESP_LOG_WARN, DEFERRED_LOG_TAG, "W (%lu) %s: Deferred log rings full, %lu records dropped\n",
+                       (unsigned long)esp_log_timestamp(), DEFERRED_LOG_TAG, (unsigned long)(dropped - deferred_log_reported_drops));
+         deferred_log_reported_drops = dropped;
+      }
+      vTaskDelay(pdMS_TO_TICKS(LOGGING_DEFERRED_DRAIN_INTERVAL_MS));
+   }
+}
+
+void deferred_log_initialize(void)
+{
+   // Start the low-priority task responsible for formatting or forwarding captured records, exactly once
+   if (__atomic_exchange_n(&deferred_log_started, true, __ATOMIC_ACQ_REL))
+      return;
+   deferred_log_reported_drops = 0;
+   xTaskCreatePinnedToCore(deferred_log_task, "deferred_log_task", 3072, NULL, LOGGING_DEFERRED_DRAIN_PRIORITY, NULL, 0);
+}
+
+void deferred_log_write(esp_log_level_t level, const char *format, const log_arg_t *args, uint32_t num_args)
+{
+   // Start draining on first use in text mode so that applications which never initialize logging still see output
+   if (!LOGGING_DEFERRED_BINARY_OUTPUT && !__atomic_load_n(&deferred_log_started, __ATOMIC_RELAXED))
+      deferred_log_initialize();
+
+   // Capture the format string address and raw arguments into the ring belonging to the calling core
+   const uint32_t core = (uint32_t)xPortGetCoreID();
+   log_ring_write(deferred_log_rings + (core % DEFERRED_LOG_NUM_CORES), (uint8_t)level, (uint8_t)core, esp_log_timestamp(), format, args, num_args);
+}
+
+uint32_t deferred_log_get_dropped(void)
+{
+   // Return the total number of records dropped across all cores
+   uint32_t dropped = 0;
+   for (int i = 0; i < DEFERRED_LOG_NUM_CORES; ++i)
+      dropped += __atomic_load_n(&deferred_log_rings[i].dropped, __ATOMIC_RELAXED);
+   return dropped;
+}
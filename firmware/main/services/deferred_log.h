@@ -0,0 +1,12 @@
+#ifndef __DEFERRED_LOG_HEADER_H__
+#define __DEFERRED_LOG_HEADER_H__
+
+#include <esp_log.h>
+#include "app_config.h"
+#include "log_format.h"
+
+void deferred_log_initialize(void);
+void deferred_log_write(esp_log_level_t level, const char *format, const log_arg_t *args, uint32_t num_args);
+uint32_t deferred_log_get_dropped(void);
+
+#endif  // __DEFERRED_LOG_HEADER_H__
@@ -0,0 +1,118 @@
+#include <freertos/FreeRTOS.h>
+#include <esp_heap_caps.h>
+#include "history.h"
+#include "logging.h"
+
+// History slot structure holding one timestamped block of audio
+typedef struct
+{
+   volatile uint32_t generation;
+   double timestamp;
+   uint32_t num_samples;
+   int16_t *samples;
+} history_slot_t;
+
+// Static global variables
+static history_slot_t *history_slots;
+static int16_t *history_storage;
+static volatile uint32_t history_next_slot;
+static uint32_t history_num_slots;
+
+void history_initialize(void)
+{
+   // Allocate as many one-second slots in PSRAM as are available, up to the configured duration
+   history_next_slot = 0;
+   history_num_slots = HISTORY_DURATION_SECONDS;
+   history_storage = NULL;
+   while (history_num_slots && !history_storage)
+   {
+      history_storage = (int16_t*)heap_caps_malloc(history_num_slots * AUDIO_PACKET_SIZE_BYTES, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      if (!history_storage)
+         history_num_slots = (history_num_slots > 1) ? (history_num_slots - (history_num_slots + 3) / 4) : 0;
+   }
+   if (!history_num_slots)
+   {
+      printw("No PSRAM available for audio history, on-demand retrieval disabled");
+      return;
+   }
+   else if (history_num_slots < HISTORY_DURATION_SECONDS)
+      printw("Audio history limited to %lu seconds by available PSRAM", history_num_slots);
+
+   // Initialize the slot descriptors in internal RAM
+   history_slots = (history_slot_t*)calloc(history_num_slots, sizeof(history_slot_t));
+   if (!history_slots)
+   {
+      printe("Unable to allocate %lu audio history slot descriptors, on-demand retrieval disabled", history_num_slots);
+      heap_caps_free(history_storage);
+      history_storage = NULL;
+      history_num_slots = 0;
+      return;
+   }
+   for (uint32_t i = 0; i < history_num_slots; ++i)
+      history_slots[i].samples = history_storage + (i * AUDIO_SAMPLE_RATE_HZ);
+}
+
+uint32_t history_get_duration_seconds(void)
+{
+   // Return the number of seconds of audio that can be retained
+   return history_num_slots;
+}
+
+void history_store(double timestamp, const int16_t *samples, uint32_t num_samples)
+{
+   // Overwrite the oldest slot, marking it as in-progress with an odd generation count
+   if (!history_num_slots)
+      return;
+   history_slot_t *slot = history_slots + history_next_slot;
+   slot->generation++;
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   slot->timestamp = timestamp;
+   slot->num_samples = (num_samples > AUDIO_SAMPLE_RATE_HZ) ? AUDIO_SAMPLE_RATE_HZ : num_samples;
+   memcpy(slot->samples, samples, slot->num_samples * sizeof(int16_t));
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   slot->generation++;
+   history_next_slot = (history_next_slot + 1) % history_num_slots;
+}
+
+history_status_t history_read(double start_timestamp, double end_timestamp, int16_t *chunk_buffer, uint32_t chunk_samples,
+                              history_segment_callback_t callback, void *context, uint32_t *num_samples_read)
+{
+   // Walk all slots from oldest to newest, returning any samples which overlap the requested window
+   *num_samples_read = 0;
+   const uint32_t first_slot = history_next_slot;
+   for (uint32_t i = 0; i < history_num_slots; ++i)
+   {
+      // Skip slots which are empty, being written, or untimestamped
+      history_slot_t *slot = history_slots + ((first_slot + i) % history_num_slots);
+      const uint32_t generation = slot->generation;
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      const double slot_timestamp = slot->timestamp;
+      const uint32_t slot_samples = slot->num_samples;
+      if (!generation || (generation & 1) || (slot_timestamp <= 0.0))
+         continue;
+
+      // Determine the range of sample indices within the slot overlapping the requested window
+      const double slot_end = slot_timestamp + ((double)slot_samples / AUDIO_SAMPLE_RATE_HZ);
+      if ((slot_end <= start_timestamp) || (slot_timestamp >= end_timestamp))
+         continue;
+      uint32_t start_idx = (start_timestamp > slot_timestamp) ? (uint32_t)((start_timestamp - slot_timestamp) * AUDIO_SAMPLE_RATE_HZ) : 0;
+      uint32_t end_idx = (end_timestamp < slot_end) ? (uint32_t)((end_timestamp - slot_timestamp) * AUDIO_SAMPLE_RATE_HZ) : slot_samples;
+      if (end_idx > slot_samples)
+         end_idx = slot_samples;
+
+      // Copy the samples out in bounded chunks, verifying that the slot was not overwritten mid-copy
+      while (start_idx < end_idx)
+      {
+         const uint32_t num_samples = ((end_idx - start_idx) < chunk_samples) ? (end_idx - start_idx) : chunk_samples;
+         memcpy(chunk_buffer, slot->samples + start_idx, num_samples * sizeof(int16_t));
+         __atomic_thread_fence(__ATOMIC_SEQ_CST);
+         if (slot->generation != generation)
+            return *num_samples_read ? HISTORY_STATUS_TRUNCATED : HISTORY_STATUS_NOT_AVAILABLE;
+         if (!callback(slot_timestamp + ((double)start_idx / AUDIO_SAMPLE_RATE_HZ), chunk_buffer, num_samples, context))
+            return HISTORY_STATUS_TIMEOUT;
+         *num_samples_read += num_samples;
+         start_idx += num_samples;
+      }
+   }
+   return *num_samples_read ? HISTORY_STATUS_OK : HISTORY_STATUS_NOT_AVAILABLE;
+}
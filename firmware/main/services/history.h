@@ -0,0 +1,15 @@
+#ifndef __HISTORY_HEADER_H__
+#define __HISTORY_HEADER_H__
+
+#include "app_config.h"
+#include "packet.h"
+
+typedef bool (*history_segment_callback_t)(double timestamp, const int16_t *samples, uint32_t num_samples, void *context);
+
+void history_initialize(void);
+uint32_t history_get_duration_seconds(void);
+void history_store(double timestamp, const int16_t *samples, uint32_t num_samples);
+history_status_t history_read(double start_timestamp, double end_timestamp, int16_t *chunk_buffer, uint32_t chunk_samples,
+                              history_segment_callback_t callback, void *context, uint32_t *num_samples_read);
+
+#endif  // __HISTORY_HEADER_H__
@@ -0,0 +1,53 @@
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include "latency_trace.h"
+#include "logging.h"
+#include "spool.h"
+#include "usb.h"
+
+// Static global variables
+static packet_latency_profile_t latency_profile, latency_snapshot;  // Snapshot kept off the reporting task's stack
+static portMUX_TYPE latency_profile_lock = portMUX_INITIALIZER_UNLOCKED;
+static const char * const latency_stage_names[LATENCY_STAGE_COUNT] = {
+   "DMA complete to read return", "Timestamp request to resolution", "Read return to dispatch", "Dispatch to USB write",
+   "USB write", "Dispatch to network write", "Network write", "Capture to USB handoff", "Capture to network handoff"
+};
+
+void latency_trace_record(latency_stage_t stage, int64_t start_us, int64_t end_us)
+{
+   // Skip stages whose start was never stamped, counting the rest into a power-of-two histogram
+   if (!start_us || (end_us < start_us))
+      return;
+   const uint64_t elapsed_us = (uint64_t)(end_us - start_us);
+   uint32_t bucket = 0;
+   for (uint64_t remaining = elapsed_us >> 1; remaining && (bucket < (PACKET_LATENCY_BUCKETS - 1)); remaining >>= 1)
+      ++bucket;
+   packet_latency_stage_t *histogram = &latency_profile.stages[stage];
+   portENTER_CRITICAL(&latency_profile_lock);
+   ++histogram->count;
+   histogram->total_us += elapsed_us;
+   if (elapsed_us > histogram->max_us)
+      histogram->max_us = (elapsed_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)elapsed_us;
+   ++histogram->buckets[bucket];
+   portEXIT_CRITICAL(&latency_profile_lock);
+}
+
+void latency_trace_report(void)
+{
+   // Send the stage histograms to the host alongside the other telemetry and log a summary of each stage traced so far;
+   //    the server copy is only appended to the spool's RAM batch, which the spool task forwards over TCP, so that a
+   //    stalled uplink drops the report instead of blocking the dispatch task that calls this
+   portENTER_CRITICAL(&latency_profile_lock);
+   latency_snapshot = latency_profile;
+   portEXIT_CRITICAL(&latency_profile_lock);
+   latency_snapshot.uptime_s = (uint32_t)(esp_timer_get_time() / 1000000);
+   usb_write_packet(PACKET_TYPE_LATENCY_PROFILE, 0, &latency_snapshot, sizeof(latency_snapshot), NULL, 0);
+   spool_write_packet(PACKET_TYPE_LATENCY_PROFILE, 0, &latency_snapshot, sizeof(latency_snapshot), NULL, 0);
+   for (int i = 0; i < LATENCY_STAGE_COUNT; ++i)
+   {
+      const packet_latency_stage_t *stage = &latency_snapshot.stages[i];
+      if (stage->count)
+         print("Latency profile: %-32s %9.3f ms mean, %9.3f ms max over %lu blocks", latency_stage_names[i],
+               1.0e-3 * (double)stage->total_us / stage->count, stage->max_us * 1.0e-3, stage->count);
+   }
+}
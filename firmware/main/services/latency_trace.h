@@ -0,0 +1,18 @@
+#ifndef __LATENCY_TRACE_HEADER_H__
+#define __LATENCY_TRACE_HEADER_H__
+
+#include <stdint.h>
+#include "app_config.h"
+#include "packet.h"
+
+// Times at which one captured second reached each point on its way to the sinks, in microseconds since power-on from
+//    esp_timer so that stamps taken on either core compare directly, or 0 where a point was not reached
+typedef struct
+{
+   int64_t dma_complete_us, read_return_us, timestamp_requested_us, timestamp_resolved_us, dispatched_us;
+} latency_trace_t;
+
+void latency_trace_record(latency_stage_t stage, int64_t start_us, int64_t end_us);
+void latency_trace_report(void);
+
+#endif  // __LATENCY_TRACE_HEADER_H__
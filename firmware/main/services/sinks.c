@@ -0,0 +1,158 @@
+#include "block_pool.h"
+#include "logging.h"
+#include "sinks.h"
+
+// Reference-counted view of a block as queued for a single sink
+typedef struct
+{
+   sink_block_t *block;
+   uint32_t streams;
+} sink_view_t;
+
+// Registered sink along with its delivery task and queue
+typedef struct
+{
+   sink_config_t config;
+   QueueHandle_t queue;
+   sink_statistics_t statistics;
+} sink_t;
+
+// Static global variables
+static sink_t sinks[SINKS_MAX_SINKS];
+static uint32_t sinks_num_registered;
+static block_pool_handle_t sinks_block_pool;
+static SemaphoreHandle_t sinks_register_mutex;
+
+static bool sinks_enqueue(sink_t *sink, sink_block_t *block, uint32_t streams);
+
+static void sinks_drop(sink_t *sink, const sink_view_t *view)
+{
+   // Count the dropped view and offer it to the overflow sink, if any, before releasing it
+   __atomic_add_fetch(&sink->statistics.dropped, 1, __ATOMIC_RELAXED);
+   if (sink->config.overflow_sink && sinks_enqueue((sink_t*)sink->config.overflow_sink, view->block, view->streams))
+      __atomic_add_fetch(&sink->statistics.overflowed, 1, __ATOMIC_RELAXED);
+   block_pool_release(view->block);
+}
+
+static bool sinks_enqueue(sink_t *sink, sink_block_t *block, uint32_t streams)
+{
+   // Queue a view without ever blocking the caller
+   sink_view_t view = { .block = block, .streams = streams }, evicted;
+   block_pool_retain(block);
+   bool queued = (xQueueSend(sink->queue, &view, 0) == pdTRUE);
+   if (!queued && (sink->config.drop_policy == SINK_DROP_OLDEST) && (xQueueReceive(sink->queue, &evicted, 0) == pdTRUE))
+   {
+      // Make room for the newest view by evicting the oldest one
+      sinks_drop(sink, &evicted);
+      queued = (xQueueSend(sink->queue, &view, 0) == pdTRUE);
+   }
+   if (!queued)
+   {
+      sinks_drop(sink, &view);
+      return false;
+   }
+   const uint32_t queue_depth = (uint32_t)uxQueueMessagesWaiting(sink->queue);
+   if (queue_depth > sink->statistics.queue_high_water)
+      sink->statistics.queue_high_water = queue_depth;
+   return true;
+}
+
+static void sink_task(void *args)
+{
+   // Deliver each queued view to the sink's handler, releasing it afterward
+   sink_t *sink = (sink_t*)args;
+   sink_view_t view;
+   while (true)
+   {
+      xQueueReceive(sink->queue, &view, portMAX_DELAY);
+      sink->config.handler(view.block, view.streams, sink->config.context);
+      ++sink->statistics.delivered;
+      block_pool_release(view.block);
+   }
+}
+
+void sinks_initialize(void)
+{
+   // Create the PSRAM block pool, seeded with every block the publisher can hold: one being captured, those queued for
+   //    dispatch, the one being dispatched, and the output second being assembled from it by drift correction
+   sinks_num_registered = 0;
+   sinks_register_mutex = xSemaphoreCreateMutex();
+   const block_pool_config_t pool_config = { .name = "audio_blocks", .max_blocks = SINKS_MAX_BLOCKS,
+      .block_size = sizeof(sink_block_t) + AUDIO_PACKET_SIZE_BYTES + (AUDIO_DECIMATED_ENABLED ? AUDIO_DECIMATED_PACKET_SIZE_BYTES : 0) };
+   sinks_block_pool = block_pool_create(&pool_config, AUDIO_CAPTURE_QUEUE_DEPTH + 3);
+   if (!sinks_block_pool)
+      printe("No audio blocks available, every captured second will be discarded");
+}
+
+sink_handle_t sinks_register(const sink_config_t *config)
+{
+   // Reserve a slot for the new sink
+   xSemaphoreTake(sinks_register_mutex, portMAX_DELAY);
+   if (sinks_num_registered >= SINKS_MAX_SINKS)
+   {
+      xSemaphoreGive(sinks_register_mutex);
+      printe("Unable to register sink \"%s\", increase SINKS_MAX_SINKS", config->name);
+      return NULL;
+   }
+   sink_t *sink = sinks + sinks_num_registered;
+   memset(sink, 0, sizeof(sink_t));
+   sink->config = *config;
+   sink->queue = xQueueCreate(config->queue_depth ? config->queue_depth : 1, sizeof(sink_view_t));
+
+   // Grow the pool by enough blocks to cover everything this sink can hold, so that no sink can starve capture
+   const uint32_t blocks_needed = (config->queue_depth ? config->queue_depth : 1) + 1;
+   const uint32_t blocks_allocated = sinks_block_pool ? block_pool_grow(sinks_block_pool, blocks_needed) : 0;
+   if (blocks_allocated < blocks_needed)
+      printw("Only %lu of %lu audio blocks available for sink \"%s\", captured audio may be dropped", blocks_allocated, blocks_needed, config->name);
+
+   // Start delivering to the sink only once it is fully set up
+   xTaskCreatePinnedToCore(sink_task, config->name, config->stack_size, sink, config->priority, NULL, config->core);
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   ++sinks_num_registered;
+   xSemaphoreGive(sinks_register_mutex);
+   return (sink_handle_t)sink;
+}
+
+sink_block_t* sinks_acquire_block(void)
+{
+   // Take a free block for the publisher to fill, never waiting for one to become available
+   sink_block_t *block = sinks_block_pool ? (sink_block_t*)block_pool_acquire(sinks_block_pool) : NULL;
+   if (!block)
+      return NULL;
+   block->streams = 0;
+   block->samples = (int16_t*)(block + 1);
+   block->decimated_samples = AUDIO_DECIMATED_ENABLED ? (block->samples + AUDIO_SAMPLE_RATE_HZ) : NULL;
+   return block;
+}
+
+void sinks_release_block(sink_block_t *block)
+{
+   // Drop a publisher reference to a block without publishing it
+   block_pool_release(block);
+}
+
+void sinks_publish(sink_block_t *block)
+{
+   // Queue a view of the block for every interested sink, then drop the publisher's reference
+   const uint32_t num_sinks = sinks_num_registered;
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   for (uint32_t i = 0; i < num_sinks; ++i)
+   {
+      const uint32_t streams = sinks[i].config.streams & block->streams;
+      if (streams)
+         sinks_enqueue(sinks + i, block, streams);
+   }
+   block_pool_release(block);
+}
+
+bool sinks_forward(sink_handle_t sink, const sink_block_t *block, uint32_t streams)
+{
+   // Hand a view that a sink is currently holding on to another sink
+   return sink && streams && sinks_enqueue((sink_t*)sink, (sink_block_t*)block, streams);
+}
+
+void sinks_get_statistics(sink_handle_t sink, sink_statistics_t *statistics)
+{
+   // Return a snapshot of the delivery counters for a sink
+   *statistics = ((const sink_t*)sink)->statistics;
+}
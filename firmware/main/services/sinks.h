@@ -0,0 +1,68 @@
+#ifndef __SINKS_HEADER_H__
+#define __SINKS_HEADER_H__
+
+#include <freertos/FreeRTOS.h>
+#include "app_config.h"
+#include "latency_trace.h"
+#include "spectral.h"
+
+#define SINK_STREAM_FULL_RATE                0x01
+#define SINK_STREAM_DECIMATED                0x02
+#define SINK_STREAM_SUMMARY                  0x04
+
+// Action taken when a view arrives at a sink whose queue is full
+typedef enum
+{
+   SINK_DROP_NEWEST = 0,
+   SINK_DROP_OLDEST
+} sink_drop_policy_t;
+
+// One captured second of audio, shared read-only by every sink holding a reference to it ("synchronized" is false
+//    while the timestamp still comes from the local clock because GPS time is not yet available, and "resampled" is
+//    true once the full-rate samples have been corrected for "drift_ppm" onto the GPS time grid, while "surveyed" is true
+//    once the position is the node's locked survey-in result); the spectral summary is computed from the decimated samples
+//    and so shares their timestamp, and "trace" records when the captured second completing the block passed each stage
+typedef struct
+{
+   uint32_t streams;
+   double timestamp, decimated_timestamp;
+   double lat, lon;
+   float height, drift_ppm;
+   float horizontal_accuracy, vertical_accuracy;
+   bool synchronized, resampled, surveyed;
+   int16_t *samples, *decimated_samples;
+   spectral_summary_t summary;
+   latency_trace_t trace;
+} sink_block_t;
+
+typedef void* sink_handle_t;
+typedef void (*sink_handler_t)(const sink_block_t *block, uint32_t streams, void *context);
+
+// Sink registration parameters; "streams" selects what the sink receives from every published block (zero for a
+//    sink which only receives views forwarded to it), and "overflow_sink" optionally receives any view this sink drops
+typedef struct
+{
+   const char *name;
+   sink_handler_t handler;
+   void *context;
+   uint32_t streams, queue_depth, stack_size;
+   sink_drop_policy_t drop_policy;
+   UBaseType_t priority;
+   BaseType_t core;
+   sink_handle_t overflow_sink;
+} sink_config_t;
+
+typedef struct
+{
+   uint32_t delivered, dropped, overflowed, queue_high_water;
+} sink_statistics_t;
+
+void sinks_initialize(void);
+sink_handle_t sinks_register(const sink_config_t *config);
+sink_block_t* sinks_acquire_block(void);
+void sinks_release_block(sink_block_t *block);
+void sinks_publish(sink_block_t *block);
+bool sinks_forward(sink_handle_t sink, const sink_block_t *block, uint32_t streams);
+void sinks_get_statistics(sink_handle_t sink, sink_statistics_t *statistics);
+
+#endif  // __SINKS_HEADER_H__
@@ -0,0 +1,327 @@
+#include <freertos/FreeRTOS.h>
+#include <esp_heap_caps.h>
+#include <esp_partition.h>
+#include "logging.h"
+#include "network.h"
+#include "spool.h"
+#include "spool_format.h"
+
+#define SPOOL_MAX_PACKET_SIZE_BYTES    (sizeof(packet_header_t) + sizeof(packet_audio_t) + AUDIO_PACKET_SIZE_BYTES)
+
+// Spool batch state within the flash partition
+typedef enum
+{
+   SPOOL_BLOCK_EMPTY = 0,
+   SPOOL_BLOCK_UNDRAINED,
+   SPOOL_BLOCK_DRAINED
+} spool_block_state_t;
+
+// RAM batch buffer being filled or waiting to be written to flash
+typedef struct
+{
+   uint8_t *batch;
+   uint32_t data_len, first_packet_offset;
+   volatile bool pending;
+} spool_buffer_t;
+
+// Static global variables
+static const esp_partition_t *spool_partition;
+static SemaphoreHandle_t spool_mutex;
+static TaskHandle_t spool_task_handle;
+static spool_buffer_t spool_buffers[SPOOL_NUM_BATCH_BUFFERS];
+static uint32_t spool_fill_index, spool_flush_index;
+static uint8_t *spool_block_states;
+static uint32_t *spool_block_sequences;
+static uint32_t spool_num_blocks, spool_write_block, spool_next_sequence;
+static uint32_t spool_dropped_packets, spool_overwritten_batches;
+static uint16_t spool_packet_sequence;
+static uint8_t *spool_drain_batch, *spool_drain_packet_buffer;
+static packet_parser_t spool_drain_parser;
+static uint32_t spool_last_drained_sequence, spool_resume_sequence, spool_resume_offset;
+static volatile bool spool_drain_requested;
+
+static uint32_t spool_space_available(void)
+{
+   // Count the space left in the active buffer plus all consecutive free buffers after it
+   uint32_t space = SPOOL_BATCH_DATA_BYTES - spool_buffers[spool_fill_index].data_len;
+   for (uint32_t i = 1; i < SPOOL_NUM_BATCH_BUFFERS; ++i)
+   {
+      if (spool_buffers[(spool_fill_index + i) % SPOOL_NUM_BATCH_BUFFERS].pending)
+         break;
+      space += SPOOL_BATCH_DATA_BYTES;
+   }
+   return space;
+}
+
+static void spool_submit_active_buffer(void)
+{
+   // Hand the active buffer to the spool task and move on to the next buffer
+   spool_buffers[spool_fill_index].pending = true;
+   spool_fill_index = (spool_fill_index + 1) % SPOOL_NUM_BATCH_BUFFERS;
+   xTaskNotifyGive(spool_task_handle);
+}
+
+static void spool_append(const uint8_t *data, size_t data_len)
+{
+   // Copy data into the active batch buffer, submitting buffers to the spool task as they fill
+   while (data_len)
+   {
+      spool_buffer_t *buffer = spool_buffers + spool_fill_index;
+      uint32_t bytes_to_copy = SPOOL_BATCH_DATA_BYTES - buffer->data_len;
+      if (bytes_to_copy > data_len)
+         bytes_to_copy = data_len;
+      memcpy(buffer->batch + sizeof(spool_batch_header_t) + buffer->data_len, data, bytes_to_copy);
+      buffer->data_len += bytes_to_copy;
+      data_len -= bytes_to_copy;
+      data += bytes_to_copy;
+      if (buffer->data_len == SPOOL_BATCH_DATA_BYTES)
+         spool_submit_active_buffer();
+   }
+}
+
+static void spool_write_batch(spool_buffer_t *buffer)
+{
+   // Erase the next flash block and program the finalized batch in a single aligned write
+   const uint32_t block_offset = spool_write_block * SPOOL_BATCH_SIZE_BYTES;
+   spool_batch_header_t *header = (spool_batch_header_t*)buffer->batch;
+   spool_finalize_batch(header, spool_next_sequence, buffer->data_len, buffer->first_packet_offset);
+   if (spool_block_states[spool_write_block] == SPOOL_BLOCK_UNDRAINED)
+      ++spool_overwritten_batches;
+   if ((esp_partition_erase_range(spool_partition, block_offset, SPOOL_BATCH_SIZE_BYTES) != ESP_OK) ||
+       (esp_partition_write(spool_partition, block_offset, buffer->batch, sizeof(spool_batch_header_t) + buffer->data_len) != ESP_OK))
+   {
+      printe("Failed to write spool batch %lu to flash", spool_next_sequence);
+      spool_block_states[spool_write_block] = SPOOL_BLOCK_EMPTY;
+   }
+   else
+   {
+      spool_block_states[spool_write_block] = SPOOL_BLOCK_UNDRAINED;
+      spool_block_sequences[spool_write_block] = spool_next_sequence;
+   }
+   spool_write_block = (spool_write_block + 1) % spool_num_blocks;
+   ++spool_next_sequence;
+
+   // Release the buffer for reuse
+   buffer->data_len = 0;
+   buffer->first_packet_offset = SPOOL_NO_PACKET_START;
+   buffer->pending = false;
+}
+
+static void spool_flush_pending_batches(void)
+{
+   // Write all submitted batch buffers to flash in the order they were filled
+   while (spool_buffers[spool_flush_index].pending)
+   {
+      spool_write_batch(spool_buffers + spool_flush_index);
+      spool_flush_index = (spool_flush_index + 1) % SPOOL_NUM_BATCH_BUFFERS;
+   }
+}
+
+static void spool_scan_partition(void)
+{
+   // Recover the state of every batch in the partition from its header
+   spool_batch_header_t header;
+   uint32_t newest_block = 0;
+   bool found_batch = false;
+   for (uint32_t block = 0; block < spool_num_blocks; ++block)
+   {
+      spool_block_states[block] = SPOOL_BLOCK_EMPTY;
+      if ((esp_partition_read(spool_partition, block * SPOOL_BATCH_SIZE_BYTES, &header, sizeof(header)) != ESP_OK) || !spool_batch_header_is_valid(&header))
+         continue;
+      spool_block_states[block] = (header.drained == SPOOL_BATCH_DRAINED) ? SPOOL_BLOCK_DRAINED : SPOOL_BLOCK_UNDRAINED;
+      spool_block_sequences[block] = header.sequence;
+      if (!found_batch || ((int32_t)(header.sequence - spool_block_sequences[newest_block]) > 0))
+         newest_block = block;
+      found_batch = true;
+   }
+
+   // Continue writing directly after the newest batch
+   spool_write_block = found_batch ? ((newest_block + 1) % spool_num_blocks) : 0;
+   spool_next_sequence = found_batch ? (spool_block_sequences[newest_block] + 1) : 1;
+   spool_last_drained_sequence = 0;
+   spool_resume_offset = SPOOL_NO_RESUME_OFFSET;
+}
+
+static int32_t spool_find_oldest_undrained_block(void)
+{
+   // Return the undrained block with the lowest sequence number, if any
+   int32_t oldest_block = -1;
+   for (uint32_t block = 0; block < spool_num_blocks; ++block)
+      if ((spool_block_states[block] == SPOOL_BLOCK_UNDRAINED) &&
+          ((oldest_block < 0) || ((int32_t)(spool_block_sequences[block] - spool_block_sequences[oldest_block]) < 0)))
+         oldest_block = block;
+   return oldest_block;
+}
+
+static void spool_record_resume_offset(uint32_t block, const spool_batch_header_t *header, uint32_t delivered_offset)
+{
+   // Remember how far a partly delivered batch got so that a retry skips the packets the server already received
+   if (delivered_offset == SPOOL_NO_RESUME_OFFSET)
+      return;
+   spool_resume_sequence = header->sequence;
+   spool_resume_offset = delivered_offset;
+
+   // Persist the offset in the next erased header slot so it also survives a reboot, leaving later retries to RAM once all slots are used
+   for (uint32_t i = 0; i < SPOOL_NUM_RESUME_SLOTS; ++i)
+      if (header->resume_offsets[i] == SPOOL_NO_RESUME_OFFSET)
+      {
+         esp_partition_write(spool_partition, (block * SPOOL_BATCH_SIZE_BYTES) + offsetof(spool_batch_header_t, resume_offsets) + (i * sizeof(uint32_t)), &delivered_offset, sizeof(delivered_offset));
+         break;
+      }
+}
+
+static bool spool_drain_block(uint32_t block)
+{
+   // Read and verify the entire batch
+   const spool_batch_header_t *header = (const spool_batch_header_t*)spool_drain_batch;
+   if ((esp_partition_read(spool_partition, block * SPOOL_BATCH_SIZE_BYTES, spool_drain_batch, SPOOL_BATCH_SIZE_BYTES) != ESP_OK) || !spool_batch_is_valid(header))
+   {
+      printw("Discarding corrupt spool batch in block %lu", block);
+      spool_block_states[block] = SPOOL_BLOCK_EMPTY;
+      return true;
+   }
+
+   // Resume a partly delivered batch directly after the last packet the server received
+   uint32_t offset = 0, resume_offset = spool_batch_resume_offset(header);
+   if ((header->sequence == spool_resume_sequence) && (spool_resume_offset != SPOOL_NO_RESUME_OFFSET) &&
+       ((resume_offset == SPOOL_NO_RESUME_OFFSET) || (spool_resume_offset > resume_offset)))
+      resume_offset = spool_resume_offset;
+   if (resume_offset != SPOOL_NO_RESUME_OFFSET)
+   {
+      packet_parser_init(&spool_drain_parser, spool_drain_packet_buffer, SPOOL_MAX_PACKET_SIZE_BYTES);
+      offset = resume_offset;
+   }
+
+   // Otherwise, packets only continue across batches that were written consecutively
+   else if (header->sequence != (spool_last_drained_sequence + 1))
+   {
+      packet_parser_init(&spool_drain_parser, spool_drain_packet_buffer, SPOOL_MAX_PACKET_SIZE_BYTES);
+      offset = (header->first_packet_offset == SPOOL_NO_PACKET_START) ? header->data_len : header->first_packet_offset;
+   }
+
+   // Forward each reassembled packet to the server, yielding bandwidth to live traffic
+   const uint8_t *data = (const uint8_t*)(header + 1);
+   const packet_header_t *packet;
+   const uint8_t *payload;
+   uint32_t delivered_offset = SPOOL_NO_RESUME_OFFSET;
+   while (offset < header->data_len)
+   {
+      offset += packet_parser_consume(&spool_drain_parser, data + offset, header->data_len - offset, &packet, &payload);
+      if (packet)
+      {
+         const size_t packet_len = sizeof(packet_header_t) + packet->length;
+         ((packet_header_t*)packet)->flags |= PACKET_FLAG_SPOOLED;
+         if (!network_write_framed_packet((const uint8_t*)packet, packet_len))
+         {
+            spool_record_resume_offset(block, header, delivered_offset);
+            spool_last_drained_sequence = 0;
+            return false;
+         }
+         delivered_offset = offset;
+         vTaskDelay(1 + pdMS_TO_TICKS((packet_len * 1000) / SPOOL_DRAIN_RATE_BYTES_PER_SECOND));
+      }
+   }
+
+   // Mark the batch as drained in flash without requiring an erase
+   const uint32_t drained = SPOOL_BATCH_DRAINED;
+   esp_partition_write(spool_partition, (block * SPOOL_BATCH_SIZE_BYTES) + offsetof(spool_batch_header_t, drained), &drained, sizeof(drained));
+   spool_block_states[block] = SPOOL_BLOCK_DRAINED;
+   spool_last_drained_sequence = header->sequence;
+   return true;
+}
+
+static void spool_task(void *args)
+{
+   // Write filled batches to flash and drain stored batches whenever the server is reachable
+   while (true)
+   {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SPOOL_IDLE_POLL_MS));
+      spool_flush_pending_batches();
+      if (spool_drain_requested && network_is_connected())
+      {
+         // Push out any partially filled batch so that it is drained along with the rest
+         xSemaphoreTake(spool_mutex, portMAX_DELAY);
+         if (spool_buffers[spool_fill_index].data_len && !spool_buffers[(spool_fill_index + 1) % SPOOL_NUM_BATCH_BUFFERS].pending)
+            spool_submit_active_buffer();
+         xSemaphoreGive(spool_mutex);
+         spool_flush_pending_batches();
+
+         // Drain one batch at a time so newly filled batches are still written promptly
+         const int32_t block = spool_find_oldest_undrained_block();
+         if (block < 0)
+         {
+            print("Spool drained (%lu packets dropped, %lu batches overwritten during outage)", spool_dropped_packets, spool_overwritten_batches);
+            spool_drain_requested = false;
+            spool_dropped_packets = spool_overwritten_batches = 0;
+         }
+         else if (spool_drain_block(block))
+            xTaskNotifyGive(spool_task_handle);
+      }
+   }
+}
+
+void spool_initialize(void)
+{
+   // Locate the spool partition
+   spool_partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, SPOOL_PARTITION_LABEL);
+   if (!spool_partition)
+   {
+      printe("Spool partition '%s' not found, store-and-forward disabled", SPOOL_PARTITION_LABEL);
+      return;
+   }
+
+   // Allocate batch buffers, preferring PSRAM to preserve internal RAM
+   spool_num_blocks = spool_partition->size / SPOOL_BATCH_SIZE_BYTES;
+   spool_block_states = (uint8_t*)calloc(spool_num_blocks, sizeof(uint8_t));
+   spool_block_sequences = (uint32_t*)calloc(spool_num_blocks, sizeof(uint32_t));
+   for (int i = 0; i < SPOOL_NUM_BATCH_BUFFERS; ++i)
+   {
+      spool_buffers[i].batch = (uint8_t*)heap_caps_malloc_prefer(SPOOL_BATCH_SIZE_BYTES, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+      spool_buffers[i].first_packet_offset = SPOOL_NO_PACKET_START;
+   }
+   spool_drain_batch = (uint8_t*)heap_caps_malloc_prefer(SPOOL_BATCH_SIZE_BYTES, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+   spool_drain_packet_buffer = (uint8_t*)heap_caps_malloc_prefer(SPOOL_MAX_PACKET_SIZE_BYTES, 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_DEFAULT);
+   packet_parser_init(&spool_drain_parser, spool_drain_packet_buffer, SPOOL_MAX_PACKET_SIZE_BYTES);
+
+   // Recover any batches left over from before the last reboot and start the spool task
+   spool_scan_partition();
+   spool_drain_requested = (spool_find_oldest_undrained_block() >= 0);
+   spool_mutex = xSemaphoreCreateMutex();
+   xTaskCreatePinnedToCore(spool_task, "spool_task", 3072, NULL, 1, &spool_task_handle, 0);
+   print("Spool initialized with %lu batches of %u bytes (next sequence %lu)", spool_num_blocks, SPOOL_BATCH_SIZE_BYTES, spool_next_sequence);
+}
+
+bool spool_write_packet(packet_type_t type, uint8_t flags, const void *header, size_t header_len, const uint8_t *data, size_t data_len)
+{
+   // Drop the packet if the batch buffers cannot absorb it without waiting on flash
+   packet_header_t packet_header;
+   const uint32_t packet_len = sizeof(packet_header) + header_len + data_len;
+   if (!spool_partition)
+      return false;
+   xSemaphoreTake(spool_mutex, portMAX_DELAY);
+   if (spool_space_available() < packet_len)
+   {
+      ++spool_dropped_packets;
+      xSemaphoreGive(spool_mutex);
+      return false;
+   }
+
+   // Record where the first packet in the active batch begins and append the framed packet
+   packet_init_header(&packet_header, type, spool_packet_sequence++, header_len + data_len);
+   packet_header.flags = flags;
+   if (spool_buffers[spool_fill_index].first_packet_offset == SPOOL_NO_PACKET_START)
+      spool_buffers[spool_fill_index].first_packet_offset = spool_buffers[spool_fill_index].data_len;
+   spool_append((const uint8_t*)&packet_header, sizeof(packet_header));
+   spool_append((const uint8_t*)header, header_len);
+   spool_append(data, data_len);
+   spool_drain_requested = true;
+   xSemaphoreGive(spool_mutex);
+   return true;
+}
+
+void spool_resume_drain(void)
+{
+   // Wake the spool task to begin draining as soon as the server connection is up
+   if (spool_partition)
+      xTaskNotifyGive(spool_task_handle);
+}
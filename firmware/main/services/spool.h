@@ -0,0 +1,11 @@
+#ifndef __SPOOL_HEADER_H__
+#define __SPOOL_HEADER_H__
+
+#include "app_config.h"
+#include "packet.h"
+
+void spool_initialize(void);
+bool spool_write_packet(packet_type_t type, uint8_t flags, const void *header, size_t header_len, const uint8_t *data, size_t data_len);
+void spool_resume_drain(void);
+
+#endif  // __SPOOL_HEADER_H__
@@ -0,0 +1,88 @@
+from serial import Serial
+from serial.tools.list_ports import comports
+from elftools.elf.elffile import ELFFile
+from test_audio_over_usb import read_packet
+import re, struct, sys
+
+PACKET_TYPE_LOG = 0x05
+LOG_RECORD_FORMAT = '<HBBBBHIIQ'
+LOG_ARG_INTEGER, LOG_ARG_DOUBLE, LOG_ARG_STRING, LOG_ARG_POINTER = range(4)
+LOG_LEVEL_LETTERS = 'NEWIDV'
+FORMAT_SPEC = re.compile(r'%([-+ #0]*\d*(?:\.\d+)?)(?:hh|h|ll|l|L|q|j|z|t)?([diouxXcfFeEgGaAsp%])')
+
+class FormatStrings:
+
+   def __init__(self, elf_path):
+      # Keep every allocated section so that format string addresses can be resolved to their contents
+      with open(elf_path, 'rb') as f:
+         elf = ELFFile(f)
+         self.sections = [(section['sh_addr'], section.data()) for section in elf.iter_sections()
+                          if section['sh_addr'] and section['sh_type'] == 'SHT_PROGBITS']
+      self.cache = {}
+
+   def lookup(self, address):
+      # Read the NUL-terminated string located at the given address
+      if address not in self.cache:
+         self.cache[address] = f'<unknown format string at 0x{address:08X}>'
+         for start, data in self.sections:
+            if start <= address < (start + len(data)):
+               offset = address - start
+               self.cache[address] = data[offset:data.index(b'\0', offset)].decode('latin-1')
+               break
+      return self.cache[address]
+
+def decode_arguments(record, payload):
+   # Unpack the argument slots that follow the record header
+   _, _, num_args, _, _, _, arg_types, _, _ = record
+   args, offset = [], 0
+   for i in range(num_args):
+      arg_type = (arg_types >> (2 * i)) & 0x3
+      if arg_type == LOG_ARG_STRING:
+         length = payload[offset]
+         args.append(payload[offset + 1:offset + 1 + length].decode('latin-1'))
+         offset += 1 + length
+      else:
+         args.append(struct.unpack_from('<d' if arg_type == LOG_ARG_DOUBLE else '<q', payload, offset)[0])
+         offset += 8
+   return args
+
+def format_message(format_string, args):
+   # Apply each argument with the conversion it was logged under, as the on-device drain task does
+   args = iter(args)
+   def substitute(match):
+      flags, conversion = match.groups()
+      if conversion == '%':
+         return '%'
+      try:
+         value = next(args)
+      except StopIteration:
+         return match.group(0)
+      if conversion == 'p':
+         return f'0x{value & 0xFFFFFFFF:x}'
+      if conversion in 'diouxXc':
+         value = int(value)
+         if conversion in 'uxXo' and value < 0:
+            value &= 0xFFFFFFFF
+      elif conversion in 'fFeEgGaA':
+         value = float(value)
+      return ('%' + flags + ('d' if conversion == 'i' else conversion)) % value
+   return FORMAT_SPEC.sub(substitute, format_string)
+
+if __name__ == '__main__':
+
+   if len(sys.argv) != 2:
+      print('Usage: decode_log.py <firmware.elf>')
+      sys.exit(1)
+   format_strings = FormatStrings(sys.argv[1])
+
+   for port, _, hwid in comports():
+      if '303A:4001' in hwid:
+         print('Found device on port:', port)
+         with Serial(port) as s:
+            while True:
+               packet_type, sequence, payload = read_packet(s)
+               if packet_type == PACKET_TYPE_LOG:
+                  record = struct.unpack_from(LOG_RECORD_FORMAT, payload)
+                  length, level, num_args, committed, core, reserved, arg_types, timestamp_ms, format_address = record
+                  message = format_message(format_strings.lookup(format_address), decode_arguments(record, payload[struct.calcsize(LOG_RECORD_FORMAT):]))
+                  print(f'{LOG_LEVEL_LETTERS[level % len(LOG_LEVEL_LETTERS)]} ({timestamp_ms}) [core {core}] CivicAlert: {message}')
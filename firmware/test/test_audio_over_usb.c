@@ -32,7 +32,8 @@ void app_main(void)
    xTaskCreatePinnedToCore(audio_task, "audio_task", 2048, xTaskGetCurrentTaskHandle(), 10, NULL, 1);
 
    // Start the main application task
-   float lat, lon, height;
+   double lat, lon;
+   float height;
    gps_timestamp_t audio_timestamp;
    uint32_t audio_data_ptr;
    while (true)
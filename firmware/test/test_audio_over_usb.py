@@ -3,11 +3,20 @@ from serial.tools.list_ports import comports
 from datetime import datetime
 import struct
 
-USB_PACKET_DELIMITER = [ 0x7E, 0x6F, 0x50, 0x11 ]
+PACKET_DELIMITER = [ 0x7E, 0x6F, 0x50, 0x11 ]
+PACKET_HEADER_FORMAT = '<BBHI'
+PACKET_TYPE_AUDIO = 0x01
+PACKET_TYPE_AUDIO_DECIMATED = 0x04
+PACKET_TYPE_TOA_REPORT = 0x08
+AUDIO_HEADER_FORMAT = '<dddffff'
+AUDIO_DECIMATED_HEADER_FORMAT = '<dddfIfff'
+TOA_REPORT_HEADER_FORMAT = '<dddfffffffhHIf'
 
-AUDIO_SAMPLE_RATE_HZ = 48000
-AUDIO_BYTES_PER_SAMPLE = 2
-AUDIO_DATA_LEN = AUDIO_SAMPLE_RATE_HZ * AUDIO_BYTES_PER_SAMPLE
+def read_packet(s, include_flags=False):
+   while True:
+      if s.read(1)[0] == PACKET_DELIMITER[0] and s.read(1)[0] == PACKET_DELIMITER[1] and s.read(1)[0] == PACKET_DELIMITER[2] and s.read(1)[0] == PACKET_DELIMITER[3]:
+         packet_type, flags, sequence, length = struct.unpack(PACKET_HEADER_FORMAT, s.read(struct.calcsize(PACKET_HEADER_FORMAT)))
+         return (packet_type, flags, sequence, s.read(length)) if include_flags else (packet_type, sequence, s.read(length))
 
 if __name__ == '__main__':
 
@@ -15,14 +24,20 @@ if __name__ == '__main__':
       if '303A:4001' in hwid:
          print('Found device on port:', port)
          with Serial(port) as s:
-            with open(datetime.now().strftime('%Y-%m-%d_%H-%M-%S') + '.wav', 'wb') as f:
+            file_prefix = datetime.now().strftime('%Y-%m-%d_%H-%M-%S')
+            with open(file_prefix + '.wav', 'wb') as f, open(file_prefix + '_decimated.wav', 'wb') as f_decimated:
                while True:
-                  if s.read(1)[0] == USB_PACKET_DELIMITER[0] and s.read(1)[0] == USB_PACKET_DELIMITER[1] and s.read(1)[0] == USB_PACKET_DELIMITER[2] and s.read(1)[0] == USB_PACKET_DELIMITER[3]:
-                     timestamp = struct.unpack('<d', s.read(8))[0]
-                     lat = struct.unpack('<f', s.read(4))[0]
-                     lon = struct.unpack('<f', s.read(4))[0]
-                     height = struct.unpack('<f', s.read(4))[0]
-                     data = s.read(AUDIO_DATA_LEN)
-                     #samples = struct.unpack(f'<{AUDIO_SAMPLE_RATE_HZ}h', data)
-                     print(f'Storing audio for timestamp {timestamp} @ <{lat}, {lon}, {height}>...')
+                  packet_type, sequence, payload = read_packet(s)
+                  if packet_type == PACKET_TYPE_AUDIO:
+                     timestamp, lat, lon, height, drift_ppm, horizontal_accuracy, _ = struct.unpack_from(AUDIO_HEADER_FORMAT, payload)
+                     data = payload[struct.calcsize(AUDIO_HEADER_FORMAT):]
+                     print(f'Storing audio for timestamp {timestamp} @ <{lat}, {lon}, {height}> +/-{horizontal_accuracy:.1f} m ({drift_ppm:+.2f} ppm)...')
                      f.write(data)
+                  elif packet_type == PACKET_TYPE_AUDIO_DECIMATED:
+                     timestamp, lat, lon, height, sample_rate, drift_ppm, _, _ = struct.unpack_from(AUDIO_DECIMATED_HEADER_FORMAT, payload)
+                     data = payload[struct.calcsize(AUDIO_DECIMATED_HEADER_FORMAT):]
+                     print(f'Storing {sample_rate} Hz decimated audio for timestamp {timestamp} @ <{lat}, {lon}, {height}>...')
+                     f_decimated.write(data)
+                  elif packet_type == PACKET_TYPE_TOA_REPORT:
+                     timestamp, lat, lon, height, _, _, _, uncertainty, confidence, snr_db, peak, num_snippet_samples, _, _ = struct.unpack_from(TOA_REPORT_HEADER_FORMAT, payload)
+                     print(f'Event onset at {timestamp:.6f} +/-{1e6 * uncertainty:.1f} us @ <{lat}, {lon}, {height}> ({100 * confidence:.0f}% confidence, {snr_db:.1f} dB SNR, peak {peak}, {num_snippet_samples}-sample snippet)')
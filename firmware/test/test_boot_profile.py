@@ -0,0 +1,32 @@
+from serial import Serial
+from serial.tools.list_ports import comports
+from test_audio_over_usb import read_packet
+import struct
+
+PACKET_TYPE_AUDIO = 0x01
+PACKET_TYPE_AUDIO_DECIMATED = 0x04
+PACKET_TYPE_BOOT_PROFILE = 0x06
+PACKET_FLAG_UNSYNCHRONIZED = 0x02
+BOOT_PHASE_NAMES = ['app_main entered', 'NVS storage ready', 'USB ready', 'Audio sinks ready', 'Audio capture started', 'First audio block',
+                    'GPS responding', 'GPS configured', 'GPS time valid', 'GPS 3D fix', 'First synchronized audio block',
+                    'Network stack ready', 'Wi-Fi started']
+
+if __name__ == '__main__':
+
+   for port, _, hwid in comports():
+      if '303A:4001' in hwid:
+         print('Found device on port:', port)
+         with Serial(port) as s:
+            unsynchronized_blocks = 0
+            while True:
+               packet_type, flags, sequence, payload = read_packet(s, True)
+               if packet_type in (PACKET_TYPE_AUDIO, PACKET_TYPE_AUDIO_DECIMATED) and (flags & PACKET_FLAG_UNSYNCHRONIZED):
+                  unsynchronized_blocks += 1
+               elif packet_type == PACKET_TYPE_BOOT_PROFILE:
+                  phases = struct.unpack(f'<{len(payload) // 4}I', payload)
+                  print(f'Boot profile ({unsynchronized_blocks} unsynchronized audio packets so far):')
+                  for phase_us, name in sorted((phase_us, BOOT_PHASE_NAMES[i] if i < len(BOOT_PHASE_NAMES) else f'Phase {i}')
+                                               for i, phase_us in enumerate(phases) if phase_us):
+                     print(f'   {phase_us / 1000.0:10.3f} ms  {name}')
+                  if phases[BOOT_PHASE_NAMES.index('First synchronized audio block')]:
+                     break
@@ -0,0 +1,58 @@
+#include <freertos/FreeRTOS.h>
+#include <esp_cpu.h>
+#include <nvs_flash.h>
+#include "conditioning.h"
+#include "logging.h"
+
+static int16_t reference_block[AUDIO_SAMPLE_RATE_HZ] __attribute__((aligned(16)));
+static int16_t optimized_block[AUDIO_SAMPLE_RATE_HZ] __attribute__((aligned(16)));
+
+void app_main(void)
+{
+   // Initialize the main flash partition
+   esp_err_t ret = nvs_flash_init();
+   if ((ret == ESP_ERR_NVS_NO_FREE_PAGES) || (ret == ESP_ERR_NVS_NEW_VERSION_FOUND))
+   {
+      // Partition was truncated and needs to be erased
+      ESP_ERROR_CHECK(nvs_flash_erase());
+      ESP_ERROR_CHECK(nvs_flash_init());
+   }
+
+   // Initialize identical conditioning chains for the reference and optimized implementations
+   conditioning_t reference, optimized;
+   const conditioning_config_t conditioning_config = {
+      .sample_rate_hz = AUDIO_SAMPLE_RATE_HZ,
+      .dc_blocker_cutoff_hz = CONDITIONING_DC_BLOCKER_CUTOFF_HZ,
+      .highpass_cutoff_hz = CONDITIONING_HIGHPASS_CUTOFF_HZ,
+      .highpass_sections = CONDITIONING_HIGHPASS_SECTIONS,
+      .gain_db = 12.0f,
+   };
+   conditioning_init(&reference, &conditioning_config);
+   conditioning_init(&optimized, &conditioning_config);
+   print("SIMD gain stage %s", optimized.use_simd ? "verified and enabled" : "disabled (failed bit-exact self-test)");
+
+   // Start the main application task
+   uint32_t seed = 1;
+   while (true)
+   {
+      // Generate one second of pseudo-random audio with a DC offset
+      for (uint32_t i = 0; i < AUDIO_SAMPLE_RATE_HZ; ++i)
+      {
+         seed = (seed * 1103515245u) + 12345u;
+         reference_block[i] = optimized_block[i] = (int16_t)(1000 + ((int32_t)(seed >> 16) & 0x3FFF) - 0x2000);
+      }
+
+      // Time both implementations and verify that their outputs are identical
+      uint32_t start = esp_cpu_get_cycle_count();
+      conditioning_process_reference(&reference, reference_block, AUDIO_SAMPLE_RATE_HZ);
+      const uint32_t reference_cycles = esp_cpu_get_cycle_count() - start;
+      start = esp_cpu_get_cycle_count();
+      for (uint32_t offset = 0; offset < AUDIO_SAMPLE_RATE_HZ; offset += AUDIO_READ_CHUNK_SAMPLES)
+         conditioning_process(&optimized, optimized_block + offset, AUDIO_READ_CHUNK_SAMPLES);
+      const uint32_t optimized_cycles = esp_cpu_get_cycle_count() - start;
+      print("Reference: %0.2f cycles/sample, Optimized: %0.2f cycles/sample, Output: %s",
+            (float)reference_cycles / AUDIO_SAMPLE_RATE_HZ, (float)optimized_cycles / AUDIO_SAMPLE_RATE_HZ,
+            memcmp(reference_block, optimized_block, sizeof(reference_block)) ? "MISMATCH" : "bit-exact");
+      vTaskDelay(pdMS_TO_TICKS(1000));
+   }
+}
@@ -21,12 +21,13 @@ void app_main(void)
 
    // Start the main application task
    gps_timestamp_t gps_timestamp;
-   float lat, lon, height;
+   double lat, lon;
+   float height;
    while (true)
    {
       gps_timestamp = gps_request_timestamp();
       gps_get_llh(&lat, &lon, &height);
-      print("Timestamp: %0.6f, Latitude: %0.6f, Longitude: %0.6f, Height: %0.3f", gps_timestamp, lat, lon, height);
+      print("Timestamp: %0.6f, Latitude: %0.6f, Longitude: %0.6f, Height: %0.3f", gps_timestamp.gps_timestamp, lat, lon, height);
       vTaskDelay(pdMS_TO_TICKS(1000));
    }
 }
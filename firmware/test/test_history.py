@@ -0,0 +1,41 @@
+from serial import Serial
+from serial.tools.list_ports import comports
+from test_audio_over_usb import PACKET_DELIMITER, PACKET_HEADER_FORMAT, read_packet
+import struct, sys, time
+
+PACKET_TYPE_HISTORY_AUDIO = 0x02
+PACKET_TYPE_HISTORY_STATUS = 0x03
+PACKET_TYPE_HISTORY_REQUEST = 0x80
+HISTORY_REQUEST_FORMAT = '<Idd'
+HISTORY_AUDIO_FORMAT = '<Id'
+HISTORY_STATUS_FORMAT = '<IBI'
+HISTORY_STATUS_NAMES = ['OK', 'TRUNCATED', 'NOT_AVAILABLE', 'BUSY', 'TIMEOUT']
+
+if __name__ == '__main__':
+
+   if len(sys.argv) != 3:
+      print('Usage: test_history.py <start_gps_time> <end_gps_time>')
+      sys.exit(1)
+   start_timestamp, end_timestamp = float(sys.argv[1]), float(sys.argv[2])
+
+   for port, _, hwid in comports():
+      if '303A:4001' in hwid:
+         print('Found device on port:', port)
+         with Serial(port) as s:
+            request_id = int(time.time()) & 0xFFFFFFFF
+            payload = struct.pack(HISTORY_REQUEST_FORMAT, request_id, start_timestamp, end_timestamp)
+            s.write(bytes(PACKET_DELIMITER) + struct.pack(PACKET_HEADER_FORMAT, PACKET_TYPE_HISTORY_REQUEST, 0, 0, len(payload)) + payload)
+            request_time = time.monotonic()
+            with open(f'history_{start_timestamp:.3f}_{end_timestamp:.3f}.pcm', 'wb') as f:
+               while True:
+                  packet_type, sequence, payload = read_packet(s)
+                  if packet_type == PACKET_TYPE_HISTORY_AUDIO:
+                     rx_id, timestamp = struct.unpack_from(HISTORY_AUDIO_FORMAT, payload)
+                     if rx_id == request_id:
+                        print(f'Received {(len(payload) - struct.calcsize(HISTORY_AUDIO_FORMAT)) // 2} samples starting at {timestamp}')
+                        f.write(payload[struct.calcsize(HISTORY_AUDIO_FORMAT):])
+                  elif packet_type == PACKET_TYPE_HISTORY_STATUS:
+                     rx_id, status, num_samples = struct.unpack(HISTORY_STATUS_FORMAT, payload)
+                     if rx_id == request_id:
+                        print(f'Request completed with status {HISTORY_STATUS_NAMES[status]}: {num_samples} samples in {time.monotonic() - request_time:.3f} s')
+                        break
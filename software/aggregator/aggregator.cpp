@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "archive_writer.hpp"
+#include "association.hpp"
+#include "ingest_server.hpp"
+#include "query_protocol.hpp"
+#include "socket_io.hpp"
+#include "time_index.hpp"
+
+static constexpr uint16_t DEFAULT_DEVICE_PORT = 5000;
+static constexpr uint32_t DEFAULT_RETENTION_SECONDS = 300;
+static constexpr int STATUS_INTERVAL_SECONDS = 10;
+
+static ingest_server_t *active_server = nullptr;
+
+static void usage(void)
+{
+   std::fprintf(stderr,
+      "Usage: aggregator [--port <device port>] [--query-port <port>] [--tty <path>]... [--retention <seconds>] [--archive <dir> [--compress]]\n"
+      "                  [--associate] [--latency]\n"
+      "       aggregator --query <start> <end> [--rate <Hz>] [--server <host>] [--query-port <port>] [--output <prefix>]\n");
+   std::exit(1);
+}
+
+static double latency_percentile_ms(const uint64_t (&buckets)[PACKET_LATENCY_BUCKETS], double fraction)
+{
+   // Upper bound of the power-of-two latency bucket holding the requested fraction of all counted latencies
+   uint64_t total = 0, cumulative = 0;
+   for (uint64_t count : buckets)
+      total += count;
+   for (size_t bucket = 0; bucket < PACKET_LATENCY_BUCKETS; ++bucket)
+      if ((cumulative += buckets[bucket]) && (cumulative >= (fraction * total)))
+         return (double)(2ull << bucket) * 1.0e-3;
+   return 0.0;
+}
+
+static void handle_signal(int)
+{
+   if (active_server)
+      active_server->stop();
+}
+
+static bool read_all(int fd, void *data, size_t data_len)
+{
+   // Receive exactly the requested number of bytes
+   uint8_t *bytes = static_cast<uint8_t*>(data);
+   while (data_len)
+   {
+      const ssize_t bytes_read = recv(fd, bytes, data_len, 0);
+      if (bytes_read <= 0)
+         return false;
+      bytes += bytes_read;
+      data_len -= bytes_read;
+   }
+   return true;
+}
+
+static void serve_query(int fd, const time_index_t &index)
+{
+   // Read a single request line
+   char request[QUERY_MAX_REQUEST_BYTES] = {};
+   size_t request_len = 0;
+   while ((request_len < (sizeof(request) - 1)) && (recv(fd, request + request_len, 1, 0) == 1) && (request[request_len] != '\n'))
+      ++request_len;
+   request[request_len] = '\0';
+   double start_timestamp = 0.0, end_timestamp = 0.0;
+   unsigned sample_rate_hz = 0;
+   if (std::sscanf(request, "%lf %lf %u", &start_timestamp, &end_timestamp, &sample_rate_hz) < 2)
+      return;
+
+   // Resolve a window that ends at the newest audio received, for live clients that do not track GPS time themselves
+   if (end_timestamp == 0.0)
+   {
+      end_timestamp = index.latest_timestamp() + TIME_INDEX_MAX_BLOCK_SECONDS;
+      if (start_timestamp <= 0.0)
+         start_timestamp += end_timestamp;
+   }
+
+   // Reply with every device's audio in the window, trimmed to the requested bounds
+   const std::vector<audio_segment_t> segments = index.query(start_timestamp, end_timestamp, sample_rate_hz);
+   const uint32_t num_segments = (uint32_t)segments.size();
+   if (!write_all(fd, &num_segments, sizeof(num_segments)))
+      return;
+   for (const audio_segment_t &segment : segments)
+   {
+      query_segment_header_t header = {};
+      header.device_id = segment.block->device_id;
+      header.sample_rate_hz = segment.block->sample_rate_hz;
+      header.timestamp = segment.timestamp();
+      header.lat = segment.block->lat;
+      header.lon = segment.block->lon;
+      header.height = segment.block->height;
+      header.num_samples = segment.num_samples;
+      std::strncpy(header.device_name, index.device_name(header.device_id).c_str(), sizeof(header.device_name) - 1);
+      if (!write_all(fd, &header, sizeof(header)) || !write_all(fd, segment.samples(), segment.num_samples * sizeof(int16_t)))
+         return;
+   }
+}
+
+static void query_server(int listen_fd, const time_index_t &index)
+{
+   // Answer window queries one at a time, independently of the ingest loop
+   while (true)
+   {
+      const int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd < 0)
+         break;
+      serve_query(fd, index);
+      close(fd);
+   }
+}
+
+static int open_query_listener(uint16_t port)
+{
+   // Only accept queries from the local machine
+   const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   const int enable = 1;
+   setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+   sockaddr_in address = {};
+   address.sin_family = AF_INET;
+   address.sin_port = htons(port);
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if ((bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) || (listen(fd, 16) != 0))
+   {
+      close(fd);
+      return -1;
+   }
+   return fd;
+}
+
+static int run_query(const std::string &server, uint16_t port, double start_timestamp, double end_timestamp, uint32_t sample_rate_hz, const std::string &output_prefix)
+{
+   // Connect to the aggregator and send the window request
+   addrinfo hints = {}, *result = nullptr;
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+   if (getaddrinfo(server.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+   {
+      std::fprintf(stderr, "Unable to resolve aggregator address: %s\n", server.c_str());
+      return 1;
+   }
+   const int fd = socket(AF_INET, SOCK_STREAM, 0);
+   const bool connected = (connect(fd, result->ai_addr, result->ai_addrlen) == 0);
+   freeaddrinfo(result);
+   if (!connected)
+   {
+      std::fprintf(stderr, "Unable to connect to aggregator at %s:%u\n", server.c_str(), port);
+      close(fd);
+      return 1;
+   }
+   const auto start_time = std::chrono::steady_clock::now();
+   char request[QUERY_MAX_REQUEST_BYTES];
+   const int request_len = std::snprintf(request, sizeof(request), "%0.6f %0.6f %u\n", start_timestamp, end_timestamp, sample_rate_hz);
+   write_all(fd, request, request_len);
+
+   // Receive each segment, optionally appending its samples to a raw PCM file per device and rate
+   uint32_t num_segments = 0;
+   size_t total_samples = 0;
+   if (!read_all(fd, &num_segments, sizeof(num_segments)))
+      num_segments = 0;
+   std::vector<int16_t> samples;
+   for (uint32_t i = 0; i < num_segments; ++i)
+   {
+      query_segment_header_t header;
+      if (!read_all(fd, &header, sizeof(header)))
+         break;
+      samples.resize(header.num_samples);
+      if (!read_all(fd, samples.data(), samples.size() * sizeof(int16_t)))
+         break;
+      total_samples += samples.size();
+      std::printf("%-24.*s [%0.6f, %0.6f] %u Hz, %u samples @ <%0.6f, %0.6f, %0.3f>\n", (int)QUERY_DEVICE_NAME_LEN, header.device_name,
+                  header.timestamp, header.timestamp + ((double)header.num_samples / header.sample_rate_hz), header.sample_rate_hz,
+                  header.num_samples, header.lat, header.lon, header.height);
+      if (!output_prefix.empty())
+      {
+         const std::string path = output_prefix + "_" + std::to_string(header.device_id) + "_" + std::to_string(header.sample_rate_hz) + ".pcm";
+         if (std::FILE *output = std::fopen(path.c_str(), "ab"))
+         {
+            std::fwrite(samples.data(), sizeof(int16_t), samples.size(), output);
+            std::fclose(output);
+         }
+      }
+   }
+   close(fd);
+   const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+   std::printf("%u segments, %zu samples in %0.3f ms\n", num_segments, total_samples, elapsed * 1.0e3);
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   // Parse command-line arguments
+   uint16_t device_port = DEFAULT_DEVICE_PORT, query_port = QUERY_DEFAULT_PORT;
+   uint32_t retention_seconds = DEFAULT_RETENTION_SECONDS, sample_rate_hz = 0;
+   std::vector<std::string> ttys;
+   std::string server = "127.0.0.1", output_prefix, archive_root;
+   bool query = false, compress = false, associate = false, latency = false;
+   double start_timestamp = 0.0, end_timestamp = 0.0;
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg = argv[i];
+      if ((arg == "--port") && (i + 1 < argc))
+         device_port = (uint16_t)std::atoi(argv[++i]);
+      else if ((arg == "--query-port") && (i + 1 < argc))
+         query_port = (uint16_t)std::atoi(argv[++i]);
+      else if ((arg == "--tty") && (i + 1 < argc))
+         ttys.push_back(argv[++i]);
+      else if ((arg == "--retention") && (i + 1 < argc))
+         retention_seconds = (uint32_t)std::atol(argv[++i]);
+      else if ((arg == "--query") && (i + 2 < argc))
+      {
+         query = true;
+         start_timestamp = std::atof(argv[++i]);
+         end_timestamp = std::atof(argv[++i]);
+      }
+      else if ((arg == "--rate") && (i + 1 < argc))
+         sample_rate_hz = (uint32_t)std::atol(argv[++i]);
+      else if ((arg == "--server") && (i + 1 < argc))
+         server = argv[++i];
+      else if ((arg == "--output") && (i + 1 < argc))
+         output_prefix = argv[++i];
+      else if ((arg == "--archive") && (i + 1 < argc))
+         archive_root = argv[++i];
+      else if (arg == "--compress")
+         compress = true;
+      else if (arg == "--associate")
+         associate = true;
+      else if (arg == "--latency")
+         latency = true;
+      else
+         usage();
+   }
+   if (query)
+      return run_query(server, query_port, start_timestamp, end_timestamp, sample_rate_hz, output_prefix);
+
+   // Open every ingest source along with the query listener
+   time_index_t index(retention_seconds);
+   ingest_server_t ingest(index);
+   if (!ingest.listen_tcp(device_port) || !ingest.listen_udp(device_port))
+   {
+      std::fprintf(stderr, "Unable to listen for devices on port %u\n", device_port);
+      return 1;
+   }
+   for (const std::string &tty : ttys)
+      if (!ingest.add_tty(tty))
+         std::fprintf(stderr, "Unable to open %s, will keep retrying\n", tty.c_str());
+   const int query_fd = open_query_listener(query_port);
+   if (query_fd < 0)
+   {
+      std::fprintf(stderr, "Unable to listen for queries on port %u\n", query_port);
+      return 1;
+   }
+   std::thread query_thread(query_server, query_fd, std::cref(index));
+   query_thread.detach();
+
+   // Persist every indexed block to the segmented archive if requested
+   std::unique_ptr<archive_writer_t> archive;
+   if (!archive_root.empty())
+      archive = std::make_unique<archive_writer_t>(archive_root, compress);
+
+   // Group the nodes' arrival-time reports into candidate events across neighbouring nodes if requested
+   std::unique_ptr<association_t> association;
+   std::atomic<uint64_t> candidate_events{0};
+   if (associate)
+   {
+      association = std::make_unique<association_t>();
+      association->set_event_handler([&index, &candidate_events](const candidate_event_t &event)
+      {
+         ++candidate_events;
+         std::printf("[%0.6f]: Candidate event from %zu nodes:", event.detections.front().timestamp, event.detections.size());
+         for (const detection_t &detection : event.detections)
+            std::printf(" %s (%+0.6f)", index.device_name(detection.device_id).c_str(), detection.timestamp - event.detections.front().timestamp);
+         std::printf("\n");
+         std::fflush(stdout);
+      });
+      ingest.set_toa_handler([&association](uint32_t device_id, const packet_toa_report_t &report)
+      {
+         detection_t detection;
+         detection.device_id = device_id;
+         detection.timestamp = report.timestamp;
+         detection.uncertainty = report.uncertainty;
+         detection.lat = report.lat;
+         detection.lon = report.lon;
+         detection.height = report.height;
+         detection.confidence = report.confidence;
+         detection.snr_db = report.snr_db;
+         association->add(detection);
+      });
+   }
+   // Summarize each node's own capture-to-output latency profile as it arrives if requested
+   if (latency)
+      ingest.set_latency_handler([&index](uint32_t device_id, const packet_latency_profile_t &profile)
+      {
+         static const char * const stage_names[LATENCY_STAGE_COUNT] = { "DMA to read", "timestamp", "read to dispatch", "USB enqueue",
+            "USB write", "network enqueue", "network write", "capture to USB", "capture to network" };
+         std::printf("%s latency after %u s:", index.device_name(device_id).c_str(), profile.uptime_s);
+         for (size_t i = 0; i < LATENCY_STAGE_COUNT; ++i)
+         {
+            const packet_latency_stage_t &stage = profile.stages[i];
+            uint64_t buckets[PACKET_LATENCY_BUCKETS];
+            std::copy(stage.buckets, stage.buckets + PACKET_LATENCY_BUCKETS, buckets);
+            if (stage.count)
+               std::printf("\n   %-20s p50 < %0.3f ms, p90 < %0.3f ms, max %0.3f ms over %u blocks", stage_names[i],
+                           latency_percentile_ms(buckets, 0.5), latency_percentile_ms(buckets, 0.9), stage.max_us * 1.0e-3, stage.count);
+         }
+         std::printf("\n");
+         std::fflush(stdout);
+      });
+   if (archive || association)
+      ingest.set_block_handler([&archive, &association, &index](const std::shared_ptr<const audio_block_t> &block)
+      {
+         // Audio from the same nodes moves association time forward, closing events even when no further reports arrive
+         if (association)
+            association->advance(block->timestamp);
+         if (archive)
+         {
+            archive_block_info_t info;
+            info.timestamp = block->timestamp;
+            info.sample_rate_hz = block->sample_rate_hz;
+            info.sequence = block->sequence;
+            info.spooled = block->spooled;
+            info.lat = block->lat;
+            info.lon = block->lon;
+            info.height = block->height;
+            archive->write_block(index.device_name(block->device_id), info, block->samples.data(), (uint32_t)block->samples.size());
+         }
+      });
+
+   // Periodically report ingest status while the event loop runs
+   active_server = &ingest;
+   std::signal(SIGINT, handle_signal);
+   std::signal(SIGTERM, handle_signal);
+   std::thread status_thread([&ingest, &index, &candidate_events]()
+   {
+      uint64_t last_bytes = 0;
+      while (true)
+      {
+         std::this_thread::sleep_for(std::chrono::seconds(STATUS_INTERVAL_SECONDS));
+         const ingest_statistics_t &stats = ingest.statistics();
+         const uint64_t bytes = stats.bytes;
+         std::printf("Devices: %zu, blocks: %llu (%llu rejected, %llu unsynchronized), latest GPS time: %0.6f, ingest rate: %0.2f MB/s\n",
+                     index.num_devices(), (unsigned long long)stats.audio_blocks.load(), (unsigned long long)stats.rejected_blocks.load(),
+                     (unsigned long long)stats.unsynchronized_blocks.load(),
+                     index.latest_timestamp(), (bytes - last_bytes) / (STATUS_INTERVAL_SECONDS * 1.0e6));
+         if (stats.datagrams)
+            std::printf("   UDP datagrams: %llu, shards recovered: %llu, shards lost: %llu\n", (unsigned long long)stats.datagrams.load(),
+                        (unsigned long long)stats.recovered_shards.load(), (unsigned long long)stats.lost_shards.load());
+         if (stats.toa_reports)
+            std::printf("   Arrival-time reports: %llu, candidate events: %llu\n", (unsigned long long)stats.toa_reports.load(),
+                        (unsigned long long)candidate_events.load());
+         const ingest_latency_histogram_t &arrival = stats.arrival_latency;
+         if (arrival.blocks)
+         {
+            uint64_t buckets[PACKET_LATENCY_BUCKETS];
+            for (size_t bucket = 0; bucket < PACKET_LATENCY_BUCKETS; ++bucket)
+               buckets[bucket] = arrival.buckets[bucket];
+            std::printf("   Capture-to-arrival latency: p50 < %0.3f ms, p90 < %0.3f ms, p99 < %0.3f ms, mean %0.3f ms, max %0.3f ms (%llu early)\n",
+                        latency_percentile_ms(buckets, 0.5), latency_percentile_ms(buckets, 0.9), latency_percentile_ms(buckets, 0.99),
+                        arrival.total_us * 1.0e-3 / arrival.blocks, arrival.max_us * 1.0e-3,
+                        (unsigned long long)arrival.early_blocks.load());
+         }
+         std::fflush(stdout);
+         last_bytes = bytes;
+      }
+   });
+   status_thread.detach();
+   std::printf("Aggregating devices on TCP and UDP port %u with %u s retention, queries on port %u\n", device_port, retention_seconds, query_port);
+   ingest.run();
+   if (association)
+      association->flush();
+   if (archive)
+      archive->close();
+   shutdown(query_fd, SHUT_RDWR);
+   close(query_fd);
+   return 0;
+}
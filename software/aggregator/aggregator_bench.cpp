@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "ingest_server.hpp"
+#include "time_index.hpp"
+
+static constexpr uint32_t BENCH_SECONDS_PER_DEVICE = 20;
+static constexpr uint32_t BENCH_RETENTION_SECONDS = 8;
+static constexpr double BENCH_BASE_TIMESTAMP = 1400000000.0;
+static constexpr double BENCH_QUERY_SECONDS = 0.2;
+
+struct bench_result_t
+{
+   double wall_seconds = 0.0, ingest_mb_per_second = 0.0;
+   uint64_t blocks = 0, rejected = 0;
+   bool window_complete = false;
+   std::vector<double> query_latencies_us;
+};
+
+static void simulate_device(int fd, uint32_t device, uint32_t num_seconds)
+{
+   // Stream framed one-second audio packets as fast as the aggregator will accept them
+   std::vector<uint8_t> packet(INGEST_MAX_PACKET_SIZE_BYTES);
+   packet_header_t *header = reinterpret_cast<packet_header_t*>(packet.data());
+   packet_audio_t *audio_header = reinterpret_cast<packet_audio_t*>(header + 1);
+   int16_t *samples = reinterpret_cast<int16_t*>(audio_header + 1);
+   for (uint32_t i = 0; i < INGEST_FULL_RATE_HZ; ++i)
+      samples[i] = (int16_t)((device * 7919u + i * 31u) & 0x7FFF);
+   const double clock_offset = 0.0001 * (device % 10);
+   for (uint32_t second = 0; second < num_seconds; ++second)
+   {
+      packet_init_header(header, PACKET_TYPE_AUDIO, (uint16_t)second, sizeof(packet_audio_t) + (INGEST_FULL_RATE_HZ * sizeof(int16_t)));
+      *audio_header = { BENCH_BASE_TIMESTAMP + second + clock_offset, 36.14 + (0.001 * device), -86.80, 180.0f, 0.0f, 0.0f, 0.0f };
+      size_t offset = 0;
+      while (offset < packet.size())
+      {
+         const ssize_t bytes_written = write(fd, packet.data() + offset, packet.size() - offset);
+         if (bytes_written <= 0)
+            return;
+         offset += bytes_written;
+      }
+   }
+   close(fd);
+}
+
+static bench_result_t run_devices(uint32_t num_devices)
+{
+   // Connect each simulated device to the ingest loop through its own socket pair
+   time_index_t index(BENCH_RETENTION_SECONDS);
+   ingest_server_t ingest(index);
+   std::vector<std::thread> devices;
+   for (uint32_t device = 0; device < num_devices; ++device)
+   {
+      int fds[2];
+      socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+      ingest.add_stream(fds[0], "sim:" + std::to_string(device));
+      devices.emplace_back(simulate_device, fds[1], device, BENCH_SECONDS_PER_DEVICE);
+   }
+
+   // Continuously query short all-node windows near the newest data while ingest is underway
+   std::atomic<bool> querying(true);
+   bench_result_t result;
+   std::thread query_thread([&]()
+   {
+      std::mt19937 generator(1234);
+      std::uniform_real_distribution<double> offset(-(BENCH_RETENTION_SECONDS - 2.0), -BENCH_QUERY_SECONDS);
+      while (querying)
+      {
+         const double latest = index.latest_timestamp();
+         if (latest == 0.0)
+         {
+            std::this_thread::yield();
+            continue;
+         }
+         const double start_timestamp = latest + offset(generator);
+         const auto start = std::chrono::steady_clock::now();
+         const std::vector<audio_segment_t> segments = index.query(start_timestamp, start_timestamp + BENCH_QUERY_SECONDS);
+         result.query_latencies_us.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+         std::this_thread::sleep_for(std::chrono::microseconds(200));
+      }
+   });
+
+   // Run the ingest loop until every device has disconnected
+   const auto start_time = std::chrono::steady_clock::now();
+   std::thread ingest_thread([&ingest]() { ingest.run(); });
+   for (std::thread &device : devices)
+      device.join();
+   while (ingest.statistics().disconnections < num_devices)
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+   result.wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+   ingest.stop();
+   ingest_thread.join();
+   querying = false;
+   query_thread.join();
+   result.blocks = ingest.statistics().audio_blocks;
+   result.rejected = ingest.statistics().rejected_blocks;
+   result.ingest_mb_per_second = ingest.statistics().bytes / (result.wall_seconds * 1.0e6);
+
+   // Verify that a window inside the final second returns exactly one trimmed segment from every device
+   const double check_start = BENCH_BASE_TIMESTAMP + BENCH_SECONDS_PER_DEVICE - 0.5;
+   const std::vector<audio_segment_t> segments = index.query(check_start, check_start + BENCH_QUERY_SECONDS);
+   result.window_complete = (segments.size() == num_devices) && std::all_of(segments.begin(), segments.end(), [](const audio_segment_t &segment)
+   {
+      return std::abs((int32_t)segment.num_samples - (int32_t)(BENCH_QUERY_SECONDS * INGEST_FULL_RATE_HZ)) <= 1;
+   });
+   return result;
+}
+
+static double percentile(std::vector<double> &values, double fraction)
+{
+   if (values.empty())
+      return 0.0;
+   const size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+   std::nth_element(values.begin(), values.begin() + index, values.end());
+   return values[index];
+}
+
+int main(int argc, char **argv)
+{
+   // Scale the number of simulated devices and report ingest throughput and query latency at each step
+   std::vector<uint32_t> device_counts = { 1, 2, 5, 10, 25, 50, 100 };
+   if (argc > 1)
+   {
+      device_counts.clear();
+      for (int i = 1; i < argc; ++i)
+         device_counts.push_back((uint32_t)std::atol(argv[i]));
+   }
+   std::printf("%8s %10s %10s %12s %10s %12s %12s %12s\n", "devices", "blocks", "rejected", "MB/s", "x realtime", "query p50 us", "query p99 us", "query max us");
+   int failures = 0;
+   for (uint32_t num_devices : device_counts)
+   {
+      bench_result_t result = run_devices(num_devices);
+      const double realtime_factor = ((result.blocks + result.rejected) / result.wall_seconds) / num_devices;
+      const double p50 = percentile(result.query_latencies_us, 0.50), p99 = percentile(result.query_latencies_us, 0.99);
+      const double max = result.query_latencies_us.empty() ? 0.0 : *std::max_element(result.query_latencies_us.begin(), result.query_latencies_us.end());
+      std::printf("%8u %10llu %10llu %12.1f %10.1f %12.1f %12.1f %12.1f\n", num_devices, (unsigned long long)result.blocks,
+                  (unsigned long long)result.rejected, result.ingest_mb_per_second, realtime_factor, p50, p99, max);
+      failures += !result.window_complete || ((result.blocks + result.rejected) != ((uint64_t)num_devices * BENCH_SECONDS_PER_DEVICE));
+   }
+   return failures ? 1 : 0;
+}
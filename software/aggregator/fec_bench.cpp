@@ -0,0 +1,359 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "ingest_server.hpp"
+#include "time_index.hpp"
+
+static constexpr uint16_t DEFAULT_BENCH_PORT = 5950;
+static constexpr uint32_t DEFAULT_BENCH_SECONDS = 20;
+static constexpr double DEFAULT_LINK_MBPS = 8.0;
+static constexpr uint16_t BENCH_SHARD_BYTES = 1200;
+static constexpr uint32_t BENCH_DECIMATED_RATE_HZ = 16000;
+static constexpr uint32_t BENCH_RETENTION_SECONDS = 8;
+static constexpr double BENCH_BASE_TIMESTAMP = 1400000000.0;
+static constexpr int BENCH_DRAIN_MS = 200;  // Time allowed after the last datagram for recovery and expiry to finish
+
+using bench_clock_t = std::chrono::steady_clock;
+
+// Codes compared, from plain UDP with no parity to heavier protection of shorter groups
+struct bench_code_t { uint8_t num_source, num_parity; };
+static const bench_code_t bench_codes[] = { { 16, 0 }, { 16, 2 }, { 16, 4 }, { 8, 4 } };
+
+// Datagram loss as a two-state Gilbert model: losses are independent when the mean burst is one datagram, otherwise
+//    every loss begins a run of losses of that mean length
+struct bench_loss_t { const char *name; double rate, mean_burst; };
+static const bench_loss_t bench_losses[] = { { "1% random", 0.01, 1.0 }, { "5% random", 0.05, 1.0 }, { "5% bursts of 4", 0.05, 4.0 } };
+
+struct bench_sender_t
+{
+   int fd = -1;
+   double link_bytes_per_second = 0.0;
+   bench_clock_t::time_point next_send;
+   std::mt19937 generator;
+   std::uniform_real_distribution<double> uniform{0.0, 1.0};
+   double enter_burst = 0.0, leave_burst = 0.0;
+   bool in_burst = false, packet_damaged = false, pace = true;
+   bench_clock_t::time_point last_source_sent;
+   uint64_t datagrams = 0, dropped = 0, bytes = 0;
+   std::vector<std::vector<uint8_t>> *capture = nullptr;
+};
+
+struct bench_result_t
+{
+   uint32_t num_packets = 0, damaged = 0, delivered = 0, recovered = 0, corrupted = 0;
+   double overhead = 0.0, datagram_loss = 0.0;
+   std::vector<double> intact_latencies_ms, recovered_latencies_ms;
+   double encode_us_per_second = 0.0, decode_us_per_second = 0.0;
+};
+
+static bool bench_drop(bench_sender_t &sender)
+{
+   // Step the loss model once per datagram
+   sender.in_burst = sender.in_burst ? (sender.uniform(sender.generator) >= sender.leave_burst) : (sender.uniform(sender.generator) < sender.enter_burst);
+   return sender.in_burst;
+}
+
+static void bench_send(void *context, const uint8_t *datagram, size_t datagram_len)
+{
+   // Pace datagrams at the link rate and drop them as the loss model dictates, noting whether the packet lost any data
+   bench_sender_t &sender = *static_cast<bench_sender_t*>(context);
+   fec_header_t header;
+   std::memcpy(&header, datagram, sizeof(header));
+   const bool is_source = !header.num_source || (header.index < header.num_source);
+   ++sender.datagrams;
+   sender.bytes += datagram_len;
+   if (sender.capture)
+   {
+      sender.capture->emplace_back(datagram, datagram + datagram_len);
+      return;
+   }
+   if (sender.pace)
+   {
+      std::this_thread::sleep_until(sender.next_send);
+      sender.next_send = std::max(sender.next_send, bench_clock_t::now()) +
+                         std::chrono::nanoseconds((int64_t)(1.0e9 * datagram_len / sender.link_bytes_per_second));
+   }
+   if (is_source)
+      sender.last_source_sent = bench_clock_t::now();
+   if (bench_drop(sender))
+   {
+      ++sender.dropped;
+      sender.packet_damaged = sender.packet_damaged || is_source;
+      return;
+   }
+   (void)!send(sender.fd, datagram, datagram_len, 0);
+}
+
+static void bench_configure_loss(bench_sender_t &sender, const bench_loss_t &loss, uint32_t seed)
+{
+   // Choose the transition probabilities that give the requested mean burst and long-run loss rate, where independent
+   //    losses are the case of staying in the lossy state exactly as often as entering it
+   sender.generator.seed(seed);
+   sender.leave_burst = (loss.mean_burst <= 1.0) ? (1.0 - loss.rate) : (1.0 / loss.mean_burst);
+   sender.enter_burst = loss.rate * sender.leave_burst / (1.0 - loss.rate);
+   sender.in_burst = false;
+}
+
+static std::vector<std::vector<uint8_t>> bench_packets(uint32_t num_seconds)
+{
+   // One full-rate and one decimated audio packet per second, framed as a node sends them
+   std::vector<std::vector<uint8_t>> packets;
+   for (uint32_t second = 0; second < num_seconds; ++second)
+      for (const uint32_t rate : { INGEST_FULL_RATE_HZ, BENCH_DECIMATED_RATE_HZ })
+      {
+         const bool full_rate = (rate == INGEST_FULL_RATE_HZ);
+         const size_t header_len = full_rate ? sizeof(packet_audio_t) : sizeof(packet_audio_decimated_t);
+         std::vector<uint8_t> packet(sizeof(packet_header_t) + header_len + (rate * sizeof(int16_t)));
+         packet_header_t *header = reinterpret_cast<packet_header_t*>(packet.data());
+         packet_init_header(header, full_rate ? PACKET_TYPE_AUDIO : PACKET_TYPE_AUDIO_DECIMATED, (uint16_t)packets.size(), header_len + (rate * sizeof(int16_t)));
+         if (full_rate)
+         {
+            const packet_audio_t audio = { BENCH_BASE_TIMESTAMP + second, 36.14, -86.80, 180.0f, 0.0f, 0.0f, 0.0f };
+            std::memcpy(header + 1, &audio, sizeof(audio));
+         }
+         else
+         {
+            const packet_audio_decimated_t audio = { BENCH_BASE_TIMESTAMP + second, 36.14, -86.80, 180.0f, rate, 0.0f, 0.0f, 0.0f };
+            std::memcpy(header + 1, &audio, sizeof(audio));
+         }
+         int16_t *samples = reinterpret_cast<int16_t*>(packet.data() + sizeof(packet_header_t) + header_len);
+         for (uint32_t i = 0; i < rate; ++i)
+            samples[i] = (int16_t)(((second * 7919u) + (i * 31u)) & 0x7FFF);
+         packets.push_back(std::move(packet));
+      }
+   return packets;
+}
+
+static void bench_cpu_cost(const std::vector<std::vector<uint8_t>> &packets, const bench_code_t &code, const bench_loss_t &loss,
+                           uint32_t num_seconds, bench_result_t &result)
+{
+   // Time the encoder alone, capturing its datagrams, then the decoder alone on them after the same losses
+   std::vector<std::vector<uint8_t>> datagrams;
+   bench_sender_t sender;
+   sender.capture = &datagrams;
+   fec_encoder_t *encoder = new fec_encoder_t;
+   fec_encoder_init(encoder, code.num_source, code.num_parity, BENCH_SHARD_BYTES, bench_send, &sender);
+   datagrams.reserve(4 * packets.size() * packets[0].size() / BENCH_SHARD_BYTES);
+   auto start = bench_clock_t::now();
+   for (const std::vector<uint8_t> &packet : packets)
+   {
+      fec_encoder_write(encoder, packet.data(), packet.size());
+      fec_encoder_end_packet(encoder);
+   }
+   result.encode_us_per_second = std::chrono::duration<double, std::micro>(bench_clock_t::now() - start).count() / num_seconds;
+   delete encoder;
+
+   bench_configure_loss(sender, loss, 99);
+   std::vector<const std::vector<uint8_t>*> received;
+   for (const std::vector<uint8_t> &datagram : datagrams)
+      if (!bench_drop(sender))
+         received.push_back(&datagram);
+   fec_decoder_t *decoder = new fec_decoder_t;
+   fec_decoder_init(decoder, [](void*, const uint8_t*, size_t) {}, nullptr);
+   start = bench_clock_t::now();
+   uint64_t now_us = 0;
+   for (const std::vector<uint8_t> *datagram : received)
+      fec_decoder_receive(decoder, datagram->data(), datagram->size(), now_us++);
+   result.decode_us_per_second = std::chrono::duration<double, std::micro>(bench_clock_t::now() - start).count() / num_seconds;
+   delete decoder;
+}
+
+static bench_result_t run_condition(const std::vector<std::vector<uint8_t>> &packets, const bench_code_t &code, const bench_loss_t &loss,
+                                    uint32_t num_seconds, double link_mbps, uint16_t port)
+{
+   // Receive through the aggregator's own UDP ingest path, noting when each block reaches the time index
+   bench_result_t result;
+   time_index_t index(BENCH_RETENTION_SECONDS);
+   ingest_server_t ingest(index);
+   if (!ingest.listen_udp(port))
+   {
+      std::fprintf(stderr, "Unable to listen on UDP port %u\n", port);
+      std::exit(1);
+   }
+   std::vector<bench_clock_t::time_point> sent(packets.size()), arrived(packets.size());
+   std::vector<bool> damaged(packets.size(), false), delivered(packets.size(), false);
+   ingest.set_block_handler([&](const std::shared_ptr<const audio_block_t> &block)
+   {
+      // Every block that arrives, rebuilt or not, must hold exactly the samples sent
+      if (block->sequence >= packets.size())
+         return;
+      const std::vector<uint8_t> &packet = packets[block->sequence];
+      const size_t samples_len = block->samples.size() * sizeof(int16_t);
+      arrived[block->sequence] = bench_clock_t::now();
+      delivered[block->sequence] = true;
+      result.corrupted += (samples_len > packet.size()) || std::memcmp(block->samples.data(), packet.data() + packet.size() - samples_len, samples_len);
+   });
+   std::thread ingest_thread([&ingest]() { ingest.run(); });
+
+   // Send every packet through the encoder over loopback, paced at the link rate with datagrams dropped on the way
+   bench_sender_t sender;
+   sender.fd = socket(AF_INET, SOCK_DGRAM, 0);
+   sockaddr_in address = {};
+   address.sin_family = AF_INET;
+   address.sin_port = htons(port);
+   address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   connect(sender.fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+   sender.link_bytes_per_second = link_mbps * 1.0e6 / 8.0;
+   sender.next_send = bench_clock_t::now();
+   bench_configure_loss(sender, loss, 1234);
+   fec_encoder_t *encoder = new fec_encoder_t;
+   fec_encoder_init(encoder, code.num_source, code.num_parity, BENCH_SHARD_BYTES, bench_send, &sender);
+   uint64_t payload_bytes = 0;
+   for (size_t p = 0; p < packets.size(); ++p)
+   {
+      sender.packet_damaged = false;
+      fec_encoder_write(encoder, packets[p].data(), packets[p].size());
+      fec_encoder_end_packet(encoder);
+      sent[p] = sender.last_source_sent;
+      damaged[p] = sender.packet_damaged;
+      payload_bytes += packets[p].size();
+   }
+   delete encoder;
+   std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_DRAIN_MS));
+   ingest.stop();
+   ingest_thread.join();
+   close(sender.fd);
+
+   // Compare the delay of blocks that arrived whole with that of blocks rebuilt from parity
+   result.num_packets = (uint32_t)packets.size();
+   result.overhead = ((double)sender.bytes / payload_bytes) - 1.0;
+   result.datagram_loss = (double)sender.dropped / sender.datagrams;
+   for (size_t p = 0; p < packets.size(); ++p)
+   {
+      result.damaged += damaged[p];
+      result.delivered += delivered[p];
+      if (!delivered[p])
+         continue;
+      const double latency_ms = std::chrono::duration<double, std::milli>(arrived[p] - sent[p]).count();
+      if (damaged[p])
+      {
+         ++result.recovered;
+         result.recovered_latencies_ms.push_back(latency_ms);
+      }
+      else
+         result.intact_latencies_ms.push_back(latency_ms);
+   }
+   bench_cpu_cost(packets, code, loss, num_seconds, result);
+   return result;
+}
+
+static void bench_write_datagram(uint8_t *datagram, const fec_header_t &header, uint16_t prefix, uint8_t fill, size_t data_len)
+{
+   std::memcpy(datagram, &header, sizeof(header));
+   datagram[sizeof(header)] = (uint8_t)prefix;
+   datagram[sizeof(header) + 1] = (uint8_t)(prefix >> 8);
+   std::memset(datagram + sizeof(header) + FEC_PREFIX_BYTES, fill, data_len);
+}
+
+static int run_malformed(void)
+{
+   // Source shards whose prefix claims more data than their datagram carries must be rejected, shards rebuilt from
+   //    parity must never pass on more than the parity carried whatever length their recovered prefix claims, and a
+   //    well-formed shard must still be passed on whole
+   static constexpr size_t BENCH_SHORT_BYTES = 16;
+   struct delivery_t { size_t calls = 0, longest = 0, last = 0; } delivery;
+   fec_decoder_t *decoder = new fec_decoder_t;
+   fec_decoder_init(decoder, [](void *context, const uint8_t *data, size_t data_len)
+   {
+      delivery_t &delivery = *static_cast<delivery_t*>(context);
+      if (!data)
+         return;
+      ++delivery.calls;
+      delivery.longest = std::max(delivery.longest, data_len);
+      delivery.last = data_len;
+   }, &delivery);
+   uint8_t datagram[FEC_MAX_DATAGRAM_BYTES];
+   uint32_t group = 0;
+   bench_write_datagram(datagram, { group++, 0, 1, 0, 0 }, FEC_PREFIX_PACKET_START | 1000, 0x55, 100);
+   fec_decoder_receive(decoder, datagram, sizeof(fec_header_t) + FEC_PREFIX_BYTES + 100, 0);
+   bench_write_datagram(datagram, { group++, 0, 1, 0, 0 }, FEC_PREFIX_PACKET_START | (FEC_PREFIX_PACKET_START - 1), 0x55, 10);
+   fec_decoder_receive(decoder, datagram, sizeof(fec_header_t) + FEC_PREFIX_BYTES + 10, 1);
+   const uint64_t rejected = decoder->stats.invalid_datagrams;
+   for (uint32_t fill = 1; fill < 256; ++fill)
+   {
+      bench_write_datagram(datagram, { group++, 1, 1, 1, 0 }, (uint16_t)((fill << 8) | fill), (uint8_t)fill, BENCH_SHORT_BYTES);
+      fec_decoder_receive(decoder, datagram, sizeof(fec_header_t) + FEC_PREFIX_BYTES + BENCH_SHORT_BYTES, group);
+   }
+   const uint64_t recovered = decoder->stats.recovered_shards;
+   const size_t longest = delivery.longest;
+   bench_write_datagram(datagram, { group++, 0, 1, 0, 0 }, FEC_PREFIX_PACKET_START | 100, 0x55, 100);
+   fec_decoder_receive(decoder, datagram, sizeof(fec_header_t) + FEC_PREFIX_BYTES + 100, group);
+   const bool passed = (rejected == 2) && (recovered == 255) && (longest <= BENCH_SHORT_BYTES) && (delivery.last == 100);
+   std::printf("Malformed datagrams: %llu of 2 overlong shards rejected, %llu shards rebuilt with at most %zu of %zu bytes delivered, "
+               "well-formed shard delivered %zu of 100 bytes: %s\n", (unsigned long long)rejected, (unsigned long long)recovered, longest,
+               BENCH_SHORT_BYTES, delivery.last, passed ? "ok" : "FAILED");
+   delete decoder;
+   return passed ? 0 : 1;
+}
+
+static double percentile(std::vector<double> &values, double fraction)
+{
+   if (values.empty())
+      return 0.0;
+   const size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+   std::nth_element(values.begin(), values.begin() + index, values.end());
+   return values[index];
+}
+
+int main(int argc, char **argv)
+{
+   // Parse command-line arguments
+   uint32_t num_seconds = DEFAULT_BENCH_SECONDS;
+   double link_mbps = DEFAULT_LINK_MBPS;
+   uint16_t port = DEFAULT_BENCH_PORT;
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg = argv[i];
+      if ((arg == "--seconds") && (i + 1 < argc))
+         num_seconds = (uint32_t)std::atol(argv[++i]);
+      else if ((arg == "--link-mbps") && (i + 1 < argc))
+         link_mbps = std::atof(argv[++i]);
+      else if ((arg == "--port") && (i + 1 < argc))
+         port = (uint16_t)std::atoi(argv[++i]);
+      else
+      {
+         std::fprintf(stderr, "Usage: fec_bench [--seconds <audio seconds per run>] [--link-mbps <rate>] [--port <UDP port>]\n");
+         return 1;
+      }
+   }
+
+   // Stream a node's audio through every code under every loss pattern, reporting how many blocks survive, how much
+   //    later than an intact block a rebuilt one arrives, and the CPU time each end spends per second of audio
+   int failures = run_malformed();
+   const std::vector<std::vector<uint8_t>> packets = bench_packets(num_seconds);
+   std::printf("%u s of full-rate and decimated audio per run over a %.1f Mbit/s link, %u-byte shards\n", num_seconds, link_mbps, BENCH_SHARD_BYTES);
+   std::printf("%-6s %-15s %8s %7s %8s %10s %10s %15s %15s %10s %10s\n", "code", "loss", "overhead", "lost", "damaged", "recovered",
+               "delivered", "intact p50/p99", "rebuilt p50/p99", "encode us", "decode us");
+   for (const bench_code_t &code : bench_codes)
+      for (const bench_loss_t &loss : bench_losses)
+      {
+         bench_result_t result = run_condition(packets, code, loss, num_seconds, link_mbps, port);
+         char code_name[16];
+         std::snprintf(code_name, sizeof(code_name), "%u+%u", code.num_source, code.num_parity);
+         std::printf("%-6s %-15s %7.1f%% %6.2f%% %8u %10u %9.1f%% %7.1f/%-7.1f %7.1f/%-7.1f %10.0f %10.0f\n", code_name, loss.name,
+                     100.0 * result.overhead, 100.0 * result.datagram_loss, result.damaged, result.recovered,
+                     100.0 * result.delivered / result.num_packets, percentile(result.intact_latencies_ms, 0.5), percentile(result.intact_latencies_ms, 0.99),
+                     percentile(result.recovered_latencies_ms, 0.5), percentile(result.recovered_latencies_ms, 0.99),
+                     result.encode_us_per_second, result.decode_us_per_second);
+         std::fflush(stdout);
+
+         // Moderate protection must ride out light random loss entirely
+         failures += (code.num_parity >= 4) && (loss.mean_burst <= 1.0) && (loss.rate <= 0.01) && (result.delivered != result.num_packets);
+         if (result.corrupted)
+         {
+            std::printf("   %u blocks arrived with corrupted samples\n", result.corrupted);
+            ++failures;
+         }
+      }
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,423 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include "ingest_server.hpp"
+
+ingest_server_t::ingest_server_t(time_index_t &index) : index(index), read_buffer(INGEST_READ_SIZE_BYTES)
+{
+   // Create the epoll instance along with an eventfd used to interrupt the loop from other threads
+   epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+   wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+   epoll_event event = {};
+   event.events = EPOLLIN;
+   event.data.fd = wake_fd;
+   epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+}
+
+ingest_server_t::~ingest_server_t()
+{
+   for (const auto &source : sources)
+      close(source.first);
+   if (listen_fd >= 0)
+      close(listen_fd);
+   if (udp_fd >= 0)
+      close(udp_fd);
+   close(wake_fd);
+   close(epoll_fd);
+}
+
+bool ingest_server_t::listen_tcp(uint16_t port)
+{
+   // Accept connections from devices which stream packets to the server over the network
+   listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   const int enable = 1;
+   setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+   sockaddr_in address = {};
+   address.sin_family = AF_INET;
+   address.sin_port = htons(port);
+   address.sin_addr.s_addr = htonl(INADDR_ANY);
+   if ((bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) || (listen(listen_fd, SOMAXCONN) != 0))
+   {
+      close(listen_fd);
+      listen_fd = -1;
+      return false;
+   }
+   epoll_event event = {};
+   event.events = EPOLLIN;
+   event.data.fd = listen_fd;
+   return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) == 0;
+}
+
+bool ingest_server_t::listen_udp(uint16_t port)
+{
+   // Receive the FEC-protected datagram uplink, with a socket buffer deep enough to absorb a whole audio packet's burst
+   udp_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   const int buffer_size = 4 * INGEST_MAX_PACKET_SIZE_BYTES;
+   setsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+   sockaddr_in address = {};
+   address.sin_family = AF_INET;
+   address.sin_port = htons(port);
+   address.sin_addr.s_addr = htonl(INADDR_ANY);
+   if (bind(udp_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+   {
+      close(udp_fd);
+      udp_fd = -1;
+      return false;
+   }
+   epoll_event event = {};
+   event.events = EPOLLIN;
+   event.data.fd = udp_fd;
+   return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, udp_fd, &event) == 0;
+}
+
+bool ingest_server_t::add_tty(const std::string &path)
+{
+   // Open the CDC-ACM device in raw, non-blocking mode; missing devices are retried periodically
+   const int fd = open(path.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+   if (fd < 0)
+   {
+      if (std::find(closed_ttys.begin(), closed_ttys.end(), path) == closed_ttys.end())
+         closed_ttys.push_back(path);
+      return false;
+   }
+   termios settings;
+   if (tcgetattr(fd, &settings) == 0)
+   {
+      cfmakeraw(&settings);
+      tcsetattr(fd, TCSANOW, &settings);
+   }
+   return watch(fd, index.register_device("tty:" + path), path);
+}
+
+bool ingest_server_t::add_stream(int fd, const std::string &name)
+{
+   // Ingest from an already-connected stream such as a pipe or socket
+   fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+   return watch(fd, index.register_device(name), std::string());
+}
+
+bool ingest_server_t::watch(int fd, uint32_t device_id, const std::string &tty_path)
+{
+   // Give every source its own packet parser so that partial packets from different devices never interleave
+   std::unique_ptr<source_t> source = std::make_unique<source_t>();
+   source->fd = fd;
+   source->device_id = device_id;
+   source->tty_path = tty_path;
+   source->packet_buffer.resize(INGEST_MAX_PACKET_SIZE_BYTES);
+   packet_parser_init(&source->parser, source->packet_buffer.data(), source->packet_buffer.size());
+   epoll_event event = {};
+   event.events = EPOLLIN | EPOLLRDHUP;
+   event.data.fd = fd;
+   if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+   {
+      close(fd);
+      return false;
+   }
+   sources[fd] = std::move(source);
+   ++stats.connections;
+   return true;
+}
+
+static std::string network_device_name(const in_addr &address)
+{
+   // Name a network device by its host address alone, so that a node streaming audio over UDP while sending everything
+   //    else over TCP, or reconnecting on either, remains a single device
+   char address_string[INET_ADDRSTRLEN] = {};
+   inet_ntop(AF_INET, &address, address_string, sizeof(address_string));
+   return std::string("net:") + address_string;
+}
+
+void ingest_server_t::accept_connections(void)
+{
+   // Identify network devices by their address so that a reconnecting device keeps its identifier
+   while (true)
+   {
+      sockaddr_in address = {};
+      socklen_t address_len = sizeof(address);
+      const int fd = accept4(listen_fd, reinterpret_cast<sockaddr*>(&address), &address_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0)
+         return;
+      const int buffer_size = 4 * INGEST_MAX_PACKET_SIZE_BYTES;
+      setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+      watch(fd, index.register_device(network_device_name(address.sin_addr)), std::string());
+   }
+}
+
+void ingest_server_t::read_source(source_t &source)
+{
+   // Perform a single bounded read per wakeup so that one busy device cannot starve the others
+   const ssize_t bytes_read = read(source.fd, read_buffer.data(), read_buffer.size());
+   if (bytes_read <= 0)
+   {
+      if ((bytes_read == 0) || ((errno != EAGAIN) && (errno != EINTR)))
+         close_source(source.fd);
+      return;
+   }
+   stats.bytes += bytes_read;
+
+   // Feed the bytes through the shared firmware packet parser
+   size_t offset = 0;
+   while (offset < (size_t)bytes_read)
+   {
+      const packet_header_t *header;
+      const uint8_t *payload;
+      offset += packet_parser_consume(&source.parser, read_buffer.data() + offset, bytes_read - offset, &header, &payload);
+      if (header)
+         handle_packet(source.device_id, header, payload);
+   }
+}
+
+void ingest_server_t::read_datagrams(void)
+{
+   // Drain a bounded number of datagrams per wakeup, passing each to its sender's decoder
+   uint8_t datagram[FEC_MAX_DATAGRAM_BYTES];
+   for (int i = 0; i < INGEST_MAX_DATAGRAMS_PER_WAKEUP; ++i)
+   {
+      sockaddr_in address = {};
+      socklen_t address_len = sizeof(address);
+      const ssize_t bytes_read = recvfrom(udp_fd, datagram, sizeof(datagram), 0, reinterpret_cast<sockaddr*>(&address), &address_len);
+      if (bytes_read < 0)
+         return;
+      stats.bytes += bytes_read;
+      ++stats.datagrams;
+      std::unique_ptr<udp_source_t> &source = udp_sources[address.sin_addr.s_addr];
+      if (!source)
+      {
+         source = std::make_unique<udp_source_t>();
+         source->server = this;
+         source->device_id = index.register_device(network_device_name(address.sin_addr));
+         source->packet_buffer.resize(INGEST_MAX_PACKET_SIZE_BYTES);
+         packet_parser_init(&source->parser, source->packet_buffer.data(), source->packet_buffer.size());
+         fec_decoder_init(&source->decoder, deliver_stream, source.get());
+         ++stats.connections;
+      }
+      const uint64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+      fec_decoder_receive(&source->decoder, datagram, bytes_read, now_us);
+      update_fec_statistics(*source);
+   }
+}
+
+void ingest_server_t::update_fec_statistics(udp_source_t &source)
+{
+   // Fold the decoder's running totals into the server-wide statistics
+   stats.recovered_shards += source.decoder.stats.recovered_shards - source.reported.recovered_shards;
+   stats.lost_shards += source.decoder.stats.lost_shards - source.reported.lost_shards;
+   source.reported = source.decoder.stats;
+}
+
+void ingest_server_t::deliver_stream(void *context, const uint8_t *data, size_t data_len)
+{
+   // Parse the decoder's in-order stream exactly like a connection's, discarding any partial packet at a loss
+   udp_source_t &source = *static_cast<udp_source_t*>(context);
+   if (!data)
+   {
+      packet_parser_init(&source.parser, source.packet_buffer.data(), source.packet_buffer.size());
+      return;
+   }
+   size_t offset = 0;
+   while (offset < data_len)
+   {
+      const packet_header_t *header;
+      const uint8_t *payload;
+      offset += packet_parser_consume(&source.parser, data + offset, data_len - offset, &header, &payload);
+      if (header)
+         source.server->handle_packet(source.device_id, header, payload);
+   }
+}
+
+void ingest_server_t::handle_packet(uint32_t device_id, const packet_header_t *header, const uint8_t *payload)
+{
+   // Copy the samples of every audio packet, at either rate, into an immutable block in the time index and hand arrival-time
+   //    reports and latency profiles to their handlers, skipping any audio or report which a node stamped from its local
+   //    clock before GPS time was available since they cannot be aligned with others, and timing the arrival of the rest
+   ++stats.packets;
+   if ((header->type == PACKET_TYPE_LATENCY_PROFILE) && (header->length >= sizeof(packet_latency_profile_t)))
+   {
+      packet_latency_profile_t profile;
+      std::memcpy(&profile, payload, sizeof(profile));
+      ++stats.latency_profiles;
+      if (latency_handler)
+         latency_handler(device_id, profile);
+      return;
+   }
+   if ((header->type == PACKET_TYPE_TOA_REPORT) && (header->length >= sizeof(packet_toa_report_t)))
+   {
+      packet_toa_report_t report;
+      std::memcpy(&report, payload, sizeof(report));
+      if (!(header->flags & PACKET_FLAG_UNSYNCHRONIZED))
+      {
+         ++stats.toa_reports;
+         if (toa_handler)
+            toa_handler(device_id, report);
+      }
+      return;
+   }
+   if (((header->type == PACKET_TYPE_AUDIO) || (header->type == PACKET_TYPE_AUDIO_DECIMATED)) && (header->flags & PACKET_FLAG_UNSYNCHRONIZED))
+   {
+      ++stats.unsynchronized_blocks;
+      return;
+   }
+   std::shared_ptr<audio_block_t> block = std::make_shared<audio_block_t>();
+   size_t header_len;
+   if ((header->type == PACKET_TYPE_AUDIO) && (header->length >= sizeof(packet_audio_t)))
+   {
+      packet_audio_t audio_header;
+      std::memcpy(&audio_header, payload, sizeof(audio_header));
+      header_len = sizeof(audio_header);
+      block->sample_rate_hz = INGEST_FULL_RATE_HZ;
+      block->timestamp = audio_header.timestamp;
+      block->lat = audio_header.lat;
+      block->lon = audio_header.lon;
+      block->height = audio_header.height;
+      block->drift_ppm = audio_header.drift_ppm;
+      block->horizontal_accuracy = audio_header.horizontal_accuracy;
+      block->vertical_accuracy = audio_header.vertical_accuracy;
+      block->resampled = (header->flags & PACKET_FLAG_RESAMPLED) != 0;
+      if (!(header->flags & PACKET_FLAG_SPOOLED))
+         record_arrival(block->timestamp);
+   }
+   else if ((header->type == PACKET_TYPE_AUDIO_DECIMATED) && (header->length >= sizeof(packet_audio_decimated_t)))
+   {
+      packet_audio_decimated_t audio_header;
+      std::memcpy(&audio_header, payload, sizeof(audio_header));
+      header_len = sizeof(audio_header);
+      block->sample_rate_hz = audio_header.sample_rate_hz;
+      block->timestamp = audio_header.timestamp;
+      block->lat = audio_header.lat;
+      block->lon = audio_header.lon;
+      block->height = audio_header.height;
+      block->drift_ppm = audio_header.drift_ppm;
+      block->horizontal_accuracy = audio_header.horizontal_accuracy;
+      block->vertical_accuracy = audio_header.vertical_accuracy;
+   }
+   else
+      return;
+   block->device_id = device_id;
+   block->sequence = header->sequence;
+   block->spooled = (header->flags & PACKET_FLAG_SPOOLED) != 0;
+   block->surveyed = (header->flags & PACKET_FLAG_SURVEYED) != 0;
+   block->samples.resize((header->length - header_len) / sizeof(int16_t));
+   std::memcpy(block->samples.data(), payload + header_len, block->samples.size() * sizeof(int16_t));
+   if (index.insert(block))
+   {
+      // Hand newly indexed blocks on to any downstream consumer such as the archive writer
+      ++stats.audio_blocks;
+      if (block_handler)
+         block_handler(block);
+   }
+   else
+      ++stats.rejected_blocks;
+}
+
+void ingest_server_t::record_arrival(double timestamp)
+{
+   // Time the arrival of a full-rate block against the GPS time at which its final sample was captured, one second after
+   //    its timestamp, which relies on this host's clock being disciplined to UTC
+   const double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+   const double latency_us = 1.0e6 * ((now - INGEST_GPS_EPOCH_UNIX_SECONDS + INGEST_GPS_LEAP_SECONDS) - (timestamp + 1.0));
+   ingest_latency_histogram_t &histogram = stats.arrival_latency;
+   if (latency_us < 0.0)
+   {
+      ++histogram.early_blocks;
+      return;
+   }
+   const uint64_t elapsed_us = (uint64_t)latency_us;
+   size_t bucket = 0;
+   for (uint64_t remaining = elapsed_us >> 1; remaining && (bucket < (PACKET_LATENCY_BUCKETS - 1)); remaining >>= 1)
+      ++bucket;
+   ++histogram.buckets[bucket];
+   histogram.total_us += elapsed_us;
+   if (elapsed_us > histogram.max_us)
+      histogram.max_us = elapsed_us;
+   ++histogram.blocks;
+}
+
+void ingest_server_t::close_source(int fd)
+{
+   // Remember ttys so that they can be reopened when the device re-enumerates
+   const auto source = sources.find(fd);
+   if (source == sources.end())
+      return;
+   if (!source->second->tty_path.empty())
+      closed_ttys.push_back(source->second->tty_path);
+   epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+   close(fd);
+   sources.erase(source);
+   ++stats.disconnections;
+}
+
+void ingest_server_t::reopen_ttys(void)
+{
+   std::vector<std::string> ttys;
+   ttys.swap(closed_ttys);
+   for (const std::string &path : ttys)
+      add_tty(path);
+}
+
+void ingest_server_t::run(void)
+{
+   // Service every ready source until stopped, periodically retrying any ttys which have disappeared and giving up on
+   //    UDP groups which can no longer be completed
+   std::vector<epoll_event> events(256);
+   auto last_retry = std::chrono::steady_clock::now();
+   while (running)
+   {
+      const int timeout = !udp_sources.empty() ? INGEST_FEC_EXPIRE_MS : (closed_ttys.empty() ? -1 : INGEST_TTY_RETRY_MS);
+      const int num_events = epoll_wait(epoll_fd, events.data(), (int)events.size(), timeout);
+      if (!udp_sources.empty())
+      {
+         const uint64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+         for (const auto &source : udp_sources)
+         {
+            fec_decoder_expire(&source.second->decoder, now_us);
+            update_fec_statistics(*source.second);
+         }
+      }
+      if (!closed_ttys.empty() && ((std::chrono::steady_clock::now() - last_retry) >= std::chrono::milliseconds(INGEST_TTY_RETRY_MS)))
+      {
+         reopen_ttys();
+         last_retry = std::chrono::steady_clock::now();
+      }
+      for (int i = 0; i < num_events; ++i)
+      {
+         const int fd = events[i].data.fd;
+         if (fd == wake_fd)
+         {
+            uint64_t value;
+            (void)!read(wake_fd, &value, sizeof(value));
+         }
+         else if (fd == listen_fd)
+            accept_connections();
+         else if (fd == udp_fd)
+            read_datagrams();
+         else
+         {
+            const auto source = sources.find(fd);
+            if (source == sources.end())
+               continue;
+            if (events[i].events & EPOLLIN)
+               read_source(*source->second);
+            else if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+               close_source(fd);
+         }
+      }
+   }
+}
+
+void ingest_server_t::stop(void)
+{
+   // Wake the event loop so that it notices the stop request
+   running = false;
+   const uint64_t value = 1;
+   (void)!write(wake_fd, &value, sizeof(value));
+}
@@ -0,0 +1,116 @@
+#ifndef __INGEST_SERVER_HEADER_HPP__
+#define __INGEST_SERVER_HEADER_HPP__
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "time_index.hpp"
+
+extern "C" {
+#include "fec.h"
+#include "packet.h"
+}
+
+// Sample rate implied by a full-rate PACKET_TYPE_AUDIO packet
+static constexpr uint32_t INGEST_FULL_RATE_HZ = 48000;
+static constexpr size_t INGEST_MAX_PACKET_SIZE_BYTES = sizeof(packet_header_t) + sizeof(packet_audio_t) + (INGEST_FULL_RATE_HZ * sizeof(int16_t));
+static constexpr size_t INGEST_READ_SIZE_BYTES = 64 * 1024;
+static constexpr int INGEST_TTY_RETRY_MS = 1000;
+static constexpr int INGEST_FEC_EXPIRE_MS = FEC_DECODER_REORDER_US / 1000;
+static constexpr int INGEST_MAX_DATAGRAMS_PER_WAKEUP = 64;
+static constexpr double INGEST_GPS_EPOCH_UNIX_SECONDS = 315964800.0;  // 1980-01-06 00:00:00 UTC
+static constexpr double INGEST_GPS_LEAP_SECONDS = 18.0;  // GPS time ahead of UTC, unchanged since 2017
+
+// Distribution of how long after its final sample was captured each live, GPS-timestamped full-rate block arrived here,
+//    binned exactly like the nodes' own stage histograms so that the two can be compared; blocks stamped as arriving
+//    before they were captured are only counted, since they show that this host's clock is not disciplined to UTC
+struct ingest_latency_histogram_t
+{
+   std::atomic<uint64_t> blocks{0}, early_blocks{0}, total_us{0}, max_us{0};
+   std::array<std::atomic<uint64_t>, PACKET_LATENCY_BUCKETS> buckets{};
+};
+
+// Running totals across every ingest source
+struct ingest_statistics_t
+{
+   std::atomic<uint64_t> bytes{0}, packets{0}, audio_blocks{0}, rejected_blocks{0}, unsynchronized_blocks{0}, connections{0}, disconnections{0};
+   std::atomic<uint64_t> datagrams{0}, recovered_shards{0}, lost_shards{0};
+   std::atomic<uint64_t> toa_reports{0}, latency_profiles{0};
+   ingest_latency_histogram_t arrival_latency;
+};
+
+// Single-threaded epoll loop which parses framed packets from many CDC ttys, network connections, and FEC-protected
+//    UDP uplinks at once and places every received audio block into the shared time index, passing on any arrival-time
+//    reports from the nodes' own onset pickers and any latency profiles from their capture pipelines as they come
+class ingest_server_t
+{
+public:
+   using block_handler_t = std::function<void(const std::shared_ptr<const audio_block_t>&)>;
+   using toa_handler_t = std::function<void(uint32_t, const packet_toa_report_t&)>;
+   using latency_handler_t = std::function<void(uint32_t, const packet_latency_profile_t&)>;
+
+   explicit ingest_server_t(time_index_t &index);
+   ~ingest_server_t();
+
+   bool listen_tcp(uint16_t port);
+   bool listen_udp(uint16_t port);
+   bool add_tty(const std::string &path);
+   bool add_stream(int fd, const std::string &name);
+   void set_block_handler(block_handler_t handler) { block_handler = std::move(handler); }
+   void set_toa_handler(toa_handler_t handler) { toa_handler = std::move(handler); }
+   void set_latency_handler(latency_handler_t handler) { latency_handler = std::move(handler); }
+   void run(void);
+   void stop(void);
+   const ingest_statistics_t& statistics(void) const { return stats; }
+
+private:
+   struct source_t
+   {
+      int fd = -1;
+      uint32_t device_id = 0;
+      std::string tty_path;
+      packet_parser_t parser;
+      std::vector<uint8_t> packet_buffer;
+   };
+
+   // A node sending over UDP, identified by its address so that a restarted node keeps its identifier
+   struct udp_source_t
+   {
+      ingest_server_t *server = nullptr;
+      uint32_t device_id = 0;
+      fec_decoder_t decoder;
+      fec_statistics_t reported = {};
+      packet_parser_t parser;
+      std::vector<uint8_t> packet_buffer;
+   };
+
+   bool watch(int fd, uint32_t device_id, const std::string &tty_path);
+   void accept_connections(void);
+   void read_source(source_t &source);
+   void read_datagrams(void);
+   void update_fec_statistics(udp_source_t &source);
+   static void deliver_stream(void *context, const uint8_t *data, size_t data_len);
+   void handle_packet(uint32_t device_id, const packet_header_t *header, const uint8_t *payload);
+   void record_arrival(double timestamp);
+   void close_source(int fd);
+   void reopen_ttys(void);
+
+   time_index_t &index;
+   ingest_statistics_t stats;
+   int epoll_fd = -1, listen_fd = -1, udp_fd = -1, wake_fd = -1;
+   std::atomic<bool> running{true};
+   block_handler_t block_handler;
+   toa_handler_t toa_handler;
+   latency_handler_t latency_handler;
+   std::unordered_map<int, std::unique_ptr<source_t>> sources;
+   std::unordered_map<uint32_t, std::unique_ptr<udp_source_t>> udp_sources;
+   std::vector<std::string> closed_ttys;
+   std::vector<uint8_t> read_buffer;
+};
+
+#endif  // __INGEST_SERVER_HEADER_HPP__
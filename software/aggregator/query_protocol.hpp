@@ -0,0 +1,27 @@
+#ifndef __QUERY_PROTOCOL_HEADER_HPP__
+#define __QUERY_PROTOCOL_HEADER_HPP__
+
+#include <cstdint>
+
+// Aggregator window query protocol
+//    Request:  one text line "<start_timestamp> <end_timestamp> [sample_rate_hz]\n"
+//              An end timestamp of 0 means the end of the newest audio received, and a start timestamp at or below 0 is
+//              then relative to that end (so "-5 0" asks for the latest five seconds)
+//    Response: uint32_t segment count followed by that many (query_segment_header_t, int16_t samples[num_samples]) pairs
+static constexpr uint16_t QUERY_DEFAULT_PORT = 5001;
+static constexpr size_t QUERY_MAX_REQUEST_BYTES = 128;
+static constexpr size_t QUERY_DEVICE_NAME_LEN = 32;
+
+#pragma pack(push, 1)
+struct query_segment_header_t
+{
+   uint32_t device_id, sample_rate_hz;
+   double timestamp;
+   double lat, lon;
+   float height;
+   uint32_t num_samples;
+   char device_name[QUERY_DEVICE_NAME_LEN];
+};
+#pragma pack(pop)
+
+#endif  // __QUERY_PROTOCOL_HEADER_HPP__
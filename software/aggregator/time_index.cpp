@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cmath>
+#include "time_index.hpp"
+
+time_index_t::time_index_t(uint32_t retention_seconds) : buckets(std::max(retention_seconds, 2u)), newest_timestamp(0.0) {}
+
+uint32_t time_index_t::register_device(const std::string &name)
+{
+   // Return the existing identifier for a known device so that reconnections keep their identity
+   std::lock_guard<std::mutex> lock(devices_mutex);
+   const auto existing = std::find(device_names.begin(), device_names.end(), name);
+   if (existing != device_names.end())
+      return (uint32_t)(existing - device_names.begin());
+   device_names.push_back(name);
+   return (uint32_t)(device_names.size() - 1);
+}
+
+std::string time_index_t::device_name(uint32_t device_id) const
+{
+   std::lock_guard<std::mutex> lock(devices_mutex);
+   return (device_id < device_names.size()) ? device_names[device_id] : std::string();
+}
+
+size_t time_index_t::num_devices(void) const
+{
+   std::lock_guard<std::mutex> lock(devices_mutex);
+   return device_names.size();
+}
+
+bool time_index_t::insert(std::shared_ptr<const audio_block_t> block)
+{
+   // Reject blocks which are malformed or have already aged out of the retention period
+   if (!block->sample_rate_hz || block->samples.empty() || (block->end_timestamp() > (block->timestamp + TIME_INDEX_MAX_BLOCK_SECONDS + 1.0e-6)))
+      return false;
+   const int64_t second = (int64_t)std::floor(block->timestamp), num_buckets = (int64_t)buckets.size();
+   if (second <= ((int64_t)std::floor(newest_timestamp.load()) - num_buckets))
+      return false;
+
+   // Recycle the bucket if it still holds an older second, ignoring duplicates such as a spooled copy of a live block
+   bucket_t &bucket = buckets[((second % num_buckets) + num_buckets) % num_buckets];
+   {
+      std::lock_guard<std::mutex> lock(bucket.mutex);
+      if (bucket.second > second)
+         return false;
+      else if (bucket.second < second)
+      {
+         bucket.second = second;
+         bucket.blocks.clear();
+      }
+      for (const auto &existing : bucket.blocks)
+         if ((existing->device_id == block->device_id) && (existing->sample_rate_hz == block->sample_rate_hz) &&
+             (std::fabs(existing->timestamp - block->timestamp) < (0.5 / block->sample_rate_hz)))
+            return false;
+      bucket.blocks.push_back(block);
+   }
+
+   // Advance the newest known timestamp, which bounds the retention window
+   double newest = newest_timestamp.load();
+   while ((block->timestamp > newest) && !newest_timestamp.compare_exchange_weak(newest, block->timestamp));
+   return true;
+}
+
+std::vector<audio_segment_t> time_index_t::query(double start_timestamp, double end_timestamp, uint32_t sample_rate_hz) const
+{
+   // Visit only the buckets whose blocks could overlap the window, limited to the retention period
+   std::vector<audio_segment_t> segments;
+   if (end_timestamp <= start_timestamp)
+      return segments;
+   const int64_t num_buckets = (int64_t)buckets.size(), last_second = (int64_t)std::floor(end_timestamp);
+   const int64_t first_second = std::max((int64_t)std::floor(start_timestamp - TIME_INDEX_MAX_BLOCK_SECONDS), last_second - num_buckets + 1);
+   for (int64_t second = first_second; second <= last_second; ++second)
+   {
+      const bucket_t &bucket = buckets[((second % num_buckets) + num_buckets) % num_buckets];
+      std::lock_guard<std::mutex> lock(bucket.mutex);
+      if (bucket.second != second)
+         continue;
+      for (const auto &block : bucket.blocks)
+      {
+         // Trim each overlapping block to the samples inside the window
+         if ((sample_rate_hz && (block->sample_rate_hz != sample_rate_hz)) || (block->timestamp >= end_timestamp) || (block->end_timestamp() <= start_timestamp))
+            continue;
+         const double rate = block->sample_rate_hz, num_samples = (double)block->samples.size();
+         const uint32_t first = (uint32_t)std::clamp(std::ceil(((start_timestamp - block->timestamp) * rate) - TIME_INDEX_SAMPLE_TOLERANCE), 0.0, num_samples);
+         const uint32_t last = (uint32_t)std::clamp(std::ceil(((end_timestamp - block->timestamp) * rate) - TIME_INDEX_SAMPLE_TOLERANCE), 0.0, num_samples);
+         if (last > first)
+            segments.push_back({ block, first, last - first });
+      }
+   }
+
+   // Order the results by device and then by time
+   std::sort(segments.begin(), segments.end(), [](const audio_segment_t &a, const audio_segment_t &b)
+   {
+      return (a.block->device_id != b.block->device_id) ? (a.block->device_id < b.block->device_id) : (a.timestamp() < b.timestamp());
+   });
+   return segments;
+}
+
+double time_index_t::latest_timestamp(void) const
+{
+   return newest_timestamp.load();
+}
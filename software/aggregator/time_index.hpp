@@ -0,0 +1,74 @@
+#ifndef __TIME_INDEX_HEADER_HPP__
+#define __TIME_INDEX_HEADER_HPP__
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Longest block the index will accept; a block is stored under the GPS second in which it starts
+static constexpr double TIME_INDEX_MAX_BLOCK_SECONDS = 1.0;
+
+// Fraction of a sample by which window edges may miss a sample boundary due to double-precision GPS times
+static constexpr double TIME_INDEX_SAMPLE_TOLERANCE = 1.0e-3;
+
+// One immutable block of audio received from a device
+struct audio_block_t
+{
+   uint32_t device_id = 0, sample_rate_hz = 0;
+   uint16_t sequence = 0;
+   double timestamp = 0.0;
+   double lat = 0.0, lon = 0.0;
+   float height = 0.0f, drift_ppm = 0.0f;
+   float horizontal_accuracy = 0.0f, vertical_accuracy = 0.0f;
+   bool spooled = false, resampled = false, surveyed = false;
+   std::vector<int16_t> samples;
+
+   double end_timestamp(void) const { return timestamp + ((double)samples.size() / sample_rate_hz); }
+};
+
+// Portion of a block falling inside a query window
+struct audio_segment_t
+{
+   std::shared_ptr<const audio_block_t> block;
+   uint32_t first_sample = 0, num_samples = 0;
+
+   double timestamp(void) const { return block->timestamp + ((double)first_sample / block->sample_rate_hz); }
+   const int16_t* samples(void) const { return block->samples.data() + first_sample; }
+};
+
+// Global GPS-time index of recent audio from every device
+//    Blocks are bucketed by GPS second in a fixed ring covering the retention period, so inserts and evictions are O(1)
+//    and a query for [t0, t1] visits only the buckets overlapping the window, each under its own lock
+class time_index_t
+{
+public:
+   explicit time_index_t(uint32_t retention_seconds);
+
+   uint32_t register_device(const std::string &name);
+   std::string device_name(uint32_t device_id) const;
+   size_t num_devices(void) const;
+
+   bool insert(std::shared_ptr<const audio_block_t> block);
+   std::vector<audio_segment_t> query(double start_timestamp, double end_timestamp, uint32_t sample_rate_hz = 0) const;
+   double latest_timestamp(void) const;
+   uint32_t retention_seconds(void) const { return (uint32_t)buckets.size(); }
+
+private:
+   struct bucket_t
+   {
+      mutable std::mutex mutex;
+      int64_t second = INT64_MIN;
+      std::vector<std::shared_ptr<const audio_block_t>> blocks;
+   };
+
+   std::vector<bucket_t> buckets;
+   mutable std::mutex devices_mutex;
+   std::vector<std::string> device_names;
+   std::atomic<double> newest_timestamp;
+};
+
+#endif  // __TIME_INDEX_HEADER_HPP__
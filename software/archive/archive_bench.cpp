@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+#include "archive_reader.hpp"
+#include "archive_writer.hpp"
+
+static constexpr double BENCH_BASE_TIMESTAMP = 1400000000.0;
+static constexpr uint32_t BENCH_DROPOUT_PERIOD_SECONDS = 7919;
+static constexpr uint32_t BENCH_DROPOUT_SECONDS = 3;
+static constexpr double BENCH_WINDOW_SECONDS = 0.2;
+static constexpr uint32_t BENCH_PACKETS_PER_SECOND = 3;  // Full-rate, decimated and summary packets sharing one transport counter
+static constexpr uint32_t BENCH_EXTRA_PACKET_PERIOD = 5;  // Seconds between the interleaved log and TOA report packets of a node
+
+static void usage(void)
+{
+   std::fprintf(stderr, "Usage: archive_bench [--root <dir>] [--days <n>] [--devices <n>] [--rate <Hz>] [--raw] [--queries <n>] [--keep]\n");
+   std::exit(1);
+}
+
+static inline int16_t synthetic_sample(uint32_t device, uint64_t index, uint32_t sample_rate_hz)
+{
+   // Quiet background noise with a slowly drifting tone, reproducible from the device and absolute sample index alone
+   uint64_t hash = (index * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)device << 56);
+   hash ^= hash >> 29;
+   hash *= 0xBF58476D1CE4E5B9ull;
+   hash ^= hash >> 32;
+   const int32_t noise = (int32_t)(hash & 0x3F) - 32;
+   const uint32_t phase = (uint32_t)((index * (440 + (device * 7)) * 65536ull) / sample_rate_hz);
+   const int32_t tone = ((phase & 0xFFFF) < 0x8000) ? 400 : -400;
+   return (int16_t)(noise + tone);
+}
+
+static inline double device_offset(uint32_t device)
+{
+   return 0.0001 * (device % 10);
+}
+
+static inline bool in_dropout(uint32_t device, uint64_t second)
+{
+   return ((second + (device * 1009)) % BENCH_DROPOUT_PERIOD_SECONDS) < BENCH_DROPOUT_SECONDS;
+}
+
+static double percentile(std::vector<double> &values, double fraction)
+{
+   if (values.empty())
+      return 0.0;
+   const size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+   std::nth_element(values.begin(), values.begin() + index, values.end());
+   return values[index];
+}
+
+int main(int argc, char **argv)
+{
+   // Parse command-line arguments
+   std::string root = "/tmp/civicalert_archive_bench";
+   double days = 2.0;
+   uint32_t num_devices = 2, sample_rate_hz = 16000, num_queries = 2000;
+   bool compress = true, keep = false;
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg = argv[i];
+      if ((arg == "--root") && (i + 1 < argc))
+         root = argv[++i];
+      else if ((arg == "--days") && (i + 1 < argc))
+         days = std::atof(argv[++i]);
+      else if ((arg == "--devices") && (i + 1 < argc))
+         num_devices = (uint32_t)std::atol(argv[++i]);
+      else if ((arg == "--rate") && (i + 1 < argc))
+         sample_rate_hz = (uint32_t)std::atol(argv[++i]);
+      else if ((arg == "--queries") && (i + 1 < argc))
+         num_queries = (uint32_t)std::atol(argv[++i]);
+      else if (arg == "--raw")
+         compress = false;
+      else if (arg == "--keep")
+         keep = true;
+      else
+         usage();
+   }
+   std::filesystem::remove_all(root);
+
+   // Write the synthetic multi-day archive one second at a time, with periodic dropouts on every device, numbering each
+   //    block as a node's transport would with every other packet type it sends interleaved between them
+   const uint64_t num_seconds = (uint64_t)(days * 86400.0);
+   std::vector<int16_t> samples(sample_rate_hz);
+   const auto write_start = std::chrono::steady_clock::now();
+   archive_writer_statistics_t write_stats;
+   uint64_t expected_gaps = 0;
+   {
+      archive_writer_t writer(root, compress);
+      std::vector<uint16_t> sequences(num_devices, 0);
+      std::vector<bool> written(num_devices, false), dropped(num_devices, false);
+      for (uint64_t second = 0; second < num_seconds; ++second)
+         for (uint32_t device = 0; device < num_devices; ++device)
+         {
+            sequences[device] += BENCH_PACKETS_PER_SECOND + ((((second + device) % BENCH_EXTRA_PACKET_PERIOD) == 0) ? 2 : 0);
+            if (in_dropout(device, second))
+            {
+               dropped[device] = true;
+               continue;
+            }
+            expected_gaps += written[device] && dropped[device];
+            written[device] = true;
+            dropped[device] = false;
+            for (uint32_t i = 0; i < sample_rate_hz; ++i)
+               samples[i] = synthetic_sample(device, (second * sample_rate_hz) + i, sample_rate_hz);
+            archive_block_info_t info;
+            info.timestamp = BENCH_BASE_TIMESTAMP + second + device_offset(device);
+            info.sample_rate_hz = sample_rate_hz;
+            info.sequence = sequences[device];
+            info.lat = 36.14 + (0.001 * device);
+            info.lon = -86.80;
+            info.height = 180.0f;
+            writer.write_block("node" + std::to_string(device), info, samples.data(), sample_rate_hz);
+         }
+      writer.close();
+      write_stats = writer.statistics();
+   }
+   const double write_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - write_start).count();
+   const double audio_bytes = (double)write_stats.samples * sizeof(int16_t);
+   std::printf("Wrote %0.2f days x %u devices @ %u Hz: %llu blocks in %llu segments, %0.1f MB audio -> %0.1f MB archive (%0.2fx), "
+               "%0.1f s (%0.0f MB/s, %0.0fx real time)\n",
+               days, num_devices, sample_rate_hz, (unsigned long long)write_stats.blocks, (unsigned long long)write_stats.segments,
+               audio_bytes / 1.0e6, write_stats.file_bytes / 1.0e6, audio_bytes / write_stats.file_bytes, write_seconds,
+               audio_bytes / (write_seconds * 1.0e6), (num_seconds * num_devices) / write_seconds);
+
+   // Open the archive fresh and summarize it from the segment indexes
+   auto open_start = std::chrono::steady_clock::now();
+   archive_reader_t reader(root);
+   uint64_t total_gaps = 0;
+   for (const archive_stream_info_t &stream : reader.describe())
+      total_gaps += stream.gaps;
+   const double open_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - open_start).count();
+   std::printf("Opened and summarized %zu devices in %0.2f ms, %llu gaps recorded (%llu dropouts written)\n", reader.devices().size(), open_ms,
+               (unsigned long long)total_gaps, (unsigned long long)expected_gaps);
+
+   // Extract random all-device windows across the whole span, verifying every returned sample
+   std::mt19937_64 generator(42);
+   std::uniform_real_distribution<double> start_distribution(1.0, std::max(2.0, num_seconds - 2.0));
+   std::vector<double> latencies_ms;
+   uint64_t mismatches = 0, windows_returned = 0;
+   for (uint32_t query = 0; query < num_queries; ++query)
+   {
+      const double start_timestamp = BENCH_BASE_TIMESTAMP + start_distribution(generator);
+      const auto query_start = std::chrono::steady_clock::now();
+      const std::vector<archive_window_t> windows = reader.read_window(start_timestamp, start_timestamp + BENCH_WINDOW_SECONDS);
+      latencies_ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - query_start).count());
+      windows_returned += windows.size();
+      for (const archive_window_t &window : windows)
+      {
+         const uint32_t device = (uint32_t)std::atol(window.device.c_str() + 4);
+         const uint64_t first_index = (uint64_t)std::llround((window.timestamp - BENCH_BASE_TIMESTAMP - device_offset(device)) * sample_rate_hz);
+         for (size_t i = 0; i < window.samples.size(); ++i)
+            mismatches += (window.samples[i] != synthetic_sample(device, first_index + i, sample_rate_hz));
+      }
+   }
+   const double p50 = percentile(latencies_ms, 0.5), p99 = percentile(latencies_ms, 0.99);
+   const double max = latencies_ms.empty() ? 0.0 : *std::max_element(latencies_ms.begin(), latencies_ms.end());
+   std::printf("%u queries of %0.0f ms across all devices: %llu windows, p50 %0.3f ms, p99 %0.3f ms, max %0.3f ms, %llu sample mismatches\n",
+               num_queries, BENCH_WINDOW_SECONDS * 1.0e3, (unsigned long long)windows_returned, p50, p99, max, (unsigned long long)mismatches);
+
+   // Confirm that a segment which lost its index (as after a crash) is rebuilt from its blocks
+   uint64_t recovered_blocks = 0, expected_blocks = 0;
+   const std::string recovery_root = root + "_recovery";
+   std::filesystem::remove_all(recovery_root);
+   for (const auto &entry : std::filesystem::recursive_directory_iterator(root))
+      if (entry.path().extension() == ARCHIVE_SEGMENT_EXTENSION)
+      {
+         const std::filesystem::path copy = std::filesystem::path(recovery_root) / "node0" / std::to_string(sample_rate_hz) / entry.path().filename();
+         std::filesystem::create_directories(copy.parent_path());
+         std::filesystem::copy_file(entry.path(), copy);
+         std::unique_ptr<archive_segment_t> segment = archive_segment_t::open(entry.path().string());
+         expected_blocks = segment ? segment->num_entries() : 0;
+         std::filesystem::resize_file(copy, std::filesystem::file_size(copy) - sizeof(archive_footer_t) - 1);
+         break;
+      }
+   {
+      archive_reader_t recovery_reader(recovery_root);
+      for (const archive_stream_info_t &stream : recovery_reader.describe())
+         recovered_blocks += stream.recovered_segments ? stream.blocks : 0;
+   }
+   std::printf("Index recovery: %llu of %llu blocks rebuilt from a segment without its footer\n", (unsigned long long)recovered_blocks, (unsigned long long)expected_blocks);
+   std::filesystem::remove_all(recovery_root);
+   if (!keep)
+      std::filesystem::remove_all(root);
+   return (mismatches || !windows_returned || (recovered_blocks != expected_blocks) || (total_gaps != expected_gaps)) ? 1 : 0;
+}
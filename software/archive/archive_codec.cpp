@@ -0,0 +1,164 @@
+#include <cstdlib>
+#include "archive_codec.hpp"
+
+namespace
+{
+
+// Most-significant-bit-first bit packer
+class bit_writer_t
+{
+public:
+   explicit bit_writer_t(std::vector<uint8_t> &output) : output(output) {}
+
+   void put(uint32_t value, uint32_t num_bits)
+   {
+      accumulator = (accumulator << num_bits) | value;
+      pending += num_bits;
+      while (pending >= 8)
+      {
+         pending -= 8;
+         output.push_back((uint8_t)(accumulator >> pending));
+      }
+   }
+
+   void flush(void)
+   {
+      if (pending)
+         output.push_back((uint8_t)(accumulator << (8 - pending)));
+      pending = 0;
+   }
+
+private:
+   std::vector<uint8_t> &output;
+   uint64_t accumulator = 0;
+   uint32_t pending = 0;
+};
+
+// Most-significant-bit-first bit unpacker which reads zeros past the end of its input and remembers that it did so
+class bit_reader_t
+{
+public:
+   bit_reader_t(const uint8_t *data, size_t data_len) : data(data), data_len(data_len) {}
+
+   void refill(void)
+   {
+      while (available <= 56)
+      {
+         const uint64_t byte = (position < data_len) ? data[position] : 0;
+         bits |= byte << (56 - available);
+         available += 8;
+         ++position;
+      }
+   }
+
+   uint32_t get(uint32_t num_bits)
+   {
+      refill();
+      const uint32_t value = num_bits ? (uint32_t)(bits >> (64 - num_bits)) : 0;
+      bits <<= num_bits;
+      available -= num_bits;
+      return value;
+   }
+
+   uint32_t get_rice(uint32_t parameter)
+   {
+      // Unary quotient terminated by a one bit, or an escape followed by the raw value
+      refill();
+      const uint32_t quotient = bits ? (uint32_t)__builtin_clzll(bits) : 64;
+      if (quotient >= ARCHIVE_RICE_ESCAPE_QUOTIENT)
+      {
+         bits <<= ARCHIVE_RICE_ESCAPE_QUOTIENT;
+         available -= ARCHIVE_RICE_ESCAPE_QUOTIENT;
+         return get(ARCHIVE_RICE_ESCAPE_BITS);
+      }
+      bits <<= (quotient + 1);
+      available -= (quotient + 1);
+      return (quotient << parameter) | get(parameter);
+   }
+
+   bool overrun(void) const { return ((position * 8) - available) > (data_len * 8); }
+
+private:
+   const uint8_t *data;
+   size_t data_len, position = 0;
+   uint64_t bits = 0;
+   uint32_t available = 0;
+};
+
+inline uint32_t zigzag(int32_t value) { return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31); }
+inline int32_t unzigzag(uint32_t value) { return (int32_t)(value >> 1) ^ -(int32_t)(value & 1); }
+
+}  // namespace
+
+size_t archive_rice_encode(const int16_t *samples, uint32_t num_samples, std::vector<uint8_t> &output)
+{
+   // Code each partition with the better of the two predictors and its own Rice parameter
+   const size_t start_size = output.size();
+   bit_writer_t writer(output);
+   int32_t previous1 = 0, previous2 = 0;
+   for (uint32_t start = 0; start < num_samples; start += ARCHIVE_RICE_PARTITION_SAMPLES)
+   {
+      const uint32_t count = ((num_samples - start) < ARCHIVE_RICE_PARTITION_SAMPLES) ? (num_samples - start) : ARCHIVE_RICE_PARTITION_SAMPLES;
+      uint64_t sum_order1 = 0, sum_order2 = 0;
+      int32_t x1 = previous1, x2 = previous2;
+      for (uint32_t i = start; i < (start + count); ++i)
+      {
+         sum_order1 += zigzag(samples[i] - x1);
+         sum_order2 += zigzag(samples[i] - (2 * x1) + x2);
+         x2 = x1;
+         x1 = samples[i];
+      }
+      const bool second_order = sum_order2 < sum_order1;
+      const uint64_t sum = second_order ? sum_order2 : sum_order1;
+      uint32_t parameter = 0;
+      while ((parameter < ARCHIVE_RICE_MAX_PARAMETER) && (((uint64_t)count << (parameter + 1)) <= sum))
+         ++parameter;
+      writer.put((second_order ? 0x20 : 0x00) | parameter, 6);
+      for (uint32_t i = start; i < (start + count); ++i)
+      {
+         const uint32_t residual = zigzag(second_order ? (samples[i] - (2 * previous1) + previous2) : (samples[i] - previous1));
+         const uint32_t quotient = residual >> parameter;
+         if (quotient < ARCHIVE_RICE_ESCAPE_QUOTIENT)
+         {
+            writer.put(1, quotient + 1);
+            writer.put(residual & ((1u << parameter) - 1), parameter);
+         }
+         else
+         {
+            writer.put(0, ARCHIVE_RICE_ESCAPE_QUOTIENT);
+            writer.put(residual, ARCHIVE_RICE_ESCAPE_BITS);
+         }
+         previous2 = previous1;
+         previous1 = samples[i];
+      }
+   }
+   writer.flush();
+   return output.size() - start_size;
+}
+
+bool archive_rice_decode(const uint8_t *data, size_t data_len, int16_t *samples, uint32_t num_samples)
+{
+   // Reverse the partitioned prediction, rejecting streams which end early or produce out-of-range samples
+   bit_reader_t reader(data, data_len);
+   int32_t previous1 = 0, previous2 = 0;
+   for (uint32_t start = 0; start < num_samples; start += ARCHIVE_RICE_PARTITION_SAMPLES)
+   {
+      const uint32_t count = ((num_samples - start) < ARCHIVE_RICE_PARTITION_SAMPLES) ? (num_samples - start) : ARCHIVE_RICE_PARTITION_SAMPLES;
+      const uint32_t partition = reader.get(6);
+      const bool second_order = (partition & 0x20) != 0;
+      const uint32_t parameter = partition & 0x1F;
+      if (parameter > ARCHIVE_RICE_MAX_PARAMETER)
+         return false;
+      for (uint32_t i = start; i < (start + count); ++i)
+      {
+         const int32_t prediction = second_order ? ((2 * previous1) - previous2) : previous1;
+         const int32_t sample = prediction + unzigzag(reader.get_rice(parameter));
+         if ((sample < INT16_MIN) || (sample > INT16_MAX))
+            return false;
+         samples[i] = (int16_t)sample;
+         previous2 = previous1;
+         previous1 = sample;
+      }
+   }
+   return !reader.overrun();
+}
@@ -0,0 +1,20 @@
+#ifndef __ARCHIVE_CODEC_HEADER_HPP__
+#define __ARCHIVE_CODEC_HEADER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless block compression for archived audio
+//    Samples are split into partitions, each predicted with whichever of a first- or second-order fixed polynomial
+//    predictor leaves the smaller residual, and the zigzagged residuals are Rice coded with a per-partition parameter.
+//    Blocks are coded independently so that any block can be decoded on its own.
+static constexpr uint32_t ARCHIVE_RICE_PARTITION_SAMPLES = 256;
+static constexpr uint32_t ARCHIVE_RICE_MAX_PARAMETER = 20;
+static constexpr uint32_t ARCHIVE_RICE_ESCAPE_QUOTIENT = 32;
+static constexpr uint32_t ARCHIVE_RICE_ESCAPE_BITS = 20;
+
+size_t archive_rice_encode(const int16_t *samples, uint32_t num_samples, std::vector<uint8_t> &output);
+bool archive_rice_decode(const uint8_t *data, size_t data_len, int16_t *samples, uint32_t num_samples);
+
+#endif  // __ARCHIVE_CODEC_HEADER_HPP__
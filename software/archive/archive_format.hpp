@@ -0,0 +1,100 @@
+#ifndef __ARCHIVE_FORMAT_HEADER_HPP__
+#define __ARCHIVE_FORMAT_HEADER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+// Segmented audio archive layout
+//    <root>/<device>/<sample rate>/<first GPS second>[.<n>].seg
+//    Each segment file holds one device stream for a fixed span of GPS time:
+//       archive_segment_header_t
+//       (archive_block_header_t, payload padded to ARCHIVE_ALIGNMENT) for every block, in arrival order
+//       archive_index_entry_t[num_entries], sorted by timestamp
+//       archive_gap_t[num_gaps], sorted by timestamp
+//       archive_footer_t
+//    Every structure is 8-byte aligned in the file, so a reader can mmap a finished segment and use the index in place.
+//    A segment without a valid footer (e.g. after a crash) is recovered by walking its CRC-protected block headers.
+static constexpr uint32_t ARCHIVE_SEGMENT_MAGIC = 0x47534143;
+static constexpr uint32_t ARCHIVE_BLOCK_MAGIC = 0x4B4C4243;
+static constexpr uint32_t ARCHIVE_FOOTER_MAGIC = 0x58444943;
+static constexpr uint16_t ARCHIVE_VERSION = 2;
+static constexpr size_t ARCHIVE_ALIGNMENT = 8;
+static constexpr size_t ARCHIVE_DEVICE_NAME_LEN = 32;
+static constexpr uint32_t ARCHIVE_DEFAULT_SEGMENT_SECONDS = 3600;
+static constexpr double ARCHIVE_GAP_TOLERANCE_SECONDS = 0.005;
+static constexpr double ARCHIVE_MAX_BLOCK_SECONDS = 1.0;
+static constexpr double ARCHIVE_SAMPLE_TOLERANCE = 1.0e-3;
+static constexpr const char *ARCHIVE_SEGMENT_EXTENSION = ".seg";
+
+enum archive_codec_t : uint8_t
+{
+   ARCHIVE_CODEC_PCM16 = 0,
+   ARCHIVE_CODEC_RICE = 1
+};
+
+enum archive_block_flags_t : uint8_t
+{
+   ARCHIVE_FLAG_SPOOLED = 0x01,
+   ARCHIVE_FLAG_GAP_BEFORE = 0x02
+};
+
+#pragma pack(push, 1)
+struct archive_segment_header_t
+{
+   uint32_t magic;
+   uint16_t version, header_size;
+   uint32_t sample_rate_hz, segment_seconds;
+   int64_t start_second;
+   char device_name[ARCHIVE_DEVICE_NAME_LEN];
+};
+
+struct archive_block_header_t
+{
+   uint32_t magic;
+   uint8_t codec, flags;
+   uint16_t sequence;
+   double timestamp;
+   uint32_t num_samples, payload_bytes;
+   double lat, lon;
+   float height;
+   uint32_t crc32;
+};
+
+struct archive_index_entry_t
+{
+   double timestamp;
+   uint64_t offset;
+   uint32_t num_samples;
+   uint16_t sequence;
+   uint8_t codec, flags;
+};
+
+struct archive_gap_t
+{
+   double start_timestamp, end_timestamp;
+   uint16_t previous_sequence, sequence;
+   uint32_t reserved;
+};
+
+struct archive_footer_t
+{
+   uint64_t index_offset, gaps_offset;
+   uint32_t num_entries, num_gaps;
+   double first_timestamp, last_timestamp;
+   uint64_t total_samples, payload_bytes;
+   uint32_t crc32, magic;
+};
+#pragma pack(pop)
+
+static_assert((sizeof(archive_segment_header_t) % ARCHIVE_ALIGNMENT) == 0, "Segment header must preserve alignment");
+static_assert((sizeof(archive_block_header_t) % ARCHIVE_ALIGNMENT) == 0, "Block header must preserve alignment");
+static_assert((sizeof(archive_index_entry_t) % ARCHIVE_ALIGNMENT) == 0, "Index entries must preserve alignment");
+static_assert((sizeof(archive_gap_t) % ARCHIVE_ALIGNMENT) == 0, "Gap entries must preserve alignment");
+static_assert((sizeof(archive_footer_t) % ARCHIVE_ALIGNMENT) == 0, "Footer must preserve alignment");
+
+static inline size_t archive_padded_size(size_t size)
+{
+   return (size + ARCHIVE_ALIGNMENT - 1) & ~(ARCHIVE_ALIGNMENT - 1);
+}
+
+#endif  // __ARCHIVE_FORMAT_HEADER_HPP__
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "archive_reader.hpp"
+
+static void usage(void)
+{
+   std::fprintf(stderr,
+      "Usage: archive_query <root> --info\n"
+      "       archive_query <root> --start <GPS time> --end <GPS time> [--rate <Hz>] [--device <name>]... [--verify] [--output <prefix>]\n");
+   std::exit(1);
+}
+
+static bool write_wav(const std::string &path, const archive_window_t &window)
+{
+   // Canonical 44-byte RIFF header for 16-bit mono PCM
+   std::FILE *file = std::fopen(path.c_str(), "wb");
+   if (!file)
+      return false;
+   const uint32_t data_bytes = (uint32_t)(window.samples.size() * sizeof(int16_t)), riff_bytes = 36 + data_bytes, format_bytes = 16;
+   const uint32_t byte_rate = window.sample_rate_hz * sizeof(int16_t);
+   const uint16_t format = 1, channels = 1, block_align = sizeof(int16_t), bits_per_sample = 16;
+   std::fwrite("RIFF", 1, 4, file);
+   std::fwrite(&riff_bytes, sizeof(riff_bytes), 1, file);
+   std::fwrite("WAVEfmt ", 1, 8, file);
+   std::fwrite(&format_bytes, sizeof(format_bytes), 1, file);
+   std::fwrite(&format, sizeof(format), 1, file);
+   std::fwrite(&channels, sizeof(channels), 1, file);
+   std::fwrite(&window.sample_rate_hz, sizeof(window.sample_rate_hz), 1, file);
+   std::fwrite(&byte_rate, sizeof(byte_rate), 1, file);
+   std::fwrite(&block_align, sizeof(block_align), 1, file);
+   std::fwrite(&bits_per_sample, sizeof(bits_per_sample), 1, file);
+   std::fwrite("data", 1, 4, file);
+   std::fwrite(&data_bytes, sizeof(data_bytes), 1, file);
+   std::fwrite(window.samples.data(), sizeof(int16_t), window.samples.size(), file);
+   return std::fclose(file) == 0;
+}
+
+int main(int argc, char **argv)
+{
+   // Parse command-line arguments
+   if (argc < 3)
+      usage();
+   const std::string root = argv[1];
+   std::string output_prefix;
+   std::vector<std::string> devices;
+   double start_timestamp = 0.0, end_timestamp = 0.0;
+   uint32_t sample_rate_hz = 0;
+   bool info = false, verify = false;
+   for (int i = 2; i < argc; ++i)
+   {
+      const std::string arg = argv[i];
+      if ((arg == "--start") && (i + 1 < argc))
+         start_timestamp = std::atof(argv[++i]);
+      else if ((arg == "--end") && (i + 1 < argc))
+         end_timestamp = std::atof(argv[++i]);
+      else if ((arg == "--rate") && (i + 1 < argc))
+         sample_rate_hz = (uint32_t)std::atol(argv[++i]);
+      else if ((arg == "--device") && (i + 1 < argc))
+         devices.push_back(argv[++i]);
+      else if ((arg == "--output") && (i + 1 < argc))
+         output_prefix = argv[++i];
+      else if (arg == "--verify")
+         verify = true;
+      else if (arg == "--info")
+         info = true;
+      else
+         usage();
+   }
+
+   // Summarize the archive contents
+   const auto start_time = std::chrono::steady_clock::now();
+   archive_reader_t reader(root);
+   if (info)
+   {
+      for (const archive_stream_info_t &stream : reader.describe())
+         std::printf("%-24s %6u Hz: %llu segments (%llu recovered), %llu blocks, %llu gaps, [%0.6f, %0.6f], %0.2f h of audio, %0.1f MB on disk (%0.2fx compression)\n",
+                     stream.device.c_str(), stream.sample_rate_hz, (unsigned long long)stream.segments, (unsigned long long)stream.recovered_segments,
+                     (unsigned long long)stream.blocks, (unsigned long long)stream.gaps, stream.first_timestamp, stream.last_timestamp,
+                     stream.samples / (3600.0 * stream.sample_rate_hz), stream.file_bytes / 1.0e6,
+                     stream.payload_bytes ? ((double)(stream.samples * sizeof(int16_t)) / stream.payload_bytes) : 0.0);
+      return 0;
+   }
+   else if (end_timestamp <= start_timestamp)
+      usage();
+
+   // Extract the requested window from every matching device
+   const std::vector<archive_window_t> windows = reader.read_window(start_timestamp, end_timestamp, sample_rate_hz, devices, verify);
+   const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+   for (const archive_window_t &window : windows)
+   {
+      std::printf("%-24s [%0.6f, %0.6f] %u Hz, %zu samples @ <%0.6f, %0.6f, %0.3f>\n", window.device.c_str(), window.timestamp,
+                  window.timestamp + ((double)window.samples.size() / window.sample_rate_hz), window.sample_rate_hz, window.samples.size(),
+                  window.lat, window.lon, window.height);
+      if (!output_prefix.empty())
+      {
+         char suffix[64];
+         std::snprintf(suffix, sizeof(suffix), "_%u_%0.6f.wav", window.sample_rate_hz, window.timestamp);
+         if (!write_wav(output_prefix + "_" + window.device + suffix, window))
+            std::fprintf(stderr, "Unable to write output for %s\n", window.device.c_str());
+      }
+   }
+   std::printf("%zu windows extracted in %0.3f ms\n", windows.size(), elapsed * 1.0e3);
+   return 0;
+}
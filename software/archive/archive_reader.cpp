@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "archive_codec.hpp"
+#include "archive_reader.hpp"
+
+extern "C" {
+#include "spool_format.h"
+}
+
+std::unique_ptr<archive_segment_t> archive_segment_t::open(const std::string &path)
+{
+   // Map the whole file read-only; pages are only touched when the index or a block is actually used
+   const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+   if (fd < 0)
+      return nullptr;
+   struct stat file_stat;
+   if ((fstat(fd, &file_stat) != 0) || ((size_t)file_stat.st_size < sizeof(archive_segment_header_t)))
+   {
+      ::close(fd);
+      return nullptr;
+   }
+   void *mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if (mapping == MAP_FAILED)
+      return nullptr;
+   std::unique_ptr<archive_segment_t> segment(new archive_segment_t());
+   segment->data = static_cast<const uint8_t*>(mapping);
+   segment->size = file_stat.st_size;
+   const archive_segment_header_t &header = segment->header();
+   if ((header.magic != ARCHIVE_SEGMENT_MAGIC) || (header.version != ARCHIVE_VERSION) || (header.header_size != sizeof(archive_segment_header_t)))
+      return nullptr;
+
+   // Use the index in place when the footer is intact, otherwise rebuild it from the blocks themselves
+   if (segment->size >= (sizeof(archive_segment_header_t) + sizeof(archive_footer_t)))
+   {
+      const archive_footer_t *footer = reinterpret_cast<const archive_footer_t*>(segment->data + segment->size - sizeof(archive_footer_t));
+      const uint64_t index_bytes = (uint64_t)footer->num_entries * sizeof(archive_index_entry_t), gap_bytes = (uint64_t)footer->num_gaps * sizeof(archive_gap_t);
+      if ((footer->magic == ARCHIVE_FOOTER_MAGIC) && (footer->index_offset >= sizeof(archive_segment_header_t)) &&
+          ((footer->index_offset + index_bytes) == footer->gaps_offset) && ((footer->gaps_offset + gap_bytes + sizeof(archive_footer_t)) == segment->size) &&
+          (spool_crc32(0, segment->data + footer->index_offset, index_bytes + gap_bytes) == footer->crc32))
+      {
+         segment->footer = footer;
+         segment->index = reinterpret_cast<const archive_index_entry_t*>(segment->data + footer->index_offset);
+         segment->entry_count = footer->num_entries;
+         segment->gap_count = footer->num_gaps;
+      }
+   }
+   if (!segment->footer)
+      segment->recover_index();
+   return segment;
+}
+
+archive_segment_t::~archive_segment_t()
+{
+   munmap(const_cast<uint8_t*>(data), size);
+}
+
+void archive_segment_t::recover_index(void)
+{
+   // Walk consecutive CRC-valid blocks from the start of the segment, stopping at the first torn or corrupt one
+   size_t offset = sizeof(archive_segment_header_t);
+   while ((offset + sizeof(archive_block_header_t)) <= size)
+   {
+      const archive_block_header_t *header = reinterpret_cast<const archive_block_header_t*>(data + offset);
+      const size_t padded_bytes = archive_padded_size(header->payload_bytes);
+      if ((header->magic != ARCHIVE_BLOCK_MAGIC) || ((offset + sizeof(archive_block_header_t) + padded_bytes) > size))
+         break;
+      const archive_index_entry_t entry = { header->timestamp, offset, header->num_samples, header->sequence, header->codec, header->flags };
+      if (!decode(entry, nullptr, true))
+         break;
+      recovered_entries.push_back(entry);
+      offset += sizeof(archive_block_header_t) + padded_bytes;
+   }
+   std::stable_sort(recovered_entries.begin(), recovered_entries.end(), [](const archive_index_entry_t &a, const archive_index_entry_t &b)
+   {
+      return a.timestamp < b.timestamp;
+   });
+   index = recovered_entries.data();
+   entry_count = recovered_entries.size();
+}
+
+uint64_t archive_segment_t::payload_bytes(void) const
+{
+   if (footer)
+      return footer->payload_bytes;
+   uint64_t total = 0;
+   for (size_t i = 0; i < entry_count; ++i)
+      total += block(index[i])->payload_bytes;
+   return total;
+}
+
+const archive_block_header_t* archive_segment_t::block(const archive_index_entry_t &entry) const
+{
+   // Bounds-check the indexed block before handing out a pointer into the mapping
+   if ((entry.offset + sizeof(archive_block_header_t)) > size)
+      return nullptr;
+   const archive_block_header_t *header = reinterpret_cast<const archive_block_header_t*>(data + entry.offset);
+   if ((header->magic != ARCHIVE_BLOCK_MAGIC) || ((entry.offset + sizeof(archive_block_header_t) + header->payload_bytes) > size))
+      return nullptr;
+   return header;
+}
+
+bool archive_segment_t::decode(const archive_index_entry_t &entry, int16_t *samples, bool verify) const
+{
+   // Optionally check the block CRC, then expand the payload into samples (or just validate it if no output is given)
+   const archive_block_header_t *header = block(entry);
+   if (!header)
+      return false;
+   const uint8_t *payload = reinterpret_cast<const uint8_t*>(header + 1);
+   if (verify)
+   {
+      const uint32_t crc = spool_crc32(0, reinterpret_cast<const uint8_t*>(header), offsetof(archive_block_header_t, crc32));
+      if (spool_crc32(crc, payload, header->payload_bytes) != header->crc32)
+         return false;
+   }
+   if (!samples)
+      return true;
+   else if (header->codec == ARCHIVE_CODEC_PCM16)
+   {
+      if (header->payload_bytes != (header->num_samples * sizeof(int16_t)))
+         return false;
+      std::memcpy(samples, payload, header->payload_bytes);
+      return true;
+   }
+   else if (header->codec == ARCHIVE_CODEC_RICE)
+      return archive_rice_decode(payload, header->payload_bytes, samples, header->num_samples);
+   return false;
+}
+
+archive_reader_t::archive_reader_t(const std::string &root)
+{
+   // Discover every <device>/<rate>/<start>.seg file without mapping any of them yet
+   std::error_code error;
+   for (const auto &device : std::filesystem::directory_iterator(root, error))
+   {
+      if (!device.is_directory())
+         continue;
+      for (const auto &rate : std::filesystem::directory_iterator(device.path(), error))
+      {
+         if (!rate.is_directory())
+            continue;
+         stream_t stream;
+         stream.device = device.path().filename().string();
+         stream.sample_rate_hz = (uint32_t)std::strtoul(rate.path().filename().c_str(), nullptr, 10);
+         for (const auto &file : std::filesystem::directory_iterator(rate.path(), error))
+            if (file.path().extension() == ARCHIVE_SEGMENT_EXTENSION)
+               stream.files.push_back({ std::strtoll(file.path().filename().c_str(), nullptr, 10), file.path().string(), nullptr });
+         if (!stream.sample_rate_hz || stream.files.empty())
+            continue;
+         std::sort(stream.files.begin(), stream.files.end(), [](const segment_file_t &a, const segment_file_t &b)
+         {
+            return (a.start_second != b.start_second) ? (a.start_second < b.start_second) : (a.path < b.path);
+         });
+         if (const archive_segment_t *segment = map(stream.files.front()))
+            stream.segment_seconds = segment->header().segment_seconds;
+         streams.push_back(std::move(stream));
+      }
+   }
+   std::sort(streams.begin(), streams.end(), [](const stream_t &a, const stream_t &b)
+   {
+      return (a.device != b.device) ? (a.device < b.device) : (a.sample_rate_hz < b.sample_rate_hz);
+   });
+}
+
+std::vector<std::string> archive_reader_t::devices(void) const
+{
+   std::vector<std::string> names;
+   for (const stream_t &stream : streams)
+      if (names.empty() || (names.back() != stream.device))
+         names.push_back(stream.device);
+   return names;
+}
+
+archive_segment_t* archive_reader_t::map(segment_file_t &file)
+{
+   // Segments stay mapped once opened so that repeated queries only pay for page faults
+   if (!file.segment)
+      file.segment = archive_segment_t::open(file.path);
+   return file.segment.get();
+}
+
+void archive_reader_t::read_stream(stream_t &stream, double start_timestamp, double end_timestamp, bool verify, std::vector<archive_window_t> &windows)
+{
+   // Locate candidate segments by start time, then candidate blocks within each by binary search of its index
+   struct candidate_t { const archive_segment_t *segment; const archive_index_entry_t *entry; };
+   std::vector<candidate_t> candidates;
+   const double earliest_start = start_timestamp - ARCHIVE_MAX_BLOCK_SECONDS;
+   auto file = std::upper_bound(stream.files.begin(), stream.files.end(), earliest_start - stream.segment_seconds, [](double time, const segment_file_t &f)
+   {
+      return time < f.start_second;
+   });
+   for (; (file != stream.files.end()) && (file->start_second < end_timestamp); ++file)
+   {
+      const archive_segment_t *segment = map(*file);
+      if (!segment)
+         continue;
+      const archive_index_entry_t *entries = segment->entries(), *last = entries + segment->num_entries();
+      const archive_index_entry_t *entry = std::lower_bound(entries, last, earliest_start, [](const archive_index_entry_t &e, double time)
+      {
+         return e.timestamp < time;
+      });
+      for (; (entry != last) && (entry->timestamp < end_timestamp); ++entry)
+         candidates.push_back({ segment, entry });
+   }
+   std::stable_sort(candidates.begin(), candidates.end(), [](const candidate_t &a, const candidate_t &b)
+   {
+      return a.entry->timestamp < b.entry->timestamp;
+   });
+
+   // Trim each block to the window, merging contiguous blocks and skipping any samples already covered by an earlier block
+   const double rate = stream.sample_rate_hz;
+   archive_window_t *window = nullptr;
+   for (const candidate_t &candidate : candidates)
+   {
+      const archive_index_entry_t &entry = *candidate.entry;
+      const double block_end = entry.timestamp + (entry.num_samples / rate);
+      if (block_end <= start_timestamp)
+         continue;
+      double from = start_timestamp;
+      if (window)
+      {
+         const double window_end = window->timestamp + (window->samples.size() / rate);
+         if (entry.timestamp < (window_end - ARCHIVE_GAP_TOLERANCE_SECONDS))
+            from = std::max(from, window_end);
+         else if (entry.timestamp > (window_end + ARCHIVE_GAP_TOLERANCE_SECONDS))
+            window = nullptr;
+      }
+      const uint32_t first = (uint32_t)std::clamp(std::ceil(((from - entry.timestamp) * rate) - ARCHIVE_SAMPLE_TOLERANCE), 0.0, (double)entry.num_samples);
+      const uint32_t last = (uint32_t)std::clamp(std::ceil(((end_timestamp - entry.timestamp) * rate) - ARCHIVE_SAMPLE_TOLERANCE), 0.0, (double)entry.num_samples);
+      if (first >= last)
+         continue;
+
+      // Copy uncompressed samples straight out of the mapping, decoding compressed blocks into a scratch buffer first
+      const archive_block_header_t *header = candidate.segment->block(entry);
+      const int16_t *samples = nullptr;
+      if (header && (header->codec == ARCHIVE_CODEC_PCM16) && !verify && (header->payload_bytes == (header->num_samples * sizeof(int16_t))))
+         samples = reinterpret_cast<const int16_t*>(header + 1);
+      else
+      {
+         decode_buffer.resize(entry.num_samples);
+         if (!candidate.segment->decode(entry, decode_buffer.data(), verify))
+            continue;
+         samples = decode_buffer.data();
+      }
+      if (!window)
+      {
+         windows.push_back({ stream.device, stream.sample_rate_hz, entry.timestamp + (first / rate), header->lat, header->lon, header->height, {} });
+         window = &windows.back();
+      }
+      window->samples.insert(window->samples.end(), samples + first, samples + last);
+   }
+}
+
+std::vector<archive_window_t> archive_reader_t::read_window(double start_timestamp, double end_timestamp, uint32_t sample_rate_hz,
+                                                            const std::vector<std::string> &devices, bool verify)
+{
+   // Gather the window from every matching device stream, in device order
+   std::vector<archive_window_t> windows;
+   if (end_timestamp <= start_timestamp)
+      return windows;
+   for (stream_t &stream : streams)
+   {
+      if ((sample_rate_hz && (stream.sample_rate_hz != sample_rate_hz)) ||
+          (!devices.empty() && (std::find(devices.begin(), devices.end(), stream.device) == devices.end())))
+         continue;
+      std::vector<archive_window_t> stream_windows;
+      read_stream(stream, start_timestamp, end_timestamp, verify, stream_windows);
+      std::move(stream_windows.begin(), stream_windows.end(), std::back_inserter(windows));
+   }
+   return windows;
+}
+
+std::vector<archive_stream_info_t> archive_reader_t::describe(void)
+{
+   // Summarize every stream from its segment footers (or recovered indexes)
+   std::vector<archive_stream_info_t> info;
+   for (stream_t &stream : streams)
+   {
+      archive_stream_info_t summary;
+      summary.device = stream.device;
+      summary.sample_rate_hz = stream.sample_rate_hz;
+      for (segment_file_t &file : stream.files)
+      {
+         const archive_segment_t *segment = map(file);
+         if (!segment || !segment->num_entries())
+            continue;
+         const archive_index_entry_t &first = segment->entries()[0], &last = segment->entries()[segment->num_entries() - 1];
+         summary.first_timestamp = summary.segments ? std::min(summary.first_timestamp, first.timestamp) : first.timestamp;
+         summary.last_timestamp = std::max(summary.last_timestamp, last.timestamp + ((double)last.num_samples / stream.sample_rate_hz));
+         ++summary.segments;
+         summary.recovered_segments += segment->recovered();
+         summary.blocks += segment->num_entries();
+         summary.gaps += segment->num_gaps();
+         summary.payload_bytes += segment->payload_bytes();
+         summary.file_bytes += segment->file_size();
+         for (size_t i = 0; i < segment->num_entries(); ++i)
+            summary.samples += segment->entries()[i].num_samples;
+      }
+      info.push_back(summary);
+   }
+   return info;
+}
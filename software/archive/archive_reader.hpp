@@ -0,0 +1,92 @@
+#ifndef __ARCHIVE_READER_HEADER_HPP__
+#define __ARCHIVE_READER_HEADER_HPP__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "archive_format.hpp"
+
+// Contiguous run of one device's audio extracted from the archive
+struct archive_window_t
+{
+   std::string device;
+   uint32_t sample_rate_hz = 0;
+   double timestamp = 0.0;
+   double lat = 0.0, lon = 0.0;
+   float height = 0.0f;
+   std::vector<int16_t> samples;
+};
+
+// Summary of one device stream
+struct archive_stream_info_t
+{
+   std::string device;
+   uint32_t sample_rate_hz = 0;
+   uint64_t segments = 0, recovered_segments = 0, blocks = 0, gaps = 0, samples = 0, payload_bytes = 0, file_bytes = 0;
+   double first_timestamp = 0.0, last_timestamp = 0.0;
+};
+
+// Read-only memory mapping of a single segment file and its index
+class archive_segment_t
+{
+public:
+   static std::unique_ptr<archive_segment_t> open(const std::string &path);
+   ~archive_segment_t();
+
+   const archive_segment_header_t& header(void) const { return *reinterpret_cast<const archive_segment_header_t*>(data); }
+   const archive_index_entry_t* entries(void) const { return index; }
+   size_t num_entries(void) const { return entry_count; }
+   size_t num_gaps(void) const { return gap_count; }
+   size_t file_size(void) const { return size; }
+   bool recovered(void) const { return !recovered_entries.empty() || !footer; }
+   uint64_t payload_bytes(void) const;
+
+   const archive_block_header_t* block(const archive_index_entry_t &entry) const;
+   bool decode(const archive_index_entry_t &entry, int16_t *samples, bool verify) const;
+
+private:
+   archive_segment_t(void) = default;
+   void recover_index(void);
+
+   const uint8_t *data = nullptr;
+   size_t size = 0, entry_count = 0, gap_count = 0;
+   const archive_footer_t *footer = nullptr;
+   const archive_index_entry_t *index = nullptr;
+   std::vector<archive_index_entry_t> recovered_entries;
+};
+
+// Finds and decodes multi-device windows of audio from an archive directory
+class archive_reader_t
+{
+public:
+   explicit archive_reader_t(const std::string &root);
+
+   std::vector<std::string> devices(void) const;
+   std::vector<archive_window_t> read_window(double start_timestamp, double end_timestamp, uint32_t sample_rate_hz = 0,
+                                             const std::vector<std::string> &devices = {}, bool verify = false);
+   std::vector<archive_stream_info_t> describe(void);
+
+private:
+   struct segment_file_t
+   {
+      int64_t start_second = 0;
+      std::string path;
+      std::unique_ptr<archive_segment_t> segment;
+   };
+
+   struct stream_t
+   {
+      std::string device;
+      uint32_t sample_rate_hz = 0, segment_seconds = ARCHIVE_DEFAULT_SEGMENT_SECONDS;
+      std::vector<segment_file_t> files;
+   };
+
+   archive_segment_t* map(segment_file_t &file);
+   void read_stream(stream_t &stream, double start_timestamp, double end_timestamp, bool verify, std::vector<archive_window_t> &windows);
+
+   std::vector<stream_t> streams;
+   std::vector<int16_t> decode_buffer;
+};
+
+#endif  // __ARCHIVE_READER_HEADER_HPP__
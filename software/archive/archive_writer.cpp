@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include "archive_codec.hpp"
+#include "archive_writer.hpp"
+
+extern "C" {
+#include "spool_format.h"
+}
+
+static constexpr size_t ARCHIVE_WRITE_BUFFER_BYTES = 1024 * 1024;
+
+std::string archive_device_directory(const std::string &device)
+{
+   // Map a device name onto a single portable path component
+   std::string directory = device;
+   for (char &c : directory)
+      if (!std::isalnum((unsigned char)c) && (c != '-') && (c != '.'))
+         c = '_';
+   return directory.empty() ? std::string("unknown") : directory;
+}
+
+archive_writer_t::archive_writer_t(const std::string &root, bool compress, uint32_t segment_seconds) :
+   root(root), compress(compress), segment_seconds(std::max(segment_seconds, 1u)) {}
+
+archive_writer_t::~archive_writer_t()
+{
+   close();
+}
+
+bool archive_writer_t::open_segment(stream_t &stream, const std::string &device, uint32_t sample_rate_hz, int64_t start_second)
+{
+   // Never overwrite an existing segment; a restart or late data for an old span gets a numbered sibling file
+   const std::filesystem::path directory = std::filesystem::path(root) / archive_device_directory(device) / std::to_string(sample_rate_hz);
+   std::error_code error;
+   std::filesystem::create_directories(directory, error);
+   std::filesystem::path path = directory / (std::to_string(start_second) + ARCHIVE_SEGMENT_EXTENSION);
+   for (uint32_t n = 1; std::filesystem::exists(path); ++n)
+      path = directory / (std::to_string(start_second) + "." + std::to_string(n) + ARCHIVE_SEGMENT_EXTENSION);
+   stream.file = std::fopen(path.c_str(), "wb");
+   if (!stream.file)
+      return false;
+   std::setvbuf(stream.file, nullptr, _IOFBF, ARCHIVE_WRITE_BUFFER_BYTES);
+
+   // Write the segment header
+   archive_segment_header_t header = {};
+   header.magic = ARCHIVE_SEGMENT_MAGIC;
+   header.version = ARCHIVE_VERSION;
+   header.header_size = sizeof(header);
+   header.sample_rate_hz = sample_rate_hz;
+   header.segment_seconds = segment_seconds;
+   header.start_second = start_second;
+   std::strncpy(header.device_name, device.c_str(), sizeof(header.device_name) - 1);
+   std::fwrite(&header, sizeof(header), 1, stream.file);
+   stream.start_second = start_second;
+   stream.offset = sizeof(header);
+   stream.payload_bytes = 0;
+   stream.entries.clear();
+   ++stats.segments;
+   return true;
+}
+
+void archive_writer_t::finalize_segment(stream_t &stream, uint32_t sample_rate_hz)
+{
+   // Sort the index by time, since spooled data may have arrived after newer live blocks
+   if (!stream.file)
+      return;
+   std::stable_sort(stream.entries.begin(), stream.entries.end(), [](const archive_index_entry_t &a, const archive_index_entry_t &b)
+   {
+      return a.timestamp < b.timestamp;
+   });
+
+   // Record every timing discontinuity, including one across the previous segment boundary; packet sequence numbers are
+   //    kept only for reference, since a node numbers every packet type on a transport from one counter and so they are
+   //    never consecutive within a single stream
+   std::vector<archive_gap_t> gaps;
+   archive_footer_t footer = {};
+   for (archive_index_entry_t &entry : stream.entries)
+   {
+      if (stream.has_previous && (std::fabs(entry.timestamp - stream.previous_end) > ARCHIVE_GAP_TOLERANCE_SECONDS))
+      {
+         entry.flags |= ARCHIVE_FLAG_GAP_BEFORE;
+         gaps.push_back({ stream.previous_end, entry.timestamp, stream.previous_sequence, entry.sequence, 0 });
+      }
+      stream.has_previous = true;
+      stream.previous_end = entry.timestamp + ((double)entry.num_samples / sample_rate_hz);
+      stream.previous_sequence = entry.sequence;
+      footer.total_samples += entry.num_samples;
+   }
+
+   // Append the index, gap table and footer
+   footer.index_offset = stream.offset;
+   footer.gaps_offset = footer.index_offset + (stream.entries.size() * sizeof(archive_index_entry_t));
+   footer.num_entries = (uint32_t)stream.entries.size();
+   footer.num_gaps = (uint32_t)gaps.size();
+   footer.first_timestamp = stream.entries.empty() ? 0.0 : stream.entries.front().timestamp;
+   footer.last_timestamp = stream.has_previous ? stream.previous_end : 0.0;
+   footer.payload_bytes = stream.payload_bytes;
+   footer.crc32 = spool_crc32(0, reinterpret_cast<const uint8_t*>(stream.entries.data()), stream.entries.size() * sizeof(archive_index_entry_t));
+   footer.crc32 = spool_crc32(footer.crc32, reinterpret_cast<const uint8_t*>(gaps.data()), gaps.size() * sizeof(archive_gap_t));
+   footer.magic = ARCHIVE_FOOTER_MAGIC;
+   std::fwrite(stream.entries.data(), sizeof(archive_index_entry_t), stream.entries.size(), stream.file);
+   std::fwrite(gaps.data(), sizeof(archive_gap_t), gaps.size(), stream.file);
+   std::fwrite(&footer, sizeof(footer), 1, stream.file);
+   stats.file_bytes += footer.gaps_offset + (gaps.size() * sizeof(archive_gap_t)) + sizeof(footer);
+   std::fclose(stream.file);
+   stream.file = nullptr;
+   stream.entries.clear();
+}
+
+bool archive_writer_t::write_block(const std::string &device, const archive_block_info_t &info, const int16_t *samples, uint32_t num_samples)
+{
+   // Switch segment files whenever the block belongs to a different span of GPS time
+   if (!info.sample_rate_hz || !num_samples || (num_samples > (ARCHIVE_MAX_BLOCK_SECONDS * info.sample_rate_hz)))
+      return false;
+   stream_t &stream = streams[{ device, info.sample_rate_hz }];
+   const int64_t start_second = (int64_t)std::floor(info.timestamp / segment_seconds) * segment_seconds;
+   if (stream.file && (stream.start_second != start_second))
+      finalize_segment(stream, info.sample_rate_hz);
+   if (!stream.file && !open_segment(stream, device, info.sample_rate_hz, start_second))
+      return false;
+
+   // Compress the samples if requested and worthwhile, otherwise store them verbatim
+   archive_block_header_t header = {};
+   const uint8_t *data = reinterpret_cast<const uint8_t*>(samples);
+   header.codec = ARCHIVE_CODEC_PCM16;
+   header.payload_bytes = num_samples * sizeof(int16_t);
+   if (compress)
+   {
+      payload.clear();
+      if (archive_rice_encode(samples, num_samples, payload) < header.payload_bytes)
+      {
+         header.codec = ARCHIVE_CODEC_RICE;
+         header.payload_bytes = (uint32_t)payload.size();
+         data = payload.data();
+      }
+   }
+
+   // Append the block header and padded payload, indexing the block by its position in the file
+   header.magic = ARCHIVE_BLOCK_MAGIC;
+   header.flags = info.spooled ? ARCHIVE_FLAG_SPOOLED : 0;
+   header.sequence = info.sequence;
+   header.timestamp = info.timestamp;
+   header.num_samples = num_samples;
+   header.lat = info.lat;
+   header.lon = info.lon;
+   header.height = info.height;
+   header.crc32 = spool_crc32(spool_crc32(0, reinterpret_cast<const uint8_t*>(&header), offsetof(archive_block_header_t, crc32)), data, header.payload_bytes);
+   static const uint8_t padding[ARCHIVE_ALIGNMENT] = {};
+   const size_t padded_bytes = archive_padded_size(header.payload_bytes);
+   std::fwrite(&header, sizeof(header), 1, stream.file);
+   std::fwrite(data, 1, header.payload_bytes, stream.file);
+   std::fwrite(padding, 1, padded_bytes - header.payload_bytes, stream.file);
+   stream.entries.push_back({ header.timestamp, stream.offset, num_samples, header.sequence, header.codec, header.flags });
+   stream.offset += sizeof(header) + padded_bytes;
+   stream.payload_bytes += header.payload_bytes;
+   ++stats.blocks;
+   stats.samples += num_samples;
+   stats.payload_bytes += header.payload_bytes;
+   return !std::ferror(stream.file);
+}
+
+void archive_writer_t::close(void)
+{
+   // Finish every open segment so that it can be memory-mapped with its index
+   for (auto &[key, stream] : streams)
+      finalize_segment(stream, key.second);
+}
@@ -0,0 +1,64 @@
+#ifndef __ARCHIVE_WRITER_HEADER_HPP__
+#define __ARCHIVE_WRITER_HEADER_HPP__
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "archive_format.hpp"
+
+// Metadata accompanying one block of audio handed to the writer
+struct archive_block_info_t
+{
+   double timestamp = 0.0;
+   uint32_t sample_rate_hz = 0;
+   uint16_t sequence = 0;
+   bool spooled = false;
+   double lat = 0.0, lon = 0.0;
+   float height = 0.0f;
+};
+
+// Running totals across every stream written
+struct archive_writer_statistics_t
+{
+   uint64_t blocks = 0, samples = 0, payload_bytes = 0, file_bytes = 0, segments = 0;
+};
+
+// Appends device audio to per-device, per-rate segment files, writing each segment's index when it is closed
+class archive_writer_t
+{
+public:
+   archive_writer_t(const std::string &root, bool compress, uint32_t segment_seconds = ARCHIVE_DEFAULT_SEGMENT_SECONDS);
+   ~archive_writer_t();
+
+   bool write_block(const std::string &device, const archive_block_info_t &info, const int16_t *samples, uint32_t num_samples);
+   void close(void);
+   const archive_writer_statistics_t& statistics(void) const { return stats; }
+
+private:
+   struct stream_t
+   {
+      std::FILE *file = nullptr;
+      int64_t start_second = 0;
+      uint64_t offset = 0, payload_bytes = 0;
+      std::vector<archive_index_entry_t> entries;
+      bool has_previous = false;
+      double previous_end = 0.0;
+      uint16_t previous_sequence = 0;
+   };
+
+   bool open_segment(stream_t &stream, const std::string &device, uint32_t sample_rate_hz, int64_t start_second);
+   void finalize_segment(stream_t &stream, uint32_t sample_rate_hz);
+
+   std::string root;
+   bool compress;
+   uint32_t segment_seconds;
+   std::map<std::pair<std::string, uint32_t>, stream_t> streams;
+   std::vector<uint8_t> payload;
+   archive_writer_statistics_t stats;
+};
+
+std::string archive_device_directory(const std::string &device);
+
+#endif  // __ARCHIVE_WRITER_HEADER_HPP__
@@ -0,0 +1,322 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "association.hpp"
+
+association_t::association_t(const association_config_t &config) :
+   config(config), node_index(2.0 * config.max_range_m), newest_timestamp(-std::numeric_limits<double>::infinity())
+{
+   // The widest separation in time two detections of one source can have, and how long detections must be kept so that
+   //    any detection not yet too late to associate can still find every partner
+   slowest_speed = config.speed_of_sound * (1.0 - config.speed_tolerance);
+   fastest_speed = config.speed_of_sound * (1.0 + config.speed_tolerance);
+   window_s = (2.0 * config.max_range_m / slowest_speed) + (2.0 * config.timing_tolerance_s) + (2.0 * config.max_uncertainty_s);
+   retention_s = (2.0 * window_s) + config.lateness_s;
+
+   // Every event tests the cells of a square just wide enough to hold any source its first detection could have heard
+   cell_radius_m = config.grid_spacing_m * M_SQRT1_2;
+   grid_radius = (int32_t)std::ceil(config.max_range_m / config.grid_spacing_m);
+   grid_width = (2 * grid_radius) + 1;
+}
+
+bool association_t::compatible(uint32_t slot_a, double timestamp_a, double uncertainty_a, uint32_t slot_b, double timestamp_b, double uncertainty_b)
+{
+   // Two arrivals of one sound at different nodes can be no further apart in time than sound takes to cross between them
+   ++stats.pair_tests;
+   if (slot_a == slot_b)
+      return false;
+   const double distance = node_index.distance_m(slot_a, slot_b);
+   return (distance <= (2.0 * config.max_range_m)) &&
+          (std::fabs(timestamp_a - timestamp_b) <= ((distance / slowest_speed) + (2.0 * config.timing_tolerance_s) + uncertainty_a + uncertainty_b));
+}
+
+void association_t::emission_interval(const event_t &event, int32_t x, int32_t y, const std::array<double, 3> &node, double timestamp, double uncertainty, float &earliest, float &latest) const
+{
+   // A source anywhere in the cell emitted between the arrival less the longest travel time from the cell's far side at
+   //    the slowest speed and the arrival less the shortest travel time from its near side at the fastest
+   const double dx = (x * config.grid_spacing_m) - node[0], dy = (y * config.grid_spacing_m) - node[1], dz = event.height - node[2];
+   const double distance = std::sqrt((dx * dx) + (dy * dy) + (dz * dz)), slack = uncertainty + config.timing_tolerance_s;
+   if ((distance - cell_radius_m) > config.max_range_m)
+   {
+      earliest = std::numeric_limits<float>::infinity();
+      latest = -std::numeric_limits<float>::infinity();
+      return;
+   }
+   earliest = (float)((timestamp - event.reference) - slack - ((distance + cell_radius_m) / slowest_speed));
+   latest = (float)((timestamp - event.reference) + slack - (std::max(distance - cell_radius_m, 0.0) / fastest_speed));
+}
+
+void association_t::start_event(event_t &event, uint32_t slot, const detection_t &detection, double uncertainty)
+{
+   // Center the event's square of cells on its first node, in the plane of that node's height
+   const std::array<double, 3> &node = node_local[slot];
+   event.reference = event.first_timestamp = detection.timestamp;
+   event.height = node[2];
+   event.base_x = (int32_t)std::lround(node[0] / config.grid_spacing_m) - grid_radius;
+   event.base_y = (int32_t)std::lround(node[1] / config.grid_spacing_m) - grid_radius;
+   event.earliest.assign((size_t)grid_width * grid_width, -std::numeric_limits<float>::infinity());
+   event.latest.assign((size_t)grid_width * grid_width, std::numeric_limits<float>::infinity());
+   event.min_x = event.min_y = 0;
+   event.max_x = event.max_y = grid_width - 1;
+   constrain(event, slot, detection, uncertainty);
+}
+
+bool association_t::consistent(const event_t &event, uint32_t slot, double timestamp, double uncertainty)
+{
+   // A detection can join an event only from a node not already represented and only if some cell still allows a common
+   //    emission time
+   if (std::find(event.slots.begin(), event.slots.end(), slot) != event.slots.end())
+      return false;
+   ++stats.consistency_tests;
+   for (int32_t y = event.min_y; y <= event.max_y; ++y)
+      for (int32_t x = event.min_x; x <= event.max_x; ++x)
+      {
+         const size_t cell = ((size_t)y * grid_width) + x;
+         if (event.earliest[cell] > event.latest[cell])
+            continue;
+         float earliest, latest;
+         emission_interval(event, event.base_x + x, event.base_y + y, node_local[slot], timestamp, uncertainty, earliest, latest);
+         if (std::max(earliest, event.earliest[cell]) <= std::min(latest, event.latest[cell]))
+            return true;
+      }
+   return false;
+}
+
+void association_t::intersect(event_t &event, const std::array<double, 3> &node, double timestamp, double uncertainty)
+{
+   for (int32_t y = event.min_y; y <= event.max_y; ++y)
+      for (int32_t x = event.min_x; x <= event.max_x; ++x)
+      {
+         const size_t cell = ((size_t)y * grid_width) + x;
+         if (event.earliest[cell] > event.latest[cell])
+            continue;
+         float earliest, latest;
+         emission_interval(event, event.base_x + x, event.base_y + y, node, timestamp, uncertainty, earliest, latest);
+         event.earliest[cell] = std::max(earliest, event.earliest[cell]);
+         event.latest[cell] = std::min(latest, event.latest[cell]);
+      }
+   shrink(event);
+}
+
+void association_t::constrain(event_t &event, uint32_t slot, const detection_t &detection, double uncertainty)
+{
+   intersect(event, node_local[slot], detection.timestamp, uncertainty);
+   event.slots.push_back(slot);
+   event.candidate.detections.push_back(detection);
+   event.first_timestamp = std::min(event.first_timestamp, detection.timestamp);
+}
+
+bool association_t::mergeable(const event_t &event, const event_t &other)
+{
+   // Two events can merge only if their nodes are distinct and some cell both squares cover allows both sets of times
+   for (const uint32_t slot : other.slots)
+      if (std::find(event.slots.begin(), event.slots.end(), slot) != event.slots.end())
+         return false;
+   ++stats.consistency_tests;
+   const float shift = (float)(other.reference - event.reference);
+   const int32_t min_x = std::max(event.base_x + event.min_x, other.base_x + other.min_x), max_x = std::min(event.base_x + event.max_x, other.base_x + other.max_x);
+   const int32_t min_y = std::max(event.base_y + event.min_y, other.base_y + other.min_y), max_y = std::min(event.base_y + event.max_y, other.base_y + other.max_y);
+   for (int32_t y = min_y; y <= max_y; ++y)
+      for (int32_t x = min_x; x <= max_x; ++x)
+      {
+         const size_t cell = ((size_t)(y - event.base_y) * grid_width) + (x - event.base_x);
+         const size_t other_cell = ((size_t)(y - other.base_y) * grid_width) + (x - other.base_x);
+         if (std::max(event.earliest[cell], other.earliest[other_cell] + shift) <= std::min(event.latest[cell], other.latest[other_cell] + shift))
+            return true;
+      }
+   return false;
+}
+
+void association_t::merge(event_t &event, const event_t &other)
+{
+   // Keep only the cells both events allow, with the intervals they share
+   const float shift = (float)(other.reference - event.reference);
+   for (int32_t y = event.min_y; y <= event.max_y; ++y)
+      for (int32_t x = event.min_x; x <= event.max_x; ++x)
+      {
+         const size_t cell = ((size_t)y * grid_width) + x;
+         const int32_t other_x = event.base_x + x - other.base_x, other_y = event.base_y + y - other.base_y;
+         if ((other_x < 0) || (other_x >= grid_width) || (other_y < 0) || (other_y >= grid_width))
+         {
+            event.earliest[cell] = std::numeric_limits<float>::infinity();
+            continue;
+         }
+         const size_t other_cell = ((size_t)other_y * grid_width) + other_x;
+         event.earliest[cell] = std::max(event.earliest[cell], other.earliest[other_cell] + shift);
+         event.latest[cell] = std::min(event.latest[cell], other.latest[other_cell] + shift);
+      }
+   shrink(event);
+   event.slots.insert(event.slots.end(), other.slots.begin(), other.slots.end());
+   event.candidate.detections.insert(event.candidate.detections.end(), other.candidate.detections.begin(), other.candidate.detections.end());
+   event.first_timestamp = std::min(event.first_timestamp, other.first_timestamp);
+}
+
+void association_t::shrink(event_t &event)
+{
+   // Narrow the searched box to the cells still allowed, which after a few detections is a small patch around the source
+   int32_t min_x = grid_width, max_x = -1, min_y = grid_width, max_y = -1;
+   for (int32_t y = event.min_y; y <= event.max_y; ++y)
+      for (int32_t x = event.min_x; x <= event.max_x; ++x)
+      {
+         const size_t cell = ((size_t)y * grid_width) + x;
+         if (event.earliest[cell] <= event.latest[cell])
+         {
+            min_x = std::min(min_x, x);
+            max_x = std::max(max_x, x);
+            min_y = std::min(min_y, y);
+            max_y = std::max(max_y, y);
+         }
+      }
+   event.min_x = min_x;
+   event.max_x = max_x;
+   event.min_y = min_y;
+   event.max_y = max_y;
+}
+
+void association_t::relabel(uint32_t slot, double timestamp, uint64_t from, uint64_t to)
+{
+   // Point a held detection at the event that absorbed its own
+   std::deque<stored_t> &held = node_detections[slot];
+   auto entry = std::lower_bound(held.begin(), held.end(), timestamp, [](const stored_t &stored, double t) { return stored.timestamp < t; });
+   for (; (entry != held.end()) && (entry->timestamp == timestamp); ++entry)
+      if (entry->event == from)
+         entry->event = to;
+}
+
+void association_t::add(const detection_t &detection)
+{
+   // Drop detections too late for any event they could belong to, which have already been passed on
+   ++stats.detections;
+   const double uncertainty = std::min(std::max(detection.uncertainty, 0.0), config.max_uncertainty_s);
+   if (detection.timestamp < (newest_timestamp - window_s - config.lateness_s))
+   {
+      ++stats.late_detections;
+      return;
+   }
+   const uint32_t slot = node_index.update(detection.device_id, detection.lat, detection.lon, detection.height);
+   node_detections.resize(node_index.size());
+   newest_timestamp = std::max(newest_timestamp, detection.timestamp);
+
+   // Place the node in a local east-north-up frame around the first node seen, flat enough across a city for the grid
+   const std::array<double, 3> &position = node_index.position(slot);
+   if (!have_origin)
+   {
+      const double phi = detection.lat * M_PI / 180.0, lambda = detection.lon * M_PI / 180.0;
+      origin = position;
+      east = { -std::sin(lambda), std::cos(lambda), 0.0 };
+      north = { -std::sin(phi) * std::cos(lambda), -std::sin(phi) * std::sin(lambda), std::cos(phi) };
+      up = { std::cos(phi) * std::cos(lambda), std::cos(phi) * std::sin(lambda), std::sin(phi) };
+      have_origin = true;
+   }
+   node_local.resize(node_index.size());
+   const std::array<double, 3> offset = { position[0] - origin[0], position[1] - origin[1], position[2] - origin[2] };
+   node_local[slot] = { (offset[0] * east[0]) + (offset[1] * east[1]) + (offset[2] * east[2]),
+                        (offset[0] * north[0]) + (offset[1] * north[1]) + (offset[2] * north[2]),
+                        (offset[0] * up[0]) + (offset[1] * up[1]) + (offset[2] * up[2]) };
+
+   // Find the events of held detections at neighbouring nodes that this one could pair with, searching each neighbour's
+   //    time-sorted detections only across the span that their separation allows
+   nearby_events.clear();
+   for (const uint32_t neighbour : node_index.neighbours(slot))
+   {
+      std::deque<stored_t> &held = node_detections[neighbour];
+      while (!held.empty() && (held.front().timestamp < (newest_timestamp - retention_s)))
+         held.pop_front();
+      const double span = (node_index.distance_m(slot, neighbour) / slowest_speed) + (2.0 * config.timing_tolerance_s) + uncertainty + config.max_uncertainty_s;
+      auto entry = std::lower_bound(held.begin(), held.end(), detection.timestamp - span, [](const stored_t &stored, double t) { return stored.timestamp < t; });
+      for (; (entry != held.end()) && (entry->timestamp <= (detection.timestamp + span)); ++entry)
+         if ((std::find(nearby_events.begin(), nearby_events.end(), entry->event) == nearby_events.end()) &&
+             compatible(slot, detection.timestamp, uncertainty, neighbour, entry->timestamp, entry->uncertainty) && events.count(entry->event))
+            nearby_events.push_back(entry->event);
+   }
+
+   // Join the largest of those events that one source could explain together with this detection, or else start a new one
+   event_t *joined = nullptr;
+   uint64_t joined_id = 0;
+   for (const uint64_t id : nearby_events)
+   {
+      event_t &event = events[id];
+      if ((!joined || (event.slots.size() > joined->slots.size())) && consistent(event, slot, detection.timestamp, uncertainty))
+      {
+         joined = &event;
+         joined_id = id;
+      }
+   }
+   if (joined)
+      constrain(*joined, slot, detection, uncertainty);
+   else
+   {
+      joined_id = next_event_id++;
+      joined = &events[joined_id];
+      joined->candidate.id = joined_id;
+      start_event(*joined, slot, detection, uncertainty);
+      ++stats.candidates;
+   }
+
+   // Hold the detection in its node's time order; arrivals are mostly in order, so this is usually an append
+   std::deque<stored_t> &held = node_detections[slot];
+   const stored_t stored = { detection.timestamp, uncertainty, joined_id };
+   if (held.empty() || (held.back().timestamp <= detection.timestamp))
+      held.push_back(stored);
+   else
+      held.insert(std::upper_bound(held.begin(), held.end(), detection.timestamp, [](double t, const stored_t &entry) { return t < entry.timestamp; }), stored);
+
+   // Absorb any other nearby event one source could explain together with the joined one, reuniting partial groupings
+   //    that formed separately before this detection linked them
+   for (const uint64_t id : nearby_events)
+   {
+      const auto other = events.find(id);
+      if ((id == joined_id) || (other == events.end()) || !mergeable(*joined, other->second))
+         continue;
+      for (size_t i = 0; i < other->second.slots.size(); ++i)
+         relabel(other->second.slots[i], other->second.candidate.detections[i].timestamp, id, joined_id);
+      merge(*joined, other->second);
+      events.erase(other);
+      ++stats.merges;
+   }
+   closing.emplace(joined->first_timestamp + window_s + config.lateness_s, joined_id);
+   close_events(false);
+}
+
+void association_t::advance(double timestamp)
+{
+   // Move time forward without a detection, such as from audio arriving from the same nodes, so that quiet periods still
+   //    close the events before them
+   newest_timestamp = std::max(newest_timestamp, timestamp);
+   close_events(false);
+}
+
+void association_t::flush(void)
+{
+   close_events(true);
+}
+
+void association_t::close_events(bool all)
+{
+   // Pass on each event once nothing that could belong to it can still arrive, provided it spans enough nodes
+   while (!closing.empty() && (all || (closing.top().first <= newest_timestamp)))
+   {
+      const uint64_t id = closing.top().second;
+      closing.pop();
+      const auto event = events.find(id);
+      if (event == events.end())
+         continue;
+      const double close_timestamp = event->second.first_timestamp + window_s + config.lateness_s;
+      if (!all && (close_timestamp > newest_timestamp))
+      {
+         closing.emplace(close_timestamp, id);
+         continue;
+      }
+      candidate_event_t &candidate = event->second.candidate;
+      if (candidate.detections.size() >= config.min_nodes)
+      {
+         std::sort(candidate.detections.begin(), candidate.detections.end(), [](const detection_t &a, const detection_t &b) { return a.timestamp < b.timestamp; });
+         ++stats.events;
+         if (event_handler)
+            event_handler(candidate);
+      }
+      else
+         ++stats.discarded;
+      events.erase(event);
+   }
+}
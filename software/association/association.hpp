@@ -0,0 +1,120 @@
+#ifndef __ASSOCIATION_HEADER_HPP__
+#define __ASSOCIATION_HEADER_HPP__
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "node_index.hpp"
+
+// Bounds on which detections could have come from one acoustic source
+struct association_config_t
+{
+   double max_range_m = 1500.0;  // Farthest from a source that a node can still detect it
+   double speed_of_sound = 343.0;
+   double speed_tolerance = 0.02;  // Fraction the propagation speed may differ from nominal, for temperature and wind
+   double timing_tolerance_s = 0.001;  // Allowed on every detection beyond its own uncertainty, for residual clock error
+   double max_uncertainty_s = 0.01;  // Larger claimed uncertainties are clamped so that every index search stays bounded
+   double grid_spacing_m = 100.0;  // Spacing of the source positions against which a group's consistency is tested
+   double lateness_s = 2.0;  // Longest a detection may arrive after others with later timestamps and still be associated
+   uint32_t min_nodes = 3;  // Fewest distinct nodes in a candidate event worth passing on to correlation or a position solve
+};
+
+// One node's detection of an arrival, at the node's reported position
+struct detection_t
+{
+   uint32_t device_id = 0;
+   double timestamp = 0.0, uncertainty = 0.0;
+   double lat = 0.0, lon = 0.0, height = 0.0;
+   float confidence = 0.0f, snr_db = 0.0f;
+   uint64_t tag = 0;  // Caller's own reference, carried through untouched
+};
+
+// Detections from distinct nodes that one source could have produced, in timestamp order
+struct candidate_event_t
+{
+   uint64_t id = 0;
+   std::vector<detection_t> detections;
+};
+
+struct association_statistics_t
+{
+   uint64_t detections = 0, late_detections = 0, pair_tests = 0, consistency_tests = 0, merges = 0, candidates = 0, events = 0, discarded = 0;
+};
+
+// Groups detections into candidate events as they arrive, in any order within the configured lateness
+//    A detection is only compared with detections held for the nodes the k-d tree places within twice the detection
+//    range, and for each of those only with the span of that node's time-sorted detections that the pair's separation
+//    allows at the speed of sound, so the work per detection grows with the local node density rather than with the
+//    whole deployment
+//    The events found that way are then tested against a grid of possible source positions around them: each keeps, per
+//    grid cell, the interval of emission times its detections allow from there, and a detection joins an event only if
+//    some cell remains in which every member agrees, which separates sources that merely overlap in time
+//    A candidate event is passed on once no detection that could still belong to it is able to arrive
+class association_t
+{
+public:
+   using event_handler_t = std::function<void(const candidate_event_t&)>;
+
+   explicit association_t(const association_config_t &config = association_config_t());
+
+   void set_event_handler(event_handler_t handler) { event_handler = std::move(handler); }
+   void add(const detection_t &detection);
+   void advance(double timestamp);
+   void flush(void);
+   const association_statistics_t& statistics(void) const { return stats; }
+   const node_index_t& nodes(void) const { return node_index; }
+
+private:
+   struct stored_t
+   {
+      double timestamp, uncertainty;
+      uint64_t event;
+   };
+
+   // Emission times allowed from each cell of a square of the grid, relative to the event's reference time; a cell is
+   //    ruled out once its interval is empty, and only the bounding box of the cells left is searched
+   struct event_t
+   {
+      candidate_event_t candidate;
+      std::vector<uint32_t> slots;
+      double first_timestamp = 0.0, reference = 0.0, height = 0.0;
+      int32_t base_x = 0, base_y = 0;
+      int32_t min_x = 0, max_x = -1, min_y = 0, max_y = -1;
+      std::vector<float> earliest, latest;
+   };
+
+   bool compatible(uint32_t slot_a, double timestamp_a, double uncertainty_a, uint32_t slot_b, double timestamp_b, double uncertainty_b);
+   void emission_interval(const event_t &event, int32_t x, int32_t y, const std::array<double, 3> &node, double timestamp, double uncertainty, float &earliest, float &latest) const;
+   void start_event(event_t &event, uint32_t slot, const detection_t &detection, double uncertainty);
+   bool consistent(const event_t &event, uint32_t slot, double timestamp, double uncertainty);
+   void intersect(event_t &event, const std::array<double, 3> &node, double timestamp, double uncertainty);
+   void constrain(event_t &event, uint32_t slot, const detection_t &detection, double uncertainty);
+   bool mergeable(const event_t &event, const event_t &other);
+   void merge(event_t &event, const event_t &other);
+   void shrink(event_t &event);
+   void relabel(uint32_t slot, double timestamp, uint64_t from, uint64_t to);
+   void close_events(bool all);
+
+   association_config_t config;
+   double window_s, retention_s, slowest_speed, fastest_speed, cell_radius_m;
+   int32_t grid_radius, grid_width;
+   node_index_t node_index;
+   bool have_origin = false;
+   std::array<double, 3> origin, east, north, up;
+   std::vector<std::array<double, 3>> node_local;
+   std::vector<std::deque<stored_t>> node_detections;
+   std::unordered_map<uint64_t, event_t> events;
+   std::priority_queue<std::pair<double, uint64_t>, std::vector<std::pair<double, uint64_t>>, std::greater<std::pair<double, uint64_t>>> closing;
+   uint64_t next_event_id = 1;
+   double newest_timestamp;
+   std::vector<uint64_t> nearby_events;
+   event_handler_t event_handler;
+   association_statistics_t stats;
+};
+
+#endif  // __ASSOCIATION_HEADER_HPP__
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "association.hpp"
+#include "scenario.hpp"
+
+static constexpr double BENCH_NODE_SPACING_M = 560.0;  // Mean spacing of the simulated city-wide grid, about three nodes per square kilometer
+static constexpr double BENCH_DETECTION_RANGE_M = 1500.0;
+static constexpr double BENCH_DETECTION_PROBABILITY = 0.9;
+static constexpr double BENCH_TIMING_NOISE_S = 0.0003;
+static constexpr double BENCH_UNCERTAINTY_S = 0.0005;
+static constexpr double BENCH_FALSE_FRACTION = 0.05;  // Unrelated detections at random nodes and times, relative to true ones
+static constexpr double BENCH_MAX_DELIVERY_DELAY_S = 0.5;  // Detections reach the host up to this late, so out of order
+static constexpr double BENCH_QUALITY_LOAD = 0.005;  // Detections per node per second at a busy but realistic city event rate
+static constexpr double BENCH_QUALITY_DURATION_S = 600.0;
+static constexpr double BENCH_LOAD_DURATION_S = 60.0;
+static constexpr size_t BENCH_BASELINE_DETECTIONS = 5000;  // Detections timed through the all-pairs baseline, which is slow
+static constexpr double BENCH_MIN_FOUND = 0.95;  // Share of true events found at the realistic rate below which the bench fails
+static constexpr double BENCH_MIN_PURITY = 0.95;
+
+struct bench_detection_t
+{
+   detection_t detection;
+   uint32_t node = 0;
+   double delivered = 0.0;
+};
+
+struct bench_result_t
+{
+   size_t num_detections = 0, num_true_events = 0, found = 0, split = 0, false_events = 0, emitted = 0;
+   double load_rate = 0.0, rate = 0.0, tests_per_detection = 0.0, purity = 0.0, baseline_rate = 0.0, baseline_tests_per_detection = 0.0, baseline_pairs_per_detection = 0.0;
+};
+
+static std::vector<bench_detection_t> bench_detections(const scenario_t &scenario, uint32_t seed)
+{
+   // Every node the index places within range of an event detects its direct arrival with small timing noise, alongside a share of
+   //    unrelated detections, all delivered to the host after random network delays
+   std::mt19937 generator(seed);
+   std::uniform_real_distribution<double> unit(0.0, 1.0);
+   std::normal_distribution<double> noise(0.0, BENCH_TIMING_NOISE_S);
+   std::vector<bench_detection_t> detections;
+   auto add = [&](uint32_t node, double timestamp, uint64_t tag)
+   {
+      bench_detection_t entry;
+      entry.node = node;
+      entry.detection.device_id = node;
+      entry.detection.timestamp = timestamp;
+      entry.detection.uncertainty = BENCH_UNCERTAINTY_S;
+      entry.detection.lat = scenario.nodes[node].lat;
+      entry.detection.lon = scenario.nodes[node].lon;
+      entry.detection.height = scenario.nodes[node].height;
+      entry.detection.tag = tag;
+      entry.delivered = timestamp + (BENCH_MAX_DELIVERY_DELAY_S * unit(generator));
+      detections.push_back(entry);
+   };
+   node_index_t nodes(BENCH_DETECTION_RANGE_M);
+   for (const scenario_node_t &node : scenario.nodes)
+      nodes.update(nodes.size(), node.lat, node.lon, node.height);
+   std::vector<uint32_t> in_range;
+   for (const scenario_event_t &event : scenario.events)
+   {
+      std::array<double, 3> source;
+      node_index_llh_to_ecef(event.lat, event.lon, event.height, source);
+      in_range.clear();
+      nodes.within(source, BENCH_DETECTION_RANGE_M, in_range);
+      std::sort(in_range.begin(), in_range.end());
+      for (const uint32_t node : in_range)
+      {
+         const scenario_node_t &position = scenario.nodes[node];
+         const double distance = scenario_distance_m(event.lat, event.lon, event.height, position.lat, position.lon, position.height);
+         if (unit(generator) < BENCH_DETECTION_PROBABILITY)
+            add(node, scenario.start_time + event.time + (distance / scenario.speed_of_sound) + position.clock_offset_s + noise(generator), event.id + 1);
+      }
+   }
+   const size_t num_false = (size_t)(BENCH_FALSE_FRACTION * detections.size());
+   for (size_t i = 0; i < num_false; ++i)
+      add((uint32_t)(generator() % scenario.nodes.size()), scenario.start_time + (scenario.duration_s * unit(generator)), 0);
+   std::sort(detections.begin(), detections.end(), [](const bench_detection_t &a, const bench_detection_t &b) { return a.delivered < b.delivered; });
+   return detections;
+}
+
+static void bench_baseline(const std::vector<bench_detection_t> &detections, const association_config_t &config, bench_result_t &result)
+{
+   // Compare each detection against every held detection from any node within the widest possible time separation,
+   //    as association without a spatial index must, timing a stretch once the held window has filled
+   std::vector<std::array<double, 3>> positions;
+   std::unordered_map<uint32_t, size_t> position_of_node;
+   for (const bench_detection_t &entry : detections)
+      if (position_of_node.emplace(entry.node, positions.size()).second)
+      {
+         positions.emplace_back();
+         node_index_llh_to_ecef(entry.detection.lat, entry.detection.lon, entry.detection.height, positions.back());
+      }
+   const double slowest_speed = config.speed_of_sound * (1.0 - config.speed_tolerance);
+   const double window = (2.0 * config.max_range_m / slowest_speed) + (2.0 * config.timing_tolerance_s) + (2.0 * config.max_uncertainty_s);
+   std::deque<const bench_detection_t*> held;
+   uint64_t tests = 0, pairs = 0;
+   size_t first = 0;
+   while ((first < detections.size()) && (detections[first].delivered < (detections.front().delivered + window + BENCH_MAX_DELIVERY_DELAY_S)))
+      held.push_back(&detections[first++]);
+   const size_t count = std::min(detections.size() - first, BENCH_BASELINE_DETECTIONS);
+   const auto start = std::chrono::steady_clock::now();
+   for (size_t i = first; i < (first + count); ++i)
+   {
+      const detection_t &detection = detections[i].detection;
+      const std::array<double, 3> &position = positions[position_of_node[detections[i].node]];
+      while (!held.empty() && (held.front()->delivered < (detections[i].delivered - window - BENCH_MAX_DELIVERY_DELAY_S)))
+         held.pop_front();
+      for (const bench_detection_t *other : held)
+      {
+         ++tests;
+         const std::array<double, 3> &other_position = positions[position_of_node[other->node]];
+         const double distance = std::sqrt(((position[0] - other_position[0]) * (position[0] - other_position[0])) +
+                                           ((position[1] - other_position[1]) * (position[1] - other_position[1])) +
+                                           ((position[2] - other_position[2]) * (position[2] - other_position[2])));
+         pairs += (other->node != detections[i].node) && (distance <= (2.0 * config.max_range_m)) &&
+                  (std::fabs(detection.timestamp - other->detection.timestamp) <= ((distance / slowest_speed) + (2.0 * config.timing_tolerance_s) + (2.0 * BENCH_UNCERTAINTY_S)));
+      }
+      held.push_back(&detections[i]);
+   }
+   const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   result.baseline_rate = count / elapsed;
+   result.baseline_tests_per_detection = (double)tests / count;
+   result.baseline_pairs_per_detection = (double)pairs / count;
+}
+
+static bench_result_t run_condition(uint32_t num_nodes, double load, double duration_s, bool baseline)
+{
+   // Lay nodes out at constant density over a disk sized for their number, with events at the rate that gives the
+   //    requested detections per node per second
+   const double expected_per_event = BENCH_DETECTION_PROBABILITY * M_PI * BENCH_DETECTION_RANGE_M * BENCH_DETECTION_RANGE_M / (BENCH_NODE_SPACING_M * BENCH_NODE_SPACING_M);
+   scenario_random_config_t layout;
+   layout.num_nodes = num_nodes;
+   layout.seed = num_nodes;
+   layout.radius_m = BENCH_NODE_SPACING_M * std::sqrt(num_nodes / M_PI);
+   layout.duration_s = duration_s;
+   layout.echoes_per_node = 0;
+   layout.events_per_minute = 60.0 * load * num_nodes / expected_per_event;
+   const scenario_t scenario = scenario_random(layout);
+   const std::vector<bench_detection_t> detections = bench_detections(scenario, num_nodes);
+
+   // Associate the detections in delivery order, timing only the association itself
+   bench_result_t result;
+   association_config_t config;
+   association_t association(config);
+   std::vector<candidate_event_t> candidates;
+   association.set_event_handler([&candidates](const candidate_event_t &candidate) { candidates.push_back(candidate); });
+   const auto start = std::chrono::steady_clock::now();
+   for (const bench_detection_t &entry : detections)
+      association.add(entry.detection);
+   association.flush();
+   const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   result.num_detections = detections.size();
+   result.load_rate = detections.size() / duration_s;
+   result.rate = detections.size() / elapsed;
+   result.tests_per_detection = (double)association.statistics().pair_tests / detections.size();
+   result.emitted = candidates.size();
+
+   // Score the candidates against the truth: how many events with enough detecting nodes came out as one candidate of
+   //    enough of their detections, how many were split across several, and how pure the candidates are
+   std::unordered_map<uint64_t, size_t> detections_per_event;
+   for (const bench_detection_t &entry : detections)
+      if (entry.detection.tag)
+         ++detections_per_event[entry.detection.tag];
+   std::unordered_map<uint64_t, size_t> best_share, num_candidates;
+   double purity_sum = 0.0;
+   for (const candidate_event_t &candidate : candidates)
+   {
+      std::unordered_map<uint64_t, size_t> counts;
+      for (const detection_t &detection : candidate.detections)
+         ++counts[detection.tag];
+      const auto dominant = std::max_element(counts.begin(), counts.end(), [](const auto &a, const auto &b) { return a.second < b.second; });
+      purity_sum += (double)dominant->second / candidate.detections.size();
+      result.false_events += (dominant->first == 0);
+      for (const auto &count : counts)
+         if (count.first && (count.second >= config.min_nodes))
+         {
+            best_share[count.first] = std::max(best_share[count.first], count.second);
+            ++num_candidates[count.first];
+         }
+   }
+   for (const auto &event : detections_per_event)
+      if (event.second >= config.min_nodes)
+      {
+         ++result.num_true_events;
+         result.found += best_share.count(event.first) != 0;
+         result.split += num_candidates.count(event.first) && (num_candidates[event.first] > 1);
+      }
+   result.purity = candidates.empty() ? 0.0 : (purity_sum / candidates.size());
+   if (baseline)
+      bench_baseline(detections, config, result);
+   return result;
+}
+
+int main(int argc, char **argv)
+{
+   // Scale the deployment at a fixed node density, reporting how well the candidates match the truth at a realistic
+   //    event rate, then association throughput and pair tests per detection under a heavy load against the all-pairs
+   //    baseline
+   std::vector<uint32_t> node_counts = { 300, 1000, 3000, 10000 };
+   double load = 0.3;
+   std::vector<uint32_t> counts;
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg = argv[i];
+      if ((arg == "--load") && (i + 1 < argc))
+         load = std::atof(argv[++i]);
+      else
+         counts.push_back((uint32_t)std::atol(argv[i]));
+   }
+   if (!counts.empty())
+      node_counts = counts;
+   std::printf("%.0f m node spacing, %.0f m detection range, %.0f%% false detections, up to %.1f s delivery delay\n", BENCH_NODE_SPACING_M,
+               BENCH_DETECTION_RANGE_M, 100.0 * BENCH_FALSE_FRACTION, BENCH_MAX_DELIVERY_DELAY_S);
+   std::printf("%6s %8s %9s %12s %10s %14s %10s %8s %8s %7s %8s\n", "nodes", "load/s", "detects", "associated/s", "tests/det",
+               "all-pairs/s", "tests/det", "found", "purity", "split", "false");
+   int failures = 0;
+   for (const uint32_t num_nodes : node_counts)
+      for (const bool heavy : { false, true })
+      {
+         const bench_result_t result = heavy ? run_condition(num_nodes, load, BENCH_LOAD_DURATION_S, true) :
+                                               run_condition(num_nodes, BENCH_QUALITY_LOAD, BENCH_QUALITY_DURATION_S, false);
+         char baseline_rate[16] = "-", baseline_tests[16] = "-";
+         if (heavy)
+         {
+            std::snprintf(baseline_rate, sizeof(baseline_rate), "%.0f", result.baseline_rate);
+            std::snprintf(baseline_tests, sizeof(baseline_tests), "%.0f", result.baseline_tests_per_detection);
+         }
+         const double found = result.num_true_events ? ((double)result.found / result.num_true_events) : 1.0;
+         std::printf("%6u %8.0f %9zu %12.0f %10.1f %14s %10s %7.1f%% %8.3f %7zu %8zu\n", num_nodes, result.load_rate, result.num_detections, result.rate,
+                     result.tests_per_detection, baseline_rate, baseline_tests, 100.0 * found, result.purity, result.split, result.false_events);
+         std::fflush(stdout);
+
+         // At a realistic event rate nearly every event must come out whole and unmixed
+         if (!heavy)
+            failures += (found < BENCH_MIN_FOUND) || (result.purity < BENCH_MIN_PURITY);
+      }
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cmath>
+#include "node_index.hpp"
+
+// WGS-84 ellipsoid
+static constexpr double WGS84_A = 6378137.0;
+static constexpr double WGS84_E2 = 6.69437999014e-3;
+
+void node_index_llh_to_ecef(double lat, double lon, double height, std::array<double, 3> &ecef)
+{
+   const double phi = lat * M_PI / 180.0, lambda = lon * M_PI / 180.0;
+   const double n = WGS84_A / std::sqrt(1.0 - (WGS84_E2 * std::sin(phi) * std::sin(phi)));
+   ecef[0] = (n + height) * std::cos(phi) * std::cos(lambda);
+   ecef[1] = (n + height) * std::cos(phi) * std::sin(lambda);
+   ecef[2] = ((n * (1.0 - WGS84_E2)) + height) * std::sin(phi);
+}
+
+static double squared_distance(const std::array<double, 3> &a, const std::array<double, 3> &b)
+{
+   return ((a[0] - b[0]) * (a[0] - b[0])) + ((a[1] - b[1]) * (a[1] - b[1])) + ((a[2] - b[2]) * (a[2] - b[2]));
+}
+
+node_index_t::node_index_t(double neighbour_radius_m) : neighbour_radius_m(neighbour_radius_m) {}
+
+uint32_t node_index_t::update(uint32_t device_id, double lat, double lon, double height)
+{
+   // Add a newly seen node, or move a known one only when its position has changed by more than fix noise
+   std::array<double, 3> position;
+   node_index_llh_to_ecef(lat, lon, height, position);
+   const auto existing = slots_by_device.find(device_id);
+   if (existing != slots_by_device.end())
+   {
+      if (squared_distance(positions[existing->second], position) > (NODE_INDEX_MOVE_THRESHOLD_M * NODE_INDEX_MOVE_THRESHOLD_M))
+      {
+         positions[existing->second] = position;
+         dirty = true;
+      }
+      return existing->second;
+   }
+   const uint32_t slot = (uint32_t)positions.size();
+   slots_by_device[device_id] = slot;
+   device_ids.push_back(device_id);
+   positions.push_back(position);
+   neighbour_cache.emplace_back();
+   neighbours_valid.push_back(false);
+   pending.push_back(slot);
+   dirty = dirty || (pending.size() > std::max(NODE_INDEX_MIN_PENDING, tree.size() / 8));
+   return slot;
+}
+
+const std::vector<uint32_t>& node_index_t::neighbours(uint32_t slot)
+{
+   // Every other node close enough to hear the same source, searched in the tree once per rebuild, along with any close
+   //    enough among the nodes added since
+   if (dirty)
+      rebuild();
+   if (!neighbours_valid[slot])
+   {
+      neighbour_cache[slot].clear();
+      search(0, (uint32_t)tree.size(), 0, positions[slot], neighbour_radius_m * neighbour_radius_m, neighbour_cache[slot]);
+      neighbour_cache[slot].erase(std::remove(neighbour_cache[slot].begin(), neighbour_cache[slot].end(), slot), neighbour_cache[slot].end());
+      neighbours_valid[slot] = true;
+   }
+   if (pending.empty())
+      return neighbour_cache[slot];
+   neighbour_scratch = neighbour_cache[slot];
+   for (const uint32_t other : pending)
+      if ((other != slot) && (squared_distance(positions[other], positions[slot]) <= (neighbour_radius_m * neighbour_radius_m)))
+         neighbour_scratch.push_back(other);
+   return neighbour_scratch;
+}
+
+void node_index_t::within(const std::array<double, 3> &center, double radius_m, std::vector<uint32_t> &slots)
+{
+   if (dirty)
+      rebuild();
+   search(0, (uint32_t)tree.size(), 0, center, radius_m * radius_m, slots);
+   for (const uint32_t slot : pending)
+      if (squared_distance(positions[slot], center) <= (radius_m * radius_m))
+         slots.push_back(slot);
+}
+
+double node_index_t::distance_m(uint32_t slot_a, uint32_t slot_b) const
+{
+   return std::sqrt(squared_distance(positions[slot_a], positions[slot_b]));
+}
+
+void node_index_t::rebuild(void)
+{
+   // Rebuild the whole tree, which at city scale takes far less time than the detections between node changes
+   tree.resize(positions.size());
+   for (uint32_t slot = 0; slot < tree.size(); ++slot)
+      tree[slot] = slot;
+   build(0, (uint32_t)tree.size(), 0);
+   pending.clear();
+   neighbours_valid.assign(positions.size(), false);
+   dirty = false;
+   ++num_rebuilds;
+}
+
+void node_index_t::build(uint32_t begin, uint32_t end, uint32_t depth)
+{
+   // Place the median on this depth's axis at the midpoint, with smaller coordinates before it and larger after
+   if ((end - begin) < 2)
+      return;
+   const uint32_t middle = begin + ((end - begin) / 2), axis = depth % 3;
+   std::nth_element(tree.begin() + begin, tree.begin() + middle, tree.begin() + end,
+                    [this, axis](uint32_t a, uint32_t b) { return positions[a][axis] < positions[b][axis]; });
+   build(begin, middle, depth + 1);
+   build(middle + 1, end, depth + 1);
+}
+
+void node_index_t::search(uint32_t begin, uint32_t end, uint32_t depth, const std::array<double, 3> &center, double radius_squared, std::vector<uint32_t> &slots) const
+{
+   // Visit only the halves whose side of the splitting plane lies within the radius
+   if (begin >= end)
+      return;
+   const uint32_t middle = begin + ((end - begin) / 2), axis = depth % 3, slot = tree[middle];
+   if (squared_distance(positions[slot], center) <= radius_squared)
+      slots.push_back(slot);
+   const double offset = center[axis] - positions[slot][axis];
+   if ((offset <= 0.0) || ((offset * offset) <= radius_squared))
+      search(begin, middle, depth + 1, center, radius_squared, slots);
+   if ((offset >= 0.0) || ((offset * offset) <= radius_squared))
+      search(middle + 1, end, depth + 1, center, radius_squared, slots);
+}
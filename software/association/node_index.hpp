@@ -0,0 +1,54 @@
+#ifndef __NODE_INDEX_HEADER_HPP__
+#define __NODE_INDEX_HEADER_HPP__
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Distance a node's reported position must move before the index is rebuilt, well above the jitter of a GPS fix
+static constexpr double NODE_INDEX_MOVE_THRESHOLD_M = 5.0;
+
+// Newly seen nodes are searched linearly until they outnumber this or an eighth of the tree, whichever is larger, so
+//    that a deployment coming online node by node costs a logarithmic number of rebuilds rather than one per node
+static constexpr size_t NODE_INDEX_MIN_PENDING = 64;
+
+// Spatial index of node positions (earth-centered, earth-fixed meters) as a balanced k-d tree
+//    Nodes are added and moved as their packets report positions; a move rebuilds the tree lazily on the next search, new
+//    nodes wait in a short list searched alongside it, and each node's neighbour list within the configured radius is
+//    cached until the next rebuild, since nodes rarely move
+class node_index_t
+{
+public:
+   explicit node_index_t(double neighbour_radius_m);
+
+   uint32_t update(uint32_t device_id, double lat, double lon, double height);
+   const std::vector<uint32_t>& neighbours(uint32_t slot);
+   void within(const std::array<double, 3> &center, double radius_m, std::vector<uint32_t> &slots);
+   double distance_m(uint32_t slot_a, uint32_t slot_b) const;
+   const std::array<double, 3>& position(uint32_t slot) const { return positions[slot]; }
+   uint32_t device_id(uint32_t slot) const { return device_ids[slot]; }
+   size_t size(void) const { return positions.size(); }
+   uint64_t rebuilds(void) const { return num_rebuilds; }
+
+private:
+   void rebuild(void);
+   void build(uint32_t begin, uint32_t end, uint32_t depth);
+   void search(uint32_t begin, uint32_t end, uint32_t depth, const std::array<double, 3> &center, double radius_squared, std::vector<uint32_t> &slots) const;
+
+   double neighbour_radius_m;
+   bool dirty = false;
+   uint64_t num_rebuilds = 0;
+   std::unordered_map<uint32_t, uint32_t> slots_by_device;
+   std::vector<uint32_t> device_ids;
+   std::vector<std::array<double, 3>> positions;
+   std::vector<uint32_t> tree;  // Slots ordered so that every range's midpoint splits it on the axis of its depth
+   std::vector<uint32_t> pending;  // Slots added since the last rebuild, not yet in the tree
+   std::vector<std::vector<uint32_t>> neighbour_cache;
+   std::vector<uint32_t> neighbour_scratch;
+   std::vector<bool> neighbours_valid;
+};
+
+void node_index_llh_to_ecef(double lat, double lon, double height, std::array<double, 3> &ecef);
+
+#endif  // __NODE_INDEX_HEADER_HPP__
@@ -0,0 +1,18 @@
+#include <cstdint>
+#include <sys/socket.h>
+#include "socket_io.hpp"
+
+bool write_all(int fd, const void *data, size_t data_len)
+{
+   // Send bytes to the socket until all bytes have been written or an error occurs
+   const uint8_t *bytes = static_cast<const uint8_t*>(data);
+   while (data_len)
+   {
+      const ssize_t bytes_written = send(fd, bytes, data_len, MSG_NOSIGNAL);
+      if (bytes_written <= 0)
+         return false;
+      bytes += bytes_written;
+      data_len -= bytes_written;
+   }
+   return true;
+}
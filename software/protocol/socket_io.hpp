@@ -0,0 +1,9 @@
+#ifndef __SOCKET_IO_HEADER_HPP__
+#define __SOCKET_IO_HEADER_HPP__
+
+#include <cstddef>
+
+// Send bytes to a socket until all have been written, returning false on error or a closed peer without raising SIGPIPE
+bool write_all(int fd, const void *data, size_t data_len);
+
+#endif  // __SOCKET_IO_HEADER_HPP__
@@ -0,0 +1,236 @@
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "shm_ring.hpp"
+
+static std::string shm_ring_path(const std::string &name)
+{
+   return (name.empty() || (name[0] != '/')) ? ("/" + name) : name;
+}
+
+static size_t record_length(size_t frame_length)
+{
+   return (sizeof(shm_ring_record_t) + frame_length + SHM_RING_ALIGNMENT - 1) & ~(SHM_RING_ALIGNMENT - 1);
+}
+
+shm_ring_writer_t::~shm_ring_writer_t()
+{
+   close();
+}
+
+bool shm_ring_writer_t::open(const std::string &name, size_t min_capacity)
+{
+   // Round the capacity up to a power of two so that positions map onto the data region with a mask
+   close();
+   size_t rounded = SHM_RING_HEADER_BYTES;
+   while (rounded < min_capacity)
+      rounded <<= 1;
+   const std::string path = shm_ring_path(name);
+   int fd = shm_open(path.c_str(), O_CREAT | O_RDWR, 0660);
+   if (fd < 0)
+      return false;
+
+   // Continue an existing ring of the same size where its last writer stopped; one of another size is replaced rather
+   //    than resized, since resizing under its readers' mappings would fault them
+   struct stat status = {};
+   mapping_length = SHM_RING_HEADER_BYTES + rounded;
+   if ((fstat(fd, &status) == 0) && status.st_size && ((size_t)status.st_size != mapping_length))
+   {
+      ::close(fd);
+      shm_unlink(path.c_str());
+      if ((fd = shm_open(path.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660)) < 0)
+         return false;
+      status.st_size = 0;
+   }
+   const bool existing = (size_t)status.st_size == mapping_length;
+   if ((!existing && (ftruncate(fd, (off_t)mapping_length) != 0)) ||
+       ((header = (shm_ring_header_t*)mmap(nullptr, mapping_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED))
+   {
+      header = nullptr;
+      ::close(fd);
+      return false;
+   }
+   ::close(fd);
+   if (!existing || (header->magic != SHM_RING_MAGIC) || (header->version != SHM_RING_VERSION) || (header->capacity != rounded))
+   {
+      std::memset((void*)header, 0, SHM_RING_HEADER_BYTES);
+      header = new (header) shm_ring_header_t();
+      header->capacity = rounded;
+      header->version = SHM_RING_VERSION;
+      std::atomic_thread_fence(std::memory_order_release);
+      header->magic = SHM_RING_MAGIC;
+   }
+   data = (uint8_t*)header + SHM_RING_HEADER_BYTES;
+   capacity = rounded;
+   position = header->published.load(std::memory_order_acquire);
+   header->reserved.store(position, std::memory_order_relaxed);
+   header->closed.store(0, std::memory_order_release);
+   return true;
+}
+
+bool shm_ring_writer_t::publish(const void *frame, size_t length)
+{
+   // Skip the tail of the data region if the record would straddle its end, so every frame is contiguous in place
+   if (!header || (length > max_frame_length()))
+      return false;
+   const size_t offset = position & (capacity - 1), needed = record_length(length);
+   const size_t padding = ((offset + needed) > capacity) ? (capacity - offset) : 0;
+
+   // Announce the bytes about to be overwritten before touching them, so readers of those bytes can tell
+   header->reserved.store(position + padding + needed, std::memory_order_relaxed);
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   if (padding)
+   {
+      const shm_ring_record_t pad = { SHM_RING_PADDING, 0 };
+      std::memcpy(data + offset, &pad, sizeof(pad));
+      position += padding;
+   }
+   const shm_ring_record_t record = { (uint32_t)length, 0 };
+   uint8_t *destination = data + (position & (capacity - 1));
+   std::memcpy(destination, &record, sizeof(record));
+   std::memcpy(destination + sizeof(record), frame, length);
+   position += needed;
+
+   // Publish the frame and wake any readers blocked waiting for one
+   header->frames.fetch_add(1, std::memory_order_relaxed);
+   header->published.store(position, std::memory_order_release);
+   header->notify.fetch_add(1, std::memory_order_seq_cst);
+   if (header->waiters.load(std::memory_order_seq_cst))
+      syscall(SYS_futex, &header->notify, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+   return true;
+}
+
+void shm_ring_writer_t::close(void)
+{
+   // Tell readers no more frames are coming, leaving the segment in place for them and for a restarted writer
+   if (!header)
+      return;
+   header->closed.store(1, std::memory_order_release);
+   header->notify.fetch_add(1, std::memory_order_seq_cst);
+   syscall(SYS_futex, &header->notify, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+   munmap(header, mapping_length);
+   header = nullptr;
+   data = nullptr;
+}
+
+shm_ring_reader_t::~shm_ring_reader_t()
+{
+   close();
+}
+
+bool shm_ring_reader_t::open(const std::string &name)
+{
+   // Map the header page writable, only for waiting, and the frames read-only so that no reader can corrupt them
+   close();
+   const int fd = shm_open(shm_ring_path(name).c_str(), O_RDWR, 0);
+   if (fd < 0)
+      return false;
+   struct stat status = {};
+   if ((fstat(fd, &status) != 0) || ((size_t)status.st_size <= SHM_RING_HEADER_BYTES) ||
+       ((header = (shm_ring_header_t*)mmap(nullptr, SHM_RING_HEADER_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED))
+   {
+      header = nullptr;
+      ::close(fd);
+      return false;
+   }
+   mapping_length = (size_t)status.st_size - SHM_RING_HEADER_BYTES;
+   if ((header->magic != SHM_RING_MAGIC) || (header->version != SHM_RING_VERSION) || (header->capacity != mapping_length) ||
+       ((data = (const uint8_t*)mmap(nullptr, mapping_length, PROT_READ, MAP_SHARED, fd, SHM_RING_HEADER_BYTES)) == MAP_FAILED))
+   {
+      data = nullptr;
+      ::close(fd);
+      close();
+      return false;
+   }
+   ::close(fd);
+   capacity = mapping_length;
+   cursor = header->published.load(std::memory_order_acquire);
+   stats = shm_ring_reader_statistics_t();
+   return true;
+}
+
+void shm_ring_reader_t::skip_to_newest(void)
+{
+   // Record how far behind the writer left this reader, then resume from the newest published position
+   const uint64_t published = header->published.load(std::memory_order_acquire);
+   ++stats.lag_events;
+   stats.lagged_bytes += published - cursor;
+   cursor = published;
+}
+
+shm_ring_status_t shm_ring_reader_t::read(shm_ring_frame_t &frame)
+{
+   // Step past the padding before a wrap to the next complete frame, if any has been published since the last read
+   if (!header)
+      return shm_ring_status_t::CLOSED;
+   while (true)
+   {
+      const uint64_t published = header->published.load(std::memory_order_acquire);
+      if (cursor == published)
+         return header->closed.load(std::memory_order_acquire) ? shm_ring_status_t::CLOSED : shm_ring_status_t::EMPTY;
+      const size_t offset = cursor & (capacity - 1);
+      shm_ring_record_t record;
+      std::memcpy(&record, data + offset, sizeof(record));
+
+      // Trust the record only if the writer had not started overwriting it by the time it was read
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (((published - cursor) > capacity) || (header->reserved.load(std::memory_order_relaxed) > (cursor + capacity)))
+      {
+         skip_to_newest();
+         return shm_ring_status_t::LAGGED;
+      }
+      if (record.length == SHM_RING_PADDING)
+      {
+         cursor += capacity - offset;
+         continue;
+      }
+      frame.data = data + offset + sizeof(record);
+      frame.length = record.length;
+      frame.position = cursor;
+      cursor += record_length(record.length);
+      ++stats.frames;
+      stats.bytes += record.length;
+      return shm_ring_status_t::FRAME;
+   }
+}
+
+bool shm_ring_reader_t::valid(const shm_ring_frame_t &frame) const
+{
+   std::atomic_thread_fence(std::memory_order_seq_cst);
+   return header && (header->reserved.load(std::memory_order_relaxed) <= (frame.position + capacity));
+}
+
+bool shm_ring_reader_t::wait(int timeout_ms)
+{
+   // Sleep on the futex word until the writer publishes or closes, registering first so the writer knows to wake us
+   if (!header)
+      return false;
+   header->waiters.fetch_add(1, std::memory_order_seq_cst);
+   const uint32_t notify = header->notify.load(std::memory_order_seq_cst);
+   bool ready = (header->published.load(std::memory_order_acquire) != cursor) || header->closed.load(std::memory_order_acquire);
+   if (!ready)
+   {
+      const timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+      syscall(SYS_futex, &header->notify, FUTEX_WAIT, notify, &timeout, nullptr, 0);
+      ready = header->published.load(std::memory_order_acquire) != cursor;
+   }
+   header->waiters.fetch_sub(1, std::memory_order_seq_cst);
+   return ready;
+}
+
+void shm_ring_reader_t::close(void)
+{
+   if (data)
+      munmap((void*)data, mapping_length);
+   if (header)
+      munmap(header, SHM_RING_HEADER_BYTES);
+   header = nullptr;
+   data = nullptr;
+}
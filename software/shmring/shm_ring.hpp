@@ -0,0 +1,110 @@
+#ifndef __SHM_RING_HEADER_HPP__
+#define __SHM_RING_HEADER_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+static constexpr uint32_t SHM_RING_MAGIC = 0x43415252;  // "CARR"
+static constexpr uint32_t SHM_RING_VERSION = 1;
+static constexpr size_t SHM_RING_HEADER_BYTES = 4096;  // One page, mapped writable by readers so that they can wait on it
+static constexpr size_t SHM_RING_DEFAULT_CAPACITY = 64 * 1024 * 1024;
+static constexpr size_t SHM_RING_ALIGNMENT = 8;
+static constexpr uint32_t SHM_RING_PADDING = 0xFFFFFFFF;  // Record length marking the unused tail before the ring wraps
+
+// Shared header at the start of the segment; positions count bytes ever written, so they never wrap
+//    The writer advances "reserved" past any bytes before it starts overwriting them and "published" once a frame is
+//    complete, so a reader knows a frame it used in place is intact if "reserved" has not yet come within one capacity
+//    of it
+struct shm_ring_header_t
+{
+   uint32_t magic = 0, version = 0;
+   uint64_t capacity = 0;  // Bytes in the data region, a power of two
+   alignas(64) std::atomic<uint64_t> reserved{0};
+   alignas(64) std::atomic<uint64_t> published{0};
+   std::atomic<uint64_t> frames{0};
+   std::atomic<uint32_t> closed{0};
+   alignas(64) std::atomic<uint32_t> notify{0};  // Futex word bumped on every publish
+   std::atomic<uint32_t> waiters{0};
+};
+
+// Each frame in the data region is an 8-byte aligned record: this header and then the frame exactly as received
+struct shm_ring_record_t
+{
+   uint32_t length;
+   uint32_t reserved;
+};
+
+static_assert(sizeof(shm_ring_header_t) <= SHM_RING_HEADER_BYTES, "Ring header must fit in its page");
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free, "Ring atomics must be address-free");
+
+enum class shm_ring_status_t { FRAME, EMPTY, LAGGED, CLOSED };
+
+// A frame read in place from the ring, valid until the writer laps it
+struct shm_ring_frame_t
+{
+   const uint8_t *data = nullptr;
+   uint32_t length = 0;
+   uint64_t position = 0;
+};
+
+struct shm_ring_reader_statistics_t
+{
+   uint64_t frames = 0, bytes = 0, lag_events = 0, lagged_bytes = 0;
+};
+
+// Single writer of a named shared-memory ring of variable-length frames
+//    The writer never waits for readers: a frame that does not fit overwrites the oldest, and readers that fall a whole
+//    ring behind detect it themselves; reopening an existing ring of the same capacity continues it, so readers stay
+//    attached across a writer restart
+class shm_ring_writer_t
+{
+public:
+   shm_ring_writer_t() = default;
+   ~shm_ring_writer_t();
+   shm_ring_writer_t(const shm_ring_writer_t&) = delete;
+   shm_ring_writer_t& operator=(const shm_ring_writer_t&) = delete;
+
+   bool open(const std::string &name, size_t min_capacity = SHM_RING_DEFAULT_CAPACITY);
+   bool publish(const void *data, size_t length);
+   void close(void);
+   size_t max_frame_length(void) const { return (capacity / 4) - sizeof(shm_ring_record_t); }
+   uint64_t frames(void) const { return header ? header->frames.load(std::memory_order_relaxed) : 0; }
+
+private:
+   shm_ring_header_t *header = nullptr;
+   uint8_t *data = nullptr;
+   size_t capacity = 0, mapping_length = 0;
+   uint64_t position = 0;
+};
+
+// One reader of a named ring, with its own cursor starting at the newest frame
+//    Frames are returned in place; a reader that processed a frame in place should confirm with valid() afterwards that
+//    the writer did not lap it meanwhile, and one that falls a whole ring behind skips ahead to the newest frame
+class shm_ring_reader_t
+{
+public:
+   shm_ring_reader_t() = default;
+   ~shm_ring_reader_t();
+   shm_ring_reader_t(const shm_ring_reader_t&) = delete;
+   shm_ring_reader_t& operator=(const shm_ring_reader_t&) = delete;
+
+   bool open(const std::string &name);
+   shm_ring_status_t read(shm_ring_frame_t &frame);
+   bool valid(const shm_ring_frame_t &frame) const;
+   bool wait(int timeout_ms);
+   void close(void);
+   const shm_ring_reader_statistics_t& statistics(void) const { return stats; }
+
+private:
+   void skip_to_newest(void);
+
+   shm_ring_header_t *header = nullptr;
+   const uint8_t *data = nullptr;
+   size_t capacity = 0, mapping_length = 0;
+   uint64_t cursor = 0;
+   shm_ring_reader_statistics_t stats;
+};
+
+#endif  // __SHM_RING_HEADER_HPP__
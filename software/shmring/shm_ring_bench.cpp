@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "shm_ring.hpp"
+
+extern "C" {
+#include "packet.h"
+}
+
+static constexpr uint32_t BENCH_SAMPLES = 48000;  // One full-rate audio packet per node per second, as the devices send
+static constexpr size_t BENCH_FRAME_BYTES = sizeof(packet_header_t) + sizeof(packet_audio_t) + (BENCH_SAMPLES * sizeof(int16_t));
+static constexpr double BENCH_PACED_SECONDS = 5.0;
+static constexpr double BENCH_FLAT_OUT_SECONDS = 2.0;
+static constexpr uint32_t BENCH_DEFAULT_NODES = 256;
+static constexpr size_t BENCH_MAX_LATENCIES = 8192;
+static constexpr int BENCH_PIPE_BYTES = 1024 * 1024;
+static constexpr int BENCH_WAIT_MS = 100;
+static const char *BENCH_RING_NAME = "/civicalert-shm-ring-bench";
+
+enum class transport_t { RING, PIPES };
+
+// Each reader's results, in an anonymous shared mapping the reader processes write and the parent reads after they exit
+struct reader_result_t
+{
+   std::atomic<uint32_t> ready{0};
+   uint64_t frames = 0, bad = 0, lag_events = 0, lagged_bytes = 0, overwritten = 0;
+   uint32_t num_latencies = 0;
+   float latencies_us[BENCH_MAX_LATENCIES];
+};
+
+struct run_result_t
+{
+   uint64_t published = 0;
+   double seconds = 0.0, writer_cpu_us = 0.0, reader_cpu_us = 0.0;
+   uint64_t delivered = 0, bad = 0, lag_events = 0, overwritten = 0;
+   std::vector<float> latencies_us;
+};
+
+static double monotonic_seconds(void)
+{
+   timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return now.tv_sec + (1.0e-9 * now.tv_nsec);
+}
+
+static double cpu_us(int who)
+{
+   rusage usage = {};
+   getrusage(who, &usage);
+   return (1.0e6 * (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)) + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static int64_t template_sum(const int16_t *samples)
+{
+   int64_t sum = 0;
+   for (uint32_t i = 1; i + 1 < BENCH_SAMPLES; ++i)
+      sum += samples[i];
+   return sum;
+}
+
+static bool verify_frame(const uint8_t *frame, size_t length, int64_t expected_sum, double &sent)
+{
+   // Read the whole frame where it lies, as a consumer would, checking that it is one intact packet from the writer
+   if (length != BENCH_FRAME_BYTES)
+      return false;
+   packet_header_t header;
+   packet_audio_t audio;
+   std::memcpy(&header, frame, sizeof(header));
+   std::memcpy(&audio, frame + sizeof(header), sizeof(audio));
+   const int16_t *samples = reinterpret_cast<const int16_t*>(frame + sizeof(header) + sizeof(audio));
+   sent = audio.timestamp;
+   return (header.type == PACKET_TYPE_AUDIO) && (samples[0] == (int16_t)header.sequence) && (samples[BENCH_SAMPLES - 1] == (int16_t)header.sequence) &&
+          (template_sum(samples) == expected_sum);
+}
+
+static void record_latency(reader_result_t &result, double sent)
+{
+   if (result.num_latencies < BENCH_MAX_LATENCIES)
+      result.latencies_us[result.num_latencies++] = (float)(1.0e6 * (monotonic_seconds() - sent));
+}
+
+static void ring_reader(reader_result_t &result, int64_t expected_sum)
+{
+   // Consume frames in place, confirming after each that the writer did not lap it while it was being read
+   shm_ring_reader_t reader;
+   if (!reader.open(BENCH_RING_NAME))
+      std::_Exit(1);
+   result.ready = 1;
+   while (true)
+   {
+      shm_ring_frame_t frame;
+      const shm_ring_status_t status = reader.read(frame);
+      if (status == shm_ring_status_t::FRAME)
+      {
+         double sent;
+         const bool intact = verify_frame(frame.data, frame.length, expected_sum, sent);
+         if (!reader.valid(frame))
+            ++result.overwritten;
+         else if (!intact)
+            ++result.bad;
+         else
+         {
+            ++result.frames;
+            record_latency(result, sent);
+         }
+      }
+      else if (status == shm_ring_status_t::EMPTY)
+         reader.wait(BENCH_WAIT_MS);
+      else if (status == shm_ring_status_t::CLOSED)
+         break;
+   }
+   result.lag_events = reader.statistics().lag_events;
+   result.lagged_bytes = reader.statistics().lagged_bytes;
+}
+
+static void pipe_reader(reader_result_t &result, int fd, int64_t expected_sum)
+{
+   // Copy every frame out of the pipe into a private buffer before reading it, as a socket or pipe consumer must
+   std::vector<uint8_t> frame(BENCH_FRAME_BYTES);
+   result.ready = 1;
+   while (true)
+   {
+      size_t offset = 0;
+      while (offset < frame.size())
+      {
+         const ssize_t bytes_read = read(fd, frame.data() + offset, frame.size() - offset);
+         if (bytes_read <= 0)
+            return;
+         offset += bytes_read;
+      }
+      double sent;
+      if (verify_frame(frame.data(), frame.size(), expected_sum, sent))
+      {
+         ++result.frames;
+         record_latency(result, sent);
+      }
+      else
+         ++result.bad;
+   }
+}
+
+static bool write_all(int fd, const uint8_t *data, size_t data_len)
+{
+   while (data_len)
+   {
+      const ssize_t bytes_written = write(fd, data, data_len);
+      if (bytes_written <= 0)
+         return false;
+      data += bytes_written;
+      data_len -= bytes_written;
+   }
+   return true;
+}
+
+static run_result_t run_transport(transport_t transport, uint32_t num_readers, double frames_per_second, double seconds)
+{
+   // Build the packet every frame is stamped from: a full-rate audio packet whose first and last samples carry its sequence
+   std::vector<uint8_t> packet(BENCH_FRAME_BYTES);
+   packet_header_t *header = reinterpret_cast<packet_header_t*>(packet.data());
+   packet_audio_t *audio = reinterpret_cast<packet_audio_t*>(header + 1);
+   int16_t *samples = reinterpret_cast<int16_t*>(audio + 1);
+   for (uint32_t i = 0; i < BENCH_SAMPLES; ++i)
+      samples[i] = (int16_t)((i * 31u) & 0x7FFF);
+   const int64_t expected_sum = template_sum(samples);
+
+   // Start every reader in its own process, then wait until each is attached
+   const size_t results_length = num_readers * sizeof(reader_result_t);
+   reader_result_t *results = (reader_result_t*)mmap(nullptr, results_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   for (uint32_t r = 0; r < num_readers; ++r)
+      new (&results[r]) reader_result_t();
+   shm_ring_writer_t writer;
+   if (transport == transport_t::RING)
+   {
+      shm_unlink(BENCH_RING_NAME);
+      writer.open(BENCH_RING_NAME);
+   }
+   std::vector<int> pipes;
+   std::vector<pid_t> children;
+   const double reader_cpu_start = cpu_us(RUSAGE_CHILDREN);
+   for (uint32_t r = 0; r < num_readers; ++r)
+   {
+      int fds[2] = { -1, -1 };
+      if ((transport == transport_t::PIPES) && (pipe(fds) == 0))
+         fcntl(fds[1], F_SETPIPE_SZ, BENCH_PIPE_BYTES);
+      const pid_t child = fork();
+      if (child == 0)
+      {
+         for (const int fd : pipes)
+            close(fd);
+         if (transport == transport_t::RING)
+            ring_reader(results[r], expected_sum);
+         else
+         {
+            close(fds[1]);
+            pipe_reader(results[r], fds[0], expected_sum);
+         }
+         std::_Exit(0);
+      }
+      children.push_back(child);
+      if (transport == transport_t::PIPES)
+      {
+         close(fds[0]);
+         pipes.push_back(fds[1]);
+      }
+   }
+   for (uint32_t r = 0; r < num_readers; ++r)
+      while (!results[r].ready)
+         std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+   // Publish frames at the requested rate, or as fast as possible when it is zero, for the requested time
+   run_result_t run;
+   const double writer_cpu_start = cpu_us(RUSAGE_SELF), start = monotonic_seconds();
+   for (uint64_t n = 0; ; ++n)
+   {
+      double now = monotonic_seconds();
+      if ((now - start) >= seconds)
+         break;
+      if (frames_per_second > 0.0)
+      {
+         const double due = start + (n / frames_per_second);
+         if (due > now)
+         {
+            std::this_thread::sleep_for(std::chrono::duration<double>(due - now));
+            now = monotonic_seconds();
+         }
+      }
+      packet_init_header(header, PACKET_TYPE_AUDIO, (uint16_t)n, (uint32_t)(packet.size() - sizeof(packet_header_t)));
+      samples[0] = samples[BENCH_SAMPLES - 1] = (int16_t)header->sequence;
+      audio->timestamp = now;
+      if (transport == transport_t::RING)
+         writer.publish(packet.data(), packet.size());
+      else
+         for (const int fd : pipes)
+            write_all(fd, packet.data(), packet.size());
+      ++run.published;
+   }
+   run.seconds = monotonic_seconds() - start;
+   run.writer_cpu_us = cpu_us(RUSAGE_SELF) - writer_cpu_start;
+
+   // Let the readers drain and exit, then gather what each one saw
+   writer.close();
+   for (const int fd : pipes)
+      close(fd);
+   for (const pid_t child : children)
+      waitpid(child, nullptr, 0);
+   run.reader_cpu_us = cpu_us(RUSAGE_CHILDREN) - reader_cpu_start;
+   for (uint32_t r = 0; r < num_readers; ++r)
+   {
+      run.delivered += results[r].frames;
+      run.bad += results[r].bad;
+      run.lag_events += results[r].lag_events;
+      run.overwritten += results[r].overwritten;
+      run.latencies_us.insert(run.latencies_us.end(), results[r].latencies_us, results[r].latencies_us + results[r].num_latencies);
+   }
+   munmap(results, results_length);
+   if (transport == transport_t::RING)
+      shm_unlink(BENCH_RING_NAME);
+   return run;
+}
+
+static double percentile(std::vector<float> values, double fraction)
+{
+   if (values.empty())
+      return 0.0;
+   const size_t index = std::min(values.size() - 1, (size_t)(fraction * values.size()));
+   std::nth_element(values.begin(), values.begin() + index, values.end());
+   return values[index];
+}
+
+int main(int argc, char **argv)
+{
+   // Fan full-rate audio packets out to many reader processes through the ring and through one pipe per reader, first at
+   //    the rate a deployment of nodes produces and then as fast as the writer can go
+   uint32_t num_nodes = BENCH_DEFAULT_NODES;
+   std::vector<uint32_t> reader_counts = { 1, 4, 16, 64 }, counts;
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg = argv[i];
+      if ((arg == "--nodes") && (i + 1 < argc))
+         num_nodes = (uint32_t)std::atol(argv[++i]);
+      else
+         counts.push_back((uint32_t)std::atol(argv[i]));
+   }
+   if (!counts.empty())
+      reader_counts = counts;
+   int failures = 0;
+   std::printf("Paced at %u nodes (%.1f MB/s of %zu-byte packets) for %.0f s on %u CPUs\n", num_nodes, num_nodes * BENCH_FRAME_BYTES / 1.0e6,
+               BENCH_FRAME_BYTES, BENCH_PACED_SECONDS, std::thread::hardware_concurrency());
+   std::printf("%-9s %7s %9s %10s %13s %13s %9s %9s %6s %8s\n", "transport", "readers", "frames", "delivered", "writer us/fr",
+               "reader us/fr", "p50 ms", "p99 ms", "lags", "corrupt");
+   for (const uint32_t num_readers : reader_counts)
+      for (const transport_t transport : { transport_t::RING, transport_t::PIPES })
+      {
+         const run_result_t run = run_transport(transport, num_readers, num_nodes, BENCH_PACED_SECONDS);
+         const uint64_t expected = run.published * num_readers;
+         std::printf("%-9s %7u %9llu %9.2f%% %13.1f %13.1f %9.3f %9.3f %6llu %8llu\n", (transport == transport_t::RING) ? "ring" : "pipes", num_readers,
+                     (unsigned long long)run.published, 100.0 * run.delivered / std::max<uint64_t>(expected, 1), run.writer_cpu_us / std::max<uint64_t>(run.published, 1),
+                     run.reader_cpu_us / std::max<uint64_t>(run.delivered, 1), 1.0e-3 * percentile(run.latencies_us, 0.5), 1.0e-3 * percentile(run.latencies_us, 0.99),
+                     (unsigned long long)run.lag_events, (unsigned long long)run.bad);
+         std::fflush(stdout);
+         failures += run.bad != 0;
+      }
+
+   // Flat out the ring's writer never waits, so slow readers lag instead, while the pipes run at their slowest reader
+   std::printf("\nFlat out for %.0f s\n", BENCH_FLAT_OUT_SECONDS);
+   std::printf("%-9s %7s %12s %16s %10s %6s %12s %8s\n", "transport", "readers", "writer MB/s", "per-reader MB/s", "delivered", "lags", "overwritten", "corrupt");
+   for (const uint32_t num_readers : reader_counts)
+      for (const transport_t transport : { transport_t::RING, transport_t::PIPES })
+      {
+         const run_result_t run = run_transport(transport, num_readers, 0.0, BENCH_FLAT_OUT_SECONDS);
+         std::printf("%-9s %7u %12.0f %16.0f %9.2f%% %6llu %12llu %8llu\n", (transport == transport_t::RING) ? "ring" : "pipes", num_readers,
+                     run.published * BENCH_FRAME_BYTES / (1.0e6 * run.seconds), run.delivered * BENCH_FRAME_BYTES / (1.0e6 * run.seconds * num_readers),
+                     100.0 * run.delivered / std::max<uint64_t>(run.published * num_readers, 1), (unsigned long long)run.lag_events,
+                     (unsigned long long)run.overwritten, (unsigned long long)run.bad);
+         std::fflush(stdout);
+         failures += run.bad != 0;
+      }
+   return failures ? 1 : 0;
+}
@@ -0,0 +1,411 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include "scenario.hpp"
+
+static constexpr double WGS84_A = 6378137.0;
+static constexpr double WGS84_F = 1.0 / 298.257223563;
+static constexpr double WGS84_E2 = WGS84_F * (2.0 - WGS84_F);
+static constexpr double FULL_SCALE = 32767.0;
+static constexpr double IMPULSE_RISE_SECONDS = 0.0001;
+static constexpr double IMPULSE_EXTENT_PERIODS = 5.0;
+static constexpr double ENVELOPE_EDGE_SECONDS = 0.01;
+static constexpr uint32_t NOISE_TONES = 24;
+static constexpr uint32_t GAUSSIAN_TABLE_BITS = 12;
+
+static void llh_to_ecef(double lat, double lon, double height, double ecef[3])
+{
+   // Convert WGS84 geodetic coordinates in degrees and meters to Earth-centered Earth-fixed meters
+   const double phi = lat * M_PI / 180.0, lambda = lon * M_PI / 180.0;
+   const double n = WGS84_A / std::sqrt(1.0 - (WGS84_E2 * std::sin(phi) * std::sin(phi)));
+   ecef[0] = (n + height) * std::cos(phi) * std::cos(lambda);
+   ecef[1] = (n + height) * std::cos(phi) * std::sin(lambda);
+   ecef[2] = ((n * (1.0 - WGS84_E2)) + height) * std::sin(phi);
+}
+
+static scenario_source_kind_t parse_source_kind(const std::string &name, bool &valid)
+{
+   valid = true;
+   if (name == "impulse")
+      return scenario_source_kind_t::IMPULSE;
+   else if (name == "tone")
+      return scenario_source_kind_t::TONE;
+   else if (name == "chirp")
+      return scenario_source_kind_t::CHIRP;
+   else if (name == "noise")
+      return scenario_source_kind_t::NOISE;
+   valid = false;
+   return scenario_source_kind_t::IMPULSE;
+}
+
+static double source_extent(const scenario_event_t &event)
+{
+   // An impulse keeps ringing through its negative phase well past its nominal duration
+   return (event.kind == scenario_source_kind_t::IMPULSE) ? (IMPULSE_EXTENT_PERIODS * event.duration_s) : event.duration_s;
+}
+
+static const float* gaussian_table(void)
+{
+   // Shared table of standard normal deviates, so that noise costs one table lookup per sample
+   static const std::vector<float> table = []()
+   {
+      std::vector<float> values(1u << GAUSSIAN_TABLE_BITS);
+      std::mt19937 generator(0x5EED);
+      std::normal_distribution<float> normal(0.0f, 1.0f);
+      for (float &value : values)
+         value = normal(generator);
+      return values;
+   }();
+   return table.data();
+}
+
+const char* scenario_source_kind_name(scenario_source_kind_t kind)
+{
+   switch (kind)
+   {
+      case scenario_source_kind_t::IMPULSE:
+         return "impulse";
+      case scenario_source_kind_t::TONE:
+         return "tone";
+      case scenario_source_kind_t::CHIRP:
+         return "chirp";
+      default:
+         return "noise";
+   }
+}
+
+double scenario_distance_m(double lat1, double lon1, double height1, double lat2, double lon2, double height2)
+{
+   double a[3], b[3];
+   llh_to_ecef(lat1, lon1, height1, a);
+   llh_to_ecef(lat2, lon2, height2, b);
+   return std::sqrt(((a[0] - b[0]) * (a[0] - b[0])) + ((a[1] - b[1]) * (a[1] - b[1])) + ((a[2] - b[2]) * (a[2] - b[2])));
+}
+
+bool scenario_load(const std::string &path, scenario_t &scenario, std::string &error)
+{
+   std::ifstream input(path);
+   if (!input)
+   {
+      error = "unable to open " + path;
+      return false;
+   }
+
+   // Parse one directive per line, ignoring blank lines and comments
+   std::string line;
+   for (uint32_t line_number = 1; std::getline(input, line); ++line_number)
+   {
+      line = line.substr(0, line.find('#'));
+      std::istringstream fields(line);
+      std::string directive;
+      if (!(fields >> directive))
+         continue;
+      bool valid = true;
+      if (directive == "start")
+         valid = static_cast<bool>(fields >> scenario.start_time);
+      else if (directive == "duration")
+         valid = static_cast<bool>(fields >> scenario.duration_s) && (scenario.duration_s >= 1.0);
+      else if (directive == "speed_of_sound")
+         valid = static_cast<bool>(fields >> scenario.speed_of_sound) && (scenario.speed_of_sound > 0.0);
+      else if (directive == "absorption")
+         valid = static_cast<bool>(fields >> scenario.absorption_db_per_km);
+      else if (directive == "corrected")
+         scenario.corrected = true;
+      else if (directive == "node")
+      {
+         // node <name> <lat> <lon> <height> [drift ppm] [clock offset us] [timestamp jitter us] [noise dBFS]
+         scenario_node_t node;
+         double clock_offset_us = 0.0, jitter_us = 0.0;
+         valid = static_cast<bool>(fields >> node.name >> node.lat >> node.lon >> node.height);
+         if (valid && (fields >> node.drift_ppm) && (fields >> clock_offset_us) && (fields >> jitter_us))
+            fields >> node.noise_dbfs;
+         node.clock_offset_s = clock_offset_us * 1.0e-6;
+         node.timestamp_jitter_s = jitter_us * 1.0e-6;
+         scenario.nodes.push_back(node);
+      }
+      else if (directive == "echo")
+      {
+         // echo <node name> <delay ms> <gain>
+         std::string name;
+         scenario_echo_t echo;
+         valid = static_cast<bool>(fields >> name >> echo.delay_s >> echo.gain);
+         auto node = std::find_if(scenario.nodes.begin(), scenario.nodes.end(), [&name](const scenario_node_t &node) { return node.name == name; });
+         valid = valid && (node != scenario.nodes.end());
+         echo.delay_s *= 1.0e-3;
+         if (valid)
+            node->echoes.push_back(echo);
+      }
+      else if (directive == "event")
+      {
+         // event <offset s> <lat> <lon> <height> <kind> <level dB at 1 m> <duration s> [frequency Hz] [end frequency Hz]
+         scenario_event_t event;
+         std::string kind;
+         event.id = (uint32_t)scenario.events.size();
+         valid = static_cast<bool>(fields >> event.time >> event.lat >> event.lon >> event.height >> kind >> event.level_db >> event.duration_s);
+         event.kind = parse_source_kind(kind, valid);
+         if (valid && (fields >> event.frequency_hz) && !(fields >> event.end_frequency_hz))
+            event.end_frequency_hz = event.frequency_hz;
+         valid = valid && (event.duration_s > 0.0);
+         scenario.events.push_back(event);
+      }
+      else
+         valid = false;
+      if (!valid)
+      {
+         error = path + ":" + std::to_string(line_number) + ": invalid \"" + directive + "\" directive";
+         return false;
+      }
+   }
+   if (scenario.nodes.empty())
+   {
+      error = path + ": no nodes defined";
+      return false;
+   }
+   return true;
+}
+
+scenario_t scenario_random(const scenario_random_config_t &config)
+{
+   // Place points uniformly over a disk around the center, converting local east/north offsets to geodetic degrees
+   scenario_t scenario;
+   scenario.duration_s = config.duration_s;
+   std::mt19937 generator(config.seed);
+   std::uniform_real_distribution<double> unit(0.0, 1.0);
+   auto uniform = [&](double low, double high) { return low + ((high - low) * unit(generator)); };
+   auto place = [&](double &lat, double &lon)
+   {
+      const double radius = config.radius_m * std::sqrt(unit(generator)), angle = uniform(0.0, 2.0 * M_PI);
+      lat = config.center_lat + ((radius * std::cos(angle)) / WGS84_A * 180.0 / M_PI);
+      lon = config.center_lon + ((radius * std::sin(angle)) / (WGS84_A * std::cos(config.center_lat * M_PI / 180.0)) * 180.0 / M_PI);
+   };
+
+   // Give every node its own clock error, noise floor, and set of nearby reflectors
+   for (uint32_t i = 0; i < config.num_nodes; ++i)
+   {
+      scenario_node_t node;
+      char name[32];
+      std::snprintf(name, sizeof(name), "sim-%04u", i);
+      node.name = name;
+      place(node.lat, node.lon);
+      node.height = config.center_height + uniform(0.0, 20.0);
+      node.drift_ppm = uniform(-config.max_drift_ppm, config.max_drift_ppm);
+      node.clock_offset_s = uniform(-config.max_clock_offset_s, config.max_clock_offset_s);
+      node.timestamp_jitter_s = config.timestamp_jitter_s;
+      node.noise_dbfs = uniform(-66.0, -54.0);
+      for (uint32_t j = 0; j < config.echoes_per_node; ++j)
+         node.echoes.push_back({ uniform(0.005, 0.08), uniform(0.05, 0.4) });
+      scenario.nodes.push_back(node);
+   }
+
+   // Generate events as a Poisson process over the whole duration
+   double time = 0.0;
+   while (config.events_per_minute > 0.0)
+   {
+      time += -std::log(1.0 - unit(generator)) * 60.0 / config.events_per_minute;
+      if (time >= config.duration_s)
+         break;
+      scenario_event_t event;
+      event.id = (uint32_t)scenario.events.size();
+      event.time = time;
+      place(event.lat, event.lon);
+      event.height = config.center_height + uniform(0.0, 10.0);
+      event.kind = (scenario_source_kind_t)(generator() % 4);
+      event.level_db = uniform(30.0, 60.0);
+      switch (event.kind)
+      {
+         case scenario_source_kind_t::IMPULSE:
+            event.duration_s = uniform(0.001, 0.005);
+            break;
+         case scenario_source_kind_t::TONE:
+            event.duration_s = uniform(0.2, 2.0);
+            event.frequency_hz = event.end_frequency_hz = uniform(200.0, 4000.0);
+            break;
+         case scenario_source_kind_t::CHIRP:
+            event.duration_s = uniform(0.5, 3.0);
+            event.frequency_hz = uniform(200.0, 1000.0);
+            event.end_frequency_hz = uniform(2000.0, 8000.0);
+            break;
+         default:
+            event.duration_s = uniform(0.5, 4.0);
+            event.frequency_hz = uniform(100.0, 1000.0);
+            event.end_frequency_hz = event.frequency_hz + uniform(500.0, 5000.0);
+            break;
+      }
+      scenario.events.push_back(event);
+   }
+   return scenario;
+}
+
+std::vector<scenario_arrival_t> scenario_node_arrivals(const scenario_t &scenario, const scenario_node_t &node)
+{
+   // Every event reaches the node directly after its propagation delay, attenuated by spherical spreading from 1 m and
+   //    by air absorption, followed by each of the node's echoes of that arrival
+   std::vector<scenario_arrival_t> arrivals;
+   for (const scenario_event_t &event : scenario.events)
+   {
+      scenario_arrival_t arrival;
+      arrival.event = &event;
+      arrival.distance_m = scenario_distance_m(event.lat, event.lon, event.height, node.lat, node.lon, node.height);
+      arrival.time = event.time + (arrival.distance_m / scenario.speed_of_sound);
+      arrival.extent_s = source_extent(event);
+      arrival.gain = std::pow(10.0, (event.level_db - (scenario.absorption_db_per_km * arrival.distance_m * 1.0e-3)) / 20.0) / std::max(arrival.distance_m, 1.0);
+      arrivals.push_back(arrival);
+      for (const scenario_echo_t &echo : node.echoes)
+      {
+         scenario_arrival_t reflection = arrival;
+         reflection.time += echo.delay_s;
+         reflection.gain *= echo.gain;
+         reflection.echo = true;
+         arrivals.push_back(reflection);
+      }
+   }
+   std::sort(arrivals.begin(), arrivals.end(), [](const scenario_arrival_t &a, const scenario_arrival_t &b) { return a.time < b.time; });
+   return arrivals;
+}
+
+scenario_node_synthesizer_t::scenario_node_synthesizer_t(const scenario_t &scenario, size_t node_index) :
+   scenario(scenario), node(scenario.nodes[node_index]), arrivals(scenario_node_arrivals(scenario, node)),
+   noise_tones(scenario.events.size()), mix(SCENARIO_SAMPLE_RATE_HZ), random_state((uint32_t)((node_index * 2654435761u) | 1u))
+{
+   // A raw node samples at its own drifting rate starting exactly at the scenario start, while a corrected node delivers
+   //    samples on its own view of the GPS grid, which is displaced from true time by its timestamping offset
+   capture_origin = scenario.corrected ? -node.clock_offset_s : 0.0;
+   capture_rate_hz = scenario.corrected ? SCENARIO_SAMPLE_RATE_HZ : (SCENARIO_SAMPLE_RATE_HZ * (1.0 + (node.drift_ppm * 1.0e-6)));
+
+   // Derive each noise source's components from its event ID alone so that every node renders the identical signal
+   for (size_t i = 0; i < scenario.events.size(); ++i)
+      if (scenario.events[i].kind == scenario_source_kind_t::NOISE)
+      {
+         std::mt19937 generator(scenario.events[i].id + 1);
+         std::uniform_real_distribution<double> unit(0.0, 1.0);
+         for (uint32_t k = 0; k < NOISE_TONES; ++k)
+         {
+            const double frequency = scenario.events[i].frequency_hz + ((scenario.events[i].end_frequency_hz - scenario.events[i].frequency_hz) * unit(generator));
+            noise_tones[i].push_back({ frequency, 2.0 * M_PI * unit(generator) });
+         }
+      }
+}
+
+uint32_t scenario_node_synthesizer_t::next_random(void)
+{
+   random_state ^= random_state << 13;
+   random_state ^= random_state >> 17;
+   random_state ^= random_state << 5;
+   return random_state;
+}
+
+void scenario_node_synthesizer_t::add_arrival(const scenario_arrival_t &arrival, double t0, double dt, float *output, uint32_t count) const
+{
+   // Impulses are short enough to evaluate directly: a Friedlander blast wave with a brief rise, decaying through its
+   //    negative phase
+   const scenario_event_t &event = *arrival.event;
+   if (event.kind == scenario_source_kind_t::IMPULSE)
+   {
+      for (uint32_t n = 0; n < count; ++n)
+      {
+         const double t = t0 + (n * dt), rise = std::min(t / IMPULSE_RISE_SECONDS, 1.0), x = t / event.duration_s;
+         output[n] += (float)(arrival.gain * rise * (1.0 - x) * std::exp(-2.0 * x));
+      }
+      return;
+   }
+
+   // Tonal sources are sums of sinusoids advanced by complex rotation from their exact phase at the first sample, with
+   //    the rotation itself advancing for a linear chirp; the phasors are re-seeded exactly on every call
+   struct phasor_t { double re, im, step_re, step_im, chirp_re, chirp_im; };
+   std::vector<phasor_t> phasors;
+   auto add_phasor = [&phasors, t0, dt](double frequency, double phase, double sweep_rate)
+   {
+      const double theta = phase + (2.0 * M_PI * t0 * (frequency + (0.5 * sweep_rate * t0)));
+      const double step = 2.0 * M_PI * dt * (frequency + (sweep_rate * t0) + (0.5 * sweep_rate * dt)), chirp = 2.0 * M_PI * sweep_rate * dt * dt;
+      phasors.push_back({ std::cos(theta), std::sin(theta), std::cos(step), std::sin(step), std::cos(chirp), std::sin(chirp) });
+   };
+   double scale = arrival.gain;
+   if (event.kind == scenario_source_kind_t::NOISE)
+   {
+      for (const scenario_tone_t &tone : noise_tones[&event - scenario.events.data()])
+         add_phasor(tone.frequency_hz, tone.phase, 0.0);
+      scale /= 3.0 * std::sqrt(0.5 * NOISE_TONES);
+   }
+   else
+      add_phasor(event.frequency_hz, 0.0, (event.kind == scenario_source_kind_t::CHIRP) ? ((event.end_frequency_hz - event.frequency_hz) / event.duration_s) : 0.0);
+
+   // Fade in and out over a short raised-cosine edge to avoid spectral splatter at the source boundaries
+   const double edge = std::min(ENVELOPE_EDGE_SECONDS, 0.5 * event.duration_s);
+   for (uint32_t n = 0; n < count; ++n)
+   {
+      const double t = t0 + (n * dt), ramp = std::min(std::min(t, event.duration_s - t) / edge, 1.0);
+      double value = 0.0;
+      for (phasor_t &phasor : phasors)
+      {
+         value += phasor.im;
+         const double re = (phasor.re * phasor.step_re) - (phasor.im * phasor.step_im);
+         phasor.im = (phasor.re * phasor.step_im) + (phasor.im * phasor.step_re);
+         phasor.re = re;
+         const double step_re = (phasor.step_re * phasor.chirp_re) - (phasor.step_im * phasor.chirp_im);
+         phasor.step_im = (phasor.step_re * phasor.chirp_im) + (phasor.step_im * phasor.chirp_re);
+         phasor.step_re = step_re;
+      }
+      output[n] += (float)(scale * ((ramp < 1.0) ? (0.5 - (0.5 * std::cos(M_PI * ramp))) : 1.0) * value);
+   }
+}
+
+void scenario_node_synthesizer_t::render_packet(uint32_t block, uint8_t *packet)
+{
+   // Determine the true time span covered by this block's samples
+   const uint64_t first_sample = (uint64_t)block * SCENARIO_SAMPLE_RATE_HZ, end_sample = first_sample + SCENARIO_SAMPLE_RATE_HZ;
+   const double block_start = capture_origin + (first_sample / capture_rate_hz), block_end = capture_origin + (end_sample / capture_rate_hz);
+
+   // Fill the block with the node's noise floor
+   const float *gaussian = gaussian_table();
+   const float noise_scale = (float)std::pow(10.0, node.noise_dbfs / 20.0);
+   for (float &sample : mix)
+      sample = noise_scale * gaussian[next_random() >> (32 - GAUSSIAN_TABLE_BITS)];
+
+   // Add every arrival overlapping the block, evaluating each source at the exact (fractional) time of every sample
+   while ((first_active < arrivals.size()) && ((arrivals[first_active].time + arrivals[first_active].extent_s) < block_start))
+      ++first_active;
+   for (size_t i = first_active; (i < arrivals.size()) && (arrivals[i].time < block_end); ++i)
+   {
+      const scenario_arrival_t &arrival = arrivals[i];
+      const double arrival_end = arrival.time + arrival.extent_s;
+      if (arrival_end <= block_start)
+         continue;
+      const uint64_t start = std::max(first_sample, (uint64_t)std::max(0.0, std::ceil((arrival.time - capture_origin) * capture_rate_hz)));
+      const uint64_t end = std::min(end_sample, (uint64_t)std::ceil((arrival_end - capture_origin) * capture_rate_hz));
+      if (end > start)
+         add_arrival(arrival, capture_origin + (start / capture_rate_hz) - arrival.time, 1.0 / capture_rate_hz, mix.data() + (start - first_sample), (uint32_t)(end - start));
+   }
+
+   // Frame the block exactly as the node does, stamped with the node's own (possibly biased and jittered) view of the
+   //    GPS time of its first sample
+   packet_header_t *header = reinterpret_cast<packet_header_t*>(packet);
+   packet_audio_t *audio_header = reinterpret_cast<packet_audio_t*>(header + 1);
+   int16_t *samples = reinterpret_cast<int16_t*>(audio_header + 1);
+   packet_init_header(header, PACKET_TYPE_AUDIO, (uint16_t)block, sizeof(packet_audio_t) + (SCENARIO_SAMPLE_RATE_HZ * sizeof(int16_t)));
+   packet_audio_t audio = {};
+   if (scenario.corrected)
+   {
+      header->flags |= PACKET_FLAG_RESAMPLED;
+      audio.timestamp = scenario.start_time + block;
+   }
+   else
+   {
+      const double jitter = node.timestamp_jitter_s * ((2.0 * next_random() / 4294967296.0) - 1.0);
+      audio.timestamp = scenario.start_time + block_start + node.clock_offset_s + jitter;
+   }
+   audio.lat = node.lat;
+   audio.lon = node.lon;
+   audio.height = (float)node.height;
+   audio.drift_ppm = (float)node.drift_ppm;
+   std::memcpy(audio_header, &audio, sizeof(audio));
+   for (uint32_t i = 0; i < SCENARIO_SAMPLE_RATE_HZ; ++i)
+   {
+      const double value = std::nearbyint(mix[i] * FULL_SCALE);
+      const int16_t sample = (int16_t)std::max(-32768.0, std::min(32767.0, value));
+      std::memcpy(samples + i, &sample, sizeof(sample));
+   }
+}
@@ -0,0 +1,106 @@
+#ifndef __SCENARIO_HEADER_HPP__
+#define __SCENARIO_HEADER_HPP__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "packet.h"
+}
+
+static constexpr uint32_t SCENARIO_SAMPLE_RATE_HZ = 48000;
+static constexpr size_t SCENARIO_PACKET_SIZE_BYTES = sizeof(packet_header_t) + sizeof(packet_audio_t) + (SCENARIO_SAMPLE_RATE_HZ * sizeof(int16_t));
+static constexpr double SCENARIO_DEFAULT_START_TIME = 1400000000.0;
+
+// Reflection heard by a node after every direct arrival, relative to that arrival
+struct scenario_echo_t
+{
+   double delay_s = 0.0, gain = 0.0;
+};
+
+// Sensor node at a fixed position (in the same LLH form the node reports), with its own clock and noise floor
+struct scenario_node_t
+{
+   std::string name;
+   double lat = 0.0, lon = 0.0, height = 0.0;
+   double drift_ppm = 0.0, clock_offset_s = 0.0, timestamp_jitter_s = 0.0, noise_dbfs = -60.0;
+   std::vector<scenario_echo_t> echoes;
+};
+
+enum class scenario_source_kind_t { IMPULSE, TONE, CHIRP, NOISE };
+
+// Acoustic source event, timed relative to the scenario start; "level_db" is the peak amplitude 1 m from the source
+//    relative to digital full scale
+struct scenario_event_t
+{
+   uint32_t id = 0;
+   double time = 0.0, lat = 0.0, lon = 0.0, height = 0.0;
+   scenario_source_kind_t kind = scenario_source_kind_t::IMPULSE;
+   double level_db = 0.0, duration_s = 0.0, frequency_hz = 0.0, end_frequency_hz = 0.0;
+};
+
+// Complete scenario; "corrected" nodes deliver drift-corrected audio on the GPS time grid as the firmware does once
+//    its drift estimate is valid, otherwise raw audio at each node's own sample rate with jittered block timestamps
+struct scenario_t
+{
+   double start_time = SCENARIO_DEFAULT_START_TIME, duration_s = 60.0;
+   double speed_of_sound = 343.0, absorption_db_per_km = 5.0;
+   bool corrected = false;
+   std::vector<scenario_node_t> nodes;
+   std::vector<scenario_event_t> events;
+};
+
+// Parameters for a randomly laid out scenario of any size
+struct scenario_random_config_t
+{
+   uint32_t num_nodes = 16, echoes_per_node = 2, seed = 1;
+   double center_lat = 36.1447, center_lon = -86.8027, center_height = 180.0, radius_m = 2000.0;
+   double duration_s = 60.0, events_per_minute = 6.0;
+   double max_drift_ppm = 30.0, max_clock_offset_s = 0.00005, timestamp_jitter_s = 0.00025;
+};
+
+// One path from an event to a node: the direct arrival or one of its echoes
+struct scenario_arrival_t
+{
+   const scenario_event_t *event = nullptr;
+   double time = 0.0, extent_s = 0.0, gain = 0.0, distance_m = 0.0;
+   bool echo = false;
+};
+
+bool scenario_load(const std::string &path, scenario_t &scenario, std::string &error);
+scenario_t scenario_random(const scenario_random_config_t &config);
+const char* scenario_source_kind_name(scenario_source_kind_t kind);
+double scenario_distance_m(double lat1, double lon1, double height1, double lat2, double lon2, double height2);
+std::vector<scenario_arrival_t> scenario_node_arrivals(const scenario_t &scenario, const scenario_node_t &node);
+
+// Component of a band-limited noise source, which is a fixed sum of sinusoids so that every node hears the same signal
+struct scenario_tone_t
+{
+   double frequency_hz = 0.0, phase = 0.0;
+};
+
+// Renders one node's audio second by second as framed PACKET_TYPE_AUDIO packets, exactly as the node sends them
+class scenario_node_synthesizer_t
+{
+public:
+   scenario_node_synthesizer_t(const scenario_t &scenario, size_t node_index);
+
+   void render_packet(uint32_t block, uint8_t *packet);
+   uint32_t num_blocks(void) const { return (uint32_t)(scenario.duration_s + 0.5); }
+
+private:
+   void add_arrival(const scenario_arrival_t &arrival, double t0, double dt, float *output, uint32_t count) const;
+   uint32_t next_random(void);
+
+   const scenario_t &scenario;
+   const scenario_node_t &node;
+   std::vector<scenario_arrival_t> arrivals;
+   std::vector<std::vector<scenario_tone_t>> noise_tones;
+   std::vector<float> mix;
+   size_t first_active = 0;
+   uint32_t random_state;
+   double capture_origin, capture_rate_hz;
+};
+
+#endif  // __SCENARIO_HEADER_HPP__
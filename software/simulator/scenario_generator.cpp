@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "scenario.hpp"
+#include "socket_io.hpp"
+
+static constexpr uint16_t DEFAULT_DEVICE_PORT = 5000;
+
+// Destination of one simulated node's packet stream
+struct node_output_t
+{
+   std::FILE *file = nullptr;
+   int fd = -1;
+   bool failed = false;
+};
+
+struct generator_statistics_t
+{
+   std::atomic<uint64_t> packets{0}, bytes{0}, failed_nodes{0};
+};
+
+static void usage(void)
+{
+   std::fprintf(stderr,
+      "Usage: scenario_generator (--scenario <file> | --nodes <count> [--radius <m>] [--center <lat> <lon> <height>] [--events-per-minute <rate>]\n"
+      "                          [--echoes <count>] [--seed <seed>]) [--duration <seconds>] [--start <GPS time>] [--corrected]\n"
+      "                          [--output-dir <dir>] [--server <host> [--port <port>] [--realtime <speed>]] [--truth <dir>] [--threads <count>]\n");
+   std::exit(1);
+}
+
+static int connect_to_server(const std::string &server, uint16_t port, uint32_t node_index)
+{
+   // Open one TCP connection per node, exactly as a networked device would; the aggregator identifies devices by address,
+   //    so connections to a local aggregator each originate from their own loopback address
+   addrinfo hints = {}, *result = nullptr;
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+   if (getaddrinfo(server.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+      return -1;
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   if ((fd >= 0) && ((ntohl(reinterpret_cast<const sockaddr_in*>(result->ai_addr)->sin_addr.s_addr) >> 24) == 127))
+   {
+      sockaddr_in source = {};
+      source.sin_family = AF_INET;
+      source.sin_addr.s_addr = htonl(0x7F010000u + (((node_index / 254) + 1) << 8) + ((node_index % 254) + 1));
+      bind(fd, reinterpret_cast<sockaddr*>(&source), sizeof(source));
+   }
+   if ((fd >= 0) && (connect(fd, result->ai_addr, result->ai_addrlen) != 0))
+   {
+      close(fd);
+      fd = -1;
+   }
+   freeaddrinfo(result);
+   return fd;
+}
+
+static bool write_truth(const scenario_t &scenario, const std::string &directory)
+{
+   // List every event along with its arrival at every node, in absolute GPS time; "node_time" is the time at which the
+   //    node's own timestamps place the arrival
+   std::FILE *events = std::fopen((directory + "/events.csv").c_str(), "w");
+   std::FILE *arrivals = std::fopen((directory + "/arrivals.csv").c_str(), "w");
+   if (!events || !arrivals)
+   {
+      if (events)
+         std::fclose(events);
+      if (arrivals)
+         std::fclose(arrivals);
+      return false;
+   }
+   std::fprintf(events, "event,kind,time,lat,lon,height,level_db,duration_s,frequency_hz,end_frequency_hz\n");
+   for (const scenario_event_t &event : scenario.events)
+      std::fprintf(events, "%u,%s,%0.6f,%0.8f,%0.8f,%0.3f,%0.2f,%0.6f,%0.2f,%0.2f\n", event.id, scenario_source_kind_name(event.kind),
+                   scenario.start_time + event.time, event.lat, event.lon, event.height, event.level_db, event.duration_s,
+                   event.frequency_hz, event.end_frequency_hz);
+   std::fprintf(arrivals, "event,node,path,time,node_time,distance_m,peak_dbfs\n");
+   for (const scenario_node_t &node : scenario.nodes)
+      for (const scenario_arrival_t &arrival : scenario_node_arrivals(scenario, node))
+         std::fprintf(arrivals, "%u,%s,%s,%0.6f,%0.6f,%0.2f,%0.2f\n", arrival.event->id, node.name.c_str(), arrival.echo ? "echo" : "direct",
+                      scenario.start_time + arrival.time, scenario.start_time + arrival.time + node.clock_offset_s,
+                      arrival.distance_m, 20.0 * std::log10(arrival.gain));
+   std::fclose(events);
+   std::fclose(arrivals);
+   return true;
+}
+
+static void run_worker(const scenario_t &scenario, uint32_t worker, uint32_t num_workers, std::vector<node_output_t> &outputs,
+                       double realtime_speed, std::chrono::steady_clock::time_point start, generator_statistics_t &statistics)
+{
+   // Each worker owns an interleaved subset of the nodes and advances all of them one second at a time, so that every
+   //    node's stream progresses together as it would in the field
+   std::vector<scenario_node_synthesizer_t> synthesizers;
+   std::vector<size_t> nodes;
+   for (size_t i = worker; i < scenario.nodes.size(); i += num_workers)
+   {
+      synthesizers.emplace_back(scenario, i);
+      nodes.push_back(i);
+   }
+   std::vector<uint8_t> packet(SCENARIO_PACKET_SIZE_BYTES);
+   const uint32_t num_blocks = synthesizers.empty() ? 0 : synthesizers.front().num_blocks();
+   for (uint32_t block = 0; block < num_blocks; ++block)
+   {
+      // A real node can only send each block once it has finished capturing it
+      if (realtime_speed > 0.0)
+         std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>((block + 1) / realtime_speed)));
+      for (size_t i = 0; i < synthesizers.size(); ++i)
+      {
+         node_output_t &output = outputs[nodes[i]];
+         if (output.failed)
+            continue;
+         synthesizers[i].render_packet(block, packet.data());
+         if (output.file)
+            output.failed = (std::fwrite(packet.data(), 1, packet.size(), output.file) != packet.size());
+         else if (output.fd >= 0)
+            output.failed = !write_all(output.fd, packet.data(), packet.size());
+         if (output.failed)
+         {
+            std::fprintf(stderr, "Stopped node %s after %u s: unable to write its stream\n", scenario.nodes[nodes[i]].name.c_str(), block);
+            ++statistics.failed_nodes;
+            continue;
+         }
+         ++statistics.packets;
+         statistics.bytes += packet.size();
+      }
+   }
+}
+
+int main(int argc, char **argv)
+{
+   // Parse command-line arguments
+   scenario_random_config_t random_config;
+   std::string scenario_path, output_dir, truth_dir, server;
+   uint16_t port = DEFAULT_DEVICE_PORT;
+   uint32_t num_threads = std::max(1u, std::thread::hardware_concurrency());
+   double duration_s = 0.0, start_time = 0.0, realtime_speed = 0.0;
+   bool corrected = false;
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg = argv[i];
+      if ((arg == "--scenario") && (i + 1 < argc))
+         scenario_path = argv[++i];
+      else if ((arg == "--nodes") && (i + 1 < argc))
+         random_config.num_nodes = (uint32_t)std::atol(argv[++i]);
+      else if ((arg == "--radius") && (i + 1 < argc))
+         random_config.radius_m = std::atof(argv[++i]);
+      else if ((arg == "--center") && (i + 3 < argc))
+      {
+         random_config.center_lat = std::atof(argv[++i]);
+         random_config.center_lon = std::atof(argv[++i]);
+         random_config.center_height = std::atof(argv[++i]);
+      }
+      else if ((arg == "--events-per-minute") && (i + 1 < argc))
+         random_config.events_per_minute = std::atof(argv[++i]);
+      else if ((arg == "--echoes") && (i + 1 < argc))
+         random_config.echoes_per_node = (uint32_t)std::atol(argv[++i]);
+      else if ((arg == "--seed") && (i + 1 < argc))
+         random_config.seed = (uint32_t)std::atol(argv[++i]);
+      else if ((arg == "--duration") && (i + 1 < argc))
+         duration_s = std::atof(argv[++i]);
+      else if ((arg == "--start") && (i + 1 < argc))
+         start_time = std::atof(argv[++i]);
+      else if (arg == "--corrected")
+         corrected = true;
+      else if ((arg == "--output-dir") && (i + 1 < argc))
+         output_dir = argv[++i];
+      else if ((arg == "--server") && (i + 1 < argc))
+         server = argv[++i];
+      else if ((arg == "--port") && (i + 1 < argc))
+         port = (uint16_t)std::atoi(argv[++i]);
+      else if ((arg == "--realtime") && (i + 1 < argc))
+         realtime_speed = std::atof(argv[++i]);
+      else if ((arg == "--truth") && (i + 1 < argc))
+         truth_dir = argv[++i];
+      else if ((arg == "--threads") && (i + 1 < argc))
+         num_threads = std::max(1, std::atoi(argv[++i]));
+      else
+         usage();
+   }
+
+   // Load or generate the scenario, letting the command line override its timing
+   scenario_t scenario;
+   if (!scenario_path.empty())
+   {
+      std::string error;
+      if (!scenario_load(scenario_path, scenario, error))
+      {
+         std::fprintf(stderr, "Unable to load scenario: %s\n", error.c_str());
+         return 1;
+      }
+   }
+   else
+   {
+      if (duration_s > 0.0)
+         random_config.duration_s = duration_s;
+      scenario = scenario_random(random_config);
+   }
+   if (duration_s > 0.0)
+      scenario.duration_s = duration_s;
+   if (start_time > 0.0)
+      scenario.start_time = start_time;
+   scenario.corrected = scenario.corrected || corrected;
+   if (!output_dir.empty() && truth_dir.empty())
+      truth_dir = output_dir;
+
+   // Open one stream per node, either as a file of framed packets or as a connection to the aggregator
+   std::vector<node_output_t> outputs(scenario.nodes.size());
+   for (const std::string &directory : { output_dir, truth_dir })
+      if (!directory.empty())
+         mkdir(directory.c_str(), 0755);
+   for (size_t i = 0; i < scenario.nodes.size(); ++i)
+   {
+      if (!server.empty())
+         outputs[i].fd = connect_to_server(server, port, (uint32_t)i);
+      else if (!output_dir.empty())
+         outputs[i].file = std::fopen((output_dir + "/" + scenario.nodes[i].name + ".bin").c_str(), "wb");
+      else
+         continue;
+      if (!outputs[i].file && (outputs[i].fd < 0))
+      {
+         std::fprintf(stderr, "Unable to open the stream for node %s\n", scenario.nodes[i].name.c_str());
+         return 1;
+      }
+   }
+   if (!truth_dir.empty() && !write_truth(scenario, truth_dir))
+   {
+      std::fprintf(stderr, "Unable to write ground truth to %s\n", truth_dir.c_str());
+      return 1;
+   }
+
+   // Render every node's stream in parallel
+   num_threads = std::min(num_threads, (uint32_t)scenario.nodes.size());
+   std::printf("Simulating %zu nodes and %zu events over %0.0f s (%s audio) with %u threads\n", scenario.nodes.size(), scenario.events.size(),
+               scenario.duration_s, scenario.corrected ? "drift-corrected" : "raw", num_threads);
+   std::fflush(stdout);
+   generator_statistics_t statistics;
+   const auto start = std::chrono::steady_clock::now();
+   std::vector<std::thread> workers;
+   for (uint32_t worker = 0; worker < num_threads; ++worker)
+      workers.emplace_back(run_worker, std::cref(scenario), worker, num_threads, std::ref(outputs), realtime_speed, start, std::ref(statistics));
+   for (std::thread &worker : workers)
+      worker.join();
+   const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   for (node_output_t &output : outputs)
+   {
+      if (output.file)
+         std::fclose(output.file);
+      if (output.fd >= 0)
+         close(output.fd);
+   }
+
+   // Report throughput in node-seconds of audio per wall-clock second
+   const uint64_t packets = statistics.packets;
+   std::printf("Generated %llu node-seconds (%0.1f MB) in %0.3f s: %0.1f node-seconds/s, %0.1f MB/s, %0.2fx real time\n",
+               (unsigned long long)packets, statistics.bytes / 1.0e6, elapsed, packets / elapsed, statistics.bytes / (elapsed * 1.0e6),
+               scenario.duration_s / elapsed);
+   return statistics.failed_nodes ? 1 : 0;
+}
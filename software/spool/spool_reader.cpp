@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "packet.h"
+#include "spool_format.h"
+}
+
+static constexpr uint32_t AUDIO_SAMPLE_RATE_HZ = 48000;
+static constexpr size_t MAX_PACKET_SIZE_BYTES = sizeof(packet_header_t) + sizeof(packet_audio_t) + (AUDIO_SAMPLE_RATE_HZ * sizeof(int16_t));
+
+// Summary of the contents of a spool image
+struct spool_summary_t
+{
+   size_t valid_batches = 0, corrupt_batches = 0, drained_batches = 0, sequence_gaps = 0;
+   size_t packets = 0, packet_bytes = 0;
+   std::map<uint8_t, size_t> packets_by_type;
+   double first_timestamp = 0.0, last_timestamp = 0.0;
+};
+
+static void usage(void)
+{
+   std::fprintf(stderr,
+      "Usage: spool_reader <image> [--output <packets.bin>] [--drain-rate <bytes/s>] [--include-drained]\n"
+      "       spool_reader <image> --generate <seconds> [--partition-size <bytes>]\n");
+   std::exit(1);
+}
+
+static bool read_image(const std::string &path, std::vector<uint8_t> &image)
+{
+   // Load the entire dumped partition into memory
+   std::ifstream file(path, std::ios::binary);
+   if (!file)
+      return false;
+   image.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+   return true;
+}
+
+static int generate_image(const std::string &path, uint32_t seconds, size_t partition_size)
+{
+   // Fill consecutive batches with framed audio packets exactly as the device spool would
+   std::vector<uint8_t> image(partition_size, 0xFF), batch(SPOOL_BATCH_SIZE_BYTES, 0xFF);
+   const size_t num_blocks = partition_size / SPOOL_BATCH_SIZE_BYTES;
+   std::vector<uint8_t> packet(MAX_PACKET_SIZE_BYTES);
+   uint32_t sequence = 1, data_len = 0, first_packet_offset = SPOOL_NO_PACKET_START, block = 0;
+   auto flush_batch = [&]()
+   {
+      spool_batch_header_t *header = reinterpret_cast<spool_batch_header_t*>(batch.data());
+      spool_finalize_batch(header, sequence++, data_len, first_packet_offset);
+      std::fill(image.begin() + (block * SPOOL_BATCH_SIZE_BYTES), image.begin() + ((block + 1) * SPOOL_BATCH_SIZE_BYTES), 0xFF);
+      std::copy(batch.begin(), batch.begin() + sizeof(spool_batch_header_t) + data_len, image.begin() + (block * SPOOL_BATCH_SIZE_BYTES));
+      block = (block + 1) % num_blocks;
+      data_len = 0;
+      first_packet_offset = SPOOL_NO_PACKET_START;
+   };
+   for (uint32_t second = 0; second < seconds; ++second)
+   {
+      // Build a synthetic one-second audio packet
+      packet_header_t *packet_header = reinterpret_cast<packet_header_t*>(packet.data());
+      packet_audio_t *audio_header = reinterpret_cast<packet_audio_t*>(packet_header + 1);
+      int16_t *samples = reinterpret_cast<int16_t*>(audio_header + 1);
+      packet_init_header(packet_header, PACKET_TYPE_AUDIO, (uint16_t)second, sizeof(packet_audio_t) + (AUDIO_SAMPLE_RATE_HZ * sizeof(int16_t)));
+      *audio_header = { 1400000000.0 + second, 36.1447, -86.8027, 180.0f, 0.0f, 0.0f, 0.0f };
+      for (uint32_t i = 0; i < AUDIO_SAMPLE_RATE_HZ; ++i)
+         samples[i] = (int16_t)((second * 7919u + i * 31u) & 0x7FFF);
+
+      // Append the packet to the batch stream, flushing each batch as it fills
+      size_t offset = 0;
+      if (first_packet_offset == SPOOL_NO_PACKET_START)
+         first_packet_offset = data_len;
+      while (offset < packet.size())
+      {
+         const size_t bytes_to_copy = std::min(packet.size() - offset, (size_t)(SPOOL_BATCH_DATA_BYTES - data_len));
+         std::memcpy(batch.data() + sizeof(spool_batch_header_t) + data_len, packet.data() + offset, bytes_to_copy);
+         data_len += bytes_to_copy;
+         offset += bytes_to_copy;
+         if (data_len == SPOOL_BATCH_DATA_BYTES)
+            flush_batch();
+      }
+   }
+   if (data_len)
+      flush_batch();
+
+   // Write the image out to disk
+   std::ofstream file(path, std::ios::binary);
+   file.write(reinterpret_cast<const char*>(image.data()), image.size());
+   std::printf("Generated %u seconds of audio in %u batches (%zu-batch partition)\n", seconds, sequence - 1, num_blocks);
+   return file ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+   // Parse command-line arguments
+   if (argc < 2)
+      usage();
+   std::string image_path = argv[1], output_path;
+   double drain_rate = 128.0 * 1024.0;
+   bool include_drained = false;
+   long generate_seconds = -1;
+   size_t partition_size = 0x4F0000;
+   for (int i = 2; i < argc; ++i)
+   {
+      const std::string arg = argv[i];
+      if ((arg == "--output") && (i + 1 < argc))
+         output_path = argv[++i];
+      else if ((arg == "--drain-rate") && (i + 1 < argc))
+         drain_rate = std::atof(argv[++i]);
+      else if ((arg == "--generate") && (i + 1 < argc))
+         generate_seconds = std::atol(argv[++i]);
+      else if ((arg == "--partition-size") && (i + 1 < argc))
+         partition_size = std::strtoul(argv[++i], nullptr, 0);
+      else if (arg == "--include-drained")
+         include_drained = true;
+      else
+         usage();
+   }
+   if (generate_seconds >= 0)
+      return generate_image(image_path, (uint32_t)generate_seconds, partition_size);
+
+   // Load the spool image
+   std::vector<uint8_t> image;
+   if (!read_image(image_path, image))
+   {
+      std::fprintf(stderr, "Unable to read spool image: %s\n", image_path.c_str());
+      return 1;
+   }
+
+   // Collect all valid batches in sequence order, as the device drain would visit them
+   const auto start_time = std::chrono::steady_clock::now();
+   spool_summary_t summary;
+   std::vector<const spool_batch_header_t*> batches;
+   for (size_t offset = 0; (offset + SPOOL_BATCH_SIZE_BYTES) <= image.size(); offset += SPOOL_BATCH_SIZE_BYTES)
+   {
+      const spool_batch_header_t *header = reinterpret_cast<const spool_batch_header_t*>(image.data() + offset);
+      if (header->magic == 0xFFFFFFFF)
+         continue;
+      else if (!spool_batch_is_valid(header))
+         ++summary.corrupt_batches;
+      else if ((header->drained == SPOOL_BATCH_DRAINED) && !include_drained)
+         ++summary.drained_batches;
+      else
+         batches.push_back(header);
+   }
+   std::sort(batches.begin(), batches.end(), [](const spool_batch_header_t *a, const spool_batch_header_t *b)
+   {
+      return (int32_t)(a->sequence - b->sequence) < 0;
+   });
+   summary.valid_batches = batches.size();
+
+   // Reassemble the packet stream using the same parser and continuation rules as the firmware
+   std::FILE *output = output_path.empty() ? nullptr : std::fopen(output_path.c_str(), "wb");
+   std::vector<uint8_t> packet_buffer(MAX_PACKET_SIZE_BYTES);
+   packet_parser_t parser;
+   uint32_t last_sequence = 0;
+   for (const spool_batch_header_t *header : batches)
+   {
+      // Skip packets the device already delivered from a partly drained batch
+      uint32_t offset = 0;
+      const uint32_t resume_offset = spool_batch_resume_offset(header);
+      if ((resume_offset != SPOOL_NO_RESUME_OFFSET) && !include_drained)
+      {
+         packet_parser_init(&parser, packet_buffer.data(), packet_buffer.size());
+         offset = resume_offset;
+      }
+      else if (header->sequence != (last_sequence + 1))
+      {
+         summary.sequence_gaps += (last_sequence != 0);
+         packet_parser_init(&parser, packet_buffer.data(), packet_buffer.size());
+         offset = (header->first_packet_offset == SPOOL_NO_PACKET_START) ? header->data_len : header->first_packet_offset;
+      }
+      last_sequence = header->sequence;
+      const uint8_t *data = reinterpret_cast<const uint8_t*>(header + 1);
+      while (offset < header->data_len)
+      {
+         const packet_header_t *packet;
+         const uint8_t *payload;
+         offset += packet_parser_consume(&parser, data + offset, header->data_len - offset, &packet, &payload);
+         if (packet)
+         {
+            ++summary.packets;
+            ++summary.packets_by_type[packet->type];
+            summary.packet_bytes += sizeof(packet_header_t) + packet->length;
+            if (((packet->type == PACKET_TYPE_AUDIO) && (packet->length >= sizeof(packet_audio_t))) ||
+                ((packet->type == PACKET_TYPE_AUDIO_DECIMATED) && (packet->length >= sizeof(packet_audio_decimated_t))))
+            {
+               // Both audio packet headers begin with the block timestamp
+               const double timestamp = reinterpret_cast<const packet_audio_t*>(payload)->timestamp;
+               if (summary.first_timestamp == 0.0)
+                  summary.first_timestamp = timestamp;
+               summary.last_timestamp = timestamp;
+            }
+            if (output)
+            {
+               packet_header_t spooled_header = *packet;
+               spooled_header.flags |= PACKET_FLAG_SPOOLED;
+               std::fwrite(&spooled_header, sizeof(spooled_header), 1, output);
+               std::fwrite(payload, 1, packet->length, output);
+            }
+         }
+      }
+   }
+   if (output)
+      std::fclose(output);
+   const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+   // Report the spool contents and drain throughput
+   std::printf("Batches: %zu pending, %zu drained, %zu corrupt, %zu sequence gaps\n",
+               summary.valid_batches, summary.drained_batches, summary.corrupt_batches, summary.sequence_gaps);
+   std::printf("Packets: %zu (%zu bytes)\n", summary.packets, summary.packet_bytes);
+   for (const auto &[type, count] : summary.packets_by_type)
+      std::printf("   type 0x%02X: %zu\n", type, count);
+   if (summary.first_timestamp != 0.0)
+      std::printf("Audio time span: [%0.6f, %0.6f]\n", summary.first_timestamp, summary.last_timestamp);
+   std::printf("Verify+reassemble throughput: %0.1f MB/s (%0.3f ms for %zu bytes)\n",
+               (summary.valid_batches * SPOOL_BATCH_SIZE_BYTES) / (elapsed * 1.0e6), elapsed * 1.0e3, summary.valid_batches * (size_t)SPOOL_BATCH_SIZE_BYTES);
+   std::printf("Drain time at %0.0f bytes/s: %0.1f s\n", drain_rate, summary.packet_bytes / drain_rate);
+   return 0;
+}
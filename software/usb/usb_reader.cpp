@@ -0,0 +1,380 @@
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <netdb.h>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+#include <libusb.h>
+#include "shm_ring.hpp"
+#include "socket_io.hpp"
+
+extern "C" {
+#include "packet.h"
+}
+
+static constexpr uint16_t DEFAULT_VENDOR_ID = 0x303A;
+static constexpr uint16_t DEFAULT_PRODUCT_ID = 0x4001;
+static constexpr uint8_t VENDOR_INTERFACE_CLASS = 0xFF;
+static constexpr size_t MAX_PACKET_SIZE_BYTES = sizeof(packet_header_t) + sizeof(packet_audio_t) + (48000 * sizeof(int16_t));
+
+// Running totals for everything received from the device
+struct reader_statistics_t
+{
+   size_t bytes = 0, packets = 0, sequence_gaps = 0, transfers = 0, short_transfers = 0;
+   std::map<uint8_t, size_t> packets_by_type;
+   bool have_sequence = false;
+   uint16_t last_sequence = 0;
+};
+
+// Received-data handling shared by the bulk and CDC-ACM transports
+struct reader_t
+{
+   std::vector<uint8_t> parser_buffer = std::vector<uint8_t>(MAX_PACKET_SIZE_BYTES);
+   packet_parser_t parser;
+   reader_statistics_t statistics;
+   FILE *output = nullptr;
+   int forward_fd = -1;
+   shm_ring_writer_t *ring = nullptr;
+};
+
+static std::atomic<bool> reader_running(true);
+
+static void stop_reader(int)
+{
+   reader_running = false;
+}
+
+static void usage(void)
+{
+   std::fprintf(stderr,
+      "Usage: usb_reader [--vid <id>] [--pid <id>] [--transfers <count>] [--transfer-size <bytes>]\n"
+      "                  [--duration <seconds>] [--output <packets.bin>] [--forward <host> [--port <port>]]\n"
+      "                  [--shm <ring name>]\n"
+      "       usb_reader --tty <device> [--duration <seconds>] [--output <packets.bin>] [--forward <host> [--port <port>]]\n"
+      "                  [--shm <ring name>]\n");
+   std::exit(1);
+}
+
+static int connect_to_server(const std::string &server, uint16_t port)
+{
+   // Relay the device's stream to the aggregator as though the device were networked
+   addrinfo hints = {}, *result = nullptr;
+   hints.ai_family = AF_INET;
+   hints.ai_socktype = SOCK_STREAM;
+   if (getaddrinfo(server.c_str(), std::to_string(port).c_str(), &hints, &result) != 0)
+      return -1;
+   int fd = socket(AF_INET, SOCK_STREAM, 0);
+   if ((fd >= 0) && (connect(fd, result->ai_addr, result->ai_addrlen) != 0))
+   {
+      close(fd);
+      fd = -1;
+   }
+   freeaddrinfo(result);
+   return fd;
+}
+
+static void process_data(reader_t &reader, const uint8_t *data, size_t data_len)
+{
+   // Pass raw bytes through untouched, then parse them to count packets, detect lost ones and share each complete packet
+   //    with local consumers exactly as received
+   reader.statistics.bytes += data_len;
+   if (reader.output)
+      std::fwrite(data, 1, data_len, reader.output);
+   if ((reader.forward_fd >= 0) && !write_all(reader.forward_fd, data, data_len))
+   {
+      std::fprintf(stderr, "Lost connection to the aggregator\n");
+      close(reader.forward_fd);
+      reader.forward_fd = -1;
+   }
+   while (data_len)
+   {
+      const packet_header_t *header;
+      const uint8_t *payload;
+      const size_t consumed = packet_parser_consume(&reader.parser, data, data_len, &header, &payload);
+      data += consumed;
+      data_len -= consumed;
+      if (header)
+      {
+         ++reader.statistics.packets;
+         ++reader.statistics.packets_by_type[header->type];
+         if (reader.statistics.have_sequence && (header->sequence != (uint16_t)(reader.statistics.last_sequence + 1)))
+            ++reader.statistics.sequence_gaps;
+         reader.statistics.have_sequence = true;
+         reader.statistics.last_sequence = header->sequence;
+         if (reader.ring)
+            reader.ring->publish(header, sizeof(packet_header_t) + header->length);
+      }
+   }
+}
+
+static double cpu_seconds(void)
+{
+   // Total user and system time consumed by this process, including libusb's event handling
+   rusage usage = {};
+   getrusage(RUSAGE_SELF, &usage);
+   return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + (1e-6 * (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec));
+}
+
+static void print_progress(const reader_statistics_t &statistics, size_t last_bytes, double interval_seconds, double cpu_interval_seconds)
+{
+   std::printf("%8.2f MB/s  %8zu packets  %4zu gaps  %5.1f%% CPU\n", (double)(statistics.bytes - last_bytes) / (1e6 * interval_seconds),
+               statistics.packets, statistics.sequence_gaps, 100.0 * cpu_interval_seconds / interval_seconds);
+   std::fflush(stdout);
+}
+
+static void print_summary(const reader_statistics_t &statistics, double elapsed_seconds, double cpu_used_seconds)
+{
+   std::printf("\nReceived %zu bytes in %.1f s: %.2f MB/s, %.1f packets/s, %zu sequence gaps\n", statistics.bytes, elapsed_seconds,
+               (double)statistics.bytes / (1e6 * elapsed_seconds), (double)statistics.packets / elapsed_seconds, statistics.sequence_gaps);
+   std::printf("CPU: %.2f s (%.1f%% of one core, %.2f ms per MB)\n", cpu_used_seconds, 100.0 * cpu_used_seconds / elapsed_seconds,
+               statistics.bytes ? (1e3 * cpu_used_seconds / ((double)statistics.bytes / 1e6)) : 0.0);
+   if (statistics.transfers)
+      std::printf("Bulk transfers: %zu completed, %zu short (%.0f bytes average)\n", statistics.transfers, statistics.short_transfers,
+                  (double)statistics.bytes / (double)statistics.transfers);
+   for (const auto &entry : statistics.packets_by_type)
+      std::printf("   Type 0x%02X: %zu packets\n", entry.first, entry.second);
+}
+
+template <typename Poll>
+static void run_reader(reader_t &reader, double duration, Poll poll)
+{
+   // Service the transport until the requested duration elapses, reporting throughput and CPU once per second
+   const auto start_time = std::chrono::steady_clock::now();
+   auto last_report = start_time;
+   const double start_cpu = cpu_seconds();
+   double last_cpu = start_cpu;
+   size_t last_bytes = 0;
+   while (reader_running && poll())
+   {
+      const auto now = std::chrono::steady_clock::now();
+      const double interval = std::chrono::duration<double>(now - last_report).count();
+      if (interval >= 1.0)
+      {
+         const double cpu = cpu_seconds();
+         print_progress(reader.statistics, last_bytes, interval, cpu - last_cpu);
+         last_report = now;
+         last_cpu = cpu;
+         last_bytes = reader.statistics.bytes;
+      }
+      if ((duration > 0.0) && (std::chrono::duration<double>(now - start_time).count() >= duration))
+         break;
+   }
+   print_summary(reader.statistics, std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count(), cpu_seconds() - start_cpu);
+}
+
+static void LIBUSB_CALL transfer_complete(libusb_transfer *transfer)
+{
+   // Consume the completed transfer and immediately queue it again so that the endpoint is never left without a request
+   reader_t &reader = *static_cast<reader_t*>(transfer->user_data);
+   if ((transfer->status == LIBUSB_TRANSFER_COMPLETED) || (transfer->status == LIBUSB_TRANSFER_TIMED_OUT))
+   {
+      ++reader.statistics.transfers;
+      if (transfer->actual_length < transfer->length)
+         ++reader.statistics.short_transfers;
+      process_data(reader, transfer->buffer, (size_t)transfer->actual_length);
+      if (reader_running && (libusb_submit_transfer(transfer) == 0))
+         return;
+   }
+   else if (transfer->status != LIBUSB_TRANSFER_CANCELLED)
+      std::fprintf(stderr, "Bulk transfer failed: %s\n", libusb_error_name(transfer->status));
+   transfer->user_data = nullptr;
+}
+
+static bool find_bulk_interface(libusb_device *device, int &interface_number, uint8_t &endpoint)
+{
+   // Locate the vendor-specific interface and its bulk IN endpoint in the active configuration
+   libusb_config_descriptor *config = nullptr;
+   if (libusb_get_active_config_descriptor(device, &config) != 0)
+      return false;
+   bool found = false;
+   for (int i = 0; !found && (i < config->bNumInterfaces); ++i)
+   {
+      const libusb_interface_descriptor &interface = config->interface[i].altsetting[0];
+      if (interface.bInterfaceClass != VENDOR_INTERFACE_CLASS)
+         continue;
+      for (int e = 0; !found && (e < interface.bNumEndpoints); ++e)
+         if (((interface.endpoint[e].bmAttributes & 0x03) == LIBUSB_TRANSFER_TYPE_BULK) && (interface.endpoint[e].bEndpointAddress & LIBUSB_ENDPOINT_IN))
+         {
+            interface_number = interface.bInterfaceNumber;
+            endpoint = interface.endpoint[e].bEndpointAddress;
+            found = true;
+         }
+   }
+   libusb_free_config_descriptor(config);
+   return found;
+}
+
+static int read_bulk(reader_t &reader, uint16_t vendor_id, uint16_t product_id, size_t num_transfers, size_t transfer_size, double duration)
+{
+   // Open the device and claim its bulk interface, leaving the CDC-ACM interfaces to the kernel's serial driver
+   libusb_context *context = nullptr;
+   if (libusb_init(&context) != 0)
+   {
+      std::fprintf(stderr, "Unable to initialize libusb\n");
+      return 1;
+   }
+   libusb_device_handle *handle = libusb_open_device_with_vid_pid(context, vendor_id, product_id);
+   int interface_number = -1;
+   uint8_t endpoint = 0;
+   if (!handle || !find_bulk_interface(libusb_get_device(handle), interface_number, endpoint) || (libusb_claim_interface(handle, interface_number) != 0))
+   {
+      std::fprintf(stderr, "Unable to open the bulk interface of device %04x:%04x (is USB_VENDOR_TRANSPORT_ENABLED set?)\n", vendor_id, product_id);
+      if (handle)
+         libusb_close(handle);
+      libusb_exit(context);
+      return 1;
+   }
+
+   // Keep several large transfers queued at all times so that the host controller always has a buffer to fill
+   std::vector<std::vector<uint8_t>> buffers(num_transfers, std::vector<uint8_t>(transfer_size));
+   std::vector<libusb_transfer*> transfers;
+   for (size_t i = 0; i < num_transfers; ++i)
+   {
+      libusb_transfer *transfer = libusb_alloc_transfer(0);
+      libusb_fill_bulk_transfer(transfer, handle, endpoint, buffers[i].data(), (int)transfer_size, transfer_complete, &reader, 0);
+      if (libusb_submit_transfer(transfer) != 0)
+      {
+         libusb_free_transfer(transfer);
+         break;
+      }
+      transfers.push_back(transfer);
+   }
+   std::printf("Reading interface %d endpoint 0x%02X with %zu x %zu-byte transfers\n", interface_number, endpoint, transfers.size(), transfer_size);
+
+   // Handle completions until finished, then cancel and drain everything still outstanding
+   run_reader(reader, duration, [&]()
+   {
+      timeval timeout = { 0, 100000 };
+      return libusb_handle_events_timeout_completed(context, &timeout, nullptr) == 0;
+   });
+   reader_running = false;
+   for (libusb_transfer *transfer : transfers)
+      if (transfer->user_data)
+         libusb_cancel_transfer(transfer);
+   for (bool pending = true; pending; )
+   {
+      pending = false;
+      for (libusb_transfer *transfer : transfers)
+         pending = pending || transfer->user_data;
+      if (pending)
+      {
+         timeval timeout = { 0, 100000 };
+         libusb_handle_events_timeout_completed(context, &timeout, nullptr);
+      }
+   }
+   for (libusb_transfer *transfer : transfers)
+      libusb_free_transfer(transfer);
+   libusb_release_interface(handle, interface_number);
+   libusb_close(handle);
+   libusb_exit(context);
+   return 0;
+}
+
+static int read_tty(reader_t &reader, const std::string &path, double duration)
+{
+   // Read the CDC-ACM serial stream in raw mode, for comparison against the bulk transport
+   const int fd = open(path.c_str(), O_RDONLY | O_NOCTTY);
+   if (fd < 0)
+   {
+      std::fprintf(stderr, "Unable to open %s\n", path.c_str());
+      return 1;
+   }
+   termios tty = {};
+   tcgetattr(fd, &tty);
+   cfmakeraw(&tty);
+   tty.c_cc[VMIN] = 0;
+   tty.c_cc[VTIME] = 1;
+   tcsetattr(fd, TCSANOW, &tty);
+   std::vector<uint8_t> buffer(64 * 1024);
+   run_reader(reader, duration, [&]()
+   {
+      const ssize_t bytes_read = read(fd, buffer.data(), buffer.size());
+      if (bytes_read > 0)
+         process_data(reader, buffer.data(), (size_t)bytes_read);
+      return bytes_read >= 0;
+   });
+   close(fd);
+   return 0;
+}
+
+int main(int argc, char **argv)
+{
+   // Parse command-line arguments
+   uint16_t vendor_id = DEFAULT_VENDOR_ID, product_id = DEFAULT_PRODUCT_ID, port = 5000;
+   size_t num_transfers = 8, transfer_size = 64 * 1024;
+   double duration = 0.0;
+   std::string tty_path, output_path, server, ring_name;
+   for (int i = 1; i < argc; ++i)
+   {
+      const std::string arg = argv[i];
+      if ((arg == "--vid") && (i + 1 < argc))
+         vendor_id = (uint16_t)std::strtoul(argv[++i], nullptr, 16);
+      else if ((arg == "--pid") && (i + 1 < argc))
+         product_id = (uint16_t)std::strtoul(argv[++i], nullptr, 16);
+      else if ((arg == "--transfers") && (i + 1 < argc))
+         num_transfers = std::strtoul(argv[++i], nullptr, 0);
+      else if ((arg == "--transfer-size") && (i + 1 < argc))
+         transfer_size = std::strtoul(argv[++i], nullptr, 0);
+      else if ((arg == "--duration") && (i + 1 < argc))
+         duration = std::atof(argv[++i]);
+      else if ((arg == "--tty") && (i + 1 < argc))
+         tty_path = argv[++i];
+      else if ((arg == "--output") && (i + 1 < argc))
+         output_path = argv[++i];
+      else if ((arg == "--forward") && (i + 1 < argc))
+         server = argv[++i];
+      else if ((arg == "--port") && (i + 1 < argc))
+         port = (uint16_t)std::atoi(argv[++i]);
+      else if ((arg == "--shm") && (i + 1 < argc))
+         ring_name = argv[++i];
+      else
+         usage();
+   }
+   if (!num_transfers || (transfer_size < 512) || (transfer_size % 512))
+   {
+      std::fprintf(stderr, "Transfer size must be a nonzero multiple of 512 bytes\n");
+      return 1;
+   }
+
+   // Open the optional destinations for the received stream
+   reader_t reader;
+   packet_parser_init(&reader.parser, reader.parser_buffer.data(), reader.parser_buffer.size());
+   if (!output_path.empty() && !(reader.output = std::fopen(output_path.c_str(), "wb")))
+   {
+      std::fprintf(stderr, "Unable to open output file: %s\n", output_path.c_str());
+      return 1;
+   }
+   if (!server.empty() && ((reader.forward_fd = connect_to_server(server, port)) < 0))
+   {
+      std::fprintf(stderr, "Unable to connect to aggregator at %s:%u\n", server.c_str(), port);
+      return 1;
+   }
+   shm_ring_writer_t ring;
+   if (!ring_name.empty())
+   {
+      if (!ring.open(ring_name))
+      {
+         std::fprintf(stderr, "Unable to open shared-memory ring: %s\n", ring_name.c_str());
+         return 1;
+      }
+      reader.ring = &ring;
+   }
+
+   // Read from the selected transport until the duration elapses or the user interrupts
+   std::signal(SIGINT, stop_reader);
+   const int result = tty_path.empty() ? read_bulk(reader, vendor_id, product_id, num_transfers, transfer_size, duration) : read_tty(reader, tty_path, duration);
+   if (reader.output)
+      std::fclose(reader.output);
+   if (reader.forward_fd >= 0)
+      close(reader.forward_fd);
+   return result;
+}